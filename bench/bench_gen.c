@@ -0,0 +1,526 @@
+/**************************************************************************
+ **
+ ** sngrep - SIP Messages flow viewer
+ **
+ ** Copyright (C) 2013,2014 Ivan Alonso (Kaian)
+ ** Copyright (C) 2013,2014 Irontec SL. All rights reserved.
+ **
+ ** This program is free software: you can redistribute it and/or modify
+ ** it under the terms of the GNU General Public License as published by
+ ** the Free Software Foundation, either version 3 of the License, or
+ ** (at your option) any later version.
+ **
+ ** This program is distributed in the hope that it will be useful,
+ ** but WITHOUT ANY WARRANTY; without even the implied warranty of
+ ** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ ** GNU General Public License for more details.
+ **
+ ** You should have received a copy of the GNU General Public License
+ ** along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ **
+ ****************************************************************************/
+/**
+ * @file bench_gen.c
+ * @author Ivan Alonso [aka Kaian] <kaian@irontec.com>
+ *
+ * @brief Synthetic SIP traffic generator
+ *
+ * Write a pcap file with SIP dialogs that can be used to benchmark
+ * sngrep. Generated files only depend on the given options, so the
+ * same options (and seed) always create the same file.
+ *
+ * Dialogs are generated in groups of concurrent dialogs, interleaving
+ * their messages. Each dialog is an INVITE transaction with SDP offer
+ * and answer, optional INFO transactions to reach the requested number
+ * of messages, and a BYE transaction.
+ *
+ * Usage: bench_gen [options] -o file.pcap
+ *   -d dialogs        Number of dialogs (default 10000)
+ *   -m messages       Messages per dialog (default 7, minimum 3)
+ *   -c concurrent     Dialogs with interleaved messages (default 100)
+ *   -r percent        Retransmitted messages (default 0)
+ *   -f percent        Messages sent in two IP fragments (default 0)
+ *   -t percent        Dialogs using TCP transport (default 0)
+ *   -s bytes          Extra header bytes added to each message (default 0)
+ *   -n packets        Non SIP (RTP) packets written after each message (default 0)
+ *   -g                Write a pcapng file instead of pcap
+ *   -x                Add packet records with oversized captured length (and
+ *                     with invalid timestamp resolution in pcapng files)
+ *   -S seed           Random seed (default 1)
+ */
+#include "config.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <stdint.h>
+#include <arpa/inet.h>
+
+//! Max size of a generated SIP message
+#define GEN_MAX_PAYLOAD 65000
+
+/**
+ * @brief Generator options
+ */
+struct gen_options {
+    //! Number of dialogs
+    int dialogs;
+    //! Messages per dialog
+    int messages;
+    //! Concurrent dialogs
+    int concurrent;
+    //! Retransmission percent
+    int retrans;
+    //! Fragmented messages percent
+    int fragment;
+    //! TCP dialogs percent
+    int tcp;
+    //! Extra header bytes
+    int padding;
+    //! Non SIP packets per message
+    int noise;
+    //! Random seed
+    uint64_t seed;
+};
+
+//! Generator random state
+static uint64_t gen_state;
+//! Packet timestamp (usecs)
+static uint64_t gen_time = 1400000000ULL * 1000000;
+//! IP identification of next packet
+static uint16_t gen_ipid;
+//! Output file
+static FILE *gen_out;
+//! Write pcapng blocks instead of pcap records
+static int gen_pcapng;
+
+/**
+ * @brief Get next random number (xorshift64*)
+ */
+static uint32_t
+gen_random()
+{
+    gen_state ^= gen_state >> 12;
+    gen_state ^= gen_state << 25;
+    gen_state ^= gen_state >> 27;
+    return (gen_state * 2685821657736338717ULL) >> 32;
+}
+
+/**
+ * @brief Check a random event with given percent of probability
+ */
+static int
+gen_chance(int percent)
+{
+    return percent > 0 && (int) (gen_random() % 100) < percent;
+}
+
+/**
+ * @brief Calculate IP header checksum
+ */
+static uint16_t
+gen_checksum(const u_char *data, int len)
+{
+    uint32_t sum = 0;
+    int i;
+
+    for (i = 0; i + 1 < len; i += 2)
+        sum += (data[i] << 8) | data[i + 1];
+    while (sum >> 16)
+        sum = (sum & 0xffff) + (sum >> 16);
+    return htons(~sum & 0xffff);
+}
+
+/**
+ * @brief Write an Ethernet frame with an IPv4 packet
+ *
+ * @param src Source address
+ * @param dst Destination address
+ * @param proto IP protocol
+ * @param off Fragment offset and flags (host byte order)
+ * @param data IP payload
+ * @param len IP payload length
+ */
+static void
+gen_write_ip(uint32_t src, uint32_t dst, int proto, uint16_t id, uint16_t off, const u_char *data,
+             int len)
+{
+    u_char frame[14 + 20];
+    uint32_t rec[7], pad = 0;
+    int caplen = sizeof(frame) + len;
+
+    // Record header
+    if (gen_pcapng) {
+        // Enhanced packet block, data padded to 32 bits
+        rec[0] = 6;
+        rec[1] = 32 + ((caplen + 3) & ~3);
+        rec[2] = 0;
+        rec[3] = gen_time >> 32;
+        rec[4] = gen_time & 0xffffffff;
+        rec[5] = rec[6] = caplen;
+        fwrite(rec, sizeof(uint32_t), 7, gen_out);
+    } else {
+        rec[0] = gen_time / 1000000;
+        rec[1] = gen_time % 1000000;
+        rec[2] = rec[3] = caplen;
+        fwrite(rec, sizeof(uint32_t), 4, gen_out);
+    }
+
+    // Ethernet header
+    memset(frame, 0, sizeof(frame));
+    frame[0] = 0x02;
+    frame[6] = 0x02;
+    frame[11] = 0x01;
+    frame[12] = 0x08;
+
+    // IP header
+    frame[14] = 0x45;
+    *(uint16_t *) (frame + 16) = htons(20 + len);
+    *(uint16_t *) (frame + 18) = htons(id);
+    *(uint16_t *) (frame + 20) = htons(off);
+    frame[22] = 64;
+    frame[23] = proto;
+    memcpy(frame + 26, &src, 4);
+    memcpy(frame + 30, &dst, 4);
+    *(uint16_t *) (frame + 24) = gen_checksum(frame + 14, 20);
+
+    fwrite(frame, sizeof(frame), 1, gen_out);
+    fwrite(data, len, 1, gen_out);
+
+    // Block padding and trailing length
+    if (gen_pcapng) {
+        fwrite(&pad, 1, ((caplen + 3) & ~3) - caplen, gen_out);
+        fwrite(&rec[1], sizeof(uint32_t), 1, gen_out);
+    }
+
+    gen_time += 100;
+}
+
+/**
+ * @brief Write the file header
+ *
+ * Pcapng files have a section header block and an Ethernet interface.
+ */
+static void
+gen_write_header()
+{
+    uint32_t pcaphdr[6] = { 0xa1b2c3d4, 0x00040002, 0, 0, 65535, 1 };
+    uint32_t shb[7] = { 0x0A0D0D0A, 28, 0x1A2B3C4D, 1, 0xffffffff, 0xffffffff, 28 };
+    uint32_t idb[5] = { 1, 20, 1, 65535, 20 };
+
+    if (gen_pcapng) {
+        fwrite(shb, sizeof(shb), 1, gen_out);
+        fwrite(idb, sizeof(idb), 1, gen_out);
+    } else {
+        fwrite(pcaphdr, sizeof(pcaphdr), 1, gen_out);
+    }
+}
+
+/**
+ * @brief Write a packet record with an oversized captured length
+ *
+ * In pcapng files the block itself is valid and readers must skip it.
+ * An interface with a timestamp resolution that doesn't fit in 64 bits
+ * and an empty packet of that interface are also written.
+ * In pcap files there is no way to skip it, so it must end the file.
+ */
+static void
+gen_write_malformed()
+{
+    static uint32_t ifid = 0;
+    uint32_t epb[9] = { 6, 36, 0, 0, 0, 0xfffffff0, 0xfffffff0, 0, 36 };
+    uint32_t idb[4] = { 1, 28, 1, 65535 };
+    uint16_t tsresol[2] = { 9, 1 };
+    u_char resol[4] = { 0x80 | 64 };
+    uint32_t empty[8] = { 6, 32, 0, 0, 1, 0, 0, 32 };
+    uint32_t rec[5] = { 0, 0, 0xfffffff0, 0xfffffff0, 0 };
+
+    if (gen_pcapng) {
+        fwrite(epb, sizeof(epb), 1, gen_out);
+        fwrite(idb, sizeof(idb), 1, gen_out);
+        fwrite(tsresol, sizeof(tsresol), 1, gen_out);
+        fwrite(resol, sizeof(resol), 1, gen_out);
+        fwrite(&idb[1], sizeof(uint32_t), 1, gen_out);
+        // Interfaces are numbered in file order, after the header one
+        empty[2] = ++ifid;
+        fwrite(empty, sizeof(empty), 1, gen_out);
+    } else {
+        fwrite(rec, sizeof(rec), 1, gen_out);
+    }
+}
+
+/**
+ * @brief Write a SIP message packet
+ */
+static void
+gen_write_packet(struct gen_options *opts, int tcp, uint32_t src, uint16_t sport, uint32_t dst,
+                 uint16_t dport, uint32_t *tcpseq, const char *payload, int len)
+{
+    static u_char data[GEN_MAX_PAYLOAD + 40];
+    uint16_t id = gen_ipid++;
+    int hlen, first;
+
+    // Transport header
+    memset(data, 0, 20);
+    *(uint16_t *) (data) = htons(sport);
+    *(uint16_t *) (data + 2) = htons(dport);
+    if (tcp) {
+        hlen = 20;
+        *(uint32_t *) (data + 4) = htonl(*tcpseq);
+        *(uint32_t *) (data + 8) = htonl(1);
+        data[12] = 5 << 4;
+        data[13] = 0x18;
+        *(uint16_t *) (data + 14) = htons(65535);
+        *tcpseq += len;
+    } else {
+        hlen = 8;
+        *(uint16_t *) (data + 4) = htons(8 + len);
+    }
+    memcpy(data + hlen, payload, len);
+
+    if (gen_chance(opts->fragment)) {
+        // Split packet in two fragments, first one size must be multiple of 8
+        first = ((hlen + len) / 2) & ~7;
+        gen_write_ip(src, dst, (tcp) ? 6 : 17, id, 0x2000, data, first);
+        gen_write_ip(src, dst, (tcp) ? 6 : 17, id, first / 8, data + first, hlen + len - first);
+    } else {
+        gen_write_ip(src, dst, (tcp) ? 6 : 17, id, 0x4000, data, hlen + len);
+    }
+}
+
+/**
+ * @brief Write a RTP packet with random payload
+ */
+static void
+gen_write_noise(uint32_t src, uint32_t dst)
+{
+    u_char data[8 + 12 + 160];
+    int i;
+
+    // UDP header
+    *(uint16_t *) (data) = htons(10000);
+    *(uint16_t *) (data + 2) = htons(20000);
+    *(uint16_t *) (data + 4) = htons(sizeof(data));
+    *(uint16_t *) (data + 6) = 0;
+
+    // RTP header (PCMU) and payload
+    for (i = 8; i < (int) sizeof(data); i++)
+        data[i] = gen_random();
+    data[8] = 0x80;
+    data[9] = 0;
+
+    gen_write_ip(src, dst, 17, gen_ipid++, 0x4000, data, sizeof(data));
+}
+
+/**
+ * @brief Create the text of a dialog message
+ *
+ * @return message length
+ */
+static int
+gen_message(struct gen_options *opts, int dialog, int number, int tcp, char *out,
+            int *request)
+{
+    char sdp[512] = "", padding[GEN_MAX_PAYLOAD / 2] = "";
+    const char *first, *method;
+    int msgcnt = opts->messages, cseq = 1, len;
+    // INFO transactions added between INVITE and BYE
+    int infos = (msgcnt > 7) ? (msgcnt - 7 + 1) / 2 : 0;
+
+    // Last two messages are always the BYE transaction
+    if (number >= msgcnt - 2) {
+        method = "BYE";
+        cseq = 2 + infos;
+        first = (number == msgcnt - 2) ? "BYE sip:bob@10.1.0.2 SIP/2.0" : "SIP/2.0 200 OK";
+    } else if (number < 5) {
+        const char *invite[] = {
+            "INVITE sip:bob@10.1.0.2 SIP/2.0", "SIP/2.0 100 Trying", "SIP/2.0 180 Ringing",
+            "SIP/2.0 200 OK", "ACK sip:bob@10.1.0.2 SIP/2.0"
+        };
+        first = invite[number];
+        method = (number == 4) ? "ACK" : "INVITE";
+        // Offer in INVITE and answer in 200 OK
+        if (number == 0 || number == 3) {
+            sprintf(sdp, "v=0\r\no=- %d 1 IN IP4 10.1.%d.%d\r\ns=-\r\nc=IN IP4 10.1.%d.%d\r\n"
+                    "t=0 0\r\nm=audio %d RTP/AVP 0 8 101\r\na=rtpmap:101 telephone-event/8000\r\n",
+                    dialog, number ? 0 : 1, number ? 2 : 1, number ? 0 : 1, number ? 2 : 1,
+                    10000 + (dialog % 20000) * 2);
+        }
+    } else {
+        // INFO transactions
+        method = "INFO";
+        cseq = 2 + (number - 5) / 2;
+        first = ((number - 5) % 2) ? "SIP/2.0 200 OK" : "INFO sip:bob@10.1.0.2 SIP/2.0";
+    }
+
+    if (opts->padding > 0) {
+        len = (opts->padding < (int) sizeof(padding) - 1) ? opts->padding : (int) sizeof(padding) - 1;
+        memset(padding, 'x', len);
+        padding[len] = '\0';
+    }
+
+    *request = strncmp(first, "SIP/2.0", 7) != 0;
+
+    return sprintf(out, "%s\r\n"
+                   "Via: SIP/2.0/%s 10.1.1.1:5060;branch=z9hG4bK%08x%d\r\n"
+                   "Max-Forwards: 70\r\n"
+                   "From: \"User %d\" <sip:user%d@10.1.1.1>;tag=%08x\r\n"
+                   "To: <sip:bob@10.1.0.2>%s\r\n"
+                   "Call-ID: %08x-%d@bench.sngrep\r\n"
+                   "CSeq: %d %s\r\n"
+                   "Contact: <sip:user%d@10.1.1.1:5060>\r\n"
+                   "User-Agent: sngrep bench\r\n"
+                   "%s%s%s"
+                   "%s"
+                   "Content-Length: %d\r\n\r\n%s",
+                   first, (tcp) ? "TCP" : "UDP", dialog, cseq,
+                   dialog, dialog, dialog * 2654435761U,
+                   (number > 1) ? ";tag=b0b" : "",
+                   dialog * 2654435761U, dialog,
+                   cseq, method, dialog,
+                   padding[0] ? "X-Padding: " : "", padding, padding[0] ? "\r\n" : "",
+                   sdp[0] ? "Content-Type: application/sdp\r\n" : "",
+                   (int) strlen(sdp), sdp);
+}
+
+/**
+ * @brief Print usage information
+ */
+static void
+gen_usage()
+{
+    fprintf(stderr, "Usage: bench_gen [-d dialogs] [-m messages] [-c concurrent] [-r retrans%%]\n"
+            "                 [-f fragment%%] [-t tcp%%] [-s padding] [-n noise] [-S seed]\n"
+            "                 [-g] [-x] -o file.pcap\n");
+}
+
+int
+main(int argc, char *argv[])
+{
+    struct gen_options opts = { 10000, 7, 100, 0, 0, 0, 0, 0, 1 };
+    static char payload[GEN_MAX_PAYLOAD];
+    const char *outfile = NULL;
+    uint32_t alice, bob, src, dst, *tcpseq;
+    uint16_t sport, dport;
+    int opt, first, count, dialog, number, len, request, tcp, *tcpdialog, i, malformed = 0;
+    long packets = 0, noise = 0;
+
+    while ((opt = getopt(argc, argv, "d:m:c:r:f:t:s:n:gxS:o:h")) != -1) {
+        switch (opt) {
+            case 'd':
+                opts.dialogs = atoi(optarg);
+                break;
+            case 'm':
+                opts.messages = atoi(optarg);
+                break;
+            case 'c':
+                opts.concurrent = atoi(optarg);
+                break;
+            case 'r':
+                opts.retrans = atoi(optarg);
+                break;
+            case 'f':
+                opts.fragment = atoi(optarg);
+                break;
+            case 't':
+                opts.tcp = atoi(optarg);
+                break;
+            case 's':
+                opts.padding = atoi(optarg);
+                break;
+            case 'n':
+                opts.noise = atoi(optarg);
+                break;
+            case 'g':
+                gen_pcapng = 1;
+                break;
+            case 'x':
+                malformed = 1;
+                break;
+            case 'S':
+                opts.seed = strtoull(optarg, NULL, 10);
+                break;
+            case 'o':
+                outfile = optarg;
+                break;
+            default:
+                gen_usage();
+                return 1;
+        }
+    }
+
+    if (!outfile || opts.dialogs <= 0 || opts.messages < 3 || opts.concurrent <= 0) {
+        gen_usage();
+        return 1;
+    }
+
+    if (!(gen_out = fopen(outfile, "w"))) {
+        perror(outfile);
+        return 1;
+    }
+    gen_write_header();
+
+    // Oversized block that pcapng readers must skip
+    if (malformed && gen_pcapng)
+        gen_write_malformed();
+
+    gen_state = opts.seed * 0x9E3779B97F4A7C15ULL + 1;
+    alice = inet_addr("10.1.1.1");
+    bob = inet_addr("10.1.0.2");
+    tcpseq = malloc(sizeof(uint32_t) * opts.concurrent);
+    tcpdialog = malloc(sizeof(int) * opts.concurrent);
+
+    // Generate dialogs in groups of concurrent dialogs
+    for (first = 0; first < opts.dialogs; first += opts.concurrent) {
+        count = (opts.dialogs - first < opts.concurrent) ? opts.dialogs - first : opts.concurrent;
+        for (dialog = 0; dialog < count; dialog++) {
+            tcpseq[dialog] = 1;
+            tcpdialog[dialog] = gen_chance(opts.tcp);
+        }
+
+        for (number = 0; number < opts.messages; number++) {
+            for (dialog = 0; dialog < count; dialog++) {
+                tcp = tcpdialog[dialog];
+                len = gen_message(&opts, first + dialog, number, tcp, payload, &request);
+                // Requests from alice, except BYE sent by bob
+                if (request != (number >= opts.messages - 2)) {
+                    src = alice;
+                    sport = (tcp) ? 40000 + dialog : 5060;
+                    dst = bob;
+                    dport = 5060;
+                } else {
+                    src = bob;
+                    sport = 5060;
+                    dst = alice;
+                    dport = (tcp) ? 40000 + dialog : 5060;
+                }
+                gen_write_packet(&opts, tcp, src, sport, dst, dport, &tcpseq[dialog], payload, len);
+                packets++;
+
+                // Send the same message again
+                if (gen_chance(opts.retrans)) {
+                    gen_write_packet(&opts, tcp, src, sport, dst, dport, &tcpseq[dialog], payload,
+                                     len);
+                    packets++;
+                }
+
+                // Media packets between messages
+                for (i = 0; i < opts.noise; i++)
+                    gen_write_noise(alice, bob);
+                noise += opts.noise;
+            }
+        }
+    }
+
+    // Oversized record at the end of the file
+    if (malformed)
+        gen_write_malformed();
+
+    free(tcpseq);
+    free(tcpdialog);
+    fclose(gen_out);
+
+    fprintf(stderr, "%s: %d dialogs, %ld messages, %ld non SIP packets\n", outfile, opts.dialogs,
+            packets, noise);
+    return 0;
+}
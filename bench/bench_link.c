@@ -0,0 +1,246 @@
+/**************************************************************************
+ **
+ ** sngrep - SIP Messages flow viewer
+ **
+ ** Copyright (C) 2013,2014 Ivan Alonso (Kaian)
+ ** Copyright (C) 2013,2014 Irontec SL. All rights reserved.
+ **
+ ** This program is free software: you can redistribute it and/or modify
+ ** it under the terms of the GNU General Public License as published by
+ ** the Free Software Foundation, either version 3 of the License, or
+ ** (at your option) any later version.
+ **
+ ** This program is distributed in the hope that it will be useful,
+ ** but WITHOUT ANY WARRANTY; without even the implied warranty of
+ ** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ ** GNU General Public License for more details.
+ **
+ ** You should have received a copy of the GNU General Public License
+ ** along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ **
+ ****************************************************************************/
+/**
+ * @file bench_link.c
+ * @author Ivan Alonso [aka Kaian] <kaian@irontec.com>
+ *
+ * @brief Datalink decoders micro-benchmark
+ *
+ * Decode synthetic frames of each supported link type and print the
+ * time per packet of the link decoder selected at open time, compared
+ * with a generic decoder that checks the link type of every packet.
+ *
+ * Usage: bench_link [iterations]
+ */
+#include "config.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <sys/socket.h>
+#include "capture.h"
+
+//! Default number of decoded packets per link type
+#define BENCH_ITERATIONS 20000000
+//! Size of SIP payload in synthetic frames
+#define BENCH_PAYLOAD 600
+//! Don't let the compiler move decoding out of the loop
+#define BENCH_BARRIER() __asm__ __volatile__("" ::: "memory")
+
+/**
+ * @brief Synthetic frame of a link type
+ */
+struct bench_link {
+    //! Printed name
+    const char *name;
+    //! pcap link type
+    int link;
+    //! Link header
+    u_char header[24];
+    //! Link header size
+    int size;
+};
+
+//! Link headers carrying IPv4
+static struct bench_link links[] = {
+    { "EN10MB", DLT_EN10MB, { [12] = 0x08, 0x00 }, 14 },
+    { "EN10MB 802.1Q", DLT_EN10MB, { [12] = 0x81, 0x00, 0x00, 0x64, 0x08, 0x00 }, 18 },
+    { "NULL (LE)", DLT_NULL, { AF_INET, 0, 0, 0 }, 4 },
+    { "NULL (BE)", DLT_NULL, { 0, 0, 0, AF_INET }, 4 },
+    { "LOOP", DLT_LOOP, { 0, 0, 0, AF_INET }, 4 },
+    { "LINUX_SLL", DLT_LINUX_SLL, { [14] = 0x08, 0x00 }, 16 },
+#ifdef DLT_LINUX_SLL2
+    { "LINUX_SLL2", DLT_LINUX_SLL2, { 0x08, 0x00 }, 20 },
+#endif
+#ifdef DLT_IPNET
+    { "IPNET", DLT_IPNET, { 1, 2 }, 24 },
+#endif
+    { "RAW", DLT_RAW, { 0 }, 0 },
+    { "PPP", DLT_PPP, { 0xff, 0x03, 0x00, 0x21 }, 4 },
+};
+
+/**
+ * @brief Generic decoder, checking link type for every packet
+ *
+ * This is how packets were decoded before having one decoder per link
+ * type, with the same header checks the decoders do. It's not inlined,
+ * so both decoders have the cost of a function call.
+ */
+static const struct nread_ip * __attribute__((noinline))
+bench_generic_decode(int link, const struct pcap_pkthdr *header, const u_char *packet)
+{
+    int size;
+
+    switch (link) {
+        case DLT_EN10MB:
+            if (packet[12] == 0x81 && packet[13] == 0x00) {
+                if (packet[16] != 0x08 || packet[17] != 0x00)
+                    return NULL;
+                size = 18;
+            } else {
+                if (packet[12] != 0x08 || packet[13] != 0x00)
+                    return NULL;
+                size = 14;
+            }
+            break;
+        case DLT_NULL:
+            if (packet[0] != AF_INET && packet[3] != AF_INET)
+                return NULL;
+            size = 4;
+            break;
+        case DLT_LOOP:
+            if (packet[3] != AF_INET)
+                return NULL;
+            size = 4;
+            break;
+        case DLT_PPP:
+            size = 4;
+            break;
+        case DLT_RAW:
+            size = 0;
+            break;
+        case DLT_LINUX_SLL:
+            if (packet[14] != 0x08 || packet[15] != 0x00)
+                return NULL;
+            size = 16;
+            break;
+#ifdef DLT_LINUX_SLL2
+        case DLT_LINUX_SLL2:
+            if (packet[0] != 0x08 || packet[1] != 0x00)
+                return NULL;
+            size = 20;
+            break;
+#endif
+#ifdef DLT_IPNET
+        case DLT_IPNET:
+            if (packet[1] != 2)
+                return NULL;
+            size = 24;
+            break;
+#endif
+        default:
+            return NULL;
+    }
+
+    if (header->caplen < size + 20 || (packet[size] >> 4) != 4)
+        return NULL;
+    return (const struct nread_ip *) (packet + size);
+}
+
+/**
+ * @brief Get monotonic time in nanoseconds
+ */
+static double
+bench_now()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1e9 + ts.tv_nsec;
+}
+
+/**
+ * @brief Create a frame with the given link header
+ *
+ * @return frame size
+ */
+static int
+bench_frame(struct bench_link *link, u_char *frame)
+{
+    struct nread_ip *ip;
+    struct nread_udp *udp;
+    int len = 20 + SIZE_UDP + BENCH_PAYLOAD;
+
+    memset(frame, 0, link->size + len);
+    memcpy(frame, link->header, link->size);
+
+    ip = (struct nread_ip *) (frame + link->size);
+    ip->ip_vhl = 0x45;
+    ip->ip_len = htons(len);
+    ip->ip_ttl = 64;
+    ip->ip_p = IPPROTO_UDP;
+    inet_aton("10.0.0.1", &ip->ip_src);
+    inet_aton("10.0.0.2", &ip->ip_dst);
+
+    udp = (struct nread_udp *) ((u_char *) ip + 20);
+    udp->udp_sport = udp->udp_dport = htons(5060);
+    udp->udp_hlen = htons(SIZE_UDP + BENCH_PAYLOAD);
+    memset((u_char *) udp + SIZE_UDP, 'A', BENCH_PAYLOAD);
+
+    return link->size + len;
+}
+
+int
+main(int argc, char *argv[])
+{
+    u_char frame[2048];
+    struct pcap_pkthdr header;
+    capture_link_decoder_t decode;
+    const struct nread_ip *ip;
+    long i, iterations = (argc > 1) ? atol(argv[1]) : BENCH_ITERATIONS;
+    unsigned long sum;
+    double start, specialized, generic;
+    int l;
+
+    printf("%-16s %14s %14s\n", "Link type", "decoder ns/pkt", "generic ns/pkt");
+
+    for (l = 0; l < sizeof(links) / sizeof(links[0]); l++) {
+        memset(&header, 0, sizeof(header));
+        header.caplen = header.len = bench_frame(&links[l], frame);
+
+        if (!(decode = capture_link_decoder(links[l].link))) {
+            printf("%-16s %14s\n", links[l].name, "unsupported");
+            continue;
+        }
+
+        // Check decoder finds the IP header
+        if (decode(&header, frame) != (const struct nread_ip *) (frame + links[l].size)) {
+            printf("%-16s %14s\n", links[l].name, "failed");
+            continue;
+        }
+
+        // Decoder selected at open time
+        sum = 0;
+        start = bench_now();
+        for (i = 0; i < iterations; i++) {
+            if ((ip = decode(&header, frame)))
+                sum += ip->ip_p;
+            BENCH_BARRIER();
+        }
+        specialized = (bench_now() - start) / iterations;
+
+        // Decoder checking link type on every packet
+        start = bench_now();
+        for (i = 0; i < iterations; i++) {
+            if ((ip = bench_generic_decode(links[l].link, &header, frame)))
+                sum += ip->ip_p;
+            BENCH_BARRIER();
+        }
+        generic = (bench_now() - start) / iterations;
+
+        if (sum == 0)
+            printf("%-16s %14s\n", links[l].name, "no packets");
+
+        printf("%-16s %14.2f %14.2f\n", links[l].name, specialized, generic);
+    }
+
+    return 0;
+}
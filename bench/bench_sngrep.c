@@ -0,0 +1,265 @@
+/**************************************************************************
+ **
+ ** sngrep - SIP Messages flow viewer
+ **
+ ** Copyright (C) 2013,2014 Ivan Alonso (Kaian)
+ ** Copyright (C) 2013,2014 Irontec SL. All rights reserved.
+ **
+ ** This program is free software: you can redistribute it and/or modify
+ ** it under the terms of the GNU General Public License as published by
+ ** the Free Software Foundation, either version 3 of the License, or
+ ** (at your option) any later version.
+ **
+ ** This program is distributed in the hope that it will be useful,
+ ** but WITHOUT ANY WARRANTY; without even the implied warranty of
+ ** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ ** GNU General Public License for more details.
+ **
+ ** You should have received a copy of the GNU General Public License
+ ** along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ **
+ ****************************************************************************/
+/**
+ * @file bench_sngrep.c
+ * @author Ivan Alonso [aka Kaian] <kaian@irontec.com>
+ *
+ * @brief Packet processing benchmark
+ *
+ * Load a capture file without interface and measure each stage of
+ * sngrep processing:
+ *
+ *  - parse: read file packets through parse_packet()
+ *  - load: add the same SIP messages again using sip_load_message()
+ *  - filter: check all calls against a display filter expression
+ *  - group: iterate the messages of call groups in time order
+ *
+ * For each stage prints processed items per second, nanoseconds and
+ * memory allocations per item. Peak RSS of the process is printed at
+ * the end. Allocations are counted wrapping malloc family functions at
+ * link time.
+ *
+ * Usage: bench_sngrep [-e filter] [-g groupsize] [-l limit] file.pcap
+ */
+#include "config.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <time.h>
+#include <sys/resource.h>
+#include "capture.h"
+#include "option.h"
+#include "filter.h"
+#include "group.h"
+#include "sip.h"
+
+//! Default display filter checked in filter stage
+#define BENCH_FILTER "state == \"COMPLETED\" && msgcnt >= 7 && sipfrom ~ \"^user1\""
+//! Default number of calls in each group
+#define BENCH_GROUP_SIZE 4
+//! Default calls limit
+#define BENCH_LIMIT 1000000
+
+/**
+ * @brief Copy of a loaded message, used to load it again
+ */
+struct bench_msg {
+    struct timeval ts;
+    struct in_addr src, dst;
+    u_short sport, dport;
+    char *payload;
+};
+
+//! Number of allocations since last reset
+static unsigned long bench_allocs;
+
+void *__real_malloc(size_t size);
+void *__real_calloc(size_t nmemb, size_t size);
+void *__real_realloc(void *ptr, size_t size);
+char *__real_strdup(const char *s);
+
+void *
+__wrap_malloc(size_t size)
+{
+    __sync_fetch_and_add(&bench_allocs, 1);
+    return __real_malloc(size);
+}
+
+void *
+__wrap_calloc(size_t nmemb, size_t size)
+{
+    __sync_fetch_and_add(&bench_allocs, 1);
+    return __real_calloc(nmemb, size);
+}
+
+void *
+__wrap_realloc(void *ptr, size_t size)
+{
+    __sync_fetch_and_add(&bench_allocs, 1);
+    return __real_realloc(ptr, size);
+}
+
+char *
+__wrap_strdup(const char *s)
+{
+    __sync_fetch_and_add(&bench_allocs, 1);
+    return __real_strdup(s);
+}
+
+/**
+ * @brief Get monotonic time in nanoseconds
+ */
+static double
+bench_now()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1e9 + ts.tv_nsec;
+}
+
+/**
+ * @brief Print the results of a stage
+ */
+static void
+bench_report(const char *stage, const char *unit, long count, double elapsed, unsigned long allocs)
+{
+    if (!count) {
+        printf("%-8s %10s\n", stage, "no items");
+        return;
+    }
+    printf("%-8s %10ld %-5s %12.0f %s/s %10.1f ns/%s %8.2f allocs/%s\n", stage, count, unit,
+           count / (elapsed / 1e9), unit, elapsed / count, unit, (double) allocs / count, unit);
+}
+
+/**
+ * @brief Count messages of all calls
+ */
+static long
+bench_count_msgs()
+{
+    sip_call_t *call = NULL;
+    long count = 0;
+
+    while ((call = call_get_next(call)))
+        count += call_msg_count(call);
+    return count;
+}
+
+int
+main(int argc, char *argv[])
+{
+    const char *expr = BENCH_FILTER;
+    struct bench_msg *msgs;
+    struct rusage usage;
+    sip_call_group_t *group;
+    sip_call_t *call;
+    sip_msg_t *msg;
+    double start;
+    long count, matched, i;
+    int opt, groupsize = BENCH_GROUP_SIZE, limit = BENCH_LIMIT;
+
+    while ((opt = getopt(argc, argv, "e:g:l:")) != -1) {
+        switch (opt) {
+            case 'e':
+                expr = optarg;
+                break;
+            case 'g':
+                groupsize = atoi(optarg);
+                break;
+            case 'l':
+                limit = atoi(optarg);
+                break;
+            default:
+                fprintf(stderr, "Usage: bench_sngrep [-e filter] [-g groupsize] [-l limit] file.pcap\n");
+                return 1;
+        }
+    }
+
+    if (optind >= argc || groupsize <= 0 || limit <= 0) {
+        fprintf(stderr, "Usage: bench_sngrep [-e filter] [-g groupsize] [-l limit] file.pcap\n");
+        return 1;
+    }
+
+    // Same setup as sngrep without interface
+    init_options();
+    sip_init(limit);
+    capture_set_limit(limit);
+    // Packets are parsed in file order by parse_packet()
+    set_option_value("capture.threads", "1");
+    set_option_value("capture.index", "off");
+    if (capture_offline(argv[optind]) != 0)
+        return 1;
+
+    // Parse stage: all packets through the capture callback
+    bench_allocs = 0;
+    start = bench_now();
+    capture_thread(NULL);
+    bench_report("parse", "msg", count = bench_count_msgs(), bench_now() - start, bench_allocs);
+
+    // Keep a copy of loaded messages
+    msgs = malloc(sizeof(struct bench_msg) * (count + 1));
+    for (i = 0, call = NULL; (call = call_get_next(call));) {
+        for (msg = NULL; (msg = call_get_next_msg(call, msg)); i++) {
+            msgs[i].ts = msg->ts;
+            msgs[i].src = msg->src;
+            msgs[i].sport = msg->sport;
+            msgs[i].dst = msg->dst;
+            msgs[i].dport = msg->dport;
+            msgs[i].payload = strdup(msg_get_payload(msg));
+        }
+    }
+    sip_calls_clear();
+
+    // Load stage: SIP parsing and call storage only
+    bench_allocs = 0;
+    start = bench_now();
+    for (i = 0; i < count; i++) {
+        sip_load_message(msgs[i].ts, msgs[i].src, msgs[i].sport, msgs[i].dst, msgs[i].dport,
+                         (u_char *) msgs[i].payload);
+    }
+    bench_report("load", "msg", count, bench_now() - start, bench_allocs);
+
+    for (i = 0; i < count; i++)
+        free(msgs[i].payload);
+    free(msgs);
+
+    // Filter stage: evaluate the filter in all calls
+    if (filter_set(FILTER_CALL_LIST, expr) != 0) {
+        fprintf(stderr, "Invalid filter expression: %s\n", expr);
+        return 1;
+    }
+    filter_reset_calls();
+    bench_allocs = 0;
+    count = matched = 0;
+    start = bench_now();
+    for (call = NULL; (call = call_get_next(call)); count++) {
+        if (filter_check_call(call) == 0)
+            matched++;
+    }
+    bench_report("filter", "call", count, bench_now() - start, bench_allocs);
+    printf("%-8s %10ld calls match '%s'\n", "", matched, expr);
+    filter_set(FILTER_CALL_LIST, NULL);
+    filter_reset_calls();
+
+    // Group stage: iterate messages of consecutive calls groups
+    group = call_group_create();
+    bench_allocs = 0;
+    count = 0;
+    start = bench_now();
+    for (call = NULL; (call = call_get_next(call));) {
+        call_group_add(group, call);
+        if (call_group_count(group) == groupsize || !call_get_next(call)) {
+            for (msg = NULL; (msg = call_group_get_next_msg(group, msg)); count++)
+                ;
+            call_group_clear(group);
+        }
+    }
+    bench_report("group", "msg", count, bench_now() - start, bench_allocs);
+    call_group_destroy(group);
+
+    getrusage(RUSAGE_SELF, &usage);
+    printf("peak RSS %ld KB\n", usage.ru_maxrss);
+
+    capture_close();
+    return 0;
+}
@@ -0,0 +1,308 @@
+/**************************************************************************
+ **
+ ** sngrep - SIP Messages flow viewer
+ **
+ ** Copyright (C) 2013,2014 Ivan Alonso (Kaian)
+ ** Copyright (C) 2013,2014 Irontec SL. All rights reserved.
+ **
+ ** This program is free software: you can redistribute it and/or modify
+ ** it under the terms of the GNU General Public License as published by
+ ** the Free Software Foundation, either version 3 of the License, or
+ ** (at your option) any later version.
+ **
+ ** This program is distributed in the hope that it will be useful,
+ ** but WITHOUT ANY WARRANTY; without even the implied warranty of
+ ** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ ** GNU General Public License for more details.
+ **
+ ** You should have received a copy of the GNU General Public License
+ ** along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ **
+ ****************************************************************************/
+/**
+ * @file batch.c
+ * @author Ivan Alonso [aka Kaian] <kaian@irontec.com>
+ *
+ * @brief Source code of functions defined in batch.h
+ *
+ */
+#include "config.h"
+#include <string.h>
+#include <stdlib.h>
+#include <signal.h>
+#include <sys/time.h>
+#include "batch.h"
+#include "capture.h"
+#include "option.h"
+#include "spool.h"
+
+//! Batch mode status
+static batch_info_t batch = { 0 };
+
+/**
+ * @brief Stop the capture when the process is interrupted
+ */
+static void
+batch_signal_handler(int signum)
+{
+    capture_stop();
+}
+
+int
+batch_run(const char *format, int limit)
+{
+    char option[80];
+    const char *field;
+    enum sip_attr_id id;
+    batch_call_t *bcall;
+    int i, ret;
+
+    // Check output format
+    if (!format || !strcasecmp(format, "json")) {
+        batch.format = BATCH_FORMAT_JSON;
+    } else if (!strcasecmp(format, "csv")) {
+        batch.format = BATCH_FORMAT_CSV;
+    } else {
+        fprintf(stderr, "Unknown output format %s\n", format);
+        return 1;
+    }
+
+    batch.out = stdout;
+    batch.limit = limit;
+    batch.timeout = get_option_int_value("batch.timeout");
+    batch.linger = get_option_int_value("batch.linger");
+    batch.pending = htable_create(limit);
+
+    // Get configured call list columns
+    for (i = 0; i < SIP_ATTR_SENTINEL; i++) {
+        sprintf(option, "cl.column%d", i);
+        if ((field = get_option_value(option))) {
+            if ((int) (id = sip_attr_from_name(field)) == -1)
+                continue;
+            batch.columns[batch.columncnt++] = id;
+        }
+    }
+
+    // Print CSV header line
+    if (batch.format == BATCH_FORMAT_CSV) {
+        for (i = 0; i < batch.columncnt; i++)
+            fprintf(batch.out, "%s%s", (i) ? "," : "", sip_attr_get_name(batch.columns[i]));
+        fprintf(batch.out, "\n");
+    }
+
+    // Finish the capture gracefully on interrupt
+    signal(SIGINT, batch_signal_handler);
+    signal(SIGTERM, batch_signal_handler);
+
+    // This is a blocking call
+    ret = capture_run(batch_parse_packet, batch_timer);
+
+    // Write all pending dialogs
+    while ((bcall = batch.first))
+        batch_call_finish(bcall);
+
+    fflush(batch.out);
+    htable_destroy(batch.pending);
+    batch.pending = NULL;
+
+    return ret;
+}
+
+/**
+ * @brief Remove a pending dialog from the activity list
+ */
+static void
+batch_call_unlink(batch_call_t *bcall)
+{
+    if (bcall->prev) {
+        bcall->prev->next = bcall->next;
+    } else {
+        batch.first = bcall->next;
+    }
+    if (bcall->next) {
+        bcall->next->prev = bcall->prev;
+    } else {
+        batch.last = bcall->prev;
+    }
+    bcall->prev = bcall->next = NULL;
+}
+
+/**
+ * @brief Add a pending dialog at the end of the activity list
+ */
+static void
+batch_call_append(batch_call_t *bcall)
+{
+    bcall->prev = batch.last;
+    if (batch.last) {
+        batch.last->next = bcall;
+    } else {
+        batch.first = bcall;
+    }
+    batch.last = bcall;
+}
+
+/**
+ * @brief Check if a dialog has reached a final state
+ */
+static int
+batch_call_is_final(sip_call_t *call)
+{
+    const char *state;
+
+    if (!(state = call_get_attribute(call, SIP_ATTR_CALLSTATE)))
+        return 0;
+
+    return !strcmp(state, "COMPLETED") || !strcmp(state, "CANCELLED")
+           || !strcmp(state, "REJECTED");
+}
+
+/**
+ * @brief Write and remove the dialogs that have finished
+ */
+static void
+batch_check_calls()
+{
+    batch_call_t *bcall, *next;
+    time_t idle;
+
+    for (bcall = batch.first; bcall; bcall = next) {
+        next = bcall->next;
+        idle = batch.now.tv_sec - bcall->last.tv_sec;
+        // Following dialogs have been active more recently
+        if (idle < batch.linger && idle < batch.timeout)
+            break;
+        if (idle >= batch.timeout || batch_call_is_final(bcall->call))
+            batch_call_finish(bcall);
+    }
+}
+
+void
+batch_parse_packet(u_char *mode, const struct pcap_pkthdr *header, const u_char *packet)
+{
+    sip_msg_t *msg;
+    batch_call_t *bcall;
+
+    // Make room for new dialogs
+    while (batch.first && batch.limit && sip_calls_count() >= batch.limit)
+        batch_call_finish(batch.first);
+
+    // Parse the packet
+    if ((msg = capture_packet(header, packet))) {
+        // Get the pending dialog of this message
+        if ((bcall = htable_find(batch.pending, msg->call->callid))) {
+            batch_call_unlink(bcall);
+        } else {
+            bcall = malloc(sizeof(batch_call_t));
+            memset(bcall, 0, sizeof(batch_call_t));
+            bcall->call = msg->call;
+            htable_insert(batch.pending, msg->call->callid, bcall);
+        }
+        // Move it to the end of the activity list
+        bcall->last = header->ts;
+        batch_call_append(bcall);
+    }
+
+    // Check finished dialogs once per captured second
+    batch.now = header->ts;
+    if (batch.now.tv_sec != batch.checked) {
+        batch.checked = batch.now.tv_sec;
+        batch_check_calls();
+        // Release payloads of messages that exceed the spool cache
+        spool_trim();
+    }
+}
+
+void
+batch_timer()
+{
+    struct timeval now;
+
+    // Dialogs are also finished while no packets are captured
+    gettimeofday(&now, NULL);
+    if (now.tv_sec <= batch.checked)
+        return;
+
+    batch.now = now;
+    batch.checked = now.tv_sec;
+    batch_check_calls();
+    spool_trim();
+    fflush(batch.out);
+}
+
+void
+batch_call_finish(batch_call_t *bcall)
+{
+    // Write dialog to output
+    batch_print_call(bcall->call);
+
+    // Remove pending dialog
+    batch_call_unlink(bcall);
+    htable_remove(batch.pending, bcall->call->callid);
+
+    // Remove the dialog from calls storage
+    sip_call_destroy(bcall->call);
+    free(bcall);
+}
+
+/**
+ * @brief Write a value escaped for the output format
+ */
+static void
+batch_print_value(const char *value)
+{
+    const char *c;
+
+    if (batch.format == BATCH_FORMAT_CSV) {
+        // Quote values only when required
+        if (!strpbrk(value, ",\"\r\n")) {
+            fputs(value, batch.out);
+            return;
+        }
+        fputc('"', batch.out);
+        for (c = value; *c; c++) {
+            if (*c == '"')
+                fputc('"', batch.out);
+            fputc(*c, batch.out);
+        }
+        fputc('"', batch.out);
+    } else {
+        fputc('"', batch.out);
+        for (c = value; *c; c++) {
+            if (*c == '"' || *c == '\\') {
+                fprintf(batch.out, "\\%c", *c);
+            } else if ((unsigned char) *c < 0x20) {
+                fprintf(batch.out, "\\u%04x", *c);
+            } else {
+                fputc(*c, batch.out);
+            }
+        }
+        fputc('"', batch.out);
+    }
+}
+
+void
+batch_print_call(sip_call_t *call)
+{
+    const char *value;
+    int i;
+
+    if (batch.format == BATCH_FORMAT_JSON)
+        fputc('{', batch.out);
+
+    for (i = 0; i < batch.columncnt; i++) {
+        if (!(value = call_get_attribute(call, batch.columns[i])))
+            value = "";
+
+        if (batch.format == BATCH_FORMAT_JSON) {
+            fprintf(batch.out, "%s\"%s\":", (i) ? "," : "", sip_attr_get_name(batch.columns[i]));
+        } else if (i) {
+            fputc(',', batch.out);
+        }
+        batch_print_value(value);
+    }
+
+    if (batch.format == BATCH_FORMAT_JSON)
+        fputc('}', batch.out);
+    fputc('\n', batch.out);
+}
@@ -0,0 +1,155 @@
+/**************************************************************************
+ **
+ ** sngrep - SIP Messages flow viewer
+ **
+ ** Copyright (C) 2013,2014 Ivan Alonso (Kaian)
+ ** Copyright (C) 2013,2014 Irontec SL. All rights reserved.
+ **
+ ** This program is free software: you can redistribute it and/or modify
+ ** it under the terms of the GNU General Public License as published by
+ ** the Free Software Foundation, either version 3 of the License, or
+ ** (at your option) any later version.
+ **
+ ** This program is distributed in the hope that it will be useful,
+ ** but WITHOUT ANY WARRANTY; without even the implied warranty of
+ ** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ ** GNU General Public License for more details.
+ **
+ ** You should have received a copy of the GNU General Public License
+ ** along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ **
+ ****************************************************************************/
+/**
+ * @file batch.h
+ * @author Ivan Alonso [aka Kaian] <kaian@irontec.com>
+ *
+ * @brief Functions to run sngrep without interface
+ *
+ * In batch mode, captured packets are parsed in the main thread and
+ * finished dialogs are written to the standard output, one line per
+ * dialog, instead of being displayed. The written fields are the
+ * attributes configured for call list columns (cl.column settings).
+ *
+ * A dialog is considered finished when it has been inactive for a
+ * while (batch.timeout seconds, or batch.linger seconds if it has
+ * reached a final state) measured with packet timestamps, or with the
+ * current time while an online capture receives no packets. When the
+ * capture limit is reached, the least recently active dialog is
+ * written and removed to make room for new ones. All pending dialogs
+ * are written when the capture ends.
+ */
+#ifndef __SNGREP_BATCH_H
+#define __SNGREP_BATCH_H
+
+#include "config.h"
+#include <stdio.h>
+#include "sip.h"
+#include "hash.h"
+
+//! Shorter declaration of batch_call structure
+typedef struct batch_call batch_call_t;
+//! Shorter declaration of batch_info structure
+typedef struct batch_info batch_info_t;
+
+/**
+ * @brief Available output formats
+ */
+enum batch_format {
+    //! One JSON object per line
+    BATCH_FORMAT_JSON = 0,
+    //! Comma separated values with a header line
+    BATCH_FORMAT_CSV,
+};
+
+/**
+ * @brief Activity information of a pending dialog
+ *
+ * Pending dialogs are stored in a list sorted by last activity, so
+ * the oldest ones are always at the beginning.
+ */
+struct batch_call {
+    //! Pending dialog
+    sip_call_t *call;
+    //! Timestamp of the last message of the dialog
+    struct timeval last;
+    //! Activity list
+    batch_call_t *prev, *next;
+};
+
+/**
+ * @brief Batch mode status information
+ */
+struct batch_info {
+    //! Output format
+    enum batch_format format;
+    //! Output stream
+    FILE *out;
+    //! Written attributes
+    enum sip_attr_id columns[SIP_ATTR_SENTINEL];
+    //! Number of written attributes
+    int columncnt;
+    //! Seconds of inactivity to consider a dialog finished
+    int timeout;
+    //! Seconds of inactivity to consider a dialog in final state finished
+    int linger;
+    //! Max number of pending dialogs
+    int limit;
+    //! Pending dialogs sorted by last activity
+    batch_call_t *first, *last;
+    //! Call-ID to pending dialog
+    htable_t *pending;
+    //! Timestamp of the last captured packet
+    struct timeval now;
+    //! Timestamp of the last finished dialogs check
+    time_t checked;
+};
+
+/**
+ * @brief Parse captured packets and write finished dialogs
+ *
+ * This is a blocking call that returns when the capture ends, either
+ * because the input file has been fully read or because the process
+ * received an interrupt signal.
+ *
+ * @param format Output format name (json or csv)
+ * @param limit Max number of pending dialogs
+ * @return 0 on success, 1 otherwise
+ */
+int
+batch_run(const char *format, int limit);
+
+/**
+ * @brief Packet callback for batch mode
+ *
+ * Parse the packet and update the pending dialogs, writing those that
+ * have finished.
+ */
+void
+batch_parse_packet(u_char *mode, const struct pcap_pkthdr *header, const u_char *packet);
+
+/**
+ * @brief Timer callback for batch mode
+ *
+ * Write the dialogs that have finished in online captures, once per
+ * second, even if no packet has been received.
+ */
+void
+batch_timer();
+
+/**
+ * @brief Write a dialog to the output and remove it
+ *
+ * @param bcall Pending dialog
+ */
+void
+batch_call_finish(batch_call_t *bcall);
+
+/**
+ * @brief Write the given dialog attributes in the output format
+ *
+ * @param call Finished dialog
+ */
+void
+batch_print_call(sip_call_t *call);
+
+#endif /* __SNGREP_BATCH_H */
@@ -31,8 +31,17 @@
  */
 
 #include "config.h"
+#include <errno.h>
 #include <netdb.h>
+#include <unistd.h>
+#include <poll.h>
 #include "capture.h"
+#include "capture_index.h"
+#include "capture_bpf.h"
+#include "spool.h"
+#include "stats.h"
+#include "rtp.h"
+#include "trace.h"
 #ifdef WITH_OPENSSL
 #include "capture_tls.h"
 #endif
@@ -66,24 +75,24 @@ capture_online(const char *dev, const char *outfile)
         return 2;
     }
 
-    // If requested store packets in a dump file
-    if (outfile) {
-        if ((capinfo.pd = dump_open(outfile)) == NULL) {
-            fprintf(stderr, "Couldn't open output dump file %s: %s\n", outfile,
-                    pcap_geterr(capinfo.handle));
-            return 2;
-        }
-    }
-
     // Get datalink to parse packets correctly
     capinfo.link = pcap_datalink(capinfo.handle);
 
     // Check linktypes sngrep knowns before start parsing packets
-    if (datalink_size(capinfo.link) == -1) {
+    if (!(capinfo.decode = capture_link_decoder(capinfo.link))) {
         fprintf(stderr, "Unable to handle linktype %d\n", capinfo.link);
         return 3;
     }
 
+    // If requested store packets in a dump file
+    if (outfile) {
+        if ((capinfo.dump = capture_dump_open(outfile, capinfo.link, dev)) == NULL) {
+            fprintf(stderr, "Couldn't open output dump file %s: %s\n", outfile,
+                    strerror(errno));
+            return 2;
+        }
+    }
+
     return 0;
 }
 
@@ -98,17 +107,29 @@ capture_offline(const char *infile)
     // Set capture input file
     capinfo.infile = infile;
 
-    // Open PCAP file
-    if ((capinfo.handle = pcap_open_offline(infile, errbuf)) == NULL) {
+    // Try to map the file in memory
+    memset(errbuf, 0, sizeof(errbuf));
+    if ((capinfo.file = capture_file_open(infile, errbuf))) {
+        // Packets will be read from mapped file, pcap handler is only
+        // required for filters and dumps
+        capinfo.link = capture_file_datalink(capinfo.file);
+        capinfo.handle = pcap_open_dead(capinfo.link, capinfo.file->snaplen);
+    } else if (errbuf[0]) {
         fprintf(stderr, "Couldn't open pcap file %s: %s\n", infile, errbuf);
         return 1;
-    }
+    } else {
+        // Open PCAP file
+        if ((capinfo.handle = pcap_open_offline(infile, errbuf)) == NULL) {
+            fprintf(stderr, "Couldn't open pcap file %s: %s\n", infile, errbuf);
+            return 1;
+        }
 
-    // Get datalink to parse packets correctly
-    capinfo.link = pcap_datalink(capinfo.handle);
+        // Get datalink to parse packets correctly
+        capinfo.link = pcap_datalink(capinfo.handle);
+    }
 
     // Check linktypes sngrep knowns before start parsing packets
-    if (datalink_size(capinfo.link) == -1) {
+    if (!(capinfo.decode = capture_link_decoder(capinfo.link))) {
         fprintf(stderr, "Unable to handle linktype %d\n", capinfo.link);
         return 3;
     }
@@ -119,91 +140,120 @@ capture_offline(const char *infile)
 void
 parse_packet(u_char *mode, const struct pcap_pkthdr *header, const u_char *packet)
 {
-    // Datalink Header size
-    int size_link;
+    capture_packet(header, packet);
+}
+
+/**
+ * @brief Check if captured packets must be discarded
+ *
+ * @return 1 if capture is paused or limit has been reached, 0 otherwise
+ */
+static int
+capture_packet_ignored()
+{
+    // Ignore packets while capture is paused
+    if (capture_is_paused())
+        return 1;
+
+    // Check if we have reached capture limit
+    if (capinfo.limit && sip_calls_count() >= capinfo.limit)
+        return 1;
+
+    return 0;
+}
+
+/**
+ * @brief Parse the SIP message of a packet
+ *
+ * The parsed message is not added to any call, so this can be
+ * called from multiple threads while loading files. Packets rejected
+ * before parsing are not accounted here, caller must do it.
+ *
+ * @param rejected Set to 1 if payload was rejected as not SIP (can be NULL)
+ * @return parsed message or NULL if packet is not SIP
+ */
+static sip_msg_t *
+capture_packet_parse(const struct pcap_pkthdr *header, const u_char *packet, int *rejected)
+{
     // IP header data
-    struct nread_ip *ip;
+    const struct nread_ip *ip;
     // IP header size
     int size_ip;
     // UDP header data
-    struct nread_udp *udp;
+    const struct nread_udp *udp;
     // TCP header data
-    struct nread_tcp *tcp;
+    const struct nread_tcp *tcp;
     // Packet payload data
     u_char *msg_payload = NULL;
     // Packet payload size
     int size_payload;
     // Parsed message data
     sip_msg_t *msg;
-    // Total packet size
-    int size_packet;
     // SIP message transport
     int transport; /* 0 UDP, 1 TCP, 2 TLS */
     // Source and Destination Ports
     u_short sport, dport;
-
-    // Ignore packets while capture is paused
-    if (capture_is_paused())
-        return;
-
-    // Check if we have reached capture limit
-    if (capinfo.limit && sip_calls_count() >= capinfo.limit)
-        return;
-
-    // Store this packets in output file
-    dump_packet(capinfo.pd, header, packet);
-
-    // Get link header size from datalink type
-    size_link = datalink_size(capinfo.link);
+    // End of captured data
+    const u_char *end = packet + header->caplen;
 
     // Get IP header
-    ip = (struct nread_ip*) (packet + size_link);
+    TRACE_BEGIN(decode);
+    ip = capinfo.decode(header, packet);
+    TRACE_END(TRACE_DECODE, decode);
+    if (!ip)
+        return NULL;
     size_ip = IP_HL(ip) * 4;
 
+    // Only the first fragment of a packet has the transport header
+    if (ntohs(ip->ip_off) & IP_OFFMASK)
+        return NULL;
+
     // Only interested in UDP packets
     if (ip->ip_p == IPPROTO_UDP) {
         // Set transport UDP
         transport = 0;
 
         // Get UDP header
-        udp = (struct nread_udp*) (packet + size_link + size_ip);
+        udp = (const struct nread_udp*) ((const u_char *) ip + size_ip);
         // Set packet ports
         sport = udp->udp_sport;
         dport = udp->udp_dport;
 
         // We're only interested in packets with payload
         size_payload = htons(udp->udp_hlen) - SIZE_UDP;
+        // Don't read past captured data (fragmented or truncated packets)
+        if (size_payload > end - ((const u_char *) udp + SIZE_UDP))
+            size_payload = end - ((const u_char *) udp + SIZE_UDP);
         if (size_payload <= 0)
-            return;
-
-        // Get packet payload
-        msg_payload = malloc(size_payload + 1);
-        memset(msg_payload, 0, size_payload + 1);
-        memcpy(msg_payload, (u_char *) (packet + size_link + size_ip + SIZE_UDP), size_payload);
+            return NULL;
 
-        // Total packet size
-        size_packet = size_link + size_ip + SIZE_UDP + size_payload;
+        // Get packet payload (only if it looks like SIP)
+        if (sip_check_start_line((const u_char *) udp + SIZE_UDP, size_payload)) {
+            msg_payload = malloc(size_payload + 1);
+            memset(msg_payload, 0, size_payload + 1);
+            memcpy(msg_payload, (const u_char *) udp + SIZE_UDP, size_payload);
+        }
 
     } else if (ip->ip_p == IPPROTO_TCP) {
         // Set transport TCP
         transport = 1;
 
-        tcp = (struct nread_tcp*) (packet + size_link + size_ip);
+        tcp = (const struct nread_tcp*) ((const u_char *) ip + size_ip);
         // Set packet ports
         sport = tcp->th_sport;
         dport = tcp->th_dport;
 
         // We're only interested in packets with payload
         size_payload = ntohs(ip->ip_len) - (size_ip + SIZE_TCP);
-        if (size_payload > 0) {
+        // Don't read past captured data (fragmented or truncated packets)
+        if (size_payload > end - ((const u_char *) tcp + SIZE_TCP))
+            size_payload = end - ((const u_char *) tcp + SIZE_TCP);
+        if (size_payload > 0 && sip_check_start_line((const u_char *) tcp + SIZE_TCP, size_payload)) {
             // Get packet payload
             msg_payload = malloc(size_payload + 1);
             memset(msg_payload, 0, size_payload + 1);
-            memcpy(msg_payload, (u_char *) (packet + size_link + size_ip + SIZE_TCP), size_payload);
+            memcpy(msg_payload, (const u_char *) tcp + SIZE_TCP, size_payload);
         }
-
-        // Total packet size
-        size_packet = size_link + size_ip + SIZE_TCP + size_payload;
 #ifdef WITH_OPENSSL
         if (!msg_payload || !strstr((const char*) msg_payload, "SIP/2.0")) {
             if (capture_get_keyfile()) {
@@ -225,20 +275,27 @@ parse_packet(u_char *mode, const struct pcap_pkthdr *header, const u_char *packe
 #endif
     } else {
         // Not handled protocol
-        return;
+        return NULL;
     }
 
     // We're only interested in packets with payload
     if (size_payload <= 0)
-        return;
+        return NULL;
+
+    // Payload is not SIP, reject it without parsing
+    if (!msg_payload) {
+        if (rejected)
+            *rejected = 1;
+        return NULL;
+    }
 
     // Parse this header and payload
-    msg = sip_load_message(header->ts, ip->ip_src, sport, ip->ip_dst, dport, msg_payload);
+    msg = sip_parse_message(header->ts, ip->ip_src, sport, ip->ip_dst, dport, msg_payload);
     free(msg_payload);
 
     // This is not a sip message, Bye!
     if (!msg)
-        return;
+        return NULL;
 
     // Store Transport attribute
     if (transport == 0) {
@@ -252,9 +309,344 @@ parse_packet(u_char *mode, const struct pcap_pkthdr *header, const u_char *packe
     // Set message PCAP data
     msg->pcap_header = malloc(sizeof(struct pcap_pkthdr));
     memcpy(msg->pcap_header, header, sizeof(struct pcap_pkthdr));
-    msg->pcap_packet = malloc(size_packet);
-    memcpy(msg->pcap_packet, packet, size_packet);
+    msg->pcap_packet = malloc(header->caplen);
+    memcpy(msg->pcap_packet, packet, header->caplen);
+
+    // Store packet position in the input file
+    if (capinfo.file && packet > capinfo.file->data && packet < capinfo.file->data + capinfo.file->size)
+        msg->pcap_offset = packet - capinfo.file->data;
+
+    return msg;
+}
+
+/**
+ * @brief Check if a packet belongs to an expected RTP stream
+ *
+ * @return 1 if packet has been counted in a RTP stream, 0 otherwise
+ */
+static int
+capture_packet_rtp(const struct pcap_pkthdr *header, const u_char *packet)
+{
+    // IP header data
+    const struct nread_ip *ip;
+    // IP header size
+    int size_ip;
+    // UDP header data
+    const struct nread_udp *udp;
+    // Packet payload size
+    int size_payload;
+
+    // End of captured data
+    const u_char *end = packet + header->caplen;
+
+    // Get IP header
+    if (!(ip = capinfo.decode(header, packet)) || IP_HL(ip) < 5)
+        return 0;
+    size_ip = IP_HL(ip) * 4;
+
+    // RTP streams are only detected over UDP
+    if (ip->ip_p != IPPROTO_UDP)
+        return 0;
+
+    // Only the first fragment of a packet has the UDP header
+    if (ntohs(ip->ip_off) & IP_OFFMASK)
+        return 0;
+
+    // Get UDP header
+    udp = (const struct nread_udp*) ((const u_char *) ip + size_ip);
+    if ((const u_char *) udp + SIZE_UDP > end)
+        return 0;
+    size_payload = htons(udp->udp_hlen) - SIZE_UDP;
+    if (size_payload <= 0 || (const u_char *) udp + SIZE_UDP + size_payload > end)
+        return 0;
+
+    return rtp_check_packet(header->ts, ip->ip_dst, udp->udp_dport, ip->ip_src, udp->udp_sport,
+                            (const u_char *) udp + SIZE_UDP, size_payload) != NULL;
+}
 
+/**
+ * @brief Add a parsed message to its call
+ *
+ * @return the message or NULL if it has been discarded
+ */
+static sip_msg_t *
+capture_packet_commit(sip_msg_t *msg)
+{
+    if (!(msg = sip_commit_message(msg)))
+        return NULL;
+
+    // Message payload can be released from memory now
+    spool_store(msg);
+
+    // Notify the interface there is new data to display
+    ui_wakeup();
+
+    return msg;
+}
+
+sip_msg_t *
+capture_packet(const struct pcap_pkthdr *header, const u_char *packet)
+{
+    sip_msg_t *msg;
+    int rejected = 0;
+
+    if (capture_packet_ignored())
+        return NULL;
+
+    // Store this packets in output file
+    TRACE_BEGIN(dump);
+    capture_dump_packet(capinfo.dump, header, packet);
+    TRACE_END(TRACE_DUMP, dump);
+
+    // Forget media streams that are no longer active
+    if (rtp_is_enabled())
+        rtp_expire(header->ts.tv_sec);
+
+    // Add learned media to the capture filter
+    capture_bpf_update(header->ts.tv_sec);
+
+    // Count packets of expected RTP streams
+    if (rtp_is_enabled() && capture_packet_rtp(header, packet))
+        return NULL;
+
+    // Parse the packet and add its message to the call
+    if (!(msg = capture_packet_parse(header, packet, &rejected))) {
+        if (rejected)
+            stats_add_rejected(header->ts.tv_sec, 1);
+        return NULL;
+    }
+
+    return capture_packet_commit(msg);
+}
+
+void
+capture_load_message(sip_msg_t *msg, char **payload, u_char **packet)
+{
+    sip_msg_t *parsed = NULL;
+
+    *payload = NULL;
+    *packet = NULL;
+
+    // Parse again the message packet from the input file
+    if (capinfo.file && msg->pcap_offset && msg->pcap_header
+        && msg->pcap_offset + msg->pcap_header->caplen <= capinfo.file->size) {
+        parsed = capture_packet_parse(msg->pcap_header, capinfo.file->data + msg->pcap_offset,
+                                      NULL);
+    }
+
+    // Take the payload and packet data from the parsed message
+    if (parsed) {
+        *payload = parsed->payload;
+        parsed->payload = NULL;
+        *packet = parsed->pcap_packet;
+        parsed->pcap_packet = NULL;
+        sip_msg_destroy(parsed);
+    }
+}
+
+/**
+ * @brief Store the message of a packet in its file range
+ */
+static void
+capture_shard_packet(u_char *user, const struct pcap_pkthdr *header, const u_char *packet)
+{
+    capture_shard_t *shard = (capture_shard_t *) user;
+    sip_msg_t *msg;
+    int rejected = 0;
+
+    if (!(msg = capture_packet_parse(header, packet, &rejected))) {
+        // Count rejected packets by second, they are accounted with the messages
+        if (rejected) {
+            if (!shard->rejcount || shard->rejsec[shard->rejcount - 1] != header->ts.tv_sec) {
+                if (shard->rejcount == shard->rejsize) {
+                    shard->rejsize = (shard->rejsize) ? shard->rejsize * 2 : 64;
+                    shard->rejsec = realloc(shard->rejsec, sizeof(time_t) * shard->rejsize);
+                    shard->rejcnt = realloc(shard->rejcnt, sizeof(int) * shard->rejsize);
+                }
+                shard->rejsec[shard->rejcount] = header->ts.tv_sec;
+                shard->rejcnt[shard->rejcount++] = 0;
+            }
+            shard->rejcnt[shard->rejcount - 1]++;
+        }
+        return;
+    }
+
+    if (shard->msgcnt == shard->msgsize) {
+        shard->msgsize = (shard->msgsize) ? shard->msgsize * 2 : 256;
+        shard->msgs = realloc(shard->msgs, sizeof(sip_msg_t *) * shard->msgsize);
+    }
+    shard->msgs[shard->msgcnt++] = msg;
+}
+
+/**
+ * @brief Parallel loader thread
+ *
+ * Parse file ranges until all of them have been read.
+ */
+static void *
+capture_loader_thread(void *data)
+{
+    capture_loader_t *loader = (capture_loader_t *) data;
+    capture_shard_t *shard;
+
+    for (;;) {
+        // Get next range to be parsed
+        pthread_mutex_lock(&loader->lock);
+        shard = (loader->next < loader->count) ? &loader->shards[loader->next++] : NULL;
+        pthread_mutex_unlock(&loader->lock);
+
+        if (!shard)
+            break;
+
+        shard->last = capture_file_loop_range(capinfo.file, shard->start, shard->end,
+                                              capture_shard_packet, (u_char *) shard);
+
+        // Notify the range is ready
+        pthread_mutex_lock(&loader->lock);
+        shard->done = 1;
+        pthread_cond_broadcast(&loader->cond);
+        pthread_mutex_unlock(&loader->lock);
+    }
+
+    return NULL;
+}
+
+/**
+ * @brief Read the input file using multiple threads
+ *
+ * File is split in ranges parsed by loader threads. Parsed messages
+ * are added to calls from this thread in file order. If a range end
+ * turns out not to be a record boundary, the rest of the file is read
+ * sequentially.
+ *
+ * @return 0 if all packets have been read, -2 if reading was stopped,
+ * 1 if file can not be read in parallel
+ */
+static int
+capture_loader_run()
+{
+    capture_loader_t loader;
+    capture_shard_t *shard;
+    pthread_t *workers;
+    size_t *bounds;
+    size_t resume = 0;
+    int threads, started, count, i, j, ret = 0;
+
+    // Get number of loader threads
+    if ((threads = get_option_int_value("capture.threads")) <= 0)
+        threads = sysconf(_SC_NPROCESSORS_ONLN);
+
+    // Packets must be read in order to be dumped, decrypted, resolved or matched with RTP streams
+    if (threads < 2 || capinfo.dump || capinfo.keyfile || is_option_enabled("capture.lookup")
+        || rtp_is_enabled())
+        return 1;
+
+    // Split file in ranges of at least a read batch
+    count = threads * CAPTURE_SHARDS_PER_THREAD;
+    if ((size_t) count > capinfo.file->size / CAPTURE_FILE_BATCH)
+        count = capinfo.file->size / CAPTURE_FILE_BATCH;
+    if (count < 2)
+        return 1;
+
+    bounds = malloc(sizeof(size_t) * (count + 1));
+    if ((count = capture_file_split(capinfo.file, bounds, count)) < 2) {
+        free(bounds);
+        return 1;
+    }
+
+    memset(&loader, 0, sizeof(capture_loader_t));
+    loader.count = count;
+    loader.shards = malloc(sizeof(capture_shard_t) * count);
+    memset(loader.shards, 0, sizeof(capture_shard_t) * count);
+    for (i = 0; i < count; i++) {
+        loader.shards[i].start = bounds[i];
+        loader.shards[i].end = bounds[i + 1];
+    }
+    free(bounds);
+    pthread_mutex_init(&loader.lock, NULL);
+    pthread_cond_init(&loader.cond, NULL);
+
+    // Launch loader threads
+    if (threads > count)
+        threads = count;
+    workers = malloc(sizeof(pthread_t) * threads);
+    gettimeofday(&capinfo.file->start, NULL);
+    for (started = 0; started < threads; started++) {
+        if (pthread_create(&workers[started], NULL, capture_loader_thread, &loader))
+            break;
+    }
+
+    // Add parsed messages to their calls in file order
+    for (i = 0; started && i < count; i++) {
+        shard = &loader.shards[i];
+
+        pthread_mutex_lock(&loader.lock);
+        while (!shard->done)
+            pthread_cond_wait(&loader.cond, &loader.lock);
+        pthread_mutex_unlock(&loader.lock);
+
+        if (capinfo.file->stop) {
+            ret = -2;
+            break;
+        }
+
+        for (j = 0; j < shard->msgcnt; j++) {
+            if (capture_packet_ignored()) {
+                sip_msg_destroy(shard->msgs[j]);
+            } else {
+                capture_packet_commit(shard->msgs[j]);
+            }
+        }
+        shard->msgcnt = 0;
+        for (j = 0; j < shard->rejcount; j++)
+            stats_add_rejected(shard->rejsec[j], shard->rejcnt[j]);
+        shard->rejcount = 0;
+        capinfo.file->offset = shard->end;
+
+        // This range didn't end in a record boundary
+        if (shard->last != shard->end) {
+            resume = shard->last;
+            break;
+        }
+    }
+
+    // Wait until all loader threads finish
+    for (j = 0; j < started; j++)
+        pthread_join(workers[j], NULL);
+
+    // Discard messages of not added ranges
+    for (i = 0; i < count; i++) {
+        shard = &loader.shards[i];
+        for (j = 0; j < shard->msgcnt; j++)
+            sip_msg_destroy(shard->msgs[j]);
+        free(shard->msgs);
+        free(shard->rejsec);
+        free(shard->rejcnt);
+    }
+
+    free(loader.shards);
+    free(workers);
+    pthread_mutex_destroy(&loader.lock);
+    pthread_cond_destroy(&loader.cond);
+
+    // No thread could be launched
+    if (!started)
+        return 1;
+
+    // Reading has been stopped
+    if (ret == -2) {
+        capinfo.file->stop = 0;
+        return ret;
+    }
+
+    // Read the rest of the file sequentially
+    if (resume) {
+        capinfo.file->offset = resume;
+        return capture_file_loop(capinfo.file, parse_packet, NULL);
+    }
+
+    capinfo.file->offset = capinfo.file->size;
+    return 0;
 }
 
 void
@@ -262,15 +654,17 @@ capture_close()
 {
     //Close PCAP file
     if (capinfo.handle) {
-        pcap_breakloop(capinfo.handle);
-        pthread_join(capinfo.capture_t, NULL);
+        capture_stop();
+        if (capinfo.capture_t)
+            pthread_join(capinfo.capture_t, NULL);
         pcap_close(capinfo.handle);
     }
 
+    // Unmap input file
+    capture_file_close(capinfo.file);
+
     // Close dump file
-    if (capinfo.pd) {
-        dump_close(capinfo.pd);
-    }
+    capture_dump_close(capinfo.dump);
 }
 
 int
@@ -279,7 +673,6 @@ capture_launch_thread()
     //! capture thread attributes
     pthread_attr_t attr;
     pthread_attr_init(&attr);
-    pthread_attr_setdetachstate(&attr, PTHREAD_CREATE_DETACHED);
     if (pthread_create(&capinfo.capture_t, &attr, (void *) capture_thread, NULL)) {
         return 1;
     }
@@ -290,11 +683,70 @@ capture_launch_thread()
 void
 capture_thread(void *none)
 {
+    int ret;
+
     // Parse available packets
-    pcap_loop(capinfo.handle, -1, parse_packet, NULL);
+    if (capinfo.file) {
+        // Load calls from the file index if available (it doesn't store RTP streams)
+        if (rtp_is_enabled() || capture_index_load(capinfo.file, capinfo.infile) != 0) {
+            // Try to parse file packets using multiple threads
+            if ((ret = capture_loader_run()) == 1)
+                ret = capture_file_loop(capinfo.file, parse_packet, NULL);
+            // Store the file index after a complete load
+            if (ret == 0 && !rtp_is_enabled())
+                capture_index_save(capinfo.file, capinfo.infile);
+        }
+    } else {
+        pcap_loop(capinfo.handle, -1, parse_packet, NULL);
+    }
+    // In offline mode, set capture to fully loaded
+    if (!capture_is_online()) {
+        capinfo.status = CAPTURE_OFFLINE;
+        ui_wakeup();
+    }
+}
+
+int
+capture_run(pcap_handler callback, void (*timer)())
+{
+    char errbuf[PCAP_ERRBUF_SIZE];
+    struct pollfd fds;
+    int ret = 0;
+
+    // Parse available packets
+    if (capinfo.file) {
+        capture_file_loop(capinfo.file, callback, NULL);
+    } else if (!timer || (fds.fd = pcap_get_selectable_fd(capinfo.handle)) == -1
+               || pcap_setnonblock(capinfo.handle, 1, errbuf) == -1) {
+        if (pcap_loop(capinfo.handle, -1, callback, NULL) == -1)
+            return 1;
+    } else {
+        // Packet buffer timeout may never expire without packets, so wait for them here
+        fds.events = POLLIN;
+        while (!capinfo.stop) {
+            fds.revents = 0;
+            if (poll(&fds, 1, 1000) > 0
+                && (ret = pcap_dispatch(capinfo.handle, -1, callback, NULL)) < 0)
+                break;
+            timer();
+        }
+        if (ret == -1)
+            return 1;
+    }
     // In offline mode, set capture to fully loaded
     if (!capture_is_online())
         capinfo.status = CAPTURE_OFFLINE;
+    return 0;
+}
+
+void
+capture_stop()
+{
+    capinfo.stop = 1;
+    if (capinfo.file)
+        capture_file_stop(capinfo.file);
+    if (capinfo.handle)
+        pcap_breakloop(capinfo.handle);
 }
 
 int
@@ -306,13 +758,29 @@ capture_is_online()
 int
 capture_set_bpf_filter(const char *filter)
 {
+    struct bpf_program fp;
+
     //! Check if filter compiles
-    if (pcap_compile(capinfo.handle, &capinfo.fp, filter, 0, capinfo.mask) == -1)
+    if (pcap_compile(capinfo.handle, &fp, filter, 0, capinfo.mask) == -1)
         return 1;
 
-    // Set capture filter
-    if (pcap_setfilter(capinfo.handle, &capinfo.fp) == -1)
+    // Mapped files apply the filter while reading
+    if (capinfo.file) {
+        pcap_freecode(&capinfo.fp);
+        capinfo.fp = fp;
+        capture_file_set_filter(capinfo.file, &capinfo.fp);
+        return 0;
+    }
+
+    // Replace capture filter
+    if (pcap_setfilter(capinfo.handle, &fp) == -1) {
+        pcap_freecode(&fp);
         return 1;
+    }
+
+    // Previous filter is no longer used
+    pcap_freecode(&capinfo.fp);
+    capinfo.fp = fp;
 
     return 0;
 }
@@ -323,6 +791,12 @@ capture_set_limit(int limit)
     capinfo.limit = limit;
 }
 
+int
+capture_get_limit()
+{
+    return capinfo.limit;
+}
+
 void
 capture_set_paused(int pause)
 {
@@ -343,6 +817,10 @@ capture_is_paused()
 const char *
 capture_status()
 {
+    static char status[80];
+    double rate;
+    int percent;
+
     switch(capinfo.status) {
         case CAPTURE_ONLINE:
             return "Online";
@@ -351,11 +829,22 @@ capture_status()
         case CAPTURE_OFFLINE:
             return "Offline";
         case CAPTURE_OFFLINE_LOADING:
-            return "Offline (Loading)";
+            if (!capinfo.file)
+                return "Offline (Loading)";
+            // Show progress of mapped files
+            capture_file_progress(capinfo.file, &percent, &rate);
+            sprintf(status, "Offline (Loading %d%%, %.1f MB/s)", percent, rate / 1048576);
+            return status;
     }
     return "";
 }
 
+int
+capture_get_datalink()
+{
+    return capinfo.link;
+}
+
 const char*
 capture_get_infile()
 {
@@ -368,6 +857,12 @@ capture_get_keyfile()
     return capinfo.keyfile;
 }
 
+capture_dump_t *
+capture_get_dump()
+{
+    return capinfo.dump;
+}
+
 void
 capture_set_keyfile(const char *keyfile)
 {
@@ -380,68 +875,6 @@ capture_last_error()
     return pcap_geterr(capinfo.handle);
 }
 
-int
-datalink_size(int datalink)
-{
-    // Datalink header size
-    switch(datalink) {
-        case DLT_EN10MB:
-            return 14;
-        case DLT_IEEE802:
-            return 22;
-        case DLT_LOOP:
-        case DLT_NULL:
-            return 4;
-        case DLT_SLIP:
-        case DLT_SLIP_BSDOS:
-            return 16;
-        case DLT_PPP:
-        case DLT_PPP_BSDOS:
-        case DLT_PPP_SERIAL:
-        case DLT_PPP_ETHER:
-            return 4;
-        case DLT_RAW:
-            return 0;
-        case DLT_FDDI:
-            return 21;
-        case DLT_ENC:
-            return 12;
-        case DLT_LINUX_SLL:
-            return 16;
-#ifdef DLT_IPNET
-        case DLT_IPNET:
-            return 24;
-#endif
-        default:
-            // Not handled datalink type
-            return -1;
-    }
-
-}
-
-pcap_dumper_t *
-dump_open(const char *dumpfile)
-{
-    return pcap_dump_open(capinfo.handle, dumpfile);
-}
-
-void
-dump_packet(pcap_dumper_t *pd, const struct pcap_pkthdr *header, const u_char *packet)
-{
-    if (!pd)
-        return;
-    pcap_dump((u_char*) pd, header, packet);
-    pcap_dump_flush(pd);
-}
-
-void
-dump_close(pcap_dumper_t *pd)
-{
-    if (!pd)
-        return;
-    pcap_dump_close(pd);
-}
-
 const char *
 lookup_hostname(struct in_addr *addr)
 {
@@ -39,6 +39,11 @@
 #include <arpa/inet.h>
 #include <netinet/if_ether.h>
 #include <time.h>
+#include <signal.h>
+#include "sip.h"
+#include "capture_file.h"
+#include "capture_dump.h"
+#include "capture_link.h"
 
 //! Capture modes
 enum capture_status {
@@ -52,6 +57,10 @@ enum capture_status {
 typedef struct capture_info capture_info_t;
 //! Shorter declaration of dns_cache structure
 typedef struct dns_cache dns_cache_t;
+//! Shorter declaration of capture_shard structure
+typedef struct capture_shard capture_shard_t;
+//! Shorter declaration of capture_loader structure
+typedef struct capture_loader capture_loader_t;
 
 /**
  * @brief Storage for DNS resolved ips
@@ -88,16 +97,73 @@ struct capture_info {
     bpf_u_int32 net;
     //! libpcap capture handler
     pcap_t *handle;
-    //! libpcap dump file handler
-    pcap_dumper_t *pd;
+    //! Mapped input file in Offline capture
+    capture_file_t *file;
+    //! Output file writer (when capturing online with -O)
+    capture_dump_t *dump;
     //! libpcap link type
     int link;
+    //! Decoder for link type headers
+    capture_link_decoder_t decode;
     //! Cache for DNS lookups
     dns_cache_t dnscache;
     //! Capture thread for online capturing
     pthread_t capture_t;
+    //! capture_run must stop reading packets
+    volatile sig_atomic_t stop;
 };
 
+/**
+ * @brief Messages parsed from a range of the input file
+ */
+struct capture_shard {
+    //! Range start offset
+    size_t start;
+    //! Range end offset
+    size_t end;
+    //! Offset where range reading stopped
+    size_t last;
+    //! Parsed messages in file order
+    sip_msg_t **msgs;
+    //! Number of parsed messages
+    int msgcnt;
+    //! Size of parsed messages array
+    int msgsize;
+    //! Seconds with rejected packets in file order
+    time_t *rejsec;
+    //! Rejected packets of each second
+    int *rejcnt;
+    //! Number of seconds with rejected packets
+    int rejcount;
+    //! Size of rejected packets arrays
+    int rejsize;
+    //! Range has been read
+    int done;
+};
+
+/**
+ * @brief Parallel input file loader
+ *
+ * Input file is split in ranges that are parsed by multiple threads,
+ * while the capture thread adds the parsed messages to their calls in
+ * file order, so calls are the same as reading the file sequentially.
+ */
+struct capture_loader {
+    //! File ranges
+    capture_shard_t *shards;
+    //! Number of file ranges
+    int count;
+    //! Next range to be parsed
+    int next;
+    //! Lock for ranges status
+    pthread_mutex_t lock;
+    //! Signaled when a range has been read
+    pthread_cond_t cond;
+};
+
+//! Number of file ranges per loader thread
+#define CAPTURE_SHARDS_PER_THREAD 4
+
 //! UDP headers are always exactly 8 bytes
 #define SIZE_UDP 8
 //! TCP headers size
@@ -213,6 +279,60 @@ capture_offline(const char *infile);
 void
 parse_packet(u_char *mode, const struct pcap_pkthdr *header, const u_char *packet);
 
+/**
+ * @brief Parse SIP message from a captured package
+ *
+ * This function does the work of parse_packet, returning the
+ * parsed message to the caller.
+ *
+ * @param header PCAP packet header
+ * @param packet PCAP packet data
+ * @return the parsed SIP message or NULL if packet is not SIP
+ */
+sip_msg_t *
+capture_packet(const struct pcap_pkthdr *header, const u_char *packet);
+
+/**
+ * @brief Read the payload and packet data of a message from input file
+ *
+ * Messages loaded from a capture file index only have their packet
+ * position in the input file. This function parses that packet again
+ * to get the message payload and packet data. Message is not modified,
+ * so this can be called without locking it.
+ *
+ * @param msg SIP message loaded from a capture file index
+ * @param payload Read payload (NULL if packet could not be read)
+ * @param packet Read packet data (NULL if packet could not be read)
+ */
+void
+capture_load_message(sip_msg_t *msg, char **payload, u_char **packet);
+
+/**
+ * @brief Parse packets in the current thread
+ *
+ * Read packets from the capture handler, passing them to the given
+ * callback, until the input file ends or capture_stop is called.
+ * This is used instead of the capture thread when there is no
+ * interface.
+ *
+ * In online captures, the timer function is also called at least once
+ * per second, even if no packet is received.
+ *
+ * @param callback Function called for each read packet
+ * @param timer Function called periodically in online captures (or NULL)
+ * @return 0 if all packets have been read, 1 on error
+ */
+int
+capture_run(pcap_handler callback, void (*timer)());
+
+/**
+ * @brief Stop reading packets in capture_run
+ *
+ * This function can be called from signal handlers.
+ */
+void
+capture_stop();
+
 /**
  * @brief Create a capture thread for online mode
  *
@@ -256,6 +376,14 @@ capture_set_bpf_filter(const char *filter);
 void
 capture_set_limit(int limit);
 
+/**
+ * @brief Get the number of calls that will be captured
+ *
+ * @return calls capture limit, 0 if disabled
+ */
+int
+capture_get_limit();
+
 /**
  * @brief Pause/Resume capture
  *
@@ -278,6 +406,14 @@ capture_is_paused();
 const char *
 capture_status();
 
+/**
+ * @brief Get link type of captured packets
+ *
+ * @return pcap link type
+ */
+int
+capture_get_datalink();
+
 /**
  * @brief Get Input file from Offline mode
  *
@@ -295,6 +431,14 @@ capture_get_infile();
 const char*
 capture_get_keyfile();
 
+/**
+ * @brief Get the dump file where captured packets are stored
+ *
+ * @return output dump file or NULL if packets are not being stored
+ */
+capture_dump_t *
+capture_get_dump();
+
 /**
  * @brief Set Keyfile to decrypt TLS packets
  *
@@ -315,33 +459,6 @@ capture_last_error();
 void
 capture_close();
 
-/**
- * @brief Get datalink header size
- *
- */
-int
-datalink_size(int datalink);
-
-/**
- * @brief Open a new dumper file for capture handler
- */
-pcap_dumper_t *
-dump_open(const char *dumpfile);
-
-/**
- * @brief Store a packet in dump file
- *
- * File must be previously opened with dump_open
- */
-void
-dump_packet(pcap_dumper_t *pd, const struct pcap_pkthdr *header, const u_char *packet);
-
-/**
- * @brief Close a dump file
- */
-void
-dump_close(pcap_dumper_t *pd);
-
 /**
  * @brief Try to get hostname from its address
  *
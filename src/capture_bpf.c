@@ -0,0 +1,206 @@
+/**************************************************************************
+ **
+ ** sngrep - SIP Messages flow viewer
+ **
+ ** Copyright (C) 2013,2014 Ivan Alonso (Kaian)
+ ** Copyright (C) 2013,2014 Irontec SL. All rights reserved.
+ **
+ ** This program is free software: you can redistribute it and/or modify
+ ** it under the terms of the GNU General Public License as published by
+ ** the Free Software Foundation, either version 3 of the License, or
+ ** (at your option) any later version.
+ **
+ ** This program is distributed in the hope that it will be useful,
+ ** but WITHOUT ANY WARRANTY; without even the implied warranty of
+ ** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ ** GNU General Public License for more details.
+ **
+ ** You should have received a copy of the GNU General Public License
+ ** along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ **
+ ****************************************************************************/
+/**
+ * @file capture_bpf.c
+ * @author Ivan Alonso [aka Kaian] <kaian@irontec.com>
+ *
+ * @brief Source of functions defined in capture_bpf.h
+ *
+ */
+#include "config.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pcap.h>
+#include <arpa/inet.h>
+#include "capture.h"
+#include "capture_bpf.h"
+#include "option.h"
+#include "rtp.h"
+
+//! Automatic capture filter status
+static capture_bpf_t autobpf;
+
+/**
+ * @brief Append a list of filter primitives joined by 'or'
+ *
+ * Each comma separated item of the list is added using the range
+ * primitive if it contains the range separator or the single one
+ * otherwise, for example "port 5060 or portrange 5070-5080".
+ *
+ * @return number of added primitives
+ */
+static int
+capture_bpf_list(char *filter, size_t len, const char *list, const char *single,
+                 const char *range, char sep)
+{
+    char items[CAPTURE_BPF_SIPLEN];
+    char *item, *saveptr = NULL;
+    int count = 0;
+
+    if (!list)
+        return 0;
+
+    snprintf(items, sizeof(items), "%s", list);
+    for (item = strtok_r(items, ", ", &saveptr); item; item = strtok_r(NULL, ", ", &saveptr)) {
+        snprintf(filter + strlen(filter), len - strlen(filter), "%s%s %s",
+                 (count) ? " or " : "", strchr(item, sep) ? range : single, item);
+        count++;
+    }
+    return count;
+}
+
+/**
+ * @brief Build the SIP part of the filter from configuration
+ *
+ * @return 1 if there is any SIP port or address configured, 0 otherwise
+ */
+static int
+capture_bpf_build_sip(char *filter, size_t len)
+{
+    char ports[CAPTURE_BPF_SIPLEN] = "", addrs[CAPTURE_BPF_SIPLEN] = "";
+
+    capture_bpf_list(ports, sizeof(ports), get_option_value("capture.sipports"),
+                     "port", "portrange", '-');
+    capture_bpf_list(addrs, sizeof(addrs), get_option_value("capture.sipaddrs"),
+                     "host", "net", '/');
+
+    if (ports[0] && addrs[0]) {
+        snprintf(filter, len, "(%s) and (%s)", ports, addrs);
+    } else {
+        snprintf(filter, len, "%s%s", ports, addrs);
+    }
+
+    return filter[0] != '\0';
+}
+
+/**
+ * @brief Get the number of instructions of a compiled filter
+ *
+ * @return number of instructions or -1 if filter doesn't compile
+ */
+static int
+capture_bpf_size(const char *filter)
+{
+    static pcap_t *dead = NULL;
+    struct bpf_program fp;
+    int size;
+
+    // Filters are compiled for the link type of the capture
+    if (!dead && !(dead = pcap_open_dead(capture_get_datalink(), 65535)))
+        return -1;
+
+    if (pcap_compile(dead, &fp, filter, 0, 0) == -1)
+        return -1;
+    size = fp.bf_len;
+    pcap_freecode(&fp);
+
+    return size;
+}
+
+/**
+ * @brief Build the complete filter and set it in the capture
+ *
+ * @return 0 if filter has been set, 1 otherwise
+ */
+static int
+capture_bpf_apply()
+{
+    struct in_addr addrs[CAPTURE_BPF_MAX_MEDIA];
+    u_short ports[CAPTURE_BPF_MAX_MEDIA];
+    char addr[INET_ADDRSTRLEN];
+    char *filter;
+    size_t len = CAPTURE_BPF_SIPLEN + CAPTURE_BPF_MAX_MEDIA * 64;
+    int count = 0, fallback, ret, i;
+
+    // Get learned media destinations
+    if (autobpf.media)
+        count = rtp_get_expected(addrs, ports, CAPTURE_BPF_MAX_MEDIA);
+
+    filter = malloc(len);
+    snprintf(filter, len, "(%s)", autobpf.sip);
+
+    if (!(fallback = count > CAPTURE_BPF_MAX_MEDIA) && count) {
+        strcat(filter, " or (udp and (");
+        for (i = 0; i < count; i++) {
+            inet_ntop(AF_INET, &addrs[i], addr, sizeof(addr));
+            sprintf(filter + strlen(filter), "%s(dst host %s and dst port %d)",
+                    (i) ? " or " : "", addr, ntohs(ports[i]));
+        }
+        strcat(filter, "))");
+
+        // Kernel won't accept this program
+        fallback = capture_bpf_size(filter) > CAPTURE_BPF_MAX_INSNS;
+    }
+
+    // Too many media destinations, let userspace filter media packets
+    if (fallback) {
+        // Filter is already accepting all UDP traffic
+        if (autobpf.fallback) {
+            free(filter);
+            return 0;
+        }
+        snprintf(filter, len, "(%s) or udp", autobpf.sip);
+    }
+
+    if ((ret = capture_set_bpf_filter(filter)) == 0)
+        autobpf.fallback = fallback;
+
+    free(filter);
+    return ret;
+}
+
+int
+capture_bpf_install()
+{
+    memset(&autobpf, 0, sizeof(capture_bpf_t));
+
+    // Nothing to filter
+    if (!capture_bpf_build_sip(autobpf.sip, sizeof(autobpf.sip)))
+        return 0;
+
+    autobpf.interval = get_option_int_value("capture.autobpfinterval");
+    autobpf.version = rtp_expected_version();
+
+    if (capture_bpf_apply() != 0)
+        return 1;
+
+    // Start updating the filter with learned media
+    autobpf.media = rtp_is_enabled();
+    return 0;
+}
+
+void
+capture_bpf_update(time_t now)
+{
+    // Expected media has not changed
+    if (!autobpf.media || autobpf.version == rtp_expected_version())
+        return;
+
+    // Limit the number of filter updates
+    if (now < autobpf.last + autobpf.interval)
+        return;
+
+    autobpf.last = now;
+    autobpf.version = rtp_expected_version();
+    capture_bpf_apply();
+}
@@ -0,0 +1,95 @@
+/**************************************************************************
+ **
+ ** sngrep - SIP Messages flow viewer
+ **
+ ** Copyright (C) 2013,2014 Ivan Alonso (Kaian)
+ ** Copyright (C) 2013,2014 Irontec SL. All rights reserved.
+ **
+ ** This program is free software: you can redistribute it and/or modify
+ ** it under the terms of the GNU General Public License as published by
+ ** the Free Software Foundation, either version 3 of the License, or
+ ** (at your option) any later version.
+ **
+ ** This program is distributed in the hope that it will be useful,
+ ** but WITHOUT ANY WARRANTY; without even the implied warranty of
+ ** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ ** GNU General Public License for more details.
+ **
+ ** You should have received a copy of the GNU General Public License
+ ** along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ **
+ ****************************************************************************/
+/**
+ * @file capture_bpf.h
+ * @author Ivan Alonso [aka Kaian] <kaian@irontec.com>
+ *
+ * @brief Functions to build the capture filter from configuration
+ *
+ * When capture.autobpf is enabled and no filter is given in the command
+ * line, online captures install a filter built from capture.sipports and
+ * capture.sipaddrs settings, so packets that are not SIP are discarded
+ * by the kernel instead of being copied to userspace.
+ *
+ * If RTP streams detection is also enabled, media destinations learned
+ * from SDP are added to the filter. The filter is replaced (at most once
+ * every capture.autobpfinterval seconds) when expected media changes.
+ * If the compiled program gets too large, all UDP traffic is accepted and
+ * media packets are filtered in userspace instead.
+ */
+#ifndef __SNGREP_CAPTURE_BPF_H
+#define __SNGREP_CAPTURE_BPF_H
+
+#include "config.h"
+#include <time.h>
+
+//! Max length of the SIP part of the filter
+#define CAPTURE_BPF_SIPLEN 1024
+//! Max number of media destinations added to the filter
+#define CAPTURE_BPF_MAX_MEDIA 256
+//! Max filter instructions accepted by the kernel (Linux socket filters)
+#define CAPTURE_BPF_MAX_INSNS 4096
+
+//! Shorter declaration of capture_bpf structure
+typedef struct capture_bpf capture_bpf_t;
+
+/**
+ * @brief Automatic capture filter status
+ */
+struct capture_bpf {
+    //! Filter is updated with media learned from SDP
+    int media;
+    //! Expected media version of the installed filter
+    int version;
+    //! Second of the last filter update
+    time_t last;
+    //! Min seconds between filter updates
+    int interval;
+    //! All UDP traffic is accepted instead of learned media
+    int fallback;
+    //! Filter of SIP packets
+    char sip[CAPTURE_BPF_SIPLEN];
+};
+
+/**
+ * @brief Build and install the capture filter from configuration
+ *
+ * Nothing is installed if there are no SIP ports nor addresses configured.
+ *
+ * @return 0 if filter is installed or not required, 1 otherwise
+ */
+int
+capture_bpf_install();
+
+/**
+ * @brief Update the capture filter with learned media
+ *
+ * This is called from the capture thread for every packet, and only
+ * replaces the filter if expected media has changed since the last update
+ * and enough time has passed.
+ *
+ * @param now Current capture second
+ */
+void
+capture_bpf_update(time_t now);
+
+#endif /* __SNGREP_CAPTURE_BPF_H */
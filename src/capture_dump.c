@@ -0,0 +1,473 @@
+/**************************************************************************
+ **
+ ** sngrep - SIP Messages flow viewer
+ **
+ ** Copyright (C) 2013,2014 Ivan Alonso (Kaian)
+ ** Copyright (C) 2013,2014 Irontec SL. All rights reserved.
+ **
+ ** This program is free software: you can redistribute it and/or modify
+ ** it under the terms of the GNU General Public License as published by
+ ** the Free Software Foundation, either version 3 of the License, or
+ ** (at your option) any later version.
+ **
+ ** This program is distributed in the hope that it will be useful,
+ ** but WITHOUT ANY WARRANTY; without even the implied warranty of
+ ** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ ** GNU General Public License for more details.
+ **
+ ** You should have received a copy of the GNU General Public License
+ ** along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ **
+ ****************************************************************************/
+/**
+ * @file capture_dump.c
+ * @author Ivan Alonso [aka Kaian] <kaian@irontec.com>
+ *
+ * @brief Source of functions defined in capture_dump.h
+ *
+ */
+#include "config.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <limits.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include "capture_dump.h"
+#include "option.h"
+
+//! pcap file magic number
+#define DUMP_PCAP_MAGIC     0xa1b2c3d4
+//! pcapng Block types
+#define DUMP_PCAPNG_SHB     0x0A0D0D0A
+#define DUMP_PCAPNG_IDB     0x00000001
+#define DUMP_PCAPNG_EPB     0x00000006
+//! pcapng Byte order magic
+#define DUMP_PCAPNG_BOM     0x1A2B3C4D
+//! pcapng Interface name option
+#define DUMP_PCAPNG_IF_NAME 2
+//! Max packet size written in file headers
+#define DUMP_SNAPLEN        262144
+
+/**
+ * @brief Create a new block
+ *
+ * @param filename File to open before writing the block or NULL
+ * @param size Minimum block size
+ */
+static capture_dump_block_t *
+capture_dump_block_create(const char *filename, size_t size)
+{
+    capture_dump_block_t *block;
+
+    block = malloc(sizeof(capture_dump_block_t));
+    memset(block, 0, sizeof(capture_dump_block_t));
+    block->data = malloc((size > CAPTURE_DUMP_BLOCK) ? size : CAPTURE_DUMP_BLOCK);
+    block->filename = (filename) ? strdup(filename) : NULL;
+    return block;
+}
+
+/**
+ * @brief Free a block memory
+ */
+static void
+capture_dump_block_destroy(capture_dump_block_t *block)
+{
+    free(block->filename);
+    free(block->data);
+    free(block);
+}
+
+/**
+ * @brief Add the block being filled to the writer queue
+ *
+ * If the queue is full, wait until the writer thread has written some
+ * blocks. Must be called with dump lock held.
+ */
+static void
+capture_dump_queue(capture_dump_t *dump)
+{
+    capture_dump_block_t *block = dump->cur;
+
+    if (!block)
+        return;
+
+    // Nothing to write yet
+    if (!block->len && !block->filename)
+        return;
+
+    while (dump->queued >= CAPTURE_DUMP_QUEUE)
+        pthread_cond_wait(&dump->cond, &dump->lock);
+
+    if (dump->last) {
+        dump->last->next = block;
+    } else {
+        dump->first = block;
+    }
+    dump->last = block;
+    dump->queued++;
+    dump->cur = NULL;
+
+    pthread_cond_broadcast(&dump->cond);
+}
+
+/**
+ * @brief Append data to the block being filled
+ */
+static void
+capture_dump_append(capture_dump_t *dump, const void *data, size_t len)
+{
+    // Current block is full
+    if (dump->cur && dump->cur->len + len > CAPTURE_DUMP_BLOCK)
+        capture_dump_queue(dump);
+
+    if (!dump->cur)
+        dump->cur = capture_dump_block_create(NULL, len);
+
+    memcpy(dump->cur->data + dump->cur->len, data, len);
+    dump->cur->len += len;
+    dump->filesize += len;
+}
+
+/**
+ * @brief Get the name of a new file
+ *
+ * Expand pattern strftime conversions with given time. If the result
+ * is the same than the previous file, a sequence number is appended.
+ *
+ * @return allocated file name
+ */
+static char *
+capture_dump_filename(capture_dump_t *dump, time_t when)
+{
+    char name[PATH_MAX], seqname[PATH_MAX + 16];
+    struct tm tm;
+
+    localtime_r(&when, &tm);
+    if (!strftime(name, sizeof(name), dump->pattern, &tm))
+        snprintf(name, sizeof(name), "%s", dump->pattern);
+
+    if (dump->filename && !strcmp(dump->filename, name)) {
+        dump->seq++;
+    } else {
+        dump->seq = 0;
+        free(dump->filename);
+        dump->filename = strdup(name);
+    }
+
+    if (!dump->seq)
+        return strdup(name);
+
+    snprintf(seqname, sizeof(seqname), "%s.%d", name, dump->seq);
+    return strdup(seqname);
+}
+
+/**
+ * @brief Append the header of a new file
+ */
+static void
+capture_dump_file_header(capture_dump_t *dump)
+{
+    uint32_t hdr[7];
+    uint16_t linkhdr[2], opthdr[2];
+    uint32_t len, namelen, padlen, zero = 0;
+
+    if (dump->format == CAPTURE_DUMP_PCAP) {
+        hdr[0] = DUMP_PCAP_MAGIC;
+        // Version 2.4
+        hdr[1] = 2 | (4 << 16);
+        // Timezone and timestamp accuracy
+        hdr[2] = hdr[3] = 0;
+        hdr[4] = DUMP_SNAPLEN;
+        hdr[5] = dump->link;
+        capture_dump_append(dump, hdr, 6 * sizeof(uint32_t));
+        return;
+    }
+
+    // Section header block: version 1.0 with unknown section length
+    hdr[0] = DUMP_PCAPNG_SHB;
+    hdr[1] = 28;
+    hdr[2] = DUMP_PCAPNG_BOM;
+    hdr[3] = 1;
+    hdr[4] = hdr[5] = 0xFFFFFFFF;
+    hdr[6] = 28;
+    capture_dump_append(dump, hdr, 7 * sizeof(uint32_t));
+
+    // Interface description block, with interface name option
+    namelen = (dump->ifname) ? strlen(dump->ifname) : 0;
+    padlen = (4 - namelen % 4) % 4;
+    len = 20 + ((namelen) ? 4 + namelen + padlen + 4 : 0);
+    hdr[0] = DUMP_PCAPNG_IDB;
+    hdr[1] = len;
+    capture_dump_append(dump, hdr, 2 * sizeof(uint32_t));
+    linkhdr[0] = dump->link;
+    linkhdr[1] = 0;
+    capture_dump_append(dump, linkhdr, sizeof(linkhdr));
+    hdr[0] = DUMP_SNAPLEN;
+    capture_dump_append(dump, hdr, sizeof(uint32_t));
+    if (namelen) {
+        opthdr[0] = DUMP_PCAPNG_IF_NAME;
+        opthdr[1] = namelen;
+        capture_dump_append(dump, opthdr, sizeof(opthdr));
+        capture_dump_append(dump, dump->ifname, namelen);
+        capture_dump_append(dump, &zero, padlen);
+        // End of options
+        capture_dump_append(dump, &zero, sizeof(zero));
+    }
+    capture_dump_append(dump, &len, sizeof(len));
+}
+
+/**
+ * @brief Start a new output file
+ *
+ * @param when Time of the first packet of the new file
+ */
+static void
+capture_dump_rotate(capture_dump_t *dump, time_t when)
+{
+    char *filename;
+
+    // Write all data of previous file
+    capture_dump_queue(dump);
+
+    // Next block will be written in the new file
+    filename = capture_dump_filename(dump, when);
+    dump->cur = capture_dump_block_create(filename, 0);
+    free(filename);
+
+    dump->filesize = 0;
+    dump->filestart = 0;
+    capture_dump_file_header(dump);
+}
+
+/**
+ * @brief Write a block to the current file
+ */
+static void
+capture_dump_write(capture_dump_t *dump, capture_dump_block_t *block)
+{
+    size_t written = 0;
+    ssize_t ret;
+
+    // Block starts a new file
+    if (block->filename) {
+        if (dump->fd != -1)
+            close(dump->fd);
+        if ((dump->fd = open(block->filename, O_WRONLY | O_CREAT | O_TRUNC, 0644)) == -1
+            && !dump->error)
+            dump->error = errno;
+    }
+
+    if (dump->fd == -1)
+        return;
+
+    while (written < block->len) {
+        if ((ret = write(dump->fd, block->data + written, block->len - written)) <= 0) {
+            if (ret < 0 && errno == EINTR)
+                continue;
+            if (!dump->error)
+                dump->error = (ret < 0) ? errno : ENOSPC;
+            break;
+        }
+        written += ret;
+    }
+}
+
+/**
+ * @brief Writer thread
+ *
+ * Write queued blocks until dump is closed. If no block is queued in
+ * CAPTURE_DUMP_FLUSH seconds, the block being filled is written.
+ */
+static void *
+capture_dump_thread(void *data)
+{
+    capture_dump_t *dump = (capture_dump_t *) data;
+    capture_dump_block_t *block;
+    struct timespec timeout;
+
+    pthread_mutex_lock(&dump->lock);
+    for (;;) {
+        // Wait for blocks to be written
+        while (!dump->first && !dump->closing) {
+            clock_gettime(CLOCK_REALTIME, &timeout);
+            timeout.tv_sec += CAPTURE_DUMP_FLUSH;
+            if (pthread_cond_timedwait(&dump->cond, &dump->lock, &timeout) == ETIMEDOUT)
+                capture_dump_queue(dump);
+        }
+
+        // Dump closed and all blocks written
+        if (!(block = dump->first))
+            break;
+
+        if (!(dump->first = block->next))
+            dump->last = NULL;
+        dump->queued--;
+        pthread_cond_broadcast(&dump->cond);
+        pthread_mutex_unlock(&dump->lock);
+
+        capture_dump_write(dump, block);
+        capture_dump_block_destroy(block);
+
+        pthread_mutex_lock(&dump->lock);
+    }
+    pthread_mutex_unlock(&dump->lock);
+
+    return NULL;
+}
+
+capture_dump_t *
+capture_dump_create(const char *pattern, int link, const char *ifname,
+                    enum capture_dump_format format, size_t rotate_size, int rotate_time)
+{
+    capture_dump_t *dump;
+    char *filename;
+
+    dump = malloc(sizeof(capture_dump_t));
+    memset(dump, 0, sizeof(capture_dump_t));
+    dump->pattern = strdup(pattern);
+    dump->link = link;
+    dump->ifname = (ifname) ? strdup(ifname) : NULL;
+    dump->format = format;
+    dump->rotate_size = rotate_size;
+    dump->rotate_time = rotate_time;
+
+    // Open first file now to report errors
+    filename = capture_dump_filename(dump, time(NULL));
+    dump->fd = open(filename, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    free(filename);
+    if (dump->fd == -1) {
+        free(dump->filename);
+        free(dump->ifname);
+        free(dump->pattern);
+        free(dump);
+        return NULL;
+    }
+
+    capture_dump_file_header(dump);
+
+    pthread_mutex_init(&dump->lock, NULL);
+    pthread_cond_init(&dump->cond, NULL);
+    if (pthread_create(&dump->thread, NULL, capture_dump_thread, dump) != 0) {
+        close(dump->fd);
+        pthread_mutex_destroy(&dump->lock);
+        pthread_cond_destroy(&dump->cond);
+        capture_dump_block_destroy(dump->cur);
+        free(dump->filename);
+        free(dump->ifname);
+        free(dump->pattern);
+        free(dump);
+        return NULL;
+    }
+
+    return dump;
+}
+
+capture_dump_t *
+capture_dump_open(const char *pattern, int link, const char *ifname)
+{
+    enum capture_dump_format format = CAPTURE_DUMP_PCAP;
+    const char *value;
+
+    if ((value = get_option_value("capture.outformat")) && !strcasecmp(value, "pcapng"))
+        format = CAPTURE_DUMP_PCAPNG;
+
+    return capture_dump_create(pattern, link, ifname, format,
+                               (size_t) get_option_int_value("capture.rotatesize") * 1024 * 1024,
+                               get_option_int_value("capture.rotatetime"));
+}
+
+void
+capture_dump_packet(capture_dump_t *dump, const struct pcap_pkthdr *header,
+                    const u_char *packet)
+{
+    uint32_t hdr[7];
+    uint64_t ts;
+    uint32_t padlen = 0, reclen, zero = 0;
+
+    if (!dump || !header || !packet)
+        return;
+
+    if (dump->format == CAPTURE_DUMP_PCAP) {
+        reclen = 16 + header->caplen;
+    } else {
+        padlen = (4 - header->caplen % 4) % 4;
+        reclen = 32 + header->caplen + padlen;
+    }
+
+    pthread_mutex_lock(&dump->lock);
+
+    // Check if packet must be written in a new file
+    if (dump->filestart) {
+        if ((dump->rotate_size && dump->filesize + reclen > dump->rotate_size)
+            || (dump->rotate_time && header->ts.tv_sec >= dump->filestart + dump->rotate_time))
+            capture_dump_rotate(dump, header->ts.tv_sec);
+    }
+
+    // First packet of this file, time rotation is aligned to its interval
+    if (!dump->filestart) {
+        dump->filestart = header->ts.tv_sec;
+        if (dump->rotate_time)
+            dump->filestart -= dump->filestart % dump->rotate_time;
+    }
+
+    if (dump->format == CAPTURE_DUMP_PCAP) {
+        hdr[0] = header->ts.tv_sec;
+        hdr[1] = header->ts.tv_usec;
+        hdr[2] = header->caplen;
+        hdr[3] = header->len;
+        capture_dump_append(dump, hdr, 4 * sizeof(uint32_t));
+        capture_dump_append(dump, packet, header->caplen);
+    } else {
+        // Enhanced packet block in interface 0 with microseconds timestamp
+        ts = (uint64_t) header->ts.tv_sec * 1000000 + header->ts.tv_usec;
+        hdr[0] = DUMP_PCAPNG_EPB;
+        hdr[1] = reclen;
+        hdr[2] = 0;
+        hdr[3] = ts >> 32;
+        hdr[4] = ts & 0xFFFFFFFF;
+        hdr[5] = header->caplen;
+        hdr[6] = header->len;
+        capture_dump_append(dump, hdr, 7 * sizeof(uint32_t));
+        capture_dump_append(dump, packet, header->caplen);
+        capture_dump_append(dump, &zero, padlen);
+        capture_dump_append(dump, &reclen, sizeof(reclen));
+    }
+
+    pthread_mutex_unlock(&dump->lock);
+}
+
+int
+capture_dump_close(capture_dump_t *dump)
+{
+    int error;
+
+    if (!dump)
+        return 0;
+
+    // Write all pending blocks
+    pthread_mutex_lock(&dump->lock);
+    capture_dump_queue(dump);
+    dump->closing = 1;
+    pthread_cond_broadcast(&dump->cond);
+    pthread_mutex_unlock(&dump->lock);
+
+    pthread_join(dump->thread, NULL);
+
+    if (dump->fd != -1 && close(dump->fd) != 0 && !dump->error)
+        dump->error = errno;
+    if (dump->cur)
+        capture_dump_block_destroy(dump->cur);
+
+    pthread_mutex_destroy(&dump->lock);
+    pthread_cond_destroy(&dump->cond);
+    free(dump->filename);
+    free(dump->ifname);
+    free(dump->pattern);
+    error = dump->error;
+    free(dump);
+
+    return error;
+}
@@ -0,0 +1,180 @@
+/**************************************************************************
+ **
+ ** sngrep - SIP Messages flow viewer
+ **
+ ** Copyright (C) 2013,2014 Ivan Alonso (Kaian)
+ ** Copyright (C) 2013,2014 Irontec SL. All rights reserved.
+ **
+ ** This program is free software: you can redistribute it and/or modify
+ ** it under the terms of the GNU General Public License as published by
+ ** the Free Software Foundation, either version 3 of the License, or
+ ** (at your option) any later version.
+ **
+ ** This program is distributed in the hope that it will be useful,
+ ** but WITHOUT ANY WARRANTY; without even the implied warranty of
+ ** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ ** GNU General Public License for more details.
+ **
+ ** You should have received a copy of the GNU General Public License
+ ** along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ **
+ ****************************************************************************/
+/**
+ * @file capture_dump.h
+ * @author Ivan Alonso [aka Kaian] <kaian@irontec.com>
+ *
+ * @brief Functions to write captured packets to files
+ *
+ * Captured packets are copied into blocks of CAPTURE_DUMP_BLOCK bytes
+ * that are written by a separate writer thread, so the capture thread
+ * never waits for disk writes. Blocks are written when they are full or
+ * after CAPTURE_DUMP_FLUSH seconds.
+ *
+ * Output files can be rotated by size (capture.rotatesize MB) or time
+ * (capture.rotatetime seconds, based on packet timestamps). The output
+ * file name can contain strftime conversions, expanded with the time
+ * of the first packet of each file. If two files would have the same
+ * name, a sequence number is appended to the new one.
+ *
+ * Files are written in pcap format or, if capture.outformat option is
+ * pcapng, in pcapng format with an interface block in each file.
+ */
+#ifndef __SNGREP_CAPTURE_DUMP_H
+#define __SNGREP_CAPTURE_DUMP_H
+
+#include "config.h"
+#include <pcap.h>
+#include <pthread.h>
+#include <time.h>
+
+//! Size of written blocks
+#define CAPTURE_DUMP_BLOCK (1024 * 1024)
+//! Max number of blocks waiting to be written
+#define CAPTURE_DUMP_QUEUE 64
+//! Seconds before writing a not full block
+#define CAPTURE_DUMP_FLUSH 1
+
+//! Shorter declaration of capture_dump structure
+typedef struct capture_dump capture_dump_t;
+//! Shorter declaration of capture_dump_block structure
+typedef struct capture_dump_block capture_dump_block_t;
+
+/**
+ * @brief Supported output formats
+ */
+enum capture_dump_format {
+    CAPTURE_DUMP_PCAP = 0,
+    CAPTURE_DUMP_PCAPNG,
+};
+
+/**
+ * @brief Block of data pending to be written
+ */
+struct capture_dump_block {
+    //! Block data
+    char *data;
+    //! Bytes used in block data
+    size_t len;
+    //! File to open before writing this block (NULL for current file)
+    char *filename;
+    //! Next block in the queue
+    capture_dump_block_t *next;
+};
+
+/**
+ * @brief Output file writer information
+ */
+struct capture_dump {
+    //! Output format
+    enum capture_dump_format format;
+    //! Output file name (can contain strftime conversions)
+    char *pattern;
+    //! Packets link type
+    int link;
+    //! Capture interface name (can be NULL)
+    char *ifname;
+    //! Max file size in bytes (0 for no size rotation)
+    size_t rotate_size;
+    //! Seconds of packets per file (0 for no time rotation)
+    int rotate_time;
+    //! Expanded pattern of the current file (without sequence number)
+    char *filename;
+    //! Sequence number of the current file
+    int seq;
+    //! Bytes written to current file (including queued blocks)
+    size_t filesize;
+    //! Start time of the current file (0 if no packet has been written)
+    time_t filestart;
+    //! Block being filled
+    capture_dump_block_t *cur;
+    //! First block pending to be written
+    capture_dump_block_t *first;
+    //! Last block pending to be written
+    capture_dump_block_t *last;
+    //! Number of blocks pending to be written
+    int queued;
+    //! Current file descriptor (only used by writer thread)
+    int fd;
+    //! Writer must exit after writing all pending blocks
+    int closing;
+    //! First write error (errno value)
+    int error;
+    //! Lock for blocks and current file information
+    pthread_mutex_t lock;
+    //! Signaled when blocks are queued or written
+    pthread_cond_t cond;
+    //! Writer thread
+    pthread_t thread;
+};
+
+/**
+ * @brief Open an output file and start its writer thread
+ *
+ * @param pattern Output file name
+ * @param link Link type of written packets
+ * @param ifname Capture interface name or NULL
+ * @param format Output file format
+ * @param rotate_size Max file size in bytes or 0
+ * @param rotate_time Seconds of packets per file or 0
+ * @return output file writer or NULL if file can not be opened
+ */
+capture_dump_t *
+capture_dump_create(const char *pattern, int link, const char *ifname,
+                    enum capture_dump_format format, size_t rotate_size, int rotate_time);
+
+/**
+ * @brief Open an output file using capture options
+ *
+ * Output format and rotation are taken from capture options.
+ *
+ * @param pattern Output file name
+ * @param link Link type of written packets
+ * @param ifname Capture interface name or NULL
+ * @return output file writer or NULL if file can not be opened
+ */
+capture_dump_t *
+capture_dump_open(const char *pattern, int link, const char *ifname);
+
+/**
+ * @brief Add a packet to the output file
+ *
+ * Packet is copied, so it can be freed after calling this function.
+ *
+ * @param dump Output file writer
+ * @param header Packet header
+ * @param packet Packet data
+ */
+void
+capture_dump_packet(capture_dump_t *dump, const struct pcap_pkthdr *header,
+                    const u_char *packet);
+
+/**
+ * @brief Write pending packets and close the output file
+ *
+ * @param dump Output file writer
+ * @return 0 if all packets have been written, errno of the failed write otherwise
+ */
+int
+capture_dump_close(capture_dump_t *dump);
+
+#endif /* __SNGREP_CAPTURE_DUMP_H */
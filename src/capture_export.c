@@ -0,0 +1,147 @@
+/**************************************************************************
+ **
+ ** sngrep - SIP Messages flow viewer
+ **
+ ** Copyright (C) 2013,2014 Ivan Alonso (Kaian)
+ ** Copyright (C) 2013,2014 Irontec SL. All rights reserved.
+ **
+ ** This program is free software: you can redistribute it and/or modify
+ ** it under the terms of the GNU General Public License as published by
+ ** the Free Software Foundation, either version 3 of the License, or
+ ** (at your option) any later version.
+ **
+ ** This program is distributed in the hope that it will be useful,
+ ** but WITHOUT ANY WARRANTY; without even the implied warranty of
+ ** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ ** GNU General Public License for more details.
+ **
+ ** You should have received a copy of the GNU General Public License
+ ** along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ **
+ ****************************************************************************/
+/**
+ * @file capture_export.c
+ * @author Ivan Alonso [aka Kaian] <kaian@irontec.com>
+ *
+ * @brief Source of functions defined in capture_export.h
+ *
+ */
+#include "config.h"
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <errno.h>
+#include "capture_export.h"
+#include "capture.h"
+#include "spool.h"
+#include "ui_manager.h"
+
+/**
+ * @brief Export thread
+ *
+ * Sort all messages of exported calls and write them to the output file.
+ */
+static void *
+capture_export_thread(void *data)
+{
+    capture_export_t *export = (capture_export_t *) data;
+    sip_msg_t *msg;
+    int i, error;
+
+    // Merge messages of all calls by timestamp
+    call_group_index_update(export->group);
+    export->total = export->group->msgcnt;
+    ui_wakeup();
+
+    for (i = 0; i < export->total && !export->cancel; i++) {
+        msg = export->group->msgs[i];
+        capture_dump_packet(export->dump, msg->pcap_header, msg_get_packet(msg));
+        export->written = i + 1;
+
+        // Notify interface to redraw progress
+        if (export->written % CAPTURE_EXPORT_PROGRESS == 0)
+            ui_wakeup();
+    }
+
+    // Cached payloads can be released again
+    spool_unpin();
+
+    // Wait until all packets are in the file
+    error = capture_dump_close(export->dump);
+    export->dump = NULL;
+
+    if (export->cancel) {
+        unlink(export->filename);
+        export->status = CAPTURE_EXPORT_CANCELLED;
+    } else if (error) {
+        export->error = error;
+        export->status = CAPTURE_EXPORT_FAILED;
+    } else {
+        export->status = CAPTURE_EXPORT_DONE;
+    }
+    ui_wakeup();
+
+    return NULL;
+}
+
+capture_export_t *
+capture_export_start(const char *filename, sip_call_group_t *group)
+{
+    capture_export_t *export;
+    const char *ext;
+    enum capture_dump_format format = CAPTURE_DUMP_PCAP;
+    int error;
+
+    // Use pcapng format based on file extension
+    if ((ext = strrchr(filename, '.')) && !strcasecmp(ext, ".pcapng"))
+        format = CAPTURE_DUMP_PCAPNG;
+
+    export = malloc(sizeof(capture_export_t));
+    memset(export, 0, sizeof(capture_export_t));
+    export->group = group;
+    export->filename = strdup(filename);
+
+    // Open output file without rotation
+    if (!(export->dump = capture_dump_create(filename, capture_get_datalink(), NULL,
+                                             format, 0, 0))) {
+        error = errno;
+        free(export->filename);
+        free(export);
+        errno = error;
+        return NULL;
+    }
+
+    // Don't release exported packets while they are being written
+    spool_pin();
+
+    if ((error = pthread_create(&export->thread, NULL, capture_export_thread, export)) != 0) {
+        spool_unpin();
+        capture_dump_close(export->dump);
+        unlink(filename);
+        free(export->filename);
+        free(export);
+        errno = error;
+        return NULL;
+    }
+
+    return export;
+}
+
+void
+capture_export_cancel(capture_export_t *export)
+{
+    if (export)
+        export->cancel = 1;
+}
+
+void
+capture_export_destroy(capture_export_t *export)
+{
+    if (!export)
+        return;
+
+    pthread_join(export->thread, NULL);
+    call_group_destroy(export->group);
+    free(export->filename);
+    free(export);
+}
@@ -0,0 +1,113 @@
+/**************************************************************************
+ **
+ ** sngrep - SIP Messages flow viewer
+ **
+ ** Copyright (C) 2013,2014 Ivan Alonso (Kaian)
+ ** Copyright (C) 2013,2014 Irontec SL. All rights reserved.
+ **
+ ** This program is free software: you can redistribute it and/or modify
+ ** it under the terms of the GNU General Public License as published by
+ ** the Free Software Foundation, either version 3 of the License, or
+ ** (at your option) any later version.
+ **
+ ** This program is distributed in the hope that it will be useful,
+ ** but WITHOUT ANY WARRANTY; without even the implied warranty of
+ ** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ ** GNU General Public License for more details.
+ **
+ ** You should have received a copy of the GNU General Public License
+ ** along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ **
+ ****************************************************************************/
+/**
+ * @file capture_export.h
+ * @author Ivan Alonso [aka Kaian] <kaian@irontec.com>
+ *
+ * @brief Functions to export dialogs packets to a file
+ *
+ * Export is done in a separate thread: messages of all exported calls
+ * are merged by timestamp using the group messages index and written
+ * in time order through a capture_dump writer, so the interface can
+ * display the export progress and cancel it.
+ */
+#ifndef __SNGREP_CAPTURE_EXPORT_H
+#define __SNGREP_CAPTURE_EXPORT_H
+
+#include "config.h"
+#include <pthread.h>
+#include "group.h"
+#include "capture_dump.h"
+
+//! Written messages between progress notifications
+#define CAPTURE_EXPORT_PROGRESS 2000
+
+//! Shorter declaration of capture_export structure
+typedef struct capture_export capture_export_t;
+
+/**
+ * @brief Export states
+ */
+enum capture_export_status {
+    CAPTURE_EXPORT_RUNNING = 0,
+    CAPTURE_EXPORT_DONE,
+    CAPTURE_EXPORT_CANCELLED,
+    CAPTURE_EXPORT_FAILED,
+};
+
+/**
+ * @brief Export information
+ */
+struct capture_export {
+    //! Exported calls
+    sip_call_group_t *group;
+    //! Output file writer
+    capture_dump_t *dump;
+    //! Output file name
+    char *filename;
+    //! Number of messages to be written (0 while they are being sorted)
+    int total;
+    //! Number of messages already written
+    int written;
+    //! Export must be stopped
+    int cancel;
+    //! Export state
+    enum capture_export_status status;
+    //! errno value when export has failed
+    int error;
+    //! Export thread
+    pthread_t thread;
+};
+
+/**
+ * @brief Start exporting calls packets
+ *
+ * Output file is opened before starting the export thread. Files with
+ * pcapng extension are written in pcapng format. If export starts, given
+ * group is owned by the export and destroyed with it.
+ *
+ * @param filename Output file name
+ * @param group Calls to be exported
+ * @return export information or NULL if file can not be opened (errno is set)
+ */
+capture_export_t *
+capture_export_start(const char *filename, sip_call_group_t *group);
+
+/**
+ * @brief Request an export to stop
+ *
+ * Partially written file will be removed.
+ *
+ * @param export Export information
+ */
+void
+capture_export_cancel(capture_export_t *export);
+
+/**
+ * @brief Wait the export thread and free its memory
+ *
+ * @param export Export information
+ */
+void
+capture_export_destroy(capture_export_t *export);
+
+#endif /* __SNGREP_CAPTURE_EXPORT_H */
@@ -0,0 +1,553 @@
+/**************************************************************************
+ **
+ ** sngrep - SIP Messages flow viewer
+ **
+ ** Copyright (C) 2013,2014 Ivan Alonso (Kaian)
+ ** Copyright (C) 2013,2014 Irontec SL. All rights reserved.
+ **
+ ** This program is free software: you can redistribute it and/or modify
+ ** it under the terms of the GNU General Public License as published by
+ ** the Free Software Foundation, either version 3 of the License, or
+ ** (at your option) any later version.
+ **
+ ** This program is distributed in the hope that it will be useful,
+ ** but WITHOUT ANY WARRANTY; without even the implied warranty of
+ ** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ ** GNU General Public License for more details.
+ **
+ ** You should have received a copy of the GNU General Public License
+ ** along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ **
+ ****************************************************************************/
+/**
+ * @file capture_file.c
+ * @author Ivan Alonso [aka Kaian] <kaian@irontec.com>
+ *
+ * @brief Source code of functions defined in capture_file.h
+ *
+ */
+#include "config.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "capture_file.h"
+
+//! pcap file magic numbers
+#define PCAP_MAGIC          0xa1b2c3d4
+#define PCAP_MAGIC_NSEC     0xa1b23c4d
+//! pcapng Block types
+#define PCAPNG_SHB          0x0A0D0D0A
+#define PCAPNG_IDB          0x00000001
+#define PCAPNG_PB           0x00000002
+#define PCAPNG_SPB          0x00000003
+#define PCAPNG_EPB          0x00000006
+//! pcapng Byte order magic
+#define PCAPNG_BOM          0x1A2B3C4D
+//! pcapng Interface timestamp resolution option
+#define PCAPNG_IF_TSRESOL   9
+//! Valid consecutive records required to find a record boundary
+#define PCAP_SYNC_RECORDS   8
+
+/**
+ * @brief Read a 16 bits value in file byte order
+ */
+static uint16_t
+capture_file_u16(capture_file_t *file, const u_char *data)
+{
+    uint16_t value;
+    memcpy(&value, data, sizeof(value));
+    return (file->swapped) ? __builtin_bswap16(value) : value;
+}
+
+/**
+ * @brief Read a 32 bits value in file byte order
+ */
+static uint32_t
+capture_file_u32(capture_file_t *file, const u_char *data)
+{
+    uint32_t value;
+    memcpy(&value, data, sizeof(value));
+    return (file->swapped) ? __builtin_bswap32(value) : value;
+}
+
+/**
+ * @brief Check the file header and get its format
+ *
+ * @return 0 if file has a supported format, 1 otherwise
+ */
+static int
+capture_file_header(capture_file_t *file)
+{
+    uint32_t magic;
+
+    if (file->size < 24)
+        return 1;
+
+    memcpy(&magic, file->data, sizeof(magic));
+
+    if (magic == PCAPNG_SHB) {
+        // pcapng: byte order is given by the section header block
+        file->format = CAPTURE_FILE_PCAPNG;
+        if (capture_file_u32(file, file->data + 8) != PCAPNG_BOM) {
+            file->swapped = 1;
+            if (capture_file_u32(file, file->data + 8) != PCAPNG_BOM)
+                return 1;
+        }
+        // Link type will be known after reading interface blocks
+        file->link = -1;
+        file->snaplen = 65535;
+        return 0;
+    }
+
+    // pcap: any of the magic numbers in any byte order
+    file->format = CAPTURE_FILE_PCAP;
+    if (magic == PCAP_MAGIC || magic == PCAP_MAGIC_NSEC) {
+        file->swapped = 0;
+    } else if (__builtin_bswap32(magic) == PCAP_MAGIC || __builtin_bswap32(magic) == PCAP_MAGIC_NSEC) {
+        file->swapped = 1;
+    } else {
+        return 1;
+    }
+
+    file->tsunits = (capture_file_u32(file, file->data) == PCAP_MAGIC_NSEC) ? 1000000000 : 1000000;
+    file->snaplen = capture_file_u32(file, file->data + 16);
+    file->link = capture_file_u32(file, file->data + 20);
+    file->offset = 24;
+    return 0;
+}
+
+/**
+ * @brief Read pcapng interface blocks until the first packet
+ *
+ * Link type of the first interface will be used as file link type.
+ */
+static void
+capture_file_pcapng_link(capture_file_t *file)
+{
+    size_t offset = 0;
+    uint32_t type, len;
+
+    while (file->link == -1 && offset + 12 <= file->size) {
+        type = capture_file_u32(file, file->data + offset);
+        len = capture_file_u32(file, file->data + offset + 4);
+        if (len < 12 || offset + len > file->size)
+            break;
+        if (type == PCAPNG_IDB && len >= 20) {
+            file->link = capture_file_u16(file, file->data + offset + 8);
+            file->snaplen = capture_file_u32(file, file->data + offset + 12);
+        }
+        offset += len;
+    }
+}
+
+capture_file_t *
+capture_file_open(const char *infile, char *errbuf)
+{
+    capture_file_t *file;
+    struct stat st;
+    void *data;
+    int fd;
+
+    if ((fd = open(infile, O_RDONLY)) == -1) {
+        snprintf(errbuf, PCAP_ERRBUF_SIZE, "%s", strerror(errno));
+        return NULL;
+    }
+
+    // Only regular files can be mapped
+    if (fstat(fd, &st) == -1 || !S_ISREG(st.st_mode) || st.st_size == 0) {
+        close(fd);
+        return NULL;
+    }
+
+    if ((data = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0)) == MAP_FAILED) {
+        close(fd);
+        return NULL;
+    }
+
+    file = malloc(sizeof(capture_file_t));
+    memset(file, 0, sizeof(capture_file_t));
+    file->fd = fd;
+    file->data = data;
+    file->size = st.st_size;
+
+    if (capture_file_header(file) != 0) {
+        capture_file_close(file);
+        return NULL;
+    }
+
+    if (file->format == CAPTURE_FILE_PCAPNG) {
+        capture_file_pcapng_link(file);
+        if (file->link == -1) {
+            capture_file_close(file);
+            return NULL;
+        }
+    }
+
+    // File will be read from start to end
+#ifdef POSIX_FADV_SEQUENTIAL
+    posix_fadvise(fd, 0, 0, POSIX_FADV_SEQUENTIAL);
+#endif
+    madvise((void *) file->data, file->size, MADV_SEQUENTIAL);
+
+    return file;
+}
+
+void
+capture_file_close(capture_file_t *file)
+{
+    if (!file)
+        return;
+    munmap((void *) file->data, file->size);
+    close(file->fd);
+    free(file);
+}
+
+int
+capture_file_datalink(capture_file_t *file)
+{
+    return file->link;
+}
+
+void
+capture_file_set_filter(capture_file_t *file, struct bpf_program *filter)
+{
+    file->filter = filter;
+}
+
+/**
+ * @brief Pass a packet to the callback if it matches the filter
+ */
+static void
+capture_file_packet(capture_file_t *file, pcap_handler callback, u_char *user,
+                    struct pcap_pkthdr *header, const u_char *packet)
+{
+    if (file->filter && !pcap_offline_filter(file->filter, header, packet))
+        return;
+    callback(user, header, packet);
+}
+
+/**
+ * @brief Convert a timestamp in given units to a timeval
+ */
+static void
+capture_file_ts(struct timeval *tv, uint64_t ts, uint64_t tsunits)
+{
+    uint64_t frac = ts % tsunits;
+
+    tv->tv_sec = ts / tsunits;
+    // Avoid overflowing the fraction with high resolutions
+    if (tsunits % 1000000 == 0) {
+        tv->tv_usec = frac / (tsunits / 1000000);
+    } else if (frac <= UINT64_MAX / 1000000) {
+        tv->tv_usec = frac * 1000000 / tsunits;
+    } else {
+        tv->tv_usec = (long double) frac * 1000000 / tsunits;
+    }
+}
+
+/**
+ * @brief Read a pcap record
+ *
+ * @return record size or 0 if file has no more complete records
+ */
+static size_t
+capture_file_pcap_record(capture_file_t *file, size_t offset, pcap_handler callback, u_char *user)
+{
+    struct pcap_pkthdr header;
+    const u_char *record = file->data + offset;
+
+    if (offset + 16 > file->size)
+        return 0;
+
+    header.caplen = capture_file_u32(file, record + 8);
+    header.len = capture_file_u32(file, record + 12);
+    if (offset + 16 + header.caplen > file->size)
+        return 0;
+
+    capture_file_ts(&header.ts, (uint64_t) capture_file_u32(file, record) * file->tsunits
+                    + capture_file_u32(file, record + 4), file->tsunits);
+
+    capture_file_packet(file, callback, user, &header, record + 16);
+    return 16 + header.caplen;
+}
+
+/**
+ * @brief Get timestamp resolution from pcapng interface options
+ */
+static uint64_t
+capture_file_pcapng_tsunits(capture_file_t *file, const u_char *opt, const u_char *end)
+{
+    uint16_t code, len;
+    uint64_t units = 1;
+    int exp;
+
+    while (opt + 4 <= end) {
+        code = capture_file_u16(file, opt);
+        len = capture_file_u16(file, opt + 2);
+        if (code == 0 || opt + 4 + len > end)
+            break;
+        if (code == PCAPNG_IF_TSRESOL && len >= 1) {
+            // Negative power of 10 or 2 depending on most significant bit
+            exp = opt[4] & 0x7f;
+            // Resolutions that don't fit in 64 bits are not supported
+            if (exp > ((opt[4] & 0x80) ? 63 : 19))
+                break;
+            for (; exp > 0; exp--)
+                units *= (opt[4] & 0x80) ? 2 : 10;
+            return units;
+        }
+        opt += 4 + ((len + 3) & ~3);
+    }
+
+    // Default resolution is microseconds
+    return 1000000;
+}
+
+/**
+ * @brief Read a pcapng block
+ *
+ * @return block size or 0 if file has no more complete blocks
+ */
+static size_t
+capture_file_pcapng_block(capture_file_t *file, size_t offset, pcap_handler callback, u_char *user)
+{
+    struct pcap_pkthdr header;
+    struct capture_file_iface *iface = NULL;
+    const u_char *block = file->data + offset;
+    uint32_t type, len, ifid;
+
+    if (offset + 12 > file->size)
+        return 0;
+
+    type = capture_file_u32(file, block);
+    // Each section can have its own byte order
+    if (type == PCAPNG_SHB) {
+        file->swapped = 0;
+        file->swapped = capture_file_u32(file, block + 8) != PCAPNG_BOM;
+        // Interface ids are relative to the section
+        file->ifcnt = 0;
+    }
+
+    len = capture_file_u32(file, block + 4);
+    if (len < 12 || offset + len > file->size)
+        return 0;
+
+    switch (type) {
+        case PCAPNG_IDB:
+            if (len >= 20 && file->ifcnt < CAPTURE_FILE_MAX_IFACES) {
+                iface = &file->ifaces[file->ifcnt++];
+                iface->link = capture_file_u16(file, block + 8);
+                iface->tsunits = capture_file_pcapng_tsunits(file, block + 16, block + len - 4);
+            }
+            break;
+        case PCAPNG_EPB:
+        case PCAPNG_PB:
+            if (len < 32)
+                break;
+            // Packet block has a 16 bits interface id
+            ifid = (type == PCAPNG_EPB) ? capture_file_u32(file, block + 8)
+                   : capture_file_u16(file, block + 8);
+            if (ifid >= file->ifcnt || file->ifaces[ifid].link != file->link)
+                break;
+            iface = &file->ifaces[ifid];
+            header.caplen = capture_file_u32(file, block + 20);
+            header.len = capture_file_u32(file, block + 24);
+            // Block length is at least 32, so this can't wrap around
+            if (header.caplen > len - 28)
+                break;
+            capture_file_ts(&header.ts, ((uint64_t) capture_file_u32(file, block + 12) << 32)
+                            | capture_file_u32(file, block + 16), iface->tsunits);
+            capture_file_packet(file, callback, user, &header, block + 28);
+            break;
+        case PCAPNG_SPB:
+            // Simple packets have no timestamp nor interface
+            if (len < 16 || !file->ifcnt || file->ifaces[0].link != file->link)
+                break;
+            header.len = capture_file_u32(file, block + 8);
+            header.caplen = (header.len < len - 16) ? header.len : len - 16;
+            if ((int) header.caplen > file->snaplen)
+                header.caplen = file->snaplen;
+            memset(&header.ts, 0, sizeof(header.ts));
+            capture_file_packet(file, callback, user, &header, block + 12);
+            break;
+    }
+
+    return len;
+}
+
+int
+capture_file_loop(capture_file_t *file, pcap_handler callback, u_char *user)
+{
+    size_t offset, batch_end, released = 0, size;
+
+    gettimeofday(&file->start, NULL);
+
+    for (offset = file->offset; !file->stop; file->offset = offset) {
+        // Read ahead the next batch
+        batch_end = offset + CAPTURE_FILE_BATCH;
+        if (batch_end > file->size)
+            batch_end = file->size;
+        madvise((void *) (file->data + (offset & ~(size_t) (getpagesize() - 1))),
+                batch_end - (offset & ~(size_t) (getpagesize() - 1)), MADV_WILLNEED);
+
+        // Read all records in this batch
+        while (offset < batch_end && !file->stop) {
+            if (file->format == CAPTURE_FILE_PCAP) {
+                size = capture_file_pcap_record(file, offset, callback, user);
+            } else {
+                size = capture_file_pcapng_block(file, offset, callback, user);
+            }
+            // No more records
+            if (!size) {
+                file->offset = file->size;
+                return 0;
+            }
+            offset += size;
+        }
+
+        // Release already read pages
+        if (offset - released >= CAPTURE_FILE_BATCH) {
+            size = (offset - released) & ~(size_t) (getpagesize() - 1);
+            madvise((void *) (file->data + released), size, MADV_DONTNEED);
+            released += size;
+        }
+
+        if (offset >= file->size) {
+            file->offset = file->size;
+            return 0;
+        }
+    }
+
+    // Reading has been stopped
+    file->stop = 0;
+    return -2;
+}
+
+/**
+ * @brief Check if there is a pcap record header at given offset
+ *
+ * @return record size or 0 if data doesn't look like a record header
+ */
+static size_t
+capture_file_pcap_valid(capture_file_t *file, size_t offset)
+{
+    const u_char *record = file->data + offset;
+    uint32_t caplen, len, snaplen;
+
+    if (offset + 16 > file->size)
+        return 0;
+
+    caplen = capture_file_u32(file, record + 8);
+    len = capture_file_u32(file, record + 12);
+    snaplen = (file->snaplen > 65535) ? file->snaplen : 65535;
+
+    // Captured bytes can not exceed original size nor snaplen
+    if (caplen > len || caplen > snaplen || offset + 16 + caplen > file->size)
+        return 0;
+
+    // Fraction of second must be less than a second
+    if (capture_file_u32(file, record + 4) >= file->tsunits)
+        return 0;
+
+    return 16 + caplen;
+}
+
+/**
+ * @brief Find the first pcap record boundary after an offset
+ *
+ * A position is considered a record boundary when a chain of record
+ * headers starting there reaches the end of the file or includes
+ * PCAP_SYNC_RECORDS valid records.
+ *
+ * @return record offset or file size if no boundary has been found
+ */
+static size_t
+capture_file_pcap_sync(capture_file_t *file, size_t offset)
+{
+    size_t next, size;
+    int count;
+
+    for (; offset + 16 <= file->size; offset++) {
+        for (next = offset, count = 0; count < PCAP_SYNC_RECORDS && next < file->size; count++) {
+            if (!(size = capture_file_pcap_valid(file, next)))
+                break;
+            next += size;
+        }
+        if (count == PCAP_SYNC_RECORDS || next == file->size)
+            return offset;
+    }
+
+    return file->size;
+}
+
+int
+capture_file_split(capture_file_t *file, size_t *bounds, int count)
+{
+    size_t offset, start = file->offset;
+    int i, ranges = 0;
+
+    // pcapng blocks depend on previous interface blocks
+    if (file->format != CAPTURE_FILE_PCAP || count < 2)
+        return 0;
+
+    bounds[ranges] = start;
+    for (i = 1; i < count; i++) {
+        offset = capture_file_pcap_sync(file, start + (file->size - start) / count * i);
+        // Ignore empty ranges
+        if (offset > bounds[ranges] && offset < file->size)
+            bounds[++ranges] = offset;
+    }
+    bounds[++ranges] = file->size;
+
+    return ranges;
+}
+
+size_t
+capture_file_loop_range(capture_file_t *file, size_t start, size_t end,
+                        pcap_handler callback, u_char *user)
+{
+    size_t offset, batch_end, size;
+
+    for (offset = start; offset < end && !file->stop;) {
+        // Read ahead the next batch
+        batch_end = offset + CAPTURE_FILE_BATCH;
+        if (batch_end > end)
+            batch_end = end;
+        madvise((void *) (file->data + (offset & ~(size_t) (getpagesize() - 1))),
+                batch_end - (offset & ~(size_t) (getpagesize() - 1)), MADV_WILLNEED);
+
+        // Read all records in this batch
+        while (offset < batch_end && !file->stop) {
+            if (!(size = capture_file_pcap_record(file, offset, callback, user)))
+                return offset;
+            offset += size;
+        }
+    }
+
+    return offset;
+}
+
+void
+capture_file_stop(capture_file_t *file)
+{
+    file->stop = 1;
+}
+
+void
+capture_file_progress(capture_file_t *file, int *percent, double *rate)
+{
+    struct timeval now;
+    double elapsed;
+    size_t offset = file->offset;
+
+    *percent = (file->size) ? (int) (offset * 100 / file->size) : 100;
+
+    gettimeofday(&now, NULL);
+    elapsed = (now.tv_sec - file->start.tv_sec) + (now.tv_usec - file->start.tv_usec) / 1000000.0;
+    *rate = (elapsed > 0) ? offset / elapsed : 0;
+}
@@ -0,0 +1,219 @@
+/**************************************************************************
+ **
+ ** sngrep - SIP Messages flow viewer
+ **
+ ** Copyright (C) 2013,2014 Ivan Alonso (Kaian)
+ ** Copyright (C) 2013,2014 Irontec SL. All rights reserved.
+ **
+ ** This program is free software: you can redistribute it and/or modify
+ ** it under the terms of the GNU General Public License as published by
+ ** the Free Software Foundation, either version 3 of the License, or
+ ** (at your option) any later version.
+ **
+ ** This program is distributed in the hope that it will be useful,
+ ** but WITHOUT ANY WARRANTY; without even the implied warranty of
+ ** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ ** GNU General Public License for more details.
+ **
+ ** You should have received a copy of the GNU General Public License
+ ** along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ **
+ ****************************************************************************/
+/**
+ * @file capture_file.h
+ * @author Ivan Alonso [aka Kaian] <kaian@irontec.com>
+ *
+ * @brief Functions to read packets from capture files
+ *
+ * Capture files are mapped in memory and their records are read in
+ * place, passing to the packet callback a pointer to the mapped data,
+ * so packets are never copied while reading. Both pcap (with micro or
+ * nanosecond timestamps, in any byte order) and pcapng formats are
+ * supported.
+ *
+ * Files are read in batches of CAPTURE_FILE_BATCH bytes. Before each
+ * batch the kernel is told to read the next one ahead, and after it
+ * the already read one is released, so memory usage doesn't depend on
+ * file size. Read progress is updated after each batch.
+ *
+ * Files that can not be mapped (like pipes) must be read using libpcap.
+ */
+#ifndef __SNGREP_CAPTURE_FILE_H
+#define __SNGREP_CAPTURE_FILE_H
+
+#include "config.h"
+#include <pcap.h>
+#include <stdint.h>
+#include <sys/time.h>
+
+//! Bytes read between progress updates
+#define CAPTURE_FILE_BATCH (4 * 1024 * 1024)
+//! Max number of pcapng interfaces
+#define CAPTURE_FILE_MAX_IFACES 32
+
+//! Shorter declaration of capture_file structure
+typedef struct capture_file capture_file_t;
+
+/**
+ * @brief Supported capture file formats
+ */
+enum capture_file_format {
+    CAPTURE_FILE_PCAP = 0,
+    CAPTURE_FILE_PCAPNG,
+};
+
+/**
+ * @brief pcapng interface information
+ */
+struct capture_file_iface {
+    //! Interface link type
+    int link;
+    //! Timestamp units per second
+    uint64_t tsunits;
+};
+
+/**
+ * @brief Mapped capture file information
+ */
+struct capture_file {
+    //! File descriptor
+    int fd;
+    //! Mapped file data
+    const u_char *data;
+    //! File size
+    size_t size;
+    //! Read position
+    volatile size_t offset;
+    //! File format
+    enum capture_file_format format;
+    //! File has been written with different byte order
+    int swapped;
+    //! Timestamp units per second (pcap format)
+    uint64_t tsunits;
+    //! File link type
+    int link;
+    //! Max packet size
+    int snaplen;
+    //! pcapng interfaces
+    struct capture_file_iface ifaces[CAPTURE_FILE_MAX_IFACES];
+    //! Number of pcapng interfaces
+    int ifcnt;
+    //! Packet filter (if any)
+    struct bpf_program *filter;
+    //! Time when reading started
+    struct timeval start;
+    //! Request to stop reading
+    volatile int stop;
+};
+
+/**
+ * @brief Map a capture file in memory
+ *
+ * @param infile Capture file path
+ * @param errbuf Buffer to store the error if file can not be opened
+ * @return mapped capture file or NULL if file can not be mapped or
+ * doesn't have a supported format
+ */
+capture_file_t *
+capture_file_open(const char *infile, char *errbuf);
+
+/**
+ * @brief Unmap a capture file and free its memory
+ *
+ * @param file Mapped capture file
+ */
+void
+capture_file_close(capture_file_t *file);
+
+/**
+ * @brief Get the link type of the capture file
+ *
+ * @param file Mapped capture file
+ * @return link type of the file packets
+ */
+int
+capture_file_datalink(capture_file_t *file);
+
+/**
+ * @brief Only pass to the callback packets matching a filter
+ *
+ * @param file Mapped capture file
+ * @param filter Compiled packet filter
+ */
+void
+capture_file_set_filter(capture_file_t *file, struct bpf_program *filter);
+
+/**
+ * @brief Read all packets of the file
+ *
+ * Read packets until the file ends or capture_file_stop is called,
+ * invoking the callback with each packet.
+ *
+ * @param file Mapped capture file
+ * @param callback Function called for each packet
+ * @param user User data passed to the callback
+ * @return 0 if all packets have been read, -2 if reading was stopped
+ */
+int
+capture_file_loop(capture_file_t *file, pcap_handler callback, u_char *user);
+
+/**
+ * @brief Split the unread part of the file in ranges of records
+ *
+ * Pick count - 1 positions equally spaced in the file and move each one
+ * forward to the next record boundary, found by checking there is a valid
+ * chain of record headers starting at that position. Ranges can then
+ * be read at the same time using capture_file_loop_range.
+ *
+ * Only pcap files can be split, as pcapng packet blocks depend on the
+ * interface blocks read before them.
+ *
+ * @param file Mapped capture file
+ * @param bounds Array of count + 1 elements to store ranges start offsets
+ * and the end of the last range
+ * @param count Max number of ranges
+ * @return number of ranges or 0 if the file can not be split
+ */
+int
+capture_file_split(capture_file_t *file, size_t *bounds, int count);
+
+/**
+ * @brief Read packets of a range of the file
+ *
+ * Read all records starting in the given range, invoking the callback
+ * with each packet. This function doesn't change file read position so
+ * multiple ranges can be read from different threads.
+ *
+ * If range bounds are not record boundaries, the returned offset will
+ * not match the range end.
+ *
+ * @param file Mapped capture file
+ * @param start Offset of the first record
+ * @param end Offset of the range end
+ * @param callback Function called for each packet
+ * @param user User data passed to the callback
+ * @return offset of the first not read record
+ */
+size_t
+capture_file_loop_range(capture_file_t *file, size_t start, size_t end,
+                        pcap_handler callback, u_char *user);
+
+/**
+ * @brief Stop reading packets in capture_file_loop
+ *
+ * @param file Mapped capture file
+ */
+void
+capture_file_stop(capture_file_t *file);
+
+/**
+ * @brief Get reading progress of the file
+ *
+ * @param file Mapped capture file
+ * @param percent Read percentage of the file
+ * @param rate Read bytes per second
+ */
+void
+capture_file_progress(capture_file_t *file, int *percent, double *rate);
+
+#endif /* __SNGREP_CAPTURE_FILE_H */
@@ -0,0 +1,438 @@
+/**************************************************************************
+ **
+ ** sngrep - SIP Messages flow viewer
+ **
+ ** Copyright (C) 2013,2014 Ivan Alonso (Kaian)
+ ** Copyright (C) 2013,2014 Irontec SL. All rights reserved.
+ **
+ ** This program is free software: you can redistribute it and/or modify
+ ** it under the terms of the GNU General Public License as published by
+ ** the Free Software Foundation, either version 3 of the License, or
+ ** (at your option) any later version.
+ **
+ ** This program is distributed in the hope that it will be useful,
+ ** but WITHOUT ANY WARRANTY; without even the implied warranty of
+ ** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ ** GNU General Public License for more details.
+ **
+ ** You should have received a copy of the GNU General Public License
+ ** along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ **
+ ****************************************************************************/
+/**
+ * @file capture_index.c
+ * @author Ivan Alonso [aka Kaian] <kaian@irontec.com>
+ *
+ * @brief Source of functions defined in capture_index.h
+ *
+ */
+#include "config.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <limits.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "capture.h"
+#include "capture_index.h"
+#include "hash.h"
+#include "option.h"
+#include "ui_manager.h"
+
+/**
+ * @brief Check if index can be used for an input file
+ *
+ * Index can not be used if some packets are discarded by capture filters
+ * or if payloads can not be read again from the file.
+ *
+ * @return 1 if index can be used, 0 otherwise
+ */
+static int
+capture_index_enabled(capture_file_t *file)
+{
+    if (!is_option_enabled("capture.index"))
+        return 0;
+
+    if (file->filter || sip_get_match_expression() || capture_get_keyfile())
+        return 0;
+
+    // Packets must be read to be stored in the dump file
+    if (capture_get_dump())
+        return 0;
+
+    return 1;
+}
+
+/**
+ * @brief Add a string to an options hash
+ */
+static uint64_t
+capture_index_hash_string(uint64_t hash, const char *value)
+{
+    // FNV-1a, including the string terminator as separator
+    do {
+        hash ^= (unsigned char) *value;
+        hash *= 1099511628211ULL;
+    } while (*value++);
+    return hash;
+}
+
+/**
+ * @brief Calculate the hash of the options that discard messages and calls
+ *
+ * Calls loaded from an index depend on these options and the capture
+ * limit, so the index can only be used if they have not changed since
+ * it was stored.
+ *
+ * @return hash of current options
+ */
+static uint64_t
+capture_index_options_hash()
+{
+    const char *opts[] = { "sip.calls", "sip.ignoreincomplete" };
+    const option_opt_t *ignore;
+    uint64_t hash = 14695981039346656037ULL;
+    const char *value;
+    char limit[16];
+    int i;
+
+    for (i = 0; i < (int) (sizeof(opts) / sizeof(opts[0])); i++) {
+        value = get_option_value(opts[i]);
+        hash = capture_index_hash_string(hash, opts[i]);
+        hash = capture_index_hash_string(hash, value ? value : "");
+    }
+
+    // Loads that reached the limit only contain the first calls
+    snprintf(limit, sizeof(limit), "%d", capture_get_limit());
+    hash = capture_index_hash_string(hash, "capture.limit");
+    hash = capture_index_hash_string(hash, limit);
+
+    for (i = 0; (ignore = get_ignore_option(i)); i++) {
+        hash = capture_index_hash_string(hash, ignore->opt);
+        hash = capture_index_hash_string(hash, ignore->value);
+    }
+
+    return hash;
+}
+
+/**
+ * @brief Get the index file path of an input file
+ */
+static void
+capture_index_path(const char *infile, char *path, size_t size)
+{
+    snprintf(path, size, "%s%s", infile, CAPTURE_INDEX_EXT);
+}
+
+/**
+ * @brief Check if an attribute is set from message packet data
+ *
+ * These attributes are not stored in the index, they are set again
+ * when messages are loaded (see msg_set_packet_attributes).
+ *
+ * @return 1 if attribute is set from packet data, 0 otherwise
+ */
+static int
+capture_index_packet_attr(enum sip_attr_id id)
+{
+    switch (id) {
+        case SIP_ATTR_SRC:
+        case SIP_ATTR_DST:
+        case SIP_ATTR_SRC_HOST:
+        case SIP_ATTR_DST_HOST:
+        case SIP_ATTR_DATE:
+        case SIP_ATTR_TIME:
+            return 1;
+        default:
+            return 0;
+    }
+}
+
+/**
+ * @brief Get the position of a value in the strings table
+ *
+ * Values are only stored once, repeated values share the same position.
+ *
+ * @return position of the value in the strings table
+ */
+static uint32_t
+capture_index_string(htable_t *table, char **strings, uint32_t *strsize, uint32_t *strcap,
+                     const char *value)
+{
+    intptr_t pos;
+    size_t len;
+
+    // Value already stored
+    if ((pos = (intptr_t) htable_find(table, value)))
+        return pos - 1;
+
+    // Make room for the new value
+    len = strlen(value) + 1;
+    while (*strsize + len > *strcap) {
+        *strcap = (*strcap) ? *strcap * 2 : 4096;
+        *strings = realloc(*strings, *strcap);
+    }
+
+    pos = *strsize;
+    memcpy(*strings + pos, value, len);
+    *strsize += len;
+    htable_insert(table, value, (void *) (pos + 1));
+    return pos;
+}
+
+int
+capture_index_save(capture_file_t *file, const char *infile)
+{
+    capture_index_header_t header;
+    capture_index_msg_t *imsgs, *imsg;
+    capture_index_attr_t *attrs = NULL;
+    uint32_t msgcnt = 0, attrcnt = 0, attrsize = 0, strsize = 0, strcap = 0;
+    char *strings = NULL;
+    htable_t *table;
+    sip_call_t *call = NULL;
+    sip_msg_t *msg;
+    sip_attr_t *attr;
+    char path[PATH_MAX], tmppath[PATH_MAX + 8];
+    struct stat st;
+    FILE *f;
+    int ret = 0;
+
+    if (!capture_index_enabled(file))
+        return 1;
+
+    if (fstat(file->fd, &st) == -1)
+        return 1;
+
+    // Count parsed messages
+    while ((call = call_get_next(call)))
+        msgcnt += call->msgcnt;
+
+    imsgs = malloc(sizeof(capture_index_msg_t) * (msgcnt + 1));
+    memset(imsgs, 0, sizeof(capture_index_msg_t) * (msgcnt + 1));
+    table = htable_create(1024);
+
+    // Store all messages, grouped by call
+    imsg = imsgs;
+    while ((call = call_get_next(call)) && ret == 0) {
+        for (msg = NULL; (msg = call_get_next_msg(call, msg)) && imsg < imsgs + msgcnt; imsg++) {
+            // All messages must have been read from the input file
+            if (!msg->pcap_offset || !msg->pcap_header) {
+                ret = 1;
+                break;
+            }
+
+            imsg->offset = msg->pcap_offset;
+            imsg->sec = msg->pcap_header->ts.tv_sec;
+            imsg->usec = msg->pcap_header->ts.tv_usec;
+            imsg->caplen = msg->pcap_header->caplen;
+            imsg->len = msg->pcap_header->len;
+            imsg->src = msg->src.s_addr;
+            imsg->dst = msg->dst.s_addr;
+            imsg->sport = msg->sport;
+            imsg->dport = msg->dport;
+            imsg->cseq = msg->cseq;
+            imsg->request = msg->request;
+            imsg->sdp = msg->sdp;
+            imsg->invite = msg->invite;
+            imsg->hash = msg->hash;
+            imsg->attr = attrcnt;
+
+            for (attr = msg->attrs; attr; attr = attr->next) {
+                if (capture_index_packet_attr(attr->hdr->id))
+                    continue;
+                if (attrcnt == attrsize) {
+                    attrsize = (attrsize) ? attrsize * 2 : 1024;
+                    attrs = realloc(attrs, sizeof(capture_index_attr_t) * attrsize);
+                }
+                attrs[attrcnt].id = attr->hdr->id;
+                attrs[attrcnt].value = capture_index_string(table, &strings, &strsize, &strcap,
+                                                            attr->value);
+                attrcnt++;
+                imsg->attrcnt++;
+            }
+        }
+    }
+
+    // Write the index to a temporal file and then replace the old one
+    capture_index_path(infile, path, sizeof(path));
+    snprintf(tmppath, sizeof(tmppath), "%s.tmp", path);
+    if (ret == 0 && strsize && (f = fopen(tmppath, "w"))) {
+        memset(&header, 0, sizeof(capture_index_header_t));
+        memcpy(header.magic, CAPTURE_INDEX_MAGIC, sizeof(header.magic));
+        header.bom = CAPTURE_INDEX_BOM;
+        header.msgcnt = imsg - imsgs;
+        header.attrcnt = attrcnt;
+        header.strsize = strsize;
+        header.filesize = file->size;
+        header.mtime = st.st_mtime;
+        header.options = capture_index_options_hash();
+
+        if (fwrite(&header, sizeof(header), 1, f) != 1
+            || fwrite(imsgs, sizeof(capture_index_msg_t), header.msgcnt, f) != header.msgcnt
+            || fwrite(attrs, sizeof(capture_index_attr_t), attrcnt, f) != attrcnt
+            || fwrite(strings, 1, strsize, f) != strsize) {
+            ret = 1;
+        }
+
+        if (fclose(f) != 0 || ret != 0 || rename(tmppath, path) != 0) {
+            unlink(tmppath);
+            ret = 1;
+        }
+    } else {
+        ret = 1;
+    }
+
+    htable_destroy(table);
+    free(imsgs);
+    free(attrs);
+    free(strings);
+    return ret;
+}
+
+/**
+ * @brief Check the index data is valid for the input file
+ *
+ * @return 0 if index is valid, 1 otherwise
+ */
+static int
+capture_index_check(capture_file_t *file, const u_char *data, size_t size)
+{
+    const capture_index_header_t *header = (const capture_index_header_t *) data;
+    const capture_index_msg_t *imsgs;
+    const capture_index_attr_t *attrs;
+    const char *strings;
+    struct stat st;
+    uint32_t i, j;
+
+    if (size < sizeof(capture_index_header_t) || fstat(file->fd, &st) == -1)
+        return 1;
+
+    // Index must be created for this file
+    if (memcmp(header->magic, CAPTURE_INDEX_MAGIC, sizeof(header->magic))
+        || header->bom != CAPTURE_INDEX_BOM || header->filesize != file->size
+        || header->mtime != st.st_mtime)
+        return 1;
+
+    // Stored calls depend on the options used to create the index
+    if (header->options != capture_index_options_hash())
+        return 1;
+
+    // Check index size
+    if (size != sizeof(capture_index_header_t)
+        + (uint64_t) header->msgcnt * sizeof(capture_index_msg_t)
+        + (uint64_t) header->attrcnt * sizeof(capture_index_attr_t)
+        + header->strsize)
+        return 1;
+
+    imsgs = (const capture_index_msg_t *) (header + 1);
+    attrs = (const capture_index_attr_t *) (imsgs + header->msgcnt);
+    strings = (const char *) (attrs + header->attrcnt);
+
+    // All strings must be terminated
+    if (!header->strsize || strings[header->strsize - 1] != '\0')
+        return 1;
+
+    // Check all messages are in the file and have valid attributes
+    for (i = 0; i < header->msgcnt; i++) {
+        if (imsgs[i].offset + imsgs[i].caplen > file->size
+            || (uint64_t) imsgs[i].attr + imsgs[i].attrcnt > header->attrcnt)
+            return 1;
+        for (j = imsgs[i].attr; j < imsgs[i].attr + imsgs[i].attrcnt; j++) {
+            if (attrs[j].id >= SIP_ATTR_SENTINEL || attrs[j].value >= header->strsize)
+                return 1;
+        }
+    }
+
+    return 0;
+}
+
+int
+capture_index_load(capture_file_t *file, const char *infile)
+{
+    const capture_index_header_t *header;
+    const capture_index_msg_t *imsgs, *imsg;
+    const capture_index_attr_t *attrs;
+    const char *strings;
+    sip_msg_t *msg;
+    char path[PATH_MAX];
+    struct stat st;
+    void *data;
+    uint32_t i;
+    int j, fd;
+
+    if (!capture_index_enabled(file))
+        return 1;
+
+    capture_index_path(infile, path, sizeof(path));
+    if ((fd = open(path, O_RDONLY)) == -1)
+        return 1;
+
+    if (fstat(fd, &st) == -1 || st.st_size == 0
+        || (data = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0)) == MAP_FAILED) {
+        close(fd);
+        return 1;
+    }
+
+    if (capture_index_check(file, data, st.st_size) != 0) {
+        munmap(data, st.st_size);
+        close(fd);
+        return 1;
+    }
+
+    header = (const capture_index_header_t *) data;
+    imsgs = (const capture_index_msg_t *) (header + 1);
+    attrs = (const capture_index_attr_t *) (imsgs + header->msgcnt);
+    strings = (const char *) (attrs + header->attrcnt);
+
+    gettimeofday(&file->start, NULL);
+
+    // Create messages without payload
+    for (i = 0; i < header->msgcnt && !file->stop; i++) {
+        imsg = &imsgs[i];
+        if (!(msg = sip_msg_create(NULL)))
+            break;
+
+        msg->ts.tv_sec = imsg->sec;
+        msg->ts.tv_usec = imsg->usec;
+        msg->src.s_addr = imsg->src;
+        msg->dst.s_addr = imsg->dst;
+        msg->sport = imsg->sport;
+        msg->dport = imsg->dport;
+        msg->cseq = imsg->cseq;
+        msg->request = imsg->request;
+        msg->sdp = imsg->sdp;
+        msg->invite = imsg->invite;
+        msg->hash = imsg->hash;
+        msg->pcap_offset = imsg->offset;
+        msg->pcap_header = malloc(sizeof(struct pcap_pkthdr));
+        msg->pcap_header->ts = msg->ts;
+        msg->pcap_header->caplen = imsg->caplen;
+        msg->pcap_header->len = imsg->len;
+
+        // Set attributes not stored in the index
+        msg_set_packet_attributes(msg);
+
+        // Keep the original attribute list order
+        for (j = imsg->attrcnt - 1; j >= 0; j--) {
+            sip_attr_set(&msg->attrs, attrs[imsg->attr + j].id,
+                         strings + attrs[imsg->attr + j].value);
+        }
+
+        // Add the message to its call
+        if (sip_commit_message(msg))
+            ui_wakeup();
+
+        // Update load progress
+        file->offset = (size_t) ((uint64_t) file->size * i / header->msgcnt);
+    }
+
+    munmap(data, st.st_size);
+    close(fd);
+
+    file->offset = file->size;
+    file->stop = 0;
+    return 0;
+}
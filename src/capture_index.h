@@ -0,0 +1,163 @@
+/**************************************************************************
+ **
+ ** sngrep - SIP Messages flow viewer
+ **
+ ** Copyright (C) 2013,2014 Ivan Alonso (Kaian)
+ ** Copyright (C) 2013,2014 Irontec SL. All rights reserved.
+ **
+ ** This program is free software: you can redistribute it and/or modify
+ ** it under the terms of the GNU General Public License as published by
+ ** the Free Software Foundation, either version 3 of the License, or
+ ** (at your option) any later version.
+ **
+ ** This program is distributed in the hope that it will be useful,
+ ** but WITHOUT ANY WARRANTY; without even the implied warranty of
+ ** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ ** GNU General Public License for more details.
+ **
+ ** You should have received a copy of the GNU General Public License
+ ** along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ **
+ ****************************************************************************/
+/**
+ * @file capture_index.h
+ * @author Ivan Alonso [aka Kaian] <kaian@irontec.com>
+ *
+ * @brief Functions to store parsed calls of capture files
+ *
+ * When capture.index option is enabled, after an input file has been
+ * completely loaded, an index file is stored next to it (with the same
+ * name plus CAPTURE_INDEX_EXT). The index contains all parsed messages
+ * attributes and the position of their packets in the input file.
+ *
+ * Next time the same input file is opened, calls are created from the
+ * index instead of parsing all file packets. Message payloads are not
+ * stored in the index: they are read from the input file the first time
+ * they are requested (see msg_get_payload).
+ *
+ * Index files have a header followed by an array of messages, an array
+ * of attributes and a table of strings, all of them using the byte
+ * order of the machine that wrote the index.
+ */
+#ifndef __SNGREP_CAPTURE_INDEX_H
+#define __SNGREP_CAPTURE_INDEX_H
+
+#include "config.h"
+#include <stdint.h>
+#include "capture_file.h"
+
+//! Index file name extension
+#define CAPTURE_INDEX_EXT ".sngidx"
+//! Index file magic (includes format version)
+#define CAPTURE_INDEX_MAGIC "SNGIDX04"
+//! Index file byte order mark
+#define CAPTURE_INDEX_BOM 0x1A2B3C4D
+
+//! Shorter declaration of capture_index_header structure
+typedef struct capture_index_header capture_index_header_t;
+//! Shorter declaration of capture_index_msg structure
+typedef struct capture_index_msg capture_index_msg_t;
+//! Shorter declaration of capture_index_attr structure
+typedef struct capture_index_attr capture_index_attr_t;
+
+/**
+ * @brief Index file header
+ */
+struct capture_index_header {
+    //! Index format identifier
+    char magic[8];
+    //! Byte order mark
+    uint32_t bom;
+    //! Number of messages
+    uint32_t msgcnt;
+    //! Number of attributes
+    uint32_t attrcnt;
+    //! Size of strings table
+    uint32_t strsize;
+    //! Indexed input file size
+    uint64_t filesize;
+    //! Indexed input file modification time
+    int64_t mtime;
+    //! Hash of the options that select which messages are stored
+    uint64_t options;
+};
+
+/**
+ * @brief Indexed message
+ *
+ * Messages are stored grouped by call, in calls creation order.
+ */
+struct capture_index_msg {
+    //! Packet data position in the input file
+    uint64_t offset;
+    //! Packet timestamp seconds
+    int64_t sec;
+    //! Packet timestamp microseconds
+    uint32_t usec;
+    //! Packet captured bytes
+    uint32_t caplen;
+    //! Packet original size
+    uint32_t len;
+    //! Source address
+    uint32_t src;
+    //! Destination address
+    uint32_t dst;
+    //! Source port
+    uint16_t sport;
+    //! Destination port
+    uint16_t dport;
+    //! Message CSeq
+    int32_t cseq;
+    //! First message attribute in attributes array
+    uint32_t attr;
+    //! Number of message attributes
+    uint16_t attrcnt;
+    //! Request: 1, Response: 0
+    uint8_t request;
+    //! Message contains sdp data
+    uint8_t sdp;
+    //! Message CSeq method is INVITE
+    uint8_t invite;
+    //! Payload hash
+    uint64_t hash;
+};
+
+/**
+ * @brief Indexed message attribute
+ */
+struct capture_index_attr {
+    //! Attribute id
+    uint32_t id;
+    //! Attribute value position in strings table
+    uint32_t value;
+};
+
+/**
+ * @brief Create calls from the index of an input file
+ *
+ * Index is only used if capture.index option is enabled and it has
+ * been created from the same input file with no capture filters and
+ * the same options to discard messages and calls and capture limit.
+ *
+ * @param file Mapped input file
+ * @param infile Input file path
+ * @return 0 if calls have been loaded from the index, 1 otherwise
+ */
+int
+capture_index_load(capture_file_t *file, const char *infile);
+
+/**
+ * @brief Store the index of a completely loaded input file
+ *
+ * Index is only stored if capture.index option is enabled and all
+ * parsed messages have been read from the input file with no capture
+ * filters.
+ *
+ * @param file Mapped input file
+ * @param infile Input file path
+ * @return 0 if index has been stored, 1 otherwise
+ */
+int
+capture_index_save(capture_file_t *file, const char *infile);
+
+#endif /* __SNGREP_CAPTURE_INDEX_H */
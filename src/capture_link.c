@@ -0,0 +1,191 @@
+/**************************************************************************
+ **
+ ** sngrep - SIP Messages flow viewer
+ **
+ ** Copyright (C) 2013,2014 Ivan Alonso (Kaian)
+ ** Copyright (C) 2013,2014 Irontec SL. All rights reserved.
+ **
+ ** This program is free software: you can redistribute it and/or modify
+ ** it under the terms of the GNU General Public License as published by
+ ** the Free Software Foundation, either version 3 of the License, or
+ ** (at your option) any later version.
+ **
+ ** This program is distributed in the hope that it will be useful,
+ ** but WITHOUT ANY WARRANTY; without even the implied warranty of
+ ** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ ** GNU General Public License for more details.
+ **
+ ** You should have received a copy of the GNU General Public License
+ ** along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ **
+ ****************************************************************************/
+/**
+ * @file capture_link.c
+ * @author Ivan Alonso [aka Kaian] <kaian@irontec.com>
+ *
+ * @brief Source of functions defined in capture_link.h
+ *
+ */
+#include "config.h"
+#include <sys/socket.h>
+#include "capture.h"
+#include "capture_link.h"
+
+//! IPv4 ethertype
+#define LINK_ETHERTYPE_IP 0x0800
+//! 802.1Q tagged frame ethertype
+#define LINK_ETHERTYPE_VLAN 0x8100
+//! IPv4 family in ipnet header
+#define LINK_IPNET_AF_INET 2
+
+//! Minimum IPv4 header size
+#define LINK_IP_SIZE 20
+
+//! Read a 16 bits field in network byte order
+#define LINK_GET16(p) ((uint16_t) ((p)[0] << 8 | (p)[1]))
+
+/**
+ * @brief Define a decoder for a link with fixed header size
+ *
+ * These links don't have a protocol field (or sngrep has never checked
+ * it), so only the IP version is checked.
+ */
+#define LINK_DECODER_FIXED(name, size)                                        \
+static const struct nread_ip *                                                \
+name(const struct pcap_pkthdr *header, const u_char *packet)                  \
+{                                                                             \
+    if (header->caplen < (size) + LINK_IP_SIZE || (packet[size] >> 4) != 4)   \
+        return NULL;                                                          \
+    return (const struct nread_ip *) (packet + (size));                       \
+}
+
+/**
+ * @brief Define a decoder for a link with a 16 bits protocol field
+ */
+#define LINK_DECODER_PROTO(name, size, offset, proto)                         \
+static const struct nread_ip *                                                \
+name(const struct pcap_pkthdr *header, const u_char *packet)                  \
+{                                                                             \
+    if (header->caplen < (size) + LINK_IP_SIZE                                \
+        || LINK_GET16(packet + (offset)) != (proto))                          \
+        return NULL;                                                          \
+    return (const struct nread_ip *) (packet + (size));                       \
+}
+
+LINK_DECODER_FIXED(link_decode_raw, 0)
+LINK_DECODER_FIXED(link_decode_ieee802, 22)
+LINK_DECODER_FIXED(link_decode_slip, 16)
+LINK_DECODER_FIXED(link_decode_fddi, 21)
+LINK_DECODER_FIXED(link_decode_enc, 12)
+LINK_DECODER_FIXED(link_decode_ppp, 4)
+LINK_DECODER_PROTO(link_decode_sll, 16, 14, LINK_ETHERTYPE_IP)
+#ifdef DLT_LINUX_SLL2
+LINK_DECODER_PROTO(link_decode_sll2, 20, 0, LINK_ETHERTYPE_IP)
+#endif
+
+/**
+ * @brief Decode Ethernet frames, with or without a 802.1Q tag
+ */
+static const struct nread_ip *
+link_decode_ethernet(const struct pcap_pkthdr *header, const u_char *packet)
+{
+    uint16_t type;
+
+    if (header->caplen < 14 + LINK_IP_SIZE)
+        return NULL;
+
+    if ((type = LINK_GET16(packet + 12)) == LINK_ETHERTYPE_IP)
+        return (const struct nread_ip *) (packet + 14);
+
+    if (type == LINK_ETHERTYPE_VLAN && header->caplen >= 18 + LINK_IP_SIZE
+        && LINK_GET16(packet + 16) == LINK_ETHERTYPE_IP)
+        return (const struct nread_ip *) (packet + 18);
+
+    return NULL;
+}
+
+/**
+ * @brief Decode BSD loopback frames
+ *
+ * Address family is stored in the byte order of the capturing host, so
+ * both orders are accepted.
+ */
+static const struct nread_ip *
+link_decode_null(const struct pcap_pkthdr *header, const u_char *packet)
+{
+    if (header->caplen < 4 + LINK_IP_SIZE)
+        return NULL;
+
+    if ((packet[0] == AF_INET && !packet[1] && !packet[2] && !packet[3])
+        || (!packet[0] && !packet[1] && !packet[2] && packet[3] == AF_INET))
+        return (const struct nread_ip *) (packet + 4);
+
+    return NULL;
+}
+
+/**
+ * @brief Decode OpenBSD loopback frames (family in network byte order)
+ */
+static const struct nread_ip *
+link_decode_loop(const struct pcap_pkthdr *header, const u_char *packet)
+{
+    if (header->caplen < 4 + LINK_IP_SIZE || packet[3] != AF_INET)
+        return NULL;
+    return (const struct nread_ip *) (packet + 4);
+}
+
+#ifdef DLT_IPNET
+/**
+ * @brief Decode Solaris ipnet frames
+ */
+static const struct nread_ip *
+link_decode_ipnet(const struct pcap_pkthdr *header, const u_char *packet)
+{
+    if (header->caplen < 24 + LINK_IP_SIZE || packet[1] != LINK_IPNET_AF_INET)
+        return NULL;
+    return (const struct nread_ip *) (packet + 24);
+}
+#endif
+
+capture_link_decoder_t
+capture_link_decoder(int datalink)
+{
+    switch (datalink) {
+        case DLT_EN10MB:
+            return link_decode_ethernet;
+        case DLT_IEEE802:
+            return link_decode_ieee802;
+        case DLT_NULL:
+            return link_decode_null;
+        case DLT_LOOP:
+            return link_decode_loop;
+        case DLT_SLIP:
+        case DLT_SLIP_BSDOS:
+            return link_decode_slip;
+        case DLT_PPP:
+        case DLT_PPP_BSDOS:
+        case DLT_PPP_SERIAL:
+        case DLT_PPP_ETHER:
+            return link_decode_ppp;
+        case DLT_RAW:
+            return link_decode_raw;
+        case DLT_FDDI:
+            return link_decode_fddi;
+        case DLT_ENC:
+            return link_decode_enc;
+        case DLT_LINUX_SLL:
+            return link_decode_sll;
+#ifdef DLT_LINUX_SLL2
+        case DLT_LINUX_SLL2:
+            return link_decode_sll2;
+#endif
+#ifdef DLT_IPNET
+        case DLT_IPNET:
+            return link_decode_ipnet;
+#endif
+        default:
+            // Not handled datalink type
+            return NULL;
+    }
+}
+
@@ -0,0 +1,63 @@
+/**************************************************************************
+ **
+ ** sngrep - SIP Messages flow viewer
+ **
+ ** Copyright (C) 2013,2014 Ivan Alonso (Kaian)
+ ** Copyright (C) 2013,2014 Irontec SL. All rights reserved.
+ **
+ ** This program is free software: you can redistribute it and/or modify
+ ** it under the terms of the GNU General Public License as published by
+ ** the Free Software Foundation, either version 3 of the License, or
+ ** (at your option) any later version.
+ **
+ ** This program is distributed in the hope that it will be useful,
+ ** but WITHOUT ANY WARRANTY; without even the implied warranty of
+ ** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ ** GNU General Public License for more details.
+ **
+ ** You should have received a copy of the GNU General Public License
+ ** along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ **
+ ****************************************************************************/
+/**
+ * @file capture_link.h
+ * @author Ivan Alonso [aka Kaian] <kaian@irontec.com>
+ *
+ * @brief Functions to decode datalink headers of captured packets
+ *
+ * Each supported link type has its own decoder, with the header size
+ * and protocol field position known at compile time. The decoder is
+ * selected once when the capture is opened, so packet parsing doesn't
+ * need to check the link type of every packet.
+ *
+ * Decoders return the IPv4 header of the packet, or NULL when the frame
+ * doesn't carry IPv4 or is too short to contain its header.
+ */
+#ifndef __SNGREP_CAPTURE_LINK_H
+#define __SNGREP_CAPTURE_LINK_H
+
+#include "config.h"
+#include <pcap.h>
+
+struct nread_ip;
+
+/**
+ * @brief Datalink decoder
+ *
+ * @param header Packet pcap header
+ * @param packet Packet data, starting with link header
+ * @return IPv4 header or NULL
+ */
+typedef const struct nread_ip *(*capture_link_decoder_t)(const struct pcap_pkthdr *header,
+                                                         const u_char *packet);
+
+/**
+ * @brief Get the decoder of a link type
+ *
+ * @param datalink pcap link type
+ * @return link type decoder or NULL if link type is not supported
+ */
+capture_link_decoder_t
+capture_link_decoder(int datalink);
+
+#endif /* __SNGREP_CAPTURE_LINK_H */
@@ -35,14 +35,23 @@
 //! Storage of filter information
 filter_t filters[FILTER_COUNT];
 
+//! Last calculated filter stats
+static filter_stats_t stats = { .version = -1 };
+
 int
 filter_set(int type, const char *expr)
 {
+    filter_expr_t *fexpr = NULL;
+
+    // Call list filter can be a filter expression
+    if (expr && type == FILTER_CALL_LIST)
+        fexpr = filter_expr_compile(expr);
+
 #ifdef WITH_PCRE
     pcre *regex = NULL;
 
     // If we have an expression, check if compiles before changing the filter
-    if (expr) {
+    if (expr && !fexpr) {
         const char *re_err = NULL;
         int32_t err_offset;
         int32_t pcre_options = PCRE_UNGREEDY |  PCRE_CASELESS;
@@ -55,7 +64,8 @@ filter_set(int type, const char *expr)
     // Remove previous value
     if (filters[type].expr) {
         free(filters[type].expr);
-        pcre_free(filters[type].regex);
+        if (filters[type].regex)
+            pcre_free(filters[type].regex);
     }
 
     // Set new expresion values
@@ -65,7 +75,7 @@ filter_set(int type, const char *expr)
 #else
     regex_t regex;
     // If we have an expression, check if compiles before changing the filter
-    if (expr) {
+    if (expr && !fexpr) {
         // Check if we have a valid expression
         if (regcomp(&regex, expr, REG_EXTENDED | REG_ICASE) != 0)
             return 1;
@@ -74,7 +84,8 @@ filter_set(int type, const char *expr)
     // Remove previous value
     if (filters[type].expr) {
         free(filters[type].expr);
-        regfree(&filters[type].regex);
+        if (!filters[type].fexpr)
+            regfree(&filters[type].regex);
     }
 
     // Set new expresion values
@@ -82,6 +93,13 @@ filter_set(int type, const char *expr)
     memcpy(&filters[type].regex, &regex, sizeof(regex));
 #endif
 
+    // Set new compiled predicate
+    filter_expr_destroy(filters[type].fexpr);
+    filters[type].fexpr = fexpr;
+
+    // Filter stats must be calculated again
+    stats.version = -1;
+
     return 0;
 }
 
@@ -95,24 +113,69 @@ void
 filter_stats(int *total, int *displayed)
 {
     sip_call_t *call = NULL;
+    int version = sip_calls_version();
+
+    // Calculate stats only if calls or filters have changed
+    if (stats.version != version) {
+        stats.total = stats.displayed = 0;
+        stats.version = version;
+
+        while ((call = call_get_next(call))) {
+            stats.total++;
+            if (filter_check_call(call) == 0)
+                stats.displayed++;
+        }
+    }
+
+    *total = stats.total;
+    *displayed = stats.displayed;
+}
+
+/**
+ * @brief Check if a text matches a filter regular expression
+ *
+ * @return 1 if data matches the filter, 0 otherwise
+ */
+static int
+filter_check_value(int type, const char *data)
+{
+    if (!data)
+        return 0;
+
+#ifdef WITH_PCRE
+    return pcre_exec(filters[type].regex, 0, data, strlen(data), 0, 0, 0, 0) >= 0;
+#else
+    return regexec(&filters[type].regex, data, 0, NULL, 0) == 0;
+#endif
+}
 
-    // Initialize stats
-    *total = 0;
-    *displayed = 0;
+/**
+ * @brief Check if any displayed column matches the call list filter
+ *
+ * Each displayed attribute is checked on its own, so there is no need
+ * to build the call list line text.
+ *
+ * @return 1 if any column matches the filter, 0 otherwise
+ */
+static int
+filter_check_columns(sip_call_t *call)
+{
+    PANEL *panel = ui_get_panel(ui_find_by_type(PANEL_CALL_LIST));
+    int col;
+    enum sip_attr_id id;
 
-    while ((call = call_get_next(call))) {
-        (*total)++;
-        if (filter_check_call(call) == 0)
-            (*displayed)++;
+    for (col = 0; (int) (id = call_list_column_attr(panel, col)) != -1; col++) {
+        if (filter_check_value(FILTER_CALL_LIST, call_get_attribute(call, id)))
+            return 1;
     }
+    return 0;
 }
 
 int
 filter_check_call(sip_call_t *call)
 {
     int i;
-    const char *data;
-    char linetext[256];
+    int matched;
 
     // Filter for this call has already be processed
     if (call->filtered != -1)
@@ -127,47 +190,41 @@ filter_check_call(sip_call_t *call)
         if (!filters[i].expr)
             continue;
 
-        // Get filtered field
+        // Check filtered field
         switch(i) {
             case FILTER_SIPFROM:
-                data = call_get_attribute(call, SIP_ATTR_SIPFROM);
+                matched = filter_check_value(i, call_get_attribute(call, SIP_ATTR_SIPFROM));
                 break;
             case FILTER_SIPTO:
-                data = call_get_attribute(call, SIP_ATTR_SIPTO);
+                matched = filter_check_value(i, call_get_attribute(call, SIP_ATTR_SIPTO));
                 break;
             case FILTER_SOURCE:
-                data = call_get_attribute(call, SIP_ATTR_SRC);
+                matched = filter_check_value(i, call_get_attribute(call, SIP_ATTR_SRC));
                 break;
             case FILTER_DESTINATION:
-                data = call_get_attribute(call, SIP_ATTR_DST);
+                matched = filter_check_value(i, call_get_attribute(call, SIP_ATTR_DST));
                 break;
             case FILTER_METHOD:
-                data = call_get_attribute(call, SIP_ATTR_METHOD);
+                matched = filter_check_value(i, call_get_attribute(call, SIP_ATTR_METHOD));
                 break;
             case FILTER_CALL_LIST:
-                // FIXME Maybe call should know hot to calculate this line
-                memset(linetext, 0, sizeof(linetext));
-                data = call_list_line_text(ui_get_panel(ui_find_by_type(PANEL_CALL_LIST)), call, linetext);
+                if (filters[i].fexpr) {
+                    matched = filter_expr_check(filters[i].fexpr, call);
+                } else {
+                    matched = filter_check_columns(call);
+                }
                 break;
             default:
                 // Unknown filter id
                 return 0;
         }
 
-#ifdef WITH_PCRE
-        if (pcre_exec(filters[i].regex, 0, data, strlen(data), 0, 0, 0, 0)) {
-            // Mak as filtered
-            call->filtered = 1;
-            break;
-        }
-#else
         // Call doesn't match this filter
-        if (regexec(&filters[i].regex, data, 0, NULL, 0)) {
+        if (!matched) {
             // Mak as filtered
             call->filtered = 1;
             break;
         }
-#endif
     }
 
     // Return the final filter status
@@ -182,4 +239,7 @@ filter_reset_calls()
     // Force filter evaluation
     while ((call = call_get_next(call)))
         call->filtered = -1;
+
+    // Filter stats must be calculated again
+    stats.version = -1;
 }
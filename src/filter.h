@@ -47,9 +47,12 @@
 #include <regex.h>
 #endif
 #include "sip.h"
+#include "filter_expr.h"
 
 //! Shorter declaration of sip_call_group structure
 typedef struct filter filter_t;
+//! Shorter declaration of filter_stats structure
+typedef struct filter_stats filter_stats_t;
 
 /**
  * @brief Available filter types
@@ -65,7 +68,7 @@ enum filter_type {
     FILTER_DESTINATION,
     //! SIP Method in packet payload
     FILTER_METHOD,
-    //! Displayed line in call list
+    //! Displayed columns in call list or filter expression
     FILTER_CALL_LIST,
     //! Number of available filter types
     FILTER_COUNT,
@@ -84,6 +87,23 @@ struct filter {
     //! The filter compiled expression
     regex_t regex;
 #endif
+    //! The filter compiled predicate (when expr is a filter expression)
+    filter_expr_t *fexpr;
+};
+
+/**
+ * @brief Filtered calls counters
+ *
+ * Counters are only calculated again when the calls list version
+ * or any filter changes.
+ */
+struct filter_stats {
+    //! Calls list version when stats were calculated
+    int version;
+    //! Total calls processed
+    int total;
+    //! Number of calls matching filters
+    int displayed;
 };
 
 /**
@@ -93,6 +113,10 @@ struct filter {
  * on a given filter. If given expression is NULL
  * the filter will be removed.
  *
+ * Call list filter can also be a filter expression (see filter_expr.h).
+ * If the text is not a valid filter expression, it will be used as a
+ * regular expression matched against displayed columns.
+ *
  * @param type Type of the filter
  * @param expr Regexpression to match
  * @return 0 if the filter is valid, 1 otherwise
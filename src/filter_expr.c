@@ -0,0 +1,555 @@
+/**************************************************************************
+ **
+ ** sngrep - SIP Messages flow viewer
+ **
+ ** Copyright (C) 2013,2014 Ivan Alonso (Kaian)
+ ** Copyright (C) 2013,2014 Irontec SL. All rights reserved.
+ **
+ ** This program is free software: you can redistribute it and/or modify
+ ** it under the terms of the GNU General Public License as published by
+ ** the Free Software Foundation, either version 3 of the License, or
+ ** (at your option) any later version.
+ **
+ ** This program is distributed in the hope that it will be useful,
+ ** but WITHOUT ANY WARRANTY; without even the implied warranty of
+ ** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ ** GNU General Public License for more details.
+ **
+ ** You should have received a copy of the GNU General Public License
+ ** along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ **
+ ****************************************************************************/
+/**
+ * @file filter_expr.c
+ * @author Ivan Alonso [aka Kaian] <kaian@irontec.com>
+ *
+ * @brief Source code of functions defined in filter_expr.h
+ *
+ * Expressions are parsed using a simple recursive descent parser with
+ * the following grammar:
+ *
+ *   expr    := and ( ( "||" | "or" ) and )*
+ *   and     := unary ( ( "&&" | "and" ) unary )*
+ *   unary   := ( "!" | "not" ) unary | "(" expr ")" | compare
+ *   compare := attribute operator value
+ *
+ */
+#include "config.h"
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+#include "filter_expr.h"
+#include "intern.h"
+
+/**
+ * @brief Expression tokens
+ */
+enum filter_expr_token {
+    FEXPR_TK_END = 0,
+    FEXPR_TK_ERROR,
+    FEXPR_TK_WORD,
+    FEXPR_TK_STRING,
+    FEXPR_TK_OPERATOR,
+    FEXPR_TK_AND,
+    FEXPR_TK_OR,
+    FEXPR_TK_NOT,
+    FEXPR_TK_LPAREN,
+    FEXPR_TK_RPAREN,
+};
+
+/**
+ * @brief Expression parser status
+ */
+typedef struct filter_expr_parser {
+    //! Next character to be parsed
+    const char *pos;
+    //! Last readed token
+    enum filter_expr_token token;
+    //! Last readed operator
+    enum filter_expr_op op;
+    //! Last readed word or string
+    char value[256];
+} filter_expr_parser_t;
+
+static filter_expr_t *
+filter_expr_parse_or(filter_expr_parser_t *parser);
+
+/**
+ * @brief Read next token from the expression text
+ */
+static void
+filter_expr_next_token(filter_expr_parser_t *parser)
+{
+    const char *pos;
+    int len = 0;
+
+    // Skip blanks
+    while (isspace(*parser->pos))
+        parser->pos++;
+
+    pos = parser->pos;
+    parser->value[0] = '\0';
+
+    switch (*pos) {
+        case '\0':
+            parser->token = FEXPR_TK_END;
+            return;
+        case '(':
+            parser->token = FEXPR_TK_LPAREN;
+            parser->pos++;
+            return;
+        case ')':
+            parser->token = FEXPR_TK_RPAREN;
+            parser->pos++;
+            return;
+        case '&':
+        case '|':
+            parser->token = (*pos == '&') ? FEXPR_TK_AND : FEXPR_TK_OR;
+            parser->pos += (pos[1] == *pos) ? 2 : 1;
+            return;
+        case '~':
+            parser->token = FEXPR_TK_OPERATOR;
+            parser->op = FEXPR_OP_MATCH;
+            parser->pos++;
+            return;
+        case '!':
+            parser->token = FEXPR_TK_OPERATOR;
+            if (pos[1] == '=') {
+                parser->op = FEXPR_OP_NE;
+                parser->pos += 2;
+            } else if (pos[1] == '~') {
+                parser->op = FEXPR_OP_NOMATCH;
+                parser->pos += 2;
+            } else {
+                parser->token = FEXPR_TK_NOT;
+                parser->pos++;
+            }
+            return;
+        case '=':
+            parser->token = FEXPR_TK_OPERATOR;
+            parser->op = FEXPR_OP_EQ;
+            parser->pos += (pos[1] == '=') ? 2 : 1;
+            return;
+        case '<':
+        case '>':
+            parser->token = FEXPR_TK_OPERATOR;
+            if (pos[1] == '=') {
+                parser->op = (*pos == '<') ? FEXPR_OP_LE : FEXPR_OP_GE;
+                parser->pos += 2;
+            } else {
+                parser->op = (*pos == '<') ? FEXPR_OP_LT : FEXPR_OP_GT;
+                parser->pos++;
+            }
+            return;
+        case '"':
+        case '\'':
+            // Quoted string, only quotes and backslashes can be escaped
+            for (pos++; *pos && *pos != *parser->pos; pos++) {
+                if (*pos == '\\' && (pos[1] == *parser->pos || pos[1] == '\\'))
+                    pos++;
+                if (len == sizeof(parser->value) - 1) {
+                    parser->token = FEXPR_TK_ERROR;
+                    return;
+                }
+                parser->value[len++] = *pos;
+            }
+            parser->value[len] = '\0';
+            parser->token = (*pos) ? FEXPR_TK_STRING : FEXPR_TK_ERROR;
+            parser->pos = (*pos) ? pos + 1 : pos;
+            return;
+    }
+
+    // Any other text is a word
+    while (*pos && !isspace(*pos) && !strchr("()&|!=<>~\"'", *pos)) {
+        if (len == sizeof(parser->value) - 1) {
+            parser->token = FEXPR_TK_ERROR;
+            return;
+        }
+        parser->value[len++] = *pos++;
+    }
+    parser->value[len] = '\0';
+    parser->pos = pos;
+
+    // Check for logical operator keywords
+    if (!strcasecmp(parser->value, "and")) {
+        parser->token = FEXPR_TK_AND;
+    } else if (!strcasecmp(parser->value, "or")) {
+        parser->token = FEXPR_TK_OR;
+    } else if (!strcasecmp(parser->value, "not")) {
+        parser->token = FEXPR_TK_NOT;
+    } else {
+        parser->token = FEXPR_TK_WORD;
+    }
+}
+
+/**
+ * @brief Convert a text into a number
+ *
+ * Durations in m:ss format are converted to seconds.
+ *
+ * @return 0 if the whole text is a number, 1 otherwise
+ */
+static int
+filter_expr_strtonum(const char *text, double *number)
+{
+    char *end;
+    double seconds;
+
+    *number = strtod(text, &end);
+    if (end == text)
+        return 1;
+
+    // Duration format
+    if (*end == ':') {
+        text = end + 1;
+        seconds = strtod(text, &end);
+        if (end == text)
+            return 1;
+        *number = *number * 60 + seconds;
+    }
+
+    // Texts like addresses only start with a number
+    return (*end != '\0');
+}
+
+/**
+ * @brief Allocate a new predicate tree node
+ */
+static filter_expr_t *
+filter_expr_node_create(enum filter_expr_type type)
+{
+    filter_expr_t *node;
+
+    if (!(node = malloc(sizeof(filter_expr_t))))
+        return NULL;
+    memset(node, 0, sizeof(filter_expr_t));
+    node->type = type;
+    return node;
+}
+
+/**
+ * @brief Append a child node
+ *
+ * Children are kept sorted by their evaluation cost, so cheapest
+ * tests are checked first. Nodes with the same cost keep the order
+ * they have in the expression.
+ */
+static int
+filter_expr_node_add(filter_expr_t *node, filter_expr_t *child)
+{
+    filter_expr_t **children;
+    int pos;
+
+    if (!(children = realloc(node->children, sizeof(filter_expr_t *) * (node->childcnt + 1))))
+        return 1;
+    node->children = children;
+
+    // Find child position
+    for (pos = node->childcnt; pos > 0 && children[pos - 1]->cost > child->cost; pos--)
+        children[pos] = children[pos - 1];
+
+    children[pos] = child;
+    node->childcnt++;
+    node->cost += child->cost;
+    return 0;
+}
+
+/**
+ * @brief Parse a single attribute comparison
+ */
+static filter_expr_t *
+filter_expr_parse_compare(filter_expr_parser_t *parser)
+{
+    filter_expr_t *node;
+    enum sip_attr_id attr;
+    enum filter_expr_op op;
+    int quoted;
+    double number;
+
+    // Attribute name
+    if (parser->token != FEXPR_TK_WORD)
+        return NULL;
+    if ((int) (attr = sip_attr_from_name(parser->value)) == -1)
+        return NULL;
+
+    // Comparison operator
+    filter_expr_next_token(parser);
+    if (parser->token != FEXPR_TK_OPERATOR)
+        return NULL;
+    op = parser->op;
+
+    // Compared value
+    filter_expr_next_token(parser);
+    if (parser->token != FEXPR_TK_WORD && parser->token != FEXPR_TK_STRING)
+        return NULL;
+    quoted = (parser->token == FEXPR_TK_STRING);
+
+    if (op == FEXPR_OP_MATCH || op == FEXPR_OP_NOMATCH) {
+        if (!(node = filter_expr_node_create(FEXPR_REGEX)))
+            return NULL;
+#ifdef WITH_PCRE
+        const char *re_err = NULL;
+        int32_t err_offset;
+        if (!(node->regex = pcre_compile(parser->value, PCRE_UNGREEDY | PCRE_CASELESS, &re_err, &err_offset, 0))) {
+            free(node);
+            return NULL;
+        }
+#else
+        if (regcomp(&node->regex, parser->value, REG_EXTENDED | REG_ICASE) != 0) {
+            free(node);
+            return NULL;
+        }
+#endif
+        node->cost = 10;
+    } else if (!quoted && sip_attr_is_numeric(attr)
+               && filter_expr_strtonum(parser->value, &number) == 0) {
+        if (!(node = filter_expr_node_create(FEXPR_NUMBER)))
+            return NULL;
+        node->number = number;
+        node->cost = 1;
+    } else {
+        if (!(node = filter_expr_node_create(FEXPR_STRING)))
+            return NULL;
+        node->cost = 2;
+    }
+
+    node->op = op;
+    node->attr = attr;
+    node->value = strdup(parser->value);
+    if (node->type == FEXPR_STRING)
+        node->ivalue = intern_get(node->value);
+
+    // Message attributes require looking at the call first message
+    switch (attr) {
+        case SIP_ATTR_CALLINDEX:
+        case SIP_ATTR_MSGCNT:
+        case SIP_ATTR_CALLSTATE:
+        case SIP_ATTR_CONVDUR:
+        case SIP_ATTR_TOTALDUR:
+        case SIP_ATTR_PDD:
+        case SIP_ATTR_TTA:
+        case SIP_ATTR_RETRANS:
+        case SIP_ATTR_RESP1XX:
+        case SIP_ATTR_RESP2XX:
+        case SIP_ATTR_RESP3XX:
+        case SIP_ATTR_RESP4XX:
+        case SIP_ATTR_RESP5XX:
+        case SIP_ATTR_RESP6XX:
+            break;
+        default:
+            node->cost++;
+            break;
+    }
+
+    filter_expr_next_token(parser);
+    return node;
+}
+
+/**
+ * @brief Parse a negated, grouped or single comparison expression
+ */
+static filter_expr_t *
+filter_expr_parse_unary(filter_expr_parser_t *parser)
+{
+    filter_expr_t *node, *child;
+
+    switch (parser->token) {
+        case FEXPR_TK_NOT:
+            filter_expr_next_token(parser);
+            if (!(child = filter_expr_parse_unary(parser)))
+                return NULL;
+            if (!(node = filter_expr_node_create(FEXPR_NOT))) {
+                filter_expr_destroy(child);
+                return NULL;
+            }
+            filter_expr_node_add(node, child);
+            return node;
+        case FEXPR_TK_LPAREN:
+            filter_expr_next_token(parser);
+            if (!(node = filter_expr_parse_or(parser)))
+                return NULL;
+            if (parser->token != FEXPR_TK_RPAREN) {
+                filter_expr_destroy(node);
+                return NULL;
+            }
+            filter_expr_next_token(parser);
+            return node;
+        default:
+            return filter_expr_parse_compare(parser);
+    }
+}
+
+/**
+ * @brief Parse a list of expressions joined by the same logical operator
+ */
+static filter_expr_t *
+filter_expr_parse_list(filter_expr_parser_t *parser, enum filter_expr_token token)
+{
+    filter_expr_t *node, *child;
+
+    // Parse first operand
+    if (token == FEXPR_TK_OR) {
+        child = filter_expr_parse_list(parser, FEXPR_TK_AND);
+    } else {
+        child = filter_expr_parse_unary(parser);
+    }
+
+    // Single operand, no need to create a new node
+    if (!child || parser->token != token)
+        return child;
+
+    if (!(node = filter_expr_node_create((token == FEXPR_TK_OR) ? FEXPR_OR : FEXPR_AND))) {
+        filter_expr_destroy(child);
+        return NULL;
+    }
+
+    while (child) {
+        filter_expr_node_add(node, child);
+        if (parser->token != token)
+            return node;
+        filter_expr_next_token(parser);
+
+        // Parse next operand
+        if (token == FEXPR_TK_OR) {
+            child = filter_expr_parse_list(parser, FEXPR_TK_AND);
+        } else {
+            child = filter_expr_parse_unary(parser);
+        }
+    }
+
+    // Some operand failed to parse
+    filter_expr_destroy(node);
+    return NULL;
+}
+
+static filter_expr_t *
+filter_expr_parse_or(filter_expr_parser_t *parser)
+{
+    return filter_expr_parse_list(parser, FEXPR_TK_OR);
+}
+
+filter_expr_t *
+filter_expr_compile(const char *text)
+{
+    filter_expr_parser_t parser;
+    filter_expr_t *expr;
+
+    if (!text)
+        return NULL;
+
+    // Initialize parser status
+    memset(&parser, 0, sizeof(filter_expr_parser_t));
+    parser.pos = text;
+
+    // Parse the full expression
+    filter_expr_next_token(&parser);
+    if (!(expr = filter_expr_parse_or(&parser)))
+        return NULL;
+
+    // There must be nothing left after the expression
+    if (parser.token != FEXPR_TK_END) {
+        filter_expr_destroy(expr);
+        return NULL;
+    }
+
+    return expr;
+}
+
+void
+filter_expr_destroy(filter_expr_t *expr)
+{
+    int i;
+
+    if (!expr)
+        return;
+
+    // Remove all children nodes
+    for (i = 0; i < expr->childcnt; i++)
+        filter_expr_destroy(expr->children[i]);
+    free(expr->children);
+
+    if (expr->type == FEXPR_REGEX) {
+#ifdef WITH_PCRE
+        pcre_free(expr->regex);
+#else
+        regfree(&expr->regex);
+#endif
+    }
+
+    if (expr->type == FEXPR_STRING)
+        intern_release(expr->ivalue);
+
+    free(expr->value);
+    free(expr);
+}
+
+int
+filter_expr_check(filter_expr_t *expr, sip_call_t *call)
+{
+    const char *value;
+    double number;
+    int i, cmp;
+
+    switch (expr->type) {
+        case FEXPR_AND:
+            for (i = 0; i < expr->childcnt; i++) {
+                if (!filter_expr_check(expr->children[i], call))
+                    return 0;
+            }
+            return 1;
+        case FEXPR_OR:
+            for (i = 0; i < expr->childcnt; i++) {
+                if (filter_expr_check(expr->children[i], call))
+                    return 1;
+            }
+            return 0;
+        case FEXPR_NOT:
+            return !filter_expr_check(expr->children[0], call);
+        case FEXPR_NUMBER:
+            // Attributes without numeric value only match inequality
+            if (call_get_attribute_num(call, expr->attr, &number) != 0)
+                return expr->op == FEXPR_OP_NE;
+            cmp = (number > expr->number) - (number < expr->number);
+            break;
+        case FEXPR_STRING:
+            // Missing attributes only match inequality
+            if (!(value = call_get_attribute(call, expr->attr)))
+                return expr->op == FEXPR_OP_NE;
+            // Attribute values are interned, so equality is a pointer compare
+            if (expr->op == FEXPR_OP_EQ)
+                return value == expr->ivalue;
+            if (expr->op == FEXPR_OP_NE)
+                return value != expr->ivalue;
+            cmp = strcmp(value, expr->value);
+            break;
+        case FEXPR_REGEX:
+            // Missing attributes never match
+            if (!(value = call_get_attribute(call, expr->attr)))
+                return expr->op == FEXPR_OP_NOMATCH;
+#ifdef WITH_PCRE
+            cmp = (pcre_exec(expr->regex, 0, value, strlen(value), 0, 0, 0, 0) >= 0);
+#else
+            cmp = (regexec(&expr->regex, value, 0, NULL, 0) == 0);
+#endif
+            return (expr->op == FEXPR_OP_MATCH) ? cmp : !cmp;
+        default:
+            return 0;
+    }
+
+    switch (expr->op) {
+        case FEXPR_OP_EQ:
+            return cmp == 0;
+        case FEXPR_OP_NE:
+            return cmp != 0;
+        case FEXPR_OP_LT:
+            return cmp < 0;
+        case FEXPR_OP_LE:
+            return cmp <= 0;
+        case FEXPR_OP_GT:
+            return cmp > 0;
+        case FEXPR_OP_GE:
+            return cmp >= 0;
+        default:
+            return 0;
+    }
+}
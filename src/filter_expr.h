@@ -0,0 +1,152 @@
+/**************************************************************************
+ **
+ ** sngrep - SIP Messages flow viewer
+ **
+ ** Copyright (C) 2013,2014 Ivan Alonso (Kaian)
+ ** Copyright (C) 2013,2014 Irontec SL. All rights reserved.
+ **
+ ** This program is free software: you can redistribute it and/or modify
+ ** it under the terms of the GNU General Public License as published by
+ ** the Free Software Foundation, either version 3 of the License, or
+ ** (at your option) any later version.
+ **
+ ** This program is distributed in the hope that it will be useful,
+ ** but WITHOUT ANY WARRANTY; without even the implied warranty of
+ ** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ ** GNU General Public License for more details.
+ **
+ ** You should have received a copy of the GNU General Public License
+ ** along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ **
+ ****************************************************************************/
+/**
+ * @file filter_expr.h
+ * @author Ivan Alonso [aka Kaian] <kaian@irontec.com>
+ *
+ * @brief Functions to manage display filter expressions
+ *
+ * Display filter expressions are small boolean expressions over call
+ * attributes, for example:
+ *
+ *   state == "REJECTED" && msgcnt > 5 && src ~ "^10\.1\."
+ *
+ * Each comparison uses an attribute name (the same names used in
+ * cl.column settings), an operator and a value. Available operators are
+ * ==, !=, <, <=, >, >= and ~, !~ for regular expressions. Comparisons can
+ * be combined using &&, || and ! (or and, or, not) and parenthesis.
+ *
+ * Expressions are compiled once into a predicate tree. Comparisons with
+ * numeric values are done numerically and the operands of every && and ||
+ * are evaluated cheapest first, so regular expressions are only checked
+ * when cheaper tests have not already decided the result.
+ */
+
+#ifndef __SNGREP_FILTER_EXPR_H_
+#define __SNGREP_FILTER_EXPR_H_
+
+#include "config.h"
+#ifdef WITH_PCRE
+#include <pcre.h>
+#else
+#include <regex.h>
+#endif
+#include "sip.h"
+
+//! Shorter declaration of filter_expr structure
+typedef struct filter_expr filter_expr_t;
+
+/**
+ * @brief Predicate tree node types
+ */
+enum filter_expr_type {
+    //! All children must match
+    FEXPR_AND = 0,
+    //! Any of the children must match
+    FEXPR_OR,
+    //! Child must not match
+    FEXPR_NOT,
+    //! Compare attribute value as number
+    FEXPR_NUMBER,
+    //! Compare attribute value as string
+    FEXPR_STRING,
+    //! Match attribute value against a regular expression
+    FEXPR_REGEX,
+};
+
+/**
+ * @brief Available comparison operators
+ */
+enum filter_expr_op {
+    FEXPR_OP_EQ = 0,
+    FEXPR_OP_NE,
+    FEXPR_OP_LT,
+    FEXPR_OP_LE,
+    FEXPR_OP_GT,
+    FEXPR_OP_GE,
+    FEXPR_OP_MATCH,
+    FEXPR_OP_NOMATCH,
+};
+
+/**
+ * @brief Predicate tree node
+ */
+struct filter_expr {
+    //! Node type
+    enum filter_expr_type type;
+    //! Comparison operator (for comparison nodes)
+    enum filter_expr_op op;
+    //! Compared attribute (for comparison nodes)
+    enum sip_attr_id attr;
+    //! Compared value as text
+    char *value;
+    //! Compared value interned (for string comparisons)
+    const char *ivalue;
+    //! Compared value as number
+    double number;
+#ifdef WITH_PCRE
+    //! Compiled regular expression
+    pcre *regex;
+#else
+    //! Compiled regular expression
+    regex_t regex;
+#endif
+    //! Estimated evaluation cost of this node
+    int cost;
+    //! Children nodes (for AND, OR and NOT nodes)
+    filter_expr_t **children;
+    //! Number of children nodes
+    int childcnt;
+};
+
+/**
+ * @brief Compile a filter expression
+ *
+ * Parse the given text and create the predicate tree that can be
+ * used to check calls. If the text is not a valid expression, NULL
+ * will be returned.
+ *
+ * @param text Expression text
+ * @return compiled expression or NULL
+ */
+filter_expr_t *
+filter_expr_compile(const char *text);
+
+/**
+ * @brief Free a compiled expression
+ *
+ * @param expr Compiled expression
+ */
+void
+filter_expr_destroy(filter_expr_t *expr);
+
+/**
+ * @brief Check if a call matches a compiled expression
+ *
+ * @param expr Compiled expression
+ * @param call Call to be checked
+ * @return 1 if call matches the expression, 0 otherwise
+ */
+int
+filter_expr_check(filter_expr_t *expr, sip_call_t *call);
+
+#endif /* __SNGREP_FILTER_EXPR_H_ */
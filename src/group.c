@@ -28,8 +28,19 @@
  */
 #include <string.h>
 #include <stdlib.h>
+#include <stdint.h>
 #include "group.h"
 
+/**
+ * @brief Heap entry used while merging the calls messages
+ */
+struct group_heap_entry {
+    //! Next message of the call to be merged
+    sip_msg_t *msg;
+    //! Call position in the group
+    int callpos;
+};
+
 sip_call_group_t *
 call_group_create()
 {
@@ -38,86 +49,148 @@ call_group_create()
         return NULL;
     }
     memset(group, 0, sizeof(sip_call_group_t));
+    if (!(group->slots = htable_create(64))) {
+        free(group);
+        return NULL;
+    }
     return group;
 }
 
 void
 call_group_destroy(sip_call_group_t *group)
 {
+    htable_destroy(group->slots);
+    free(group->calls);
+    free(group->msgs);
+    free(group->cursors);
     free(group);
 }
 
+void
+call_group_clear(sip_call_group_t *group)
+{
+    // Calls may have been destroyed already, don't use them
+    htable_clear(group->slots);
+    group->callcnt = group->slotcnt = 0;
+
+    // Group messages must be merged again
+    call_group_index_clear(group);
+}
+
+/**
+ * @brief Get the calls array slot of a call in the group
+ *
+ * @return slot position or -1 if the call is not in the group
+ */
+static int
+call_group_slot(sip_call_group_t *group, sip_call_t *call)
+{
+    // Slots are stored with an offset to tell them apart from NULL
+    intptr_t slot = (intptr_t) htable_find(group->slots, call->callid);
+    return slot - 1;
+}
+
+/**
+ * @brief Remove empty slots from the calls array
+ */
+static void
+call_group_compact(sip_call_group_t *group)
+{
+    int i, slotcnt = 0;
+
+    for (i = 0; i < group->slotcnt; i++) {
+        if (!group->calls[i])
+            continue;
+        group->calls[slotcnt++] = group->calls[i];
+        htable_remove(group->slots, group->calls[i]->callid);
+        htable_insert(group->slots, group->calls[i]->callid, (void *) (intptr_t) slotcnt);
+    }
+    group->slotcnt = slotcnt;
+}
+
 void
 call_group_add(sip_call_group_t *group, sip_call_t *call)
 {
+    sip_call_t **calls;
 
     if (!group || !call || call_group_exists(group, call))
         return;
-    group->calls[group->callcnt++] = call;
+
+    // Reuse empty slots before growing the array
+    if (group->slotcnt == group->slotsize && group->callcnt <= group->slotcnt / 2)
+        call_group_compact(group);
+
+    // Make room for the new call
+    if (group->slotcnt == group->slotsize) {
+        if (!(calls = realloc(group->calls, sizeof(sip_call_t *) * (group->slotsize + 1024))))
+            return;
+        group->calls = calls;
+        group->slotsize += 1024;
+    }
+
+    if (htable_insert(group->slots, call->callid, (void *) (intptr_t) (group->slotcnt + 1)) != 0)
+        return;
+    group->calls[group->slotcnt++] = call;
+    group->callcnt++;
+
+    // Group messages must be merged again
+    call_group_index_clear(group);
 }
 
 void
 call_group_del(sip_call_group_t *group, sip_call_t *call)
 {
-    int i;
-    if (!group || !call || !call_group_exists(group, call))
+    int slot;
+
+    if (!group || !call || (slot = call_group_slot(group, call)) == -1)
         return;
-    for (i = 0; i < group->callcnt; i++) {
-        if (call == group->calls[i]) {
-            group->calls[i] = group->calls[i + 1];
-            call = group->calls[i + 1];
-        }
-    }
+
+    // Leave an empty slot, so other calls keep their positions
+    htable_remove(group->slots, call->callid);
+    group->calls[slot] = NULL;
     group->callcnt--;
+
+    // Remove empty slots at the end
+    while (group->slotcnt && !group->calls[group->slotcnt - 1])
+        group->slotcnt--;
+
+    // Group messages must be merged again
+    call_group_index_clear(group);
 }
 
 int
 call_group_exists(sip_call_group_t *group, sip_call_t *call)
 {
-    int i;
-    for (i = 0; i < group->callcnt; i++) {
-        if (call == group->calls[i])
-            return 1;
-    }
-    return 0;
+    return call && call_group_slot(group, call) != -1;
 }
 
 int
 call_group_color(sip_call_group_t *group, sip_call_t *call)
 {
-    int i;
-    for (i = 0; i < group->callcnt; i++) {
-        if (call == group->calls[i]) {
-            return (i % 7) + 1;
-        }
-    }
-    return -1;
+    int slot;
+
+    if ((slot = call_group_slot(group, call)) == -1)
+        return -1;
+    return (slot % 7) + 1;
 }
 
 sip_call_t *
 call_group_get_next(sip_call_group_t *group, sip_call_t *call)
 {
-    int i;
+    int slot = -1;
 
     if (!group)
         return NULL;
 
-    // Return first call
-    if (!call)
-        return group->calls[0];
-
-    for (i = 0; i < group->callcnt; i++) {
-        if (call == group->calls[i])
-            break;
-    }
-
-    // Reference is last call
-    if (i == group->callcnt - 1)
+    // Get the slot of the reference call
+    if (call && (slot = call_group_slot(group, call)) == -1)
         return NULL;
 
-    // Return next call
-    if (i < group->callcnt)
-        return group->calls[i + 1];
+    // Return next call skipping empty slots
+    for (slot++; slot < group->slotcnt; slot++) {
+        if (group->calls[slot])
+            return group->calls[slot];
+    }
 
     return NULL;
 }
@@ -128,68 +201,245 @@ call_group_count(sip_call_group_t *group)
     return group->callcnt;
 }
 
+/**
+ * @brief Check if a heap entry must be merged before other
+ *
+ * Messages are sorted by timestamp. Messages with the same timestamp
+ * keep the order of their calls in the group.
+ */
+static int
+call_group_heap_less(struct group_heap_entry *one, struct group_heap_entry *two)
+{
+    if (sip_msg_is_older(two->msg, one->msg))
+        return 1;
+    if (sip_msg_is_older(one->msg, two->msg))
+        return 0;
+    return one->callpos < two->callpos;
+}
 
-int
-call_group_msg_count(sip_call_group_t *group)
+/**
+ * @brief Move down a heap entry until heap order is restored
+ */
+static void
+call_group_heap_down(struct group_heap_entry *heap, int count, int pos)
 {
-    sip_msg_t *msg = NULL;
-    int msgcnt = 0, i;
+    struct group_heap_entry tmp;
+    int child;
 
-    for (i = 0; i < group->callcnt; i++) {
-        while ((msg = call_get_next_msg(group->calls[i], msg))) {
-            if (group->sdp_only && !msg->sdp)
-                continue;
-            msgcnt++;
-        }
+    while ((child = pos * 2 + 1) < count) {
+        // Pick the lowest child
+        if (child + 1 < count && call_group_heap_less(&heap[child + 1], &heap[child]))
+            child++;
+        if (!call_group_heap_less(&heap[child], &heap[pos]))
+            break;
+        tmp = heap[pos];
+        heap[pos] = heap[child];
+        heap[child] = tmp;
+        pos = child;
     }
-    return msgcnt;
 }
 
-int
-call_group_msg_number(sip_call_group_t *group, sip_msg_t *msg)
+/**
+ * @brief Add a message at the end of the group messages index
+ *
+ * @return 0 if message has been added, 1 otherwise
+ */
+static int
+call_group_index_add(sip_call_group_t *group, sip_msg_t *msg)
 {
-    int number = 0;
-    sip_msg_t *cur = NULL;
-    while ((cur = call_group_get_next_msg(group, cur))) {
-        if (group->sdp_only && !msg->sdp)
-            continue;
+    sip_msg_t **msgs;
 
-        if (cur == msg)
-            return number;
-        number++;
+    if (group->msgcnt == group->msgsize) {
+        if (!(msgs = realloc(group->msgs, sizeof(sip_msg_t *) * (group->msgsize + 1024))))
+            return 1;
+        group->msgs = msgs;
+        group->msgsize += 1024;
     }
+    group->msgs[group->msgcnt++] = msg;
     return 0;
 }
 
-sip_msg_t *
-call_group_get_next_msg(sip_call_group_t *group, sip_msg_t *msg)
+/**
+ * @brief Find the position of a message in the group messages index
+ *
+ * @return message position or -1 if message is not indexed
+ */
+static int
+call_group_index_find(sip_call_group_t *group, sip_msg_t *msg)
+{
+    int first = 0, last = group->msgcnt - 1, pos;
+
+    // Usually we are asked for the last returned message
+    if (group->lastpos < group->msgcnt && group->msgs[group->lastpos] == msg)
+        return group->lastpos;
+
+    // Look for the first message with the same timestamp
+    while (first < last) {
+        pos = (first + last) / 2;
+        if (sip_msg_is_older(msg, group->msgs[pos])) {
+            first = pos + 1;
+        } else {
+            last = pos;
+        }
+    }
+
+    // Check all messages with the same timestamp
+    for (pos = first; pos < group->msgcnt; pos++) {
+        if (group->msgs[pos] == msg)
+            return pos;
+        if (sip_msg_is_older(group->msgs[pos], msg))
+            break;
+    }
+
+    // Messages of the same call are not sorted, look everywhere
+    for (pos = 0; pos < group->msgcnt; pos++) {
+        if (group->msgs[pos] == msg)
+            return pos;
+    }
+
+    return -1;
+}
+
+void
+call_group_index_clear(sip_call_group_t *group)
 {
-    sip_msg_t *next = NULL;
-    sip_msg_t *cand;
-    int i;
+    group->msgcnt = 0;
+    group->lastpos = 0;
+    // Let users of the index know it has to be read again
+    group->generation++;
+    // Cursors will be allocated again on next update
+    free(group->cursors);
+    group->cursors = NULL;
+    group->cursorsize = 0;
+}
+
+void
+call_group_index_update(sip_call_group_t *group)
+{
+    struct group_heap_entry *heap;
+    sip_msg_t *msg, **cursors;
+    int i, count = 0;
+
+    // Filtering mode changed, merge all messages again
+    if (group->index_sdp_only != group->sdp_only) {
+        group->index_sdp_only = group->sdp_only;
+        call_group_index_clear(group);
+    }
 
-    for (i = 0; i < group->callcnt; i++) {
-        cand = NULL;
-        while ((cand = call_get_next_msg(group->calls[i], cand))) {
-            if (group->sdp_only && !cand->sdp)
-                continue;
+    // Make room for one cursor per call
+    if (group->cursorsize < group->slotcnt) {
+        if (!(cursors = realloc(group->cursors, sizeof(sip_msg_t *) * group->slotcnt)))
+            return;
+        memset(cursors + group->cursorsize, 0,
+               sizeof(sip_msg_t *) * (group->slotcnt - group->cursorsize));
+        group->cursors = cursors;
+        group->cursorsize = group->slotcnt;
+    }
+
+    if (!(heap = malloc(sizeof(struct group_heap_entry) * (group->slotcnt + 1))))
+        return;
+
+    // Get the next message to be merged of each call
+    for (i = 0; i < group->slotcnt; i++) {
+        if (!group->calls[i])
+            continue;
+        if (!(msg = call_get_next_msg(group->calls[i], group->cursors[i])))
+            continue;
+        // New message is older than already merged ones, merge everything again
+        if (group->msgcnt && sip_msg_is_older(group->msgs[group->msgcnt - 1], msg)) {
+            free(heap);
+            call_group_index_clear(group);
+            call_group_index_update(group);
+            return;
+        }
+        heap[count].msg = msg;
+        heap[count].callpos = i;
+        count++;
+    }
 
-            // candidate must be between msg and next
-            if (sip_msg_is_older(cand, msg) && (!next || !sip_msg_is_older(cand, next))) {
-                next = cand;
+    // Build the heap
+    for (i = count / 2 - 1; i >= 0; i--)
+        call_group_heap_down(heap, count, i);
+
+    // Merge messages until all calls have been consumed
+    while (count) {
+        msg = heap[0].msg;
+        group->cursors[heap[0].callpos] = msg;
+
+        if (!group->sdp_only || msg->sdp) {
+            if (call_group_index_add(group, msg) != 0)
                 break;
-            }
         }
+
+        // Replace the top of the heap with the next message of the same call
+        if (!(heap[0].msg = call_get_next_msg(msg->call, msg)))
+            heap[0] = heap[--count];
+        call_group_heap_down(heap, count, 0);
     }
+    free(heap);
 
     // If sdp_only is enabled but no message has been found with SDP, just
     // ignore the flag
-    if (msg == NULL && next == NULL) {
+    if (group->sdp_only && !group->msgcnt) {
         group->sdp_only = 0;
-        return call_group_get_next_msg(group, msg);
+        call_group_index_update(group);
     }
+}
+
+int
+call_group_msg_count(sip_call_group_t *group)
+{
+    call_group_index_update(group);
+    return group->msgcnt;
+}
+
+int
+call_group_msg_number(sip_call_group_t *group, sip_msg_t *msg)
+{
+    int pos;
+
+    call_group_index_update(group);
+    if ((pos = call_group_index_find(group, msg)) == -1)
+        return 0;
+    return pos;
+}
+
+sip_msg_t *
+call_group_get_next_msg(sip_call_group_t *group, sip_msg_t *msg)
+{
+    int pos = -1;
+
+    // Index new messages only when requested message is the last one
+    if (!group->msgcnt || group->sdp_only != group->index_sdp_only
+        || (msg && group->msgs[group->msgcnt - 1] == msg)) {
+        call_group_index_update(group);
+    }
+
+    // Get the position of the given message
+    if (msg && (pos = call_group_index_find(group, msg)) == -1)
+        return NULL;
+
+    if (pos + 1 >= group->msgcnt)
+        return NULL;
+
+    group->lastpos = pos + 1;
+    return group->msgs[group->lastpos];
+}
+
+sip_msg_t *
+call_group_get_prev_msg(sip_call_group_t *group, sip_msg_t *msg)
+{
+    int pos;
+
+    if (group->sdp_only != group->index_sdp_only)
+        call_group_index_update(group);
+
+    // Get the position of the given message
+    if (!msg || (pos = call_group_index_find(group, msg)) <= 0)
+        return NULL;
 
-    return next;
+    group->lastpos = pos - 1;
+    return group->msgs[group->lastpos];
 }
 
 int
@@ -35,6 +35,7 @@
 
 #include "config.h"
 #include "sip.h"
+#include "hash.h"
 
 //! Shorter declaration of sip_call_group structure
 typedef struct sip_call_group sip_call_group_t;
@@ -46,17 +47,41 @@ typedef struct sip_call_group sip_call_group_t;
  * same call flow. Instead of displaying a call flow, we will display
  * a calls group flow.
  *
- * @fixme Remove 1024 "limitation"
+ * Calls are stored in insertion order in a growable array. Removed calls
+ * leave an empty slot that is reused when the array is compacted, and a
+ * hash table maps each Call-ID to its slot.
  */
 struct sip_call_group {
-    //! Calls array in the group
-    sip_call_t *calls[1024];
+    //! Calls array in the group (removed calls are NULL)
+    sip_call_t **calls;
     //! Calls counter
     int callcnt;
+    //! Used slots in calls array
+    int slotcnt;
+    //! Allocated slots in calls array
+    int slotsize;
+    //! Call-ID to calls array slot
+    htable_t *slots;
     //! Color of the last printed call in mode Color-by-Call
     int color;
     //! Only consider SDP messages from Calls
     int sdp_only;
+    //! Messages of all calls sorted by timestamp
+    sip_msg_t **msgs;
+    //! Number of indexed messages
+    int msgcnt;
+    //! Allocated size of messages index
+    int msgsize;
+    //! Last merged message of each call
+    sip_msg_t **cursors;
+    //! Allocated size of cursors array
+    int cursorsize;
+    //! sdp_only value when messages were indexed
+    int index_sdp_only;
+    //! Index position of the last returned message
+    int lastpos;
+    //! Increased each time the messages index is created again
+    int generation;
 };
 
 /**
@@ -77,6 +102,17 @@ call_group_create();
 void
 call_group_destroy(sip_call_group_t *group);
 
+/**
+ * @brief Remove all calls from the group
+ *
+ * Group calls are not accessed, so this can be used after they have
+ * been destroyed.
+ *
+ * @param Pointer to an existing group
+ */
+void
+call_group_clear(sip_call_group_t *group);
+
 /**
  * @brief Add a Call to the group
  *
@@ -142,6 +178,30 @@ call_group_get_next(sip_call_group_t *group, sip_call_t *call);
 int
 call_group_count(sip_call_group_t *group);
 
+/**
+ * @brief Add new messages of the group calls to the messages index
+ *
+ * Group messages are stored in an index sorted by timestamp. The index
+ * is created merging the messages of all the calls using a heap with
+ * the next message of each call, so only new messages are merged each
+ * time this function is called.
+ *
+ * If sdp_only flag is enabled only messages with SDP are indexed. If
+ * there is no message with SDP, the flag is disabled.
+ *
+ * @param group Pointer to an existing group
+ */
+void
+call_group_index_update(sip_call_group_t *group);
+
+/**
+ * @brief Remove all messages from the group messages index
+ *
+ * @param group Pointer to an existing group
+ */
+void
+call_group_index_clear(sip_call_group_t *group);
+
 /**
  * @brief Return message count in the group
  *
@@ -179,6 +239,16 @@ call_group_msg_number(sip_call_group_t *group, sip_msg_t *msg);
 sip_msg_t *
 call_group_get_next_msg(sip_call_group_t *group, sip_msg_t *msg);
 
+/**
+ * @brief Finds the previous msg in a call group.
+ *
+ * @param callgroup SIP call group structure
+ * @param msg Actual SIP msg from any call of the group
+ * @return Previous chronological message in the group or NULL
+ */
+sip_msg_t *
+call_group_get_prev_msg(sip_call_group_t *group, sip_msg_t *msg);
+
 /**
  * @brief Check if a message is older than other
  *
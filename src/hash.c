@@ -0,0 +1,190 @@
+/**************************************************************************
+ **
+ ** sngrep - SIP Messages flow viewer
+ **
+ ** Copyright (C) 2013,2014 Ivan Alonso (Kaian)
+ ** Copyright (C) 2013,2014 Irontec SL. All rights reserved.
+ **
+ ** This program is free software: you can redistribute it and/or modify
+ ** it under the terms of the GNU General Public License as published by
+ ** the Free Software Foundation, either version 3 of the License, or
+ ** (at your option) any later version.
+ **
+ ** This program is distributed in the hope that it will be useful,
+ ** but WITHOUT ANY WARRANTY; without even the implied warranty of
+ ** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ ** GNU General Public License for more details.
+ **
+ ** You should have received a copy of the GNU General Public License
+ ** along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ **
+ ****************************************************************************/
+/**
+ * @file hash.c
+ * @author Ivan Alonso [aka Kaian] <kaian@irontec.com>
+ *
+ * @brief Source code of functions defined in hash.h
+ *
+ */
+#include <string.h>
+#include <stdlib.h>
+#include "hash.h"
+
+/**
+ * @brief Calculate the bucket of a key
+ *
+ * djb2 string hash function
+ */
+static size_t
+htable_hash(htable_t *table, const char *key)
+{
+    size_t hash = 5381;
+
+    while (*key)
+        hash = ((hash << 5) + hash) + (unsigned char) *key++;
+
+    return hash % table->size;
+}
+
+/**
+ * @brief Move all entries of the table to a new buckets array
+ *
+ * @return 0 if the table has been resized, 1 otherwise
+ */
+static int
+htable_resize(htable_t *table, size_t size)
+{
+    hentry_t **buckets, **old, *entry, *next;
+    size_t i, oldsize, bucket;
+
+    if (!(buckets = calloc(size, sizeof(hentry_t *))))
+        return 1;
+
+    old = table->buckets;
+    oldsize = table->size;
+    table->buckets = buckets;
+    table->size = size;
+
+    // Move all entries to their new buckets
+    for (i = 0; i < oldsize; i++) {
+        for (entry = old[i]; entry; entry = next) {
+            next = entry->next;
+            bucket = htable_hash(table, entry->key);
+            entry->next = buckets[bucket];
+            buckets[bucket] = entry;
+        }
+    }
+
+    free(old);
+    return 0;
+}
+
+htable_t *
+htable_create(size_t size)
+{
+    htable_t *table;
+
+    if (!(table = malloc(sizeof(htable_t))))
+        return NULL;
+    memset(table, 0, sizeof(htable_t));
+
+    // At least one bucket is required
+    table->size = (size) ? size : 1;
+    if (!(table->buckets = calloc(table->size, sizeof(hentry_t *)))) {
+        free(table);
+        return NULL;
+    }
+
+    return table;
+}
+
+void
+htable_destroy(htable_t *table)
+{
+    if (!table)
+        return;
+
+    htable_clear(table);
+    free(table->buckets);
+    free(table);
+}
+
+void
+htable_clear(htable_t *table)
+{
+    hentry_t *entry, *next;
+    size_t i;
+
+    for (i = 0; i < table->size; i++) {
+        for (entry = table->buckets[i]; entry; entry = next) {
+            next = entry->next;
+            free(entry->key);
+            free(entry);
+        }
+        table->buckets[i] = NULL;
+    }
+    table->count = 0;
+}
+
+int
+htable_insert(htable_t *table, const char *key, void *data)
+{
+    hentry_t *entry;
+    size_t bucket;
+
+    // Keys are unique in the table
+    if (htable_find(table, key))
+        return 1;
+
+    if (!(entry = malloc(sizeof(hentry_t))))
+        return 1;
+    memset(entry, 0, sizeof(hentry_t));
+
+    if (!(entry->key = strdup(key))) {
+        free(entry);
+        return 1;
+    }
+    entry->data = data;
+
+    // Add the entry at the beginning of its bucket
+    bucket = htable_hash(table, key);
+    entry->next = table->buckets[bucket];
+    table->buckets[bucket] = entry;
+    table->count++;
+
+    // Keep chains short
+    if (table->count > table->size)
+        htable_resize(table, table->size * 4);
+
+    return 0;
+}
+
+void
+htable_remove(htable_t *table, const char *key)
+{
+    hentry_t *entry, **prev;
+
+    prev = &table->buckets[htable_hash(table, key)];
+    for (entry = *prev; entry; prev = &entry->next, entry = entry->next) {
+        if (!strcmp(entry->key, key)) {
+            *prev = entry->next;
+            free(entry->key);
+            free(entry);
+            table->count--;
+            return;
+        }
+    }
+}
+
+void *
+htable_find(htable_t *table, const char *key)
+{
+    hentry_t *entry;
+
+    for (entry = table->buckets[htable_hash(table, key)]; entry; entry = entry->next) {
+        if (!strcmp(entry->key, key))
+            return entry->data;
+    }
+
+    return NULL;
+}
@@ -0,0 +1,132 @@
+/**************************************************************************
+ **
+ ** sngrep - SIP Messages flow viewer
+ **
+ ** Copyright (C) 2013,2014 Ivan Alonso (Kaian)
+ ** Copyright (C) 2013,2014 Irontec SL. All rights reserved.
+ **
+ ** This program is free software: you can redistribute it and/or modify
+ ** it under the terms of the GNU General Public License as published by
+ ** the Free Software Foundation, either version 3 of the License, or
+ ** (at your option) any later version.
+ **
+ ** This program is distributed in the hope that it will be useful,
+ ** but WITHOUT ANY WARRANTY; without even the implied warranty of
+ ** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ ** GNU General Public License for more details.
+ **
+ ** You should have received a copy of the GNU General Public License
+ ** along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ **
+ ****************************************************************************/
+/**
+ * @file hash.h
+ * @author Ivan Alonso [aka Kaian] <kaian@irontec.com>
+ *
+ * @brief Functions to manage hash tables
+ *
+ * Simple chained hash tables indexed by a string key. Unlike hsearch
+ * family functions, multiple tables can be used at the same time and
+ * entries can be removed from them. Tables grow when they have more
+ * entries than buckets, so the given size is just an initial hint.
+ *
+ */
+
+#ifndef __SNGREP_HASH_H_
+#define __SNGREP_HASH_H_
+
+#include <stddef.h>
+
+//! Shorter declaration of hash table structure
+typedef struct htable htable_t;
+//! Shorter declaration of hash entry structure
+typedef struct hentry hentry_t;
+
+/**
+ * @brief Hash table entry
+ *
+ * Each entry stores a copy of its key and a pointer to the data, that
+ * is not managed by the hash table.
+ */
+struct hentry {
+    //! Entry key
+    char *key;
+    //! Entry data
+    void *data;
+    //! Next entry in the same bucket
+    hentry_t *next;
+};
+
+/**
+ * @brief Hash table structure
+ */
+struct htable {
+    //! Number of buckets
+    size_t size;
+    //! Number of stored entries
+    size_t count;
+    //! Buckets array
+    hentry_t **buckets;
+};
+
+/**
+ * @brief Create a new hash table
+ *
+ * @param size Initial number of buckets of the table
+ * @return Pointer to a new hash table or NULL on allocation failure
+ */
+htable_t *
+htable_create(size_t size);
+
+/**
+ * @brief Deallocate memory of an existing hash table
+ *
+ * Stored data is not freed.
+ *
+ * @param table Pointer to an existing hash table
+ */
+void
+htable_destroy(htable_t *table);
+
+/**
+ * @brief Remove all entries of the hash table
+ *
+ * Stored data is not freed.
+ *
+ * @param table Pointer to an existing hash table
+ */
+void
+htable_clear(htable_t *table);
+
+/**
+ * @brief Insert a new entry in the hash table
+ *
+ * @param table Pointer to an existing hash table
+ * @param key Entry key
+ * @param data Entry data
+ * @return 0 if the entry has been inserted, 1 if the key already exists
+ * or on allocation failure
+ */
+int
+htable_insert(htable_t *table, const char *key, void *data);
+
+/**
+ * @brief Remove an entry from the hash table
+ *
+ * @param table Pointer to an existing hash table
+ * @param key Entry key
+ */
+void
+htable_remove(htable_t *table, const char *key);
+
+/**
+ * @brief Find the data of an entry in the hash table
+ *
+ * @param table Pointer to an existing hash table
+ * @param key Entry key
+ * @return Entry data or NULL if key is not in the table
+ */
+void *
+htable_find(htable_t *table, const char *key);
+
+#endif /* __SNGREP_HASH_H_ */
@@ -0,0 +1,179 @@
+/**************************************************************************
+ **
+ ** sngrep - SIP Messages flow viewer
+ **
+ ** Copyright (C) 2013,2014 Ivan Alonso (Kaian)
+ ** Copyright (C) 2013,2014 Irontec SL. All rights reserved.
+ **
+ ** This program is free software: you can redistribute it and/or modify
+ ** it under the terms of the GNU General Public License as published by
+ ** the Free Software Foundation, either version 3 of the License, or
+ ** (at your option) any later version.
+ **
+ ** This program is distributed in the hope that it will be useful,
+ ** but WITHOUT ANY WARRANTY; without even the implied warranty of
+ ** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ ** GNU General Public License for more details.
+ **
+ ** You should have received a copy of the GNU General Public License
+ ** along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ **
+ ****************************************************************************/
+/**
+ * @file intern.c
+ * @author Ivan Alonso [aka Kaian] <kaian@irontec.com>
+ *
+ * @brief Source of functions defined in intern.h
+ *
+ */
+#include "config.h"
+#include <stdlib.h>
+#include <string.h>
+#include "intern.h"
+
+//! Interned strings table (shard buckets are allocated on first use)
+static intern_shard_t shards[INTERN_SHARDS] = {
+    [0 ... INTERN_SHARDS - 1] = { .lock = PTHREAD_MUTEX_INITIALIZER }
+};
+
+/**
+ * @brief Calculate string hash (FNV-1a)
+ */
+static uint32_t
+intern_hash(const char *str)
+{
+    uint32_t hash = 2166136261U;
+
+    for (; *str; str++) {
+        hash ^= (unsigned char) *str;
+        hash *= 16777619U;
+    }
+    return hash;
+}
+
+/**
+ * @brief Get the shard of a string hash
+ *
+ * Shards are selected using the highest hash bits, the lowest ones are
+ * used to select the bucket inside the shard.
+ */
+static intern_shard_t *
+intern_shard(uint32_t hash)
+{
+    return &shards[hash >> 28 & (INTERN_SHARDS - 1)];
+}
+
+/**
+ * @brief Double the number of buckets of a shard
+ */
+static void
+intern_shard_grow(intern_shard_t *shard)
+{
+    intern_entry_t **buckets, *entry, *next;
+    size_t size = shard->size * 2, i;
+
+    if (!(buckets = calloc(size, sizeof(intern_entry_t *))))
+        return;
+
+    for (i = 0; i < shard->size; i++) {
+        for (entry = shard->buckets[i]; entry; entry = next) {
+            next = entry->next;
+            entry->next = buckets[entry->hash & (size - 1)];
+            buckets[entry->hash & (size - 1)] = entry;
+        }
+    }
+
+    free(shard->buckets);
+    shard->buckets = buckets;
+    shard->size = size;
+}
+
+const char *
+intern_get(const char *str)
+{
+    uint32_t hash = intern_hash(str);
+    intern_shard_t *shard = intern_shard(hash);
+    intern_entry_t *entry, **bucket;
+    size_t len;
+
+    pthread_mutex_lock(&shard->lock);
+
+    // First string of this shard
+    if (!shard->buckets) {
+        if (!(shard->buckets = calloc(INTERN_SHARD_SIZE, sizeof(intern_entry_t *)))) {
+            pthread_mutex_unlock(&shard->lock);
+            return NULL;
+        }
+        shard->size = INTERN_SHARD_SIZE;
+    }
+
+    // Check if string is already interned
+    bucket = &shard->buckets[hash & (shard->size - 1)];
+    for (entry = *bucket; entry; entry = entry->next) {
+        if (entry->hash == hash && !strcmp(entry->value, str)) {
+            entry->refs++;
+            pthread_mutex_unlock(&shard->lock);
+            return entry->value;
+        }
+    }
+
+    // Add a new entry for this string
+    len = strlen(str);
+    if (!(entry = malloc(sizeof(intern_entry_t) + len + 1))) {
+        pthread_mutex_unlock(&shard->lock);
+        return NULL;
+    }
+    entry->hash = hash;
+    entry->refs = 1;
+    memcpy(entry->value, str, len + 1);
+    entry->next = *bucket;
+    *bucket = entry;
+
+    // Keep chains short
+    if (++shard->count > shard->size)
+        intern_shard_grow(shard);
+
+    pthread_mutex_unlock(&shard->lock);
+    return entry->value;
+}
+
+void
+intern_release(const char *str)
+{
+    intern_entry_t *entry, **cur;
+    intern_shard_t *shard;
+
+    if (!str)
+        return;
+
+    entry = (intern_entry_t *) (str - offsetof(intern_entry_t, value));
+    shard = intern_shard(entry->hash);
+
+    pthread_mutex_lock(&shard->lock);
+    if (--entry->refs == 0) {
+        // Last reference, remove it from the table
+        for (cur = &shard->buckets[entry->hash & (shard->size - 1)]; *cur; cur = &(*cur)->next) {
+            if (*cur == entry) {
+                *cur = entry->next;
+                break;
+            }
+        }
+        shard->count--;
+        free(entry);
+    }
+    pthread_mutex_unlock(&shard->lock);
+}
+
+size_t
+intern_count()
+{
+    size_t count = 0;
+    int i;
+
+    for (i = 0; i < INTERN_SHARDS; i++) {
+        pthread_mutex_lock(&shards[i].lock);
+        count += shards[i].count;
+        pthread_mutex_unlock(&shards[i].lock);
+    }
+    return count;
+}
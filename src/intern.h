@@ -0,0 +1,112 @@
+/**************************************************************************
+ **
+ ** sngrep - SIP Messages flow viewer
+ **
+ ** Copyright (C) 2013,2014 Ivan Alonso (Kaian)
+ ** Copyright (C) 2013,2014 Irontec SL. All rights reserved.
+ **
+ ** This program is free software: you can redistribute it and/or modify
+ ** it under the terms of the GNU General Public License as published by
+ ** the Free Software Foundation, either version 3 of the License, or
+ ** (at your option) any later version.
+ **
+ ** This program is distributed in the hope that it will be useful,
+ ** but WITHOUT ANY WARRANTY; without even the implied warranty of
+ ** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ ** GNU General Public License for more details.
+ **
+ ** You should have received a copy of the GNU General Public License
+ ** along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ **
+ ****************************************************************************/
+/**
+ * @file intern.h
+ * @author Ivan Alonso [aka Kaian] <kaian@irontec.com>
+ *
+ * @brief Functions to manage the interned strings table
+ *
+ * Attribute values repeat a lot across a capture (addresses, methods,
+ * users, transports...). Instead of a copy per message, each different
+ * value is stored once in this table and attributes keep a reference to
+ * it, so two interned strings are equal only if they are the same pointer.
+ *
+ * The table is split in shards, each with its own lock, so parsing
+ * threads adding attributes don't wait for each other. Interned strings
+ * are reference counted and removed when they are no longer used.
+ */
+#ifndef __SNGREP_INTERN_H
+#define __SNGREP_INTERN_H
+
+#include "config.h"
+#include <stddef.h>
+#include <stdint.h>
+#include <pthread.h>
+
+//! Number of table shards (power of two)
+#define INTERN_SHARDS 16
+//! Initial number of buckets of each shard (power of two)
+#define INTERN_SHARD_SIZE 1024
+
+//! Shorter declaration of intern_entry structure
+typedef struct intern_entry intern_entry_t;
+//! Shorter declaration of intern_shard structure
+typedef struct intern_shard intern_shard_t;
+
+/**
+ * @brief Interned string
+ */
+struct intern_entry {
+    //! Next entry in the same bucket
+    intern_entry_t *next;
+    //! String hash
+    uint32_t hash;
+    //! Number of references to this string
+    int refs;
+    //! String value
+    char value[];
+};
+
+/**
+ * @brief Part of the table with its own lock
+ */
+struct intern_shard {
+    //! Buckets array
+    intern_entry_t **buckets;
+    //! Number of buckets
+    size_t size;
+    //! Number of stored strings
+    size_t count;
+    //! Protect shard access from capture and interface threads
+    pthread_mutex_t lock;
+};
+
+/**
+ * @brief Get the interned copy of a string
+ *
+ * The string is added to the table if it's not already there. Each call
+ * adds a reference that must be released with intern_release.
+ *
+ * @param str String to intern
+ * @return interned string
+ */
+const char *
+intern_get(const char *str);
+
+/**
+ * @brief Release a reference of an interned string
+ *
+ * The string is removed from the table when its last reference is
+ * released.
+ *
+ * @param str Interned string (as returned by intern_get)
+ */
+void
+intern_release(const char *str);
+
+/**
+ * @brief Get the number of different interned strings
+ */
+size_t
+intern_count();
+
+#endif /* __SNGREP_INTERN_H */
@@ -35,6 +35,10 @@
 #include "option.h"
 #include "ui_manager.h"
 #include "capture.h"
+#include "capture_bpf.h"
+#include "batch.h"
+#include "spool.h"
+#include "trace.h"
 #ifdef WITH_OPENSSL
 #include "capture_tls.h"
 #endif
@@ -47,7 +51,7 @@
 void
 usage()
 {
-    printf("Usage: %s [-hVciv] [-IO pcap_dump] [-d dev] [-l limit]"
+    printf("Usage: %s [-hVcivN] [-IO pcap_dump] [-d dev] [-l limit] [-F format] [-H headers]"
 #ifdef WITH_OPENSSL
            " [-k keyfile]"
 #endif
@@ -61,6 +65,9 @@ usage()
            "    -l --limit\t\t Set capture limit to N dialogs\n"
            "    -i --icase\t\t Make <match expression> case insensitive\n"
            "    -v --invert\t\t Invert <match expression>\n"
+           "    -H --headers\t Check <match expression> only in these headers (comma separated)\n"
+           "    -N --no-interface\t Don't display interface, write finished dialogs to stdout\n"
+           "    -F --format\t\t Output format without interface: json or csv\n"
 #ifdef WITH_OPENSSL
            "    -k  RSA private keyfile to decrypt captured packets\n"
 #endif
@@ -99,10 +106,11 @@ main(int argc, char* argv[])
 {
     int opt, idx, limit, i;
     const char *device, *infile, *outfile;
-    char bpf[512];
+    char bpf[512] = "";
     const char *keyfile;
     const char *match_expr;
-    int match_insensitive = 0, match_invert = 0;
+    const char *format;
+    int match_insensitive = 0, match_invert = 0, no_interface = 0, ret;
 
     // Program otptions
     static struct option long_options[] = {
@@ -116,6 +124,10 @@ main(int argc, char* argv[])
         { "limit", no_argument, 0, 'l' },
         { "icase", no_argument, 0, 'i' },
         { "invert", no_argument, 0, 'v' },
+        { "headers", required_argument, 0, 'H' },
+        { "no-interface", no_argument, 0, 'N' },
+        { "format", required_argument, 0, 'F' },
+        { 0, 0, 0, 0 }
     };
 
     // Initialize configuration options
@@ -127,10 +139,11 @@ main(int argc, char* argv[])
     outfile = get_option_value("capture.outfile");
     keyfile = get_option_value("capture.keyfile");
     limit = get_option_int_value("capture.limit");
+    format = get_option_value("batch.format");
 
     // Parse command line arguments
     opterr = 0;
-    char *options = "hVd:I:O:pqtW:k:cl:iv";
+    char *options = "hVd:I:O:pqtW:k:cl:ivH:NF:";
     while ((opt = getopt_long(argc, argv, options, long_options, &idx)) != -1) {
         switch (opt) {
             case 'h':
@@ -166,6 +179,15 @@ main(int argc, char* argv[])
             case 'v':
                 match_invert++;
                 break;
+            case 'H':
+                set_option_value("sip.matchheaders", optarg);
+                break;
+            case 'N':
+                no_interface = 1;
+                break;
+            case 'F':
+                format = optarg;
+                break;
             // Dark options for dummy ones
             case 'p':
             case 'q':
@@ -203,6 +225,11 @@ main(int argc, char* argv[])
         return 0;
     }
 
+#ifdef WITH_TRACING
+    // Dump stage latencies on SIGUSR1 (before starting other threads)
+    trace_init();
+#endif
+
     // Initialize SIP Messages Storage
     sip_init(limit);
 
@@ -255,6 +282,23 @@ main(int argc, char* argv[])
             }
     }
 
+    // Build the capture filter from configuration if none has been given
+    if (!infile && !bpf[0] && is_option_enabled("capture.autobpf")) {
+        if (capture_bpf_install() != 0) {
+            fprintf(stderr, "Couldn't install automatic filter: %s\n", capture_last_error());
+            return 1;
+        }
+    }
+
+    // Without interface, write dialogs until capture ends
+    if (no_interface) {
+        ret = batch_run(format, limit);
+        capture_close();
+        deinit_options();
+        sip_calls_clear();
+        return ret;
+    }
+
     // Initialize interface
     init_interface();
 
@@ -281,6 +325,9 @@ main(int argc, char* argv[])
     // Deallocate sip stored messages
     sip_calls_clear();
 
+    // Remove spooled messages
+    spool_close();
+
     // Leaving!
     return 0;
 }
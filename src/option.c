@@ -32,6 +32,7 @@
 #include <string.h>
 #include <time.h>
 #include "option.h"
+#include "intern.h"
 
 /**
  * @brief Configuration options array
@@ -75,6 +76,10 @@ init_options()
     set_option_value("cl.scrollstep", "10");
     set_option_value("cl.defexitbutton", "1");
 
+    // Set call list default order
+    set_option_value("cl.sortfield", "index");
+    set_option_value("cl.sortorder", "asc");
+
     // Raw options for Call flow screen
     set_option_value("cf.forceraw", "on");
     set_option_value("cf.rawminwidth", "40");
@@ -87,13 +92,36 @@ init_options()
     // Allow dialogs to be incomplete
     set_option_value("sip.ignoreincomlete", "on");
 
+    // Check match expression against the whole payload
+    set_option_value("sip.matchheaders", "");
+
     // Set default save file location
     set_option_value("sngrep.savepath", home);
 
+    // Set max screen redraws per second when new data arrives
+    set_option_value("sngrep.refreshrate", "5");
+
+    // Set default options without interface
+    set_option_value("batch.format", "json");
+    set_option_value("batch.timeout", "32");
+    set_option_value("batch.linger", "2");
+
     // Set default capture options
     set_option_value("capture.limit", "50000");
     set_option_value("capture.device", "any");
     set_option_value("capture.lookup", "off");
+    set_option_value("capture.threads", "0");
+    set_option_value("capture.index", "off");
+    set_option_value("capture.spool", "off");
+    set_option_value("capture.spoolcache", "32");
+    set_option_value("capture.outformat", "pcap");
+    set_option_value("capture.rotatesize", "0");
+    set_option_value("capture.rotatetime", "0");
+    set_option_value("capture.rtp", "off");
+    set_option_value("capture.rtptimeout", "60");
+    set_option_value("capture.autobpf", "off");
+    set_option_value("capture.sipports", "5060");
+    set_option_value("capture.autobpfinterval", "1");
 
     // Set default filter options
     set_option_value("filter.enable", "off");
@@ -130,6 +158,8 @@ deinit_options()
     for (i = 0; i < optscnt; i++) {
         free(options[i].opt);
         free(options[i].value);
+        if (options[i].type == IGNORE)
+            intern_release(options[i].ivalue);
     }
 }
 
@@ -257,6 +287,7 @@ set_ignore_value(const char *opt, const char *value)
     options[optscnt].type = IGNORE;
     options[optscnt].opt = strdup(opt);
     options[optscnt].value = strdup(value);
+    options[optscnt].ivalue = intern_get(value);
     optscnt++;
 }
 
@@ -274,13 +305,27 @@ is_ignored_value(const char *field, const char *fvalue)
 {
     int i;
     for (i = 0; i < optscnt; i++) {
-        if (!strcasecmp(options[i].opt, field) && !strcasecmp(options[i].value, fvalue)) {
+        if (options[i].type != IGNORE || !fvalue || strcasecmp(options[i].opt, field))
+            continue;
+        // Attribute values are interned, so equal values are the same pointer
+        if (fvalue == options[i].ivalue || !strcasecmp(options[i].value, fvalue)) {
             return 1;
         }
     }
     return 0;
 }
 
+const option_opt_t *
+get_ignore_option(int idx)
+{
+    int i;
+    for (i = 0; i < optscnt; i++) {
+        if (options[i].type == IGNORE && idx-- == 0)
+            return &options[i];
+    }
+    return NULL;
+}
+
 void
 toggle_option(const char *option)
 {
@@ -63,6 +63,8 @@ struct config_option {
     char *opt;
     //! Value of attribute
     char *value;
+    //! Interned value of attribute (for ignore directives)
+    const char *ivalue;
 };
 
 /**
@@ -204,6 +206,15 @@ is_option_disabled(const char *opt);
 int
 is_ignored_value(const char *field, const char *fvalue);
 
+/**
+ * @brief Get an ignore directive by its position
+ *
+ * @param idx Position of the directive, counting only ignore directives
+ * @return ignore directive or NULL if there are no more directives
+ */
+const option_opt_t *
+get_ignore_option(int idx);
+
 /**
  * @brief Toggle a boolean option
  *
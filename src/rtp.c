@@ -0,0 +1,527 @@
+/**************************************************************************
+ **
+ ** sngrep - SIP Messages flow viewer
+ **
+ ** Copyright (C) 2013,2014 Ivan Alonso (Kaian)
+ ** Copyright (C) 2013,2014 Irontec SL. All rights reserved.
+ **
+ ** This program is free software: you can redistribute it and/or modify
+ ** it under the terms of the GNU General Public License as published by
+ ** the Free Software Foundation, either version 3 of the License, or
+ ** (at your option) any later version.
+ **
+ ** This program is distributed in the hope that it will be useful,
+ ** but WITHOUT ANY WARRANTY; without even the implied warranty of
+ ** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ ** GNU General Public License for more details.
+ **
+ ** You should have received a copy of the GNU General Public License
+ ** along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ **
+ ****************************************************************************/
+/**
+ * @file rtp.c
+ * @author Ivan Alonso [aka Kaian] <kaian@irontec.com>
+ *
+ * @brief Source of functions defined in rtp.h
+ *
+ */
+#include "config.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "option.h"
+#include "rtp.h"
+
+//! Max number of media read from a single SDP
+#define RTP_MAX_MEDIA 8
+
+/**
+ * @brief Media read from SDP
+ */
+struct rtp_sdp_media {
+    //! Media connection address
+    struct in_addr addr;
+    //! Media port
+    int port;
+    //! Media uses RTP profile
+    int rtp;
+    //! Media formats
+    rtp_format_t formats[RTP_MAX_FORMATS];
+    //! Number of media formats
+    int fmtcnt;
+};
+
+//! Static payload types (RFC 3551)
+static rtp_format_t rtp_static_formats[] = {
+    { 0, "PCMU", 8000 },
+    { 3, "GSM", 8000 },
+    { 4, "G723", 8000 },
+    { 8, "PCMA", 8000 },
+    { 9, "G722", 8000 },
+    { 13, "CN", 8000 },
+    { 18, "G729", 8000 },
+    { 26, "JPEG", 90000 },
+    { 31, "H261", 90000 },
+    { 34, "H263", 90000 },
+};
+
+//! capture.rtp option value (-1 if not checked yet)
+static int rtp_enabled = -1;
+//! Expected media table
+static rtp_stream_t *rtp_table[RTP_HASH_SIZE];
+//! Expected media table version, increased every time it changes
+static int rtp_version;
+//! capture.rtptimeout option value (-1 if not checked yet)
+static int rtp_timeout = -1;
+//! Last time idle streams were expired
+static time_t rtp_expired;
+//! Protect table and streams from capture and interface threads
+static pthread_mutex_t rtp_lock = PTHREAD_MUTEX_INITIALIZER;
+
+int
+rtp_is_enabled()
+{
+    if (rtp_enabled == -1)
+        rtp_enabled = is_option_enabled("capture.rtp");
+    return rtp_enabled;
+}
+
+/**
+ * @brief Get expected media table bucket of an address and port
+ */
+static unsigned int
+rtp_hash(struct in_addr addr, u_short port)
+{
+    uint32_t key = addr.s_addr ^ ((uint32_t) port * 2654435761U);
+    return (key ^ (key >> 16)) % RTP_HASH_SIZE;
+}
+
+/**
+ * @brief Find the stream expected at an address and port
+ */
+static rtp_stream_t *
+rtp_find(struct in_addr addr, u_short port)
+{
+    rtp_stream_t *stream;
+
+    for (stream = rtp_table[rtp_hash(addr, port)]; stream; stream = stream->hnext) {
+        if (stream->dport == port && stream->dst.s_addr == addr.s_addr)
+            return stream;
+    }
+    return NULL;
+}
+
+/**
+ * @brief Remove a stream from the expected media table
+ */
+static void
+rtp_hash_remove(rtp_stream_t *stream)
+{
+    rtp_stream_t **cur;
+
+    for (cur = &rtp_table[rtp_hash(stream->dst, stream->dport)]; *cur; cur = &(*cur)->hnext) {
+        if (*cur == stream) {
+            *cur = stream->hnext;
+            break;
+        }
+    }
+    stream->hashed = 0;
+    stream->hnext = NULL;
+    rtp_version++;
+}
+
+/**
+ * @brief Add a stream to the expected media table
+ */
+static void
+rtp_hash_add(rtp_stream_t *stream)
+{
+    stream->hnext = rtp_table[rtp_hash(stream->dst, stream->dport)];
+    rtp_table[rtp_hash(stream->dst, stream->dport)] = stream;
+    stream->hashed = 1;
+    rtp_version++;
+}
+
+/**
+ * @brief Get a negotiated or static format for a payload type
+ */
+static const rtp_format_t *
+rtp_get_format(rtp_stream_t *stream, int pt)
+{
+    int i;
+
+    for (i = 0; i < stream->fmtcnt; i++) {
+        if (stream->formats[i].pt == pt)
+            return &stream->formats[i];
+    }
+    for (i = 0; i < sizeof(rtp_static_formats) / sizeof(rtp_format_t); i++) {
+        if (rtp_static_formats[i].pt == pt)
+            return &rtp_static_formats[i];
+    }
+    return NULL;
+}
+
+/**
+ * @brief Add or update the stream of a SDP media
+ */
+static void
+rtp_add_media(sip_msg_t *msg, struct rtp_sdp_media *media)
+{
+    rtp_stream_t *stream, *last;
+    u_short port = htons(media->port);
+
+    pthread_mutex_lock(&rtp_lock);
+
+    // Same media in a new offer or answer of the call
+    if ((stream = rtp_find(media->addr, port)) && stream->msg->call == msg->call) {
+        stream->msg = msg;
+        memcpy(stream->formats, media->formats, sizeof(rtp_format_t) * media->fmtcnt);
+        stream->fmtcnt = media->fmtcnt;
+        pthread_mutex_unlock(&rtp_lock);
+        return;
+    }
+
+    // Address and port are now used by other call
+    if (stream)
+        rtp_hash_remove(stream);
+
+    // Same media of an ended or idle stream of the call
+    for (stream = msg->call->streams; stream; stream = stream->next) {
+        if (stream->dport == port && stream->dst.s_addr == media->addr.s_addr)
+            break;
+    }
+    if (stream) {
+        stream->msg = msg;
+        memcpy(stream->formats, media->formats, sizeof(rtp_format_t) * media->fmtcnt);
+        stream->fmtcnt = media->fmtcnt;
+        rtp_hash_add(stream);
+        pthread_mutex_unlock(&rtp_lock);
+        return;
+    }
+
+    stream = malloc(sizeof(rtp_stream_t));
+    memset(stream, 0, sizeof(rtp_stream_t));
+    stream->dst = media->addr;
+    stream->dport = port;
+    stream->msg = msg;
+    stream->pt = -1;
+    memcpy(stream->formats, media->formats, sizeof(rtp_format_t) * media->fmtcnt);
+    stream->fmtcnt = media->fmtcnt;
+
+    // Add to the expected media table
+    rtp_hash_add(stream);
+
+    // Add at the end of call streams
+    if (!msg->call->streams) {
+        msg->call->streams = stream;
+    } else {
+        for (last = msg->call->streams; last->next; last = last->next)
+            ;
+        last->next = stream;
+    }
+
+    pthread_mutex_unlock(&rtp_lock);
+}
+
+void
+rtp_add_sdp(sip_msg_t *msg)
+{
+    struct rtp_sdp_media medias[RTP_MAX_MEDIA], *media = NULL;
+    struct in_addr sessaddr = { 0 }, addr;
+    const char *payload, *body, *line, *next;
+    char text[256], value[64], *token, *save;
+    rtp_format_t *format;
+    int i, len, pt, rate, count = 0;
+
+    if (!rtp_is_enabled() || !msg->call || !(payload = msg_get_payload(msg)))
+        return;
+
+    // SDP starts after SIP headers
+    if (!(body = strstr(payload, "\r\n\r\n")))
+        return;
+
+    for (line = body + 4; *line; line = next) {
+        // Get next SDP line
+        if ((next = strchr(line, '\n'))) {
+            len = next++ - line;
+        } else {
+            len = strlen(line);
+            next = line + len;
+        }
+        if (len >= sizeof(text))
+            len = sizeof(text) - 1;
+        memcpy(text, line, len);
+        text[len] = '\0';
+        if (len && text[len - 1] == '\r')
+            text[len - 1] = '\0';
+
+        if (!strncmp(text, "c=", 2)) {
+            // Connection address of the session or the current media
+            if (sscanf(text, "c=IN IP4 %63[^ /]", value) != 1 || !inet_aton(value, &addr))
+                continue;
+            if (media) {
+                media->addr = addr;
+            } else {
+                sessaddr = addr;
+            }
+        } else if (!strncmp(text, "m=", 2)) {
+            // New media description
+            if (count == RTP_MAX_MEDIA) {
+                media = NULL;
+                break;
+            }
+            media = &medias[count++];
+            memset(media, 0, sizeof(struct rtp_sdp_media));
+            media->addr = sessaddr;
+
+            // Media name, port, protocol and formats
+            strtok_r(text, " ", &save);
+            if (!(token = strtok_r(NULL, " ", &save)))
+                continue;
+            media->port = atoi(token);
+            if (!(token = strtok_r(NULL, " ", &save)))
+                continue;
+            media->rtp = !strncmp(token, "RTP/", 4);
+            while ((token = strtok_r(NULL, " ", &save)) && media->fmtcnt < RTP_MAX_FORMATS) {
+                format = &media->formats[media->fmtcnt++];
+                format->pt = atoi(token);
+                // Static payload types don't require a rtpmap attribute
+                for (i = 0; i < sizeof(rtp_static_formats) / sizeof(rtp_format_t); i++) {
+                    if (rtp_static_formats[i].pt == format->pt)
+                        *format = rtp_static_formats[i];
+                }
+            }
+        } else if (media && sscanf(text, "a=rtpmap:%d %63[^/]/%d", &pt, value, &rate) == 3) {
+            // Encoding of a dynamic or static format
+            for (i = 0; i < media->fmtcnt; i++) {
+                if (media->formats[i].pt == pt) {
+                    snprintf(media->formats[i].name, sizeof(media->formats[i].name), "%.15s", value);
+                    media->formats[i].rate = rate;
+                }
+            }
+        }
+    }
+
+    // Add each RTP media with a valid port
+    for (i = 0; i < count; i++) {
+        if (medias[i].rtp && medias[i].port > 0 && medias[i].port < 65536 && medias[i].addr.s_addr)
+            rtp_add_media(msg, &medias[i]);
+    }
+}
+
+/**
+ * @brief Update stream sequence counters with a new packet
+ */
+static void
+rtp_stream_update_seq(rtp_stream_t *stream, uint16_t seq, uint32_t ssrc)
+{
+    uint16_t udelta = seq - stream->max_seq;
+
+    if (!stream->pktcnt || ssrc != stream->ssrc
+        || (udelta >= RTP_MAX_DROPOUT && udelta <= 65536 - RTP_MAX_MISORDER)) {
+        // New source or sequence restart
+        if (stream->pktcnt) {
+            stream->prior_expected += stream->cycles + stream->max_seq - stream->base_seq + 1;
+            stream->prior_received += stream->received;
+        }
+        stream->ssrc = ssrc;
+        stream->base_seq = stream->max_seq = seq;
+        stream->cycles = 0;
+        stream->received = 0;
+        stream->jitter = 0;
+        stream->transit = 0;
+    } else if (udelta < RTP_MAX_DROPOUT) {
+        // In order, with permissible gap
+        if (seq < stream->max_seq)
+            stream->cycles += 65536;
+        stream->max_seq = seq;
+    }
+
+    // Duplicated and reordered packets are only counted as received
+    stream->received++;
+}
+
+rtp_stream_t *
+rtp_check_packet(struct timeval ts, struct in_addr dst, u_short dport, struct in_addr src,
+                 u_short sport, const u_char *payload, int len)
+{
+    rtp_stream_t *stream;
+    const rtp_format_t *format;
+    uint32_t rtpts, ssrc, arrival;
+    int32_t transit, d;
+    int pt, rate, newsrc;
+
+    // Check RTP version
+    if (len < 12 || (payload[0] >> 6) != 2)
+        return NULL;
+
+    // RTCP packet types (200-204) are not counted
+    pt = payload[1] & 0x7f;
+    if (pt >= 72 && pt <= 76)
+        return NULL;
+
+    pthread_mutex_lock(&rtp_lock);
+    if (!(stream = rtp_find(dst, dport))) {
+        pthread_mutex_unlock(&rtp_lock);
+        return NULL;
+    }
+
+    rtpts = ntohl(*(uint32_t *) (payload + 4));
+    ssrc = ntohl(*(uint32_t *) (payload + 8));
+
+    // First packet of the stream
+    if (!stream->pktcnt) {
+        stream->src = src;
+        stream->sport = sport;
+        stream->first = ts;
+    }
+    newsrc = (!stream->pktcnt || ssrc != stream->ssrc);
+
+    rtp_stream_update_seq(stream, ntohs(*(uint16_t *) (payload + 2)), ssrc);
+    stream->pktcnt++;
+    stream->last = ts;
+    stream->pt = pt;
+
+    // Update interarrival jitter using arrival time in timestamp units
+    rate = ((format = rtp_get_format(stream, pt)) && format->rate > 0) ? format->rate : 8000;
+    arrival = (uint32_t) ts.tv_sec * rate + (uint32_t) ((uint64_t) ts.tv_usec * rate / 1000000);
+    transit = arrival - rtpts;
+    if (!newsrc && stream->received > 1) {
+        d = transit - stream->transit;
+        if (d < 0)
+            d = -d;
+        stream->jitter += (d - stream->jitter) / 16.0;
+    }
+    stream->transit = transit;
+
+    pthread_mutex_unlock(&rtp_lock);
+    return stream;
+}
+
+void
+rtp_call_ended(sip_call_t *call)
+{
+    rtp_stream_t *stream;
+
+    pthread_mutex_lock(&rtp_lock);
+    for (stream = call->streams; stream; stream = stream->next) {
+        if (stream->hashed)
+            rtp_hash_remove(stream);
+    }
+    pthread_mutex_unlock(&rtp_lock);
+}
+
+void
+rtp_expire(time_t now)
+{
+    rtp_stream_t *stream, *next;
+    time_t active;
+    int i;
+
+    if (rtp_timeout == -1)
+        rtp_timeout = get_option_int_value("capture.rtptimeout");
+
+    // Check the table once per second
+    if (rtp_timeout <= 0 || now == rtp_expired)
+        return;
+    rtp_expired = now;
+
+    pthread_mutex_lock(&rtp_lock);
+    for (i = 0; i < RTP_HASH_SIZE; i++) {
+        for (stream = rtp_table[i]; stream; stream = next) {
+            next = stream->hnext;
+            // Last received packet or last SDP announcing the stream
+            active = stream->msg->ts.tv_sec;
+            if (stream->pktcnt && stream->last.tv_sec > active)
+                active = stream->last.tv_sec;
+            if (now - active >= rtp_timeout)
+                rtp_hash_remove(stream);
+        }
+    }
+    pthread_mutex_unlock(&rtp_lock);
+}
+
+int
+rtp_expected_version()
+{
+    return rtp_version;
+}
+
+int
+rtp_get_expected(struct in_addr *addrs, u_short *ports, int max)
+{
+    rtp_stream_t *stream;
+    int i, count = 0;
+
+    pthread_mutex_lock(&rtp_lock);
+    for (i = 0; i < RTP_HASH_SIZE; i++) {
+        for (stream = rtp_table[i]; stream; stream = stream->hnext) {
+            if (count < max) {
+                addrs[count] = stream->dst;
+                ports[count] = stream->dport;
+            }
+            count++;
+        }
+    }
+    pthread_mutex_unlock(&rtp_lock);
+
+    return count;
+}
+
+void
+rtp_stream_list_destroy(rtp_stream_t *list)
+{
+    rtp_stream_t *next;
+
+    pthread_mutex_lock(&rtp_lock);
+    for (; list; list = next) {
+        next = list->next;
+        if (list->hashed)
+            rtp_hash_remove(list);
+        free(list);
+    }
+    pthread_mutex_unlock(&rtp_lock);
+}
+
+const char *
+rtp_stream_codec(rtp_stream_t *stream, char *name)
+{
+    const rtp_format_t *format = NULL;
+    int pt = stream->pt;
+
+    // Without packets, use the preferred negotiated format
+    if (pt == -1 && stream->fmtcnt)
+        pt = stream->formats[0].pt;
+
+    if ((format = rtp_get_format(stream, pt)) && format->name[0]) {
+        sprintf(name, "%.15s", format->name);
+    } else {
+        sprintf(name, "PT%d", pt);
+    }
+    return name;
+}
+
+int
+rtp_stream_expected(rtp_stream_t *stream)
+{
+    if (!stream->pktcnt)
+        return 0;
+    return stream->prior_expected + stream->cycles + stream->max_seq - stream->base_seq + 1;
+}
+
+int
+rtp_stream_lost(rtp_stream_t *stream)
+{
+    int lost = rtp_stream_expected(stream) - stream->prior_received - stream->received;
+    return (lost > 0) ? lost : 0;
+}
+
+double
+rtp_stream_jitter(rtp_stream_t *stream)
+{
+    const rtp_format_t *format;
+    int rate = ((format = rtp_get_format(stream, stream->pt)) && format->rate > 0) ? format->rate : 8000;
+
+    return stream->jitter * 1000.0 / rate;
+}
@@ -0,0 +1,249 @@
+/**************************************************************************
+ **
+ ** sngrep - SIP Messages flow viewer
+ **
+ ** Copyright (C) 2013,2014 Ivan Alonso (Kaian)
+ ** Copyright (C) 2013,2014 Irontec SL. All rights reserved.
+ **
+ ** This program is free software: you can redistribute it and/or modify
+ ** it under the terms of the GNU General Public License as published by
+ ** the Free Software Foundation, either version 3 of the License, or
+ ** (at your option) any later version.
+ **
+ ** This program is distributed in the hope that it will be useful,
+ ** but WITHOUT ANY WARRANTY; without even the implied warranty of
+ ** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ ** GNU General Public License for more details.
+ **
+ ** You should have received a copy of the GNU General Public License
+ ** along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ **
+ ****************************************************************************/
+/**
+ * @file rtp.h
+ * @author Ivan Alonso [aka Kaian] <kaian@irontec.com>
+ *
+ * @brief Functions to detect and measure RTP streams
+ *
+ * When capture.rtp option is enabled, the SDP of every message is used to
+ * fill a table of expected media destinations (address and port) and the
+ * call that negotiated them. Captured UDP packets that are not SIP are
+ * checked against this table with a single hash lookup.
+ *
+ * Streams are removed from the expected media table when their call ends
+ * or when no packet has been received for capture.rtptimeout seconds, but
+ * they are kept in their call with their counters.
+ *
+ * RTP payloads are not stored. Each stream only keeps counters: received
+ * packets, lost packets (from sequence numbers, as RFC 3550 A.1) and
+ * interarrival jitter (RFC 3550 A.8), along with the negotiated codecs.
+ */
+#ifndef __SNGREP_RTP_H
+#define __SNGREP_RTP_H
+
+#include "config.h"
+#include <stdint.h>
+#include <sys/time.h>
+#include <pthread.h>
+#include <arpa/inet.h>
+#include "sip.h"
+
+//! Number of buckets of the expected media table
+#define RTP_HASH_SIZE 4096
+//! Max number of formats stored for each stream
+#define RTP_MAX_FORMATS 16
+//! Max sequence jump considered in order (RFC 3550 A.1)
+#define RTP_MAX_DROPOUT 3000
+//! Max sequence decrease considered reordering (RFC 3550 A.1)
+#define RTP_MAX_MISORDER 100
+
+//! Shorter declaration of rtp_stream structure
+typedef struct rtp_stream rtp_stream_t;
+//! Shorter declaration of rtp_format structure
+typedef struct rtp_format rtp_format_t;
+
+/**
+ * @brief Payload format negotiated in SDP
+ */
+struct rtp_format {
+    //! RTP payload type
+    int pt;
+    //! Encoding name
+    char name[16];
+    //! Clock rate
+    int rate;
+};
+
+/**
+ * @brief Media stream expected from SDP and its counters
+ */
+struct rtp_stream {
+    //! Media destination address announced in SDP
+    struct in_addr dst;
+    //! Media destination port announced in SDP (network byte order)
+    u_short dport;
+    //! Source address of the first received packet
+    struct in_addr src;
+    //! Source port of the first received packet (network byte order)
+    u_short sport;
+    //! Last message with SDP announcing this stream
+    sip_msg_t *msg;
+    //! Formats negotiated in SDP
+    rtp_format_t formats[RTP_MAX_FORMATS];
+    //! Number of negotiated formats
+    int fmtcnt;
+    //! Payload type of the last received packet
+    int pt;
+    //! Time of first received packet
+    struct timeval first;
+    //! Time of last received packet
+    struct timeval last;
+    //! Received packets
+    int pktcnt;
+    //! Current synchronization source
+    uint32_t ssrc;
+    //! First sequence number of current source
+    uint16_t base_seq;
+    //! Highest sequence number of current source
+    uint16_t max_seq;
+    //! Sequence number cycles of current source
+    uint32_t cycles;
+    //! Received packets of current source
+    int received;
+    //! Expected packets of previous sources
+    int prior_expected;
+    //! Received packets of previous sources
+    int prior_received;
+    //! Relative transit time of last packet (in timestamp units)
+    int32_t transit;
+    //! Interarrival jitter (in timestamp units)
+    double jitter;
+    //! Stream is in the expected media table
+    int hashed;
+    //! Next stream in the expected media table bucket
+    rtp_stream_t *hnext;
+    //! Next stream of the same call
+    rtp_stream_t *next;
+};
+
+/**
+ * @brief Check if RTP detection is enabled
+ *
+ * @return 1 if capture.rtp option is enabled, 0 otherwise
+ */
+int
+rtp_is_enabled();
+
+/**
+ * @brief Add the streams announced in a message SDP
+ *
+ * Each media in SDP with a valid port is added to the message call and
+ * to the expected media table. If the same address and port were already
+ * expected for the call, the stream is updated keeping its counters.
+ *
+ * @param msg SIP message with SDP, already added to its call
+ */
+void
+rtp_add_sdp(sip_msg_t *msg);
+
+/**
+ * @brief Account a captured UDP packet if it belongs to a stream
+ *
+ * @param ts Packet capture time
+ * @param dst Packet destination address
+ * @param dport Packet destination port (network byte order)
+ * @param src Packet source address
+ * @param sport Packet source port (network byte order)
+ * @param payload UDP payload
+ * @param len UDP payload length
+ * @return stream of the packet or NULL if it's not expected RTP
+ */
+rtp_stream_t *
+rtp_check_packet(struct timeval ts, struct in_addr dst, u_short dport, struct in_addr src,
+                 u_short sport, const u_char *payload, int len);
+
+/**
+ * @brief Stop expecting the streams of a call
+ *
+ * Call has ended, so its media destinations can be reused and removed
+ * from the capture filter.
+ *
+ * @param call Ended call
+ */
+void
+rtp_call_ended(sip_call_t *call);
+
+/**
+ * @brief Remove idle streams from the expected media table
+ *
+ * Streams without packets or SDP in the last capture.rtptimeout seconds
+ * are no longer expected. The table is checked at most once per second.
+ *
+ * @param now Current capture time
+ */
+void
+rtp_expire(time_t now);
+
+/**
+ * @brief Get expected media table version
+ *
+ * Version changes every time a stream is added to or removed from the
+ * expected media table.
+ *
+ * @return current table version
+ */
+int
+rtp_expected_version();
+
+/**
+ * @brief Get the addresses and ports of expected streams
+ *
+ * @param addrs Array to store expected addresses
+ * @param ports Array to store expected ports (network byte order)
+ * @param max Size of addrs and ports arrays
+ * @return number of expected streams (it can be greater than max)
+ */
+int
+rtp_get_expected(struct in_addr *addrs, u_short *ports, int max);
+
+/**
+ * @brief Free a call streams list
+ *
+ * Streams are also removed from the expected media table.
+ *
+ * @param list First stream of the list
+ */
+void
+rtp_stream_list_destroy(rtp_stream_t *list);
+
+/**
+ * @brief Get the codec name of a stream
+ *
+ * Codec of the last received packet or the first negotiated one.
+ *
+ * @param stream RTP stream
+ * @param name Buffer to store the name (at least 16 bytes)
+ * @return name
+ */
+const char *
+rtp_stream_codec(rtp_stream_t *stream, char *name);
+
+/**
+ * @brief Get the number of lost packets of a stream
+ */
+int
+rtp_stream_lost(rtp_stream_t *stream);
+
+/**
+ * @brief Get the number of expected packets of a stream
+ */
+int
+rtp_stream_expected(rtp_stream_t *stream);
+
+/**
+ * @brief Get the interarrival jitter of a stream in milliseconds
+ */
+double
+rtp_stream_jitter(rtp_stream_t *stream);
+
+#endif /* __SNGREP_RTP_H */
@@ -38,12 +38,16 @@
 #include <string.h>
 #include <stdio.h>
 #include <time.h>
+#include <ctype.h>
 #include <pthread.h>
-#include <search.h>
 #include "sip.h"
 #include "option.h"
 #include "capture.h"
 #include "filter.h"
+#include "spool.h"
+#include "stats.h"
+#include "rtp.h"
+#include "trace.h"
 
 /**
  * @brief Linked list of parsed calls
@@ -60,7 +64,7 @@ sip_init(int limit)
     calls.limit = limit;
 
     // Create hash table for callid search
-    hcreate(calls.limit);
+    calls.callids = htable_create(calls.limit);
 
     // Initialize calls lock
     pthread_mutexattr_t attr;
@@ -71,6 +75,10 @@ sip_init(int limit)
     pthread_mutexattr_settype(&attr, PTHREAD_MUTEX_RECURSIVE_NP);
 #endif
     pthread_mutex_init(&calls.lock, &attr);
+
+    // Initialize sorted calls list
+    sip_sort_init(&calls.sort, sip_attr_from_name(get_option_value("cl.sortfield")),
+                  !is_option_value("cl.sortorder", "desc"));
 }
 
 sip_msg_t *
@@ -82,7 +90,7 @@ sip_msg_create(const char *payload)
         return NULL;
     memset(msg, 0, sizeof(sip_msg_t));
     msg->attrs = NULL;
-    msg->payload = strdup(payload);
+    msg->payload = (payload) ? strdup(payload) : NULL;
     msg->color = 0;
     return msg;
 }
@@ -95,6 +103,9 @@ sip_msg_destroy(sip_msg_t *msg)
     if (!msg)
         return;
 
+    // Remove the message from the payload cache
+    spool_remove(msg);
+
     // If the message belongs to a call, remove it from
     // its message list
     if (msg->call) {
@@ -123,12 +134,12 @@ sip_msg_destroy(sip_msg_t *msg)
 }
 
 sip_call_t *
-sip_call_create(char *callid)
+sip_call_create(const char *callid)
 {
-    ENTRY entry;
     // Initialize a new call structure
     sip_call_t *call = malloc(sizeof(sip_call_t));
     memset(call, 0, sizeof(sip_call_t));
+    call->callid = strdup(callid);
 
     if (!calls.count) {
         calls.first = call;
@@ -140,16 +151,21 @@ sip_call_create(char *callid)
     calls.count++;
 
     // Store this call in hash table
-    entry.key = strdup(callid);
-    entry.data = (void *) call;
-    hsearch(entry, ENTER);
+    htable_insert(calls.callids, call->callid, call);
 
     // Initialize call filter status
     call->filtered = -1;
 
     // Store current call Index
+    call->index = calls.count;
     call_set_attribute(call, SIP_ATTR_CALLINDEX, "%d", calls.count);
 
+    // Metrics not calculated yet
+    call->pdd = call->tta = call->convdur = call->totaldur = -1;
+
+    // Add the call to the sorted calls list
+    sip_sort_insert(&calls.sort, call);
+
     return call;
 }
 
@@ -175,6 +191,15 @@ sip_call_destroy(sip_call_t *call)
     // Update call counter
     calls.count--;
 
+    // Remove this call from sorted calls list
+    sip_sort_remove(&calls.sort, call);
+
+    // Remove this call from hash table
+    htable_remove(calls.callids, call->callid);
+
+    // Remove all RTP streams
+    rtp_stream_list_destroy(call->streams);
+
     // Remove all messages
     while (call->msgs)
         sip_msg_destroy(call->msgs);
@@ -183,6 +208,7 @@ sip_call_destroy(sip_call_t *call)
     sip_attr_list_destroy(call->attrs);
 
     // Free it!
+    free(call->callid);
     free(call);
 }
 
@@ -190,10 +216,10 @@ char *
 sip_get_callid(const char* payload)
 {
     char *body = strdup(payload);
-    char *pch, *callid = NULL;
+    char *pch, *save, *callid = NULL;
     char value[256];
 
-    for (pch = strtok(body, "\n"); pch; pch = strtok(NULL, "\n")) {
+    for (pch = strtok_r(body, "\n", &save); pch; pch = strtok_r(NULL, "\n", &save)) {
         if (!strncasecmp(pch, "Call-ID", 7)) {
             if (sscanf(pch, "Call-ID: %[^@\r\n]", value) == 1) {
                 callid = strdup(value);
@@ -204,14 +230,115 @@ sip_get_callid(const char* payload)
     return callid;
 }
 
+//! Shortest valid start line ("ACK x SIP/2.0\n")
+#define SIP_MIN_START_LINE      14
+//! Longest checked method token
+#define SIP_MAX_METHOD          16
+//! Byte mask with the given value in each byte of a word
+#define SIP_BYTES(c)            (0x0101010101010101ULL * (c))
+
+/**
+ * @brief Get the number of leading uppercase letters of a payload
+ *
+ * Eight payload bytes are checked at once: each byte in 'A'..'Z' gets its
+ * high bit set in the result mask. Bytes are only counted until the first
+ * one that is not an uppercase letter.
+ */
+static int
+sip_method_length(const u_char *payload, int len)
+{
+    uint64_t word, low, upper;
+    int i, count = 0;
+
+    while (count + 8 <= len && count < SIP_MAX_METHOD) {
+        memcpy(&word, payload + count, sizeof(word));
+        // Clear high bits so the additions don't carry into the next byte
+        low = word & SIP_BYTES(0x7F);
+        upper = (low + SIP_BYTES(0x80 - 'A')) & ~(low + SIP_BYTES(0x80 - 'Z' - 1))
+                & ~word & SIP_BYTES(0x80);
+        if (upper != SIP_BYTES(0x80)) {
+            // Count bytes before the first non uppercase one
+#if __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
+            return count + __builtin_ctzll(~upper & SIP_BYTES(0x80)) / 8;
+#else
+            return count + __builtin_clzll(~upper & SIP_BYTES(0x80)) / 8;
+#endif
+        }
+        count += 8;
+    }
+
+    // Remaining bytes one by one
+    for (i = count; i < len && i <= SIP_MAX_METHOD && payload[i] >= 'A' && payload[i] <= 'Z'; i++);
+    return i;
+}
+
+int
+sip_check_start_line(const u_char *payload, int len)
+{
+    const u_char *eol;
+    int toklen;
+
+    if (len < SIP_MIN_START_LINE)
+        return 0;
+
+    // Responses: SIP/2.0 and a three digits status code
+    if (!memcmp(payload, "SIP/2.0 ", 8))
+        return isdigit(payload[8]) && isdigit(payload[9]) && isdigit(payload[10]);
+
+    // Requests: method token followed by a space
+    toklen = sip_method_length(payload, len);
+    if (toklen < 3 || toklen > SIP_MAX_METHOD || toklen >= len || payload[toklen] != ' ')
+        return 0;
+
+    // Request line must end with SIP version
+    if (!(eol = memchr(payload + toklen, '\n', len - toklen)))
+        return 0;
+    if (eol[-1] == '\r')
+        eol--;
+    return eol - payload >= toklen + 8 && !memcmp(eol - 7, "SIP/2.0", 7);
+}
+
 sip_msg_t *
 sip_load_message(struct timeval tv, struct in_addr src, u_short sport, struct in_addr dst,
                  u_short dport, u_char *payload)
 {
     sip_msg_t *msg;
-    sip_call_t *call;
+
+    // Parse the message data
+    if (!(msg = sip_parse_message(tv, src, sport, dst, dport, payload)))
+        return NULL;
+
+    // Add it to its call
+    return sip_commit_message(msg);
+}
+
+/**
+ * @brief Calculate a payload hash
+ *
+ * Case insensitive FNV-1a hash of the payload, so messages with the
+ * same payload (compared with strcasecmp) have the same hash.
+ */
+static uint64_t
+sip_payload_hash(const char *payload)
+{
+    uint64_t hash = 14695981039346656037ULL;
+
+    for (; *payload; payload++) {
+        hash ^= (unsigned char) tolower((unsigned char) *payload);
+        hash *= 1099511628211ULL;
+    }
+
+    // Zero is used for messages without hash
+    return (hash) ? hash : 1;
+}
+
+sip_msg_t *
+sip_parse_message(struct timeval tv, struct in_addr src, u_short sport, struct in_addr dst,
+                  u_short dport, u_char *payload)
+{
+    sip_msg_t *msg;
     char *callid;
-    char date[12], time[20];
+    int ret;
 
     // Get the Call-ID of this message
     if (!(callid = sip_get_callid((const char*) payload))) {
@@ -220,15 +347,23 @@ sip_load_message(struct timeval tv, struct in_addr src, u_short sport, struct in
 
     // Create a new message from this data
     if (!(msg = sip_msg_create((const char*) payload))) {
+        free(callid);
         return NULL;
     }
 
     // Parse the package payload to fill message attributes
-    if (msg_parse_payload(msg, (const char*) payload) != 0) {
+    TRACE_BEGIN(parse);
+    ret = msg_parse_payload(msg, (const char*) payload);
+    TRACE_END(TRACE_PARSE, parse);
+    if (ret != 0) {
         sip_msg_destroy(msg);
+        free(callid);
         return NULL;
     }
 
+    // Store payload hash to detect retransmissions
+    msg->hash = sip_payload_hash((const char*) payload);
+
     // Fill message data
     msg->ts = tv;
     msg->src = src;
@@ -236,35 +371,41 @@ sip_load_message(struct timeval tv, struct in_addr src, u_short sport, struct in
     msg->dst = dst;
     msg->dport = dport;
 
-    // Set Source and Destination attributes
-    msg_set_attribute(msg, SIP_ATTR_SRC, "%s:%u", inet_ntoa(src), htons(sport));
-    msg_set_attribute(msg, SIP_ATTR_DST, "%s:%u", inet_ntoa(dst), htons(dport));
+    // Set attributes from packet data
+    TRACE_BEGIN(attr);
+    msg_set_packet_attributes(msg);
+    TRACE_END(TRACE_ATTR, attr);
 
-    // Set Source and Destination lookpued hosts
-    if (is_option_enabled("capture.lookup")) {
-        msg_set_attribute(msg, SIP_ATTR_SRC_HOST, "%.15s:%u", lookup_hostname(&src), htons(sport));
-        msg_set_attribute(msg, SIP_ATTR_DST_HOST, "%.15s:%u", lookup_hostname(&dst), htons(dport));
-    }
-    msg_set_attribute(msg, SIP_ATTR_SRC_HOST, "%s:%u", inet_ntoa(src), htons(sport));
-    msg_set_attribute(msg, SIP_ATTR_DST_HOST, "%s:%u", inet_ntoa(dst), htons(dport));
+    // Set message callid
+    msg_set_attribute(msg, SIP_ATTR_CALLID, callid);
+    // Dellocate callid memory
+    free(callid);
 
-    // Set message Date attribute
-    time_t t = (time_t) msg->ts.tv_sec;
-    struct tm *timestamp = localtime(&t);
-    strftime(date, sizeof(date), "%Y/%m/%d", timestamp);
-    msg_set_attribute(msg, SIP_ATTR_DATE, date);
+    return msg;
+}
 
-    // Set message Time attribute
-    strftime(time, sizeof(time), "%H:%M:%S", timestamp);
-    sprintf(time + 8, ".%06d", (int) msg->ts.tv_usec);
-    msg_set_attribute(msg, SIP_ATTR_TIME, time);
+sip_msg_t *
+sip_commit_message(sip_msg_t *msg)
+{
+    sip_call_t *call;
+    const char *callid = msg_get_attribute(msg, SIP_ATTR_CALLID);
+    int matched;
 
+    TRACE_BEGIN(lock);
     pthread_mutex_lock(&calls.lock);
+    TRACE_END(TRACE_LOCK, lock);
+
     // Find the call for this msg
-    if (!(call = call_find_by_callid(callid))) {
+    TRACE_BEGIN(lookup);
+    call = call_find_by_callid(callid);
+    TRACE_END(TRACE_CALLID, lookup);
 
+    if (!call) {
         // Check if payload matches expression
-        if (!sip_check_match_expression((const char*) payload)) {
+        TRACE_BEGIN(match);
+        matched = sip_check_match_expression(msg->payload);
+        TRACE_END(TRACE_MATCH, match);
+        if (!matched) {
             // Deallocate message memory
             sip_msg_destroy(msg);
             pthread_mutex_unlock(&calls.lock);
@@ -316,16 +457,24 @@ sip_load_message(struct timeval tv, struct in_addr src, u_short sport, struct in
         }
     }
 
-    // Set message callid
-    msg_set_attribute(msg, SIP_ATTR_CALLID, callid);
-    // Dellocate callid memory
-    free(callid);
-
     // Add the message to the found/created call
     call_add_message(call, msg);
 
+    // Expect the media announced in message SDP
+    if (msg->sdp)
+        rtp_add_sdp(msg);
+
     // Update Call State
     call_update_state(call, msg);
+
+    // Move the call to its new sorted position
+    sip_sort_update(&calls.sort, call);
+
+    // Add message to traffic statistics
+    stats_add_message(msg);
+
+    // Calls list has changed
+    calls.version++;
     pthread_mutex_unlock(&calls.lock);
 
     // Return the loaded message
@@ -338,6 +487,32 @@ sip_calls_count()
     return calls.count;
 }
 
+int
+sip_calls_version()
+{
+    return calls.version;
+}
+
+sip_call_t **
+sip_calls_array(int filtered, int *count)
+{
+    sip_call_t **array, *call;
+
+    *count = 0;
+
+    pthread_mutex_lock(&calls.lock);
+    if ((array = malloc(sizeof(sip_call_t *) * (calls.count + 1)))) {
+        for (call = calls.first; call; call = call->next) {
+            if (filtered && filter_check_call(call))
+                continue;
+            array[(*count)++] = call;
+        }
+    }
+    pthread_mutex_unlock(&calls.lock);
+
+    return array;
+}
+
 void
 call_add_message(sip_call_t *call, sip_msg_t *msg)
 {
@@ -350,28 +525,34 @@ call_add_message(sip_call_t *call, sip_msg_t *msg)
     if (!call->msgs) {
         call->msgs = msg;
     } else {
-        for (cur = call->msgs; cur; prev = cur, cur = cur->next)
-            ;
+        for (cur = call->msgs; cur; prev = cur, cur = cur->next) {
+            // Same payload than a previous message
+            if (msg->hash && cur->hash == msg->hash)
+                msg->retrans = 1;
+        }
         prev->next = msg;
     }
 
+    // Count retransmissions
+    if (msg->retrans) {
+        call->retrans++;
+        call_set_attribute(call, SIP_ATTR_RETRANS, "%d", call->retrans);
+    }
+
     // Increase message count
     call->msgcnt++;
 
     // Store message count
     call_set_attribute(call, SIP_ATTR_MSGCNT, "%d", call->msgcnt);
+
+    // Call attributes have changed, filters must be evaluated again
+    call->filtered = -1;
 }
 
 sip_call_t *
 call_find_by_callid(const char *callid)
 {
-    ENTRY entry, *eptr;
-
-    entry.key = (char *) callid;
-    if ((eptr = hsearch(entry, FIND)))
-        return eptr->data;
-
-    return NULL;
+    return htable_find(calls.callids, callid);
 }
 
 sip_call_t *
@@ -477,12 +658,12 @@ call_get_prev(sip_call_t *cur)
 sip_call_t *
 call_get_next_filtered(sip_call_t *cur)
 {
-    sip_call_t *next = call_get_next(cur);
+    sip_call_t *next = cur;
 
     pthread_mutex_lock(&calls.lock);
-    // Return next not filtered call
-    if (next && filter_check_call(next))
-        next = call_get_next_filtered(next);
+    // Return next not filtered call in sort order
+    while ((next = sip_sort_next(&calls.sort, next)) && filter_check_call(next))
+        ;
     pthread_mutex_unlock(&calls.lock);
 
     return next;
@@ -491,16 +672,89 @@ call_get_next_filtered(sip_call_t *cur)
 sip_call_t *
 call_get_prev_filtered(sip_call_t *cur)
 {
-    sip_call_t *prev = call_get_prev(cur);
+    sip_call_t *prev = cur;
+
+    // Without current call there is no previous one
+    if (!cur)
+        return NULL;
 
     pthread_mutex_lock(&calls.lock);
-    // Return previous call if this one is filtered
-    if (prev && filter_check_call(prev))
-        prev = call_get_prev_filtered(prev);
+    // Return previous not filtered call in sort order
+    while ((prev = sip_sort_prev(&calls.sort, prev)) && filter_check_call(prev))
+        ;
     pthread_mutex_unlock(&calls.lock);
     return prev;
 }
 
+struct rtp_stream *
+call_get_next_stream(sip_call_t *call, struct rtp_stream *cur)
+{
+    struct rtp_stream *next;
+
+    pthread_mutex_lock(&calls.lock);
+    next = (cur) ? cur->next : call->streams;
+    pthread_mutex_unlock(&calls.lock);
+    return next;
+}
+
+/**
+ * @brief Get the time between two messages in microseconds
+ */
+static int64_t
+sip_msg_time_diff(const sip_msg_t *start, const sip_msg_t *end)
+{
+    return (int64_t) (end->ts.tv_sec - start->ts.tv_sec) * 1000000
+           + (end->ts.tv_usec - start->ts.tv_usec);
+}
+
+/**
+ * @brief Update call metrics with a new message
+ *
+ * Delays are measured from the first INVITE of the call to the first
+ * responses of any INVITE transaction, so calls that are challenged and
+ * send the INVITE again with a new CSeq are also measured.
+ */
+static void
+call_update_metrics(sip_call_t *call, sip_msg_t *msg, const char *method)
+{
+    int code, class;
+
+    if (msg->request) {
+        // First INVITE starts delays measurement
+        if (!call->invite_msg && msg->invite)
+            call->invite_msg = msg;
+        return;
+    }
+
+    // Retransmitted responses are only counted as retransmissions
+    if (msg->retrans)
+        return;
+
+    // Count responses by class
+    code = atoi(method);
+    if (code < 100 || code > 699)
+        return;
+    class = code / 100 - 1;
+    call->responses[class]++;
+    call_set_attribute(call, SIP_ATTR_RESP1XX + class, "%d", call->responses[class]);
+
+    // Responses to other requests (like CANCEL) don't end delays
+    if (!call->invite_msg || !msg->invite)
+        return;
+
+    // Remote party is ringing
+    if (call->pdd < 0 && code >= 180 && code < 190) {
+        call->pdd = sip_msg_time_diff(call->invite_msg, msg);
+        call_set_attribute(call, SIP_ATTR_PDD, "%.3f", call->pdd / 1000000.0);
+    }
+
+    // Remote party has answered
+    if (call->tta < 0 && code >= 200 && code < 300) {
+        call->tta = sip_msg_time_diff(call->invite_msg, msg);
+        call_set_attribute(call, SIP_ATTR_TTA, "%.3f", call->tta / 1000000.0);
+    }
+}
+
 void
 call_update_state(sip_call_t *call, sip_msg_t *msg)
 {
@@ -517,6 +771,9 @@ call_update_state(sip_call_t *call, sip_msg_t *msg)
         return;
     }
 
+    // Update numeric call metrics
+    call_update_metrics(call, msg, method);
+
     // If this message is actually a call, get its current state
     if ((callstate = call_get_attribute(call, SIP_ATTR_CALLSTATE))) {
         if (!strcmp(callstate, "CALL SETUP")) {
@@ -525,22 +782,31 @@ call_update_state(sip_call_t *call, sip_msg_t *msg)
                 call_set_attribute(call, SIP_ATTR_CALLSTATE, "IN CALL");
                 // Store the timestap where call has started
                 call->cstart_msg = msg;
+                stats_add_setup(msg);
             } else if (!strncasecmp(method, "CANCEL", 6)) {
                 // Alice is not in the mood
                 call_set_attribute(call, SIP_ATTR_CALLSTATE, "CANCELLED");
+                rtp_call_ended(call);
                 // Store total call duration
+                call->totaldur = sip_msg_time_diff(call->msgs, msg);
                 call_set_attribute(call, SIP_ATTR_TOTALDUR, sip_calculate_duration(call->msgs, msg, dur));
+                stats_add_setup(msg);
             } else if (*method == '4' || *method == '5' || *method == '6') {
                 // Bob is not in the mood
                 call_set_attribute(call, SIP_ATTR_CALLSTATE, "REJECTED");
+                rtp_call_ended(call);
                 // Store total call duration
+                call->totaldur = sip_msg_time_diff(call->msgs, msg);
                 call_set_attribute(call, SIP_ATTR_TOTALDUR, sip_calculate_duration(call->msgs, msg, dur));
+                stats_add_setup(msg);
             }
         } else if (!strcmp(callstate, "IN CALL")) {
             if (!strncasecmp(method, "BYE", 3)) {
                 // Thanks for all the fish!
                 call_set_attribute(call, SIP_ATTR_CALLSTATE, "COMPLETED");
+                rtp_call_ended(call);
                 // Store Conversation duration
+                call->convdur = sip_msg_time_diff(call->cstart_msg, msg);
                 call_set_attribute(call, SIP_ATTR_CONVDUR, sip_calculate_duration(call->cstart_msg, msg, dur));
             }
         } else if (!strncasecmp(method, "INVITE", 6) && strcmp(callstate, "IN CALL")) {
@@ -548,6 +814,7 @@ call_update_state(sip_call_t *call, sip_msg_t *msg)
             call_set_attribute(call, SIP_ATTR_CALLSTATE, "CALL SETUP");
         } else {
             // Store total call duration
+            call->totaldur = sip_msg_time_diff(call->msgs, msg);
             call_set_attribute(call, SIP_ATTR_TOTALDUR, sip_calculate_duration(call->msgs, msg, dur));
         }
     } else {
@@ -562,7 +829,7 @@ int
 msg_parse_payload(sip_msg_t *msg, const char *payload)
 {
     char *body;
-    char *pch;
+    char *pch, *save;
     int ivalue;
     char value[256];
     char rest[256];
@@ -574,7 +841,7 @@ msg_parse_payload(sip_msg_t *msg, const char *payload)
     // Duplicate payload to cut into lines
     body = strdup(payload);
 
-    for (pch = strtok(body, "\n"); pch; pch = strtok(NULL, "\n")) {
+    for (pch = strtok_r(body, "\n", &save); pch; pch = strtok_r(NULL, "\n", &save)) {
         if (!strlen(pch))
             continue;
 
@@ -599,6 +866,7 @@ msg_parse_payload(sip_msg_t *msg, const char *payload)
                 msg_set_attribute(msg, SIP_ATTR_METHOD, value);
             }
             msg->cseq = ivalue;
+            msg->invite = !strncasecmp(value, "INVITE", 6);
             continue;
         }
         if (sscanf(pch, "From: %*[^:]:%[^@]@%[^\t\n\r]", value, rest) == 2) {
@@ -632,27 +900,59 @@ msg_parse_payload(sip_msg_t *msg, const char *payload)
     return 0;
 }
 
-int
-msg_is_retrans(sip_msg_t *msg)
+void
+msg_set_packet_attributes(sip_msg_t *msg)
 {
-    sip_msg_t *prev = NULL;
-
-    // Sanity check
-    if (!msg || !msg->call || !msg->payload)
-        return 0;
+    char date[12], time[20];
+    char srcip[INET_ADDRSTRLEN], dstip[INET_ADDRSTRLEN];
+    struct tm timestamp;
 
-    // Start on previous message
-    prev = msg;
+    // Set Source and Destination attributes
+    inet_ntop(AF_INET, &msg->src, srcip, sizeof(srcip));
+    inet_ntop(AF_INET, &msg->dst, dstip, sizeof(dstip));
+    msg_set_attribute(msg, SIP_ATTR_SRC, "%s:%u", srcip, htons(msg->sport));
+    msg_set_attribute(msg, SIP_ATTR_DST, "%s:%u", dstip, htons(msg->dport));
 
-    // Check previous messages in same call
-    while ((prev = call_get_prev_msg(msg->call, prev))) {
-        // Check if the payload is exactly the same
-        if (!strcasecmp(msg->payload, prev->payload)) {
-            return 1;
-        }
+    // Set Source and Destination lookpued hosts
+    if (is_option_enabled("capture.lookup")) {
+        msg_set_attribute(msg, SIP_ATTR_SRC_HOST, "%.15s:%u", lookup_hostname(&msg->src), htons(msg->sport));
+        msg_set_attribute(msg, SIP_ATTR_DST_HOST, "%.15s:%u", lookup_hostname(&msg->dst), htons(msg->dport));
     }
+    msg_set_attribute(msg, SIP_ATTR_SRC_HOST, "%s:%u", srcip, htons(msg->sport));
+    msg_set_attribute(msg, SIP_ATTR_DST_HOST, "%s:%u", dstip, htons(msg->dport));
 
-    return 0;
+    // Set message Date attribute
+    time_t t = (time_t) msg->ts.tv_sec;
+    localtime_r(&t, &timestamp);
+    strftime(date, sizeof(date), "%Y/%m/%d", &timestamp);
+    msg_set_attribute(msg, SIP_ATTR_DATE, date);
+
+    // Set message Time attribute
+    strftime(time, sizeof(time), "%H:%M:%S", &timestamp);
+    sprintf(time + 8, ".%06d", (int) msg->ts.tv_usec);
+    msg_set_attribute(msg, SIP_ATTR_TIME, time);
+}
+
+const char *
+msg_get_payload(sip_msg_t *msg)
+{
+    // Read payload from spool or input file if required
+    spool_fetch(msg);
+    return msg->payload;
+}
+
+const u_char *
+msg_get_packet(sip_msg_t *msg)
+{
+    // Read packet data from spool or input file if required
+    spool_fetch(msg);
+    return msg->pcap_packet;
+}
+
+int
+msg_is_retrans(sip_msg_t *msg)
+{
+    return (msg) ? msg->retrans : 0;
 }
 
 char *
@@ -684,9 +984,12 @@ sip_calls_clear()
     while (calls.first) {
         sip_call_destroy(calls.first);
     }
-    // Create again the callid hash table
-    hdestroy();
-    hcreate(calls.limit);
+
+    // Traffic statistics start again
+    stats_clear();
+
+    // Calls list has changed
+    calls.version++;
 
     pthread_mutex_unlock(&calls.lock);
 }
@@ -704,6 +1007,78 @@ sip_calculate_duration(const sip_msg_t *start, const sip_msg_t *end, char *dur)
     return dur;
 }
 
+/**
+ * @brief Get the compact form of a SIP header name
+ *
+ * If a compact header name is given, it will be replaced with its
+ * long form.
+ *
+ * @param name Header name in lowercase
+ * @param len Header name buffer size
+ * @return compact header letter or 0 if header has no compact form
+ */
+static char
+sip_header_compact(char *name, size_t len)
+{
+    static const char *compact[][2] = {
+        { "from", "f" }, { "to", "t" }, { "call-id", "i" }, { "contact", "m" },
+        { "via", "v" }, { "subject", "s" }, { "content-type", "c" },
+        { "content-length", "l" }, { "supported", "k" }, { "event", "o" },
+        { "refer-to", "r" }, { "referred-by", "b" },
+    };
+    size_t i;
+
+    for (i = 0; i < sizeof(compact) / sizeof(compact[0]); i++) {
+        if (!strcmp(name, compact[i][1]))
+            strncpy(name, compact[i][0], len - 1);
+        if (!strcmp(name, compact[i][0]))
+            return compact[i][1][0];
+    }
+    return 0;
+}
+
+/**
+ * @brief Set the headers the match expression will be checked against
+ *
+ * @param headers Comma separated list of header names or NULL for all payload
+ */
+static void
+sip_set_match_headers(const char *headers)
+{
+    char list[512];
+    char *name, *saveptr = NULL;
+    int i;
+
+    calls.match_hdrcnt = 0;
+    calls.match_ruri = 0;
+
+    if (!headers)
+        return;
+
+    strncpy(list, headers, sizeof(list) - 1);
+    list[sizeof(list) - 1] = '\0';
+
+    for (name = strtok_r(list, ", ", &saveptr); name; name = strtok_r(NULL, ", ", &saveptr)) {
+        for (i = 0; name[i]; i++)
+            name[i] = tolower(name[i]);
+
+        // Request line is not a header, but it can also be checked
+        if (!strcmp(name, "ruri")) {
+            calls.match_ruri = 1;
+            continue;
+        }
+
+        if (calls.match_hdrcnt == SIP_MATCH_MAX_HEADERS)
+            break;
+
+        i = calls.match_hdrcnt++;
+        strncpy(calls.match_headers[i], name, sizeof(calls.match_headers[i]) - 1);
+        calls.match_headers[i][sizeof(calls.match_headers[i]) - 1] = '\0';
+        calls.match_compact[i] = sip_header_compact(calls.match_headers[i],
+                                                    sizeof(calls.match_headers[i]));
+    }
+}
+
 int
 sip_set_match_expression(const char *expr, int insensitive, int invert)
 {
@@ -711,6 +1086,8 @@ sip_set_match_expression(const char *expr, int insensitive, int invert)
     calls.match_expr = expr;
     // Set invert flag
     calls.match_invert = invert;
+    // Set payload headers where expression will be checked
+    sip_set_match_headers(get_option_value("sip.matchheaders"));
 
 #ifdef WITH_PCRE
     const char *re_err = NULL;
@@ -735,6 +1112,114 @@ sip_set_match_expression(const char *expr, int insensitive, int invert)
 #endif
 }
 
+const char *
+sip_get_match_expression()
+{
+    return calls.match_expr;
+}
+
+void
+sip_set_sort(enum sip_attr_id by, int asc)
+{
+    sip_call_t *call;
+
+    pthread_mutex_lock(&calls.lock);
+    // Nothing to do if sort has not changed
+    if (calls.sort.by != by || calls.sort.asc != asc) {
+        // Sort all calls again
+        sip_sort_clear(&calls.sort);
+        sip_sort_init(&calls.sort, by, asc);
+        for (call = calls.first; call; call = call->next)
+            sip_sort_insert(&calls.sort, call);
+
+        // Calls list has changed
+        calls.version++;
+    }
+    pthread_mutex_unlock(&calls.lock);
+}
+
+void
+sip_get_sort(enum sip_attr_id *by, int *asc)
+{
+    *by = calls.sort.by;
+    *asc = calls.sort.asc;
+}
+
+/**
+ * @brief Check if a payload span matches the match expression
+ *
+ * @param start First character of the span
+ * @param len Span length
+ * @return 1 if span matches the expression, 0 otherwise
+ */
+static int
+sip_check_match_span(const char *start, int len)
+{
+#ifdef WITH_PCRE
+    return pcre_exec(calls.match_regex, 0, start, len, 0, 0, 0, 0) >= 0;
+#else
+    char line[SIP_MATCH_MAX_LINE];
+
+    // POSIX regexec requires a null terminated string
+    if (len >= (int) sizeof(line))
+        len = sizeof(line) - 1;
+    memcpy(line, start, len);
+    line[len] = '\0';
+    return regexec(&calls.match_regex, line, 0, NULL, 0) == 0;
+#endif
+}
+
+/**
+ * @brief Check match expression against the selected payload headers
+ *
+ * @param payload Packet payload
+ * @return 1 if any selected header matches, 0 otherwise
+ */
+static int
+sip_check_match_headers(const char *payload)
+{
+    const char *line, *eol, *colon;
+    int len, namelen, i;
+
+    for (line = payload; *line; line = eol + 1) {
+        if (!(eol = strchr(line, '\n')))
+            eol = line + strlen(line);
+
+        len = eol - line;
+        if (len && line[len - 1] == '\r')
+            len--;
+
+        // Headers end with an empty line, message body is never checked
+        if (!len)
+            break;
+
+        if (line == payload) {
+            // First line is the request or status line
+            if (calls.match_ruri && sip_check_match_span(line, len))
+                return 1;
+        } else if ((colon = memchr(line, ':', len))) {
+            // Get header name length without trailing spaces
+            for (namelen = colon - line; namelen && line[namelen - 1] == ' '; namelen--);
+
+            for (i = 0; i < calls.match_hdrcnt; i++) {
+                if ((namelen == 1 && tolower(line[0]) == calls.match_compact[i])
+                    || (namelen < (int) sizeof(calls.match_headers[i])
+                        && !calls.match_headers[i][namelen]
+                        && !strncasecmp(line, calls.match_headers[i], namelen))) {
+                    if (sip_check_match_span(line, len))
+                        return 1;
+                    break;
+                }
+            }
+        }
+
+        if (!*eol)
+            break;
+    }
+
+    return 0;
+}
+
 int
 sip_check_match_expression(const char *payload)
 {
@@ -742,6 +1227,10 @@ sip_check_match_expression(const char *payload)
     if (!calls.match_expr)
         return 1;
 
+    // Expression scoped to some payload headers
+    if (calls.match_hdrcnt || calls.match_ruri)
+        return sip_check_match_headers(payload) != calls.match_invert;
+
 #ifdef WITH_PCRE
     switch(pcre_exec(calls.match_regex, 0, payload, strlen(payload), 0, 0, 0, 0)) {
         case PCRE_ERROR_NOMATCH:
@@ -35,6 +35,7 @@
 #include "config.h"
 #include <pcap.h>
 #include <sys/time.h>
+#include <stdint.h>
 #include <pthread.h>
 #include <arpa/inet.h>
 #ifdef WITH_PCRE
@@ -43,6 +44,8 @@
 #include <regex.h>
 #endif
 #include "sip_attr.h"
+#include "sip_sort.h"
+#include "hash.h"
 
 //! Shorter declaration of sip_call structure
 typedef struct sip_call sip_call_t;
@@ -76,7 +79,7 @@ struct sip_msg {
     struct in_addr dst;
     //! Destination port
     u_short dport;
-    //! Temporal payload data before being parsed
+    //! Message payload (use msg_get_payload, it can be read on demand)
     char *payload;
     //! Color for this message (in color.cseq mode)
     int color;
@@ -86,10 +89,28 @@ struct sip_msg {
     int sdp;
     //! Message Cseq
     int cseq;
+    //! Message CSeq method is INVITE
+    int invite;
+    //! Payload hash, used to detect retransmissions
+    uint64_t hash;
+    //! Message has the same payload than a previous message of the call
+    int retrans;
     //! PCAP Packet Header data
     struct pcap_pkthdr *pcap_header;
-    //! PCAP Packet data
+    //! PCAP Packet data (use msg_get_packet, it can be read on demand)
     u_char *pcap_packet;
+    //! PCAP Packet data offset in the input file (0 if unknown)
+    size_t pcap_offset;
+    //! Payload and packet offset in the spool file (0 if not spooled)
+    off_t spool_offset;
+    //! Payload is in the spool cache
+    int cached;
+    //! Memory used by payload and packet when cached
+    size_t cachesize;
+    //! Previous message in the spool cache
+    sip_msg_t *cache_prev;
+    //! Next message in the spool cache
+    sip_msg_t *cache_next;
     //! Message owner
     sip_call_t *call;
 
@@ -107,18 +128,47 @@ struct sip_msg {
 struct sip_call {
     //! Flag this call as filtered so won't be displayed
     int filtered;
+    //! Call data version, increased every time the call changes
+    int version;
     //! Call attribute list
     struct sip_attr *attrs;
+    //! Call-ID of this call
+    char *callid;
     //! List of messages of this call
     sip_msg_t *msgs;
     //! How many messages has this call
     int msgcnt;
     //! Message when conversation started
     sip_msg_t *cstart_msg;
+    //! Call position in the calls list when it was created
+    int index;
+    //! First INVITE of the call
+    sip_msg_t *invite_msg;
+    //! Post dial delay: first INVITE to first 18x response (usecs, -1 if unknown)
+    int64_t pdd;
+    //! Time to answer: first INVITE to its 2xx response (usecs, -1 if unknown)
+    int64_t tta;
+    //! Conversation duration (usecs, -1 if unknown)
+    int64_t convdur;
+    //! Total call duration (usecs, -1 if unknown)
+    int64_t totaldur;
+    //! Number of retransmitted messages
+    int retrans;
+    //! Number of responses of each class (1xx to 6xx)
+    int responses[6];
+    //! Position of this call in the sorted calls list
+    sip_sort_node_t *sortnode;
+    //! RTP streams negotiated in this call SDP
+    struct rtp_stream *streams;
     //! Calls double linked list
     sip_call_t *next, *prev;
 };
 
+//! Max number of headers the match expression can be scoped to
+#define SIP_MATCH_MAX_HEADERS   16
+//! Max length of a header line checked by the match expression
+#define SIP_MATCH_MAX_LINE      1024
+
 /**
  * @brief call structures head list
  *
@@ -132,6 +182,8 @@ struct sip_call_list {
     int count;
     // Max call limit
     int limit;
+    //! Calls data version, increased every time any call changes
+    int version;
     //! match expression text
     const char *match_expr;
 #ifdef WITH_PCRE
@@ -143,6 +195,18 @@ struct sip_call_list {
 #endif
     //! Invert match expression result
     int match_invert;
+    //! Header names the match expression is checked against
+    char match_headers[SIP_MATCH_MAX_HEADERS][32];
+    //! Compact form of each match header (or 0 if it has none)
+    char match_compact[SIP_MATCH_MAX_HEADERS];
+    //! Number of match headers (0 to check the whole payload)
+    int match_hdrcnt;
+    //! Check match expression against the request/status line
+    int match_ruri;
+    //! Call-ID to call hash table
+    htable_t *callids;
+    //! Calls sorted by the selected attribute
+    sip_sort_t sort;
     // Warranty thread-safe access to the calls list
     pthread_mutex_t lock;
 };
@@ -200,14 +264,14 @@ sip_msg_destroy(sip_msg_t *msg);
  * @return pointer to the sip_call created
  */
 sip_call_t *
-sip_call_create(char *callid);
+sip_call_create(const char *callid);
 
 /**
  * @brief Free all related memory from a call and remove from call list
  *
  * Deallocate memory of an existing SIP Call.
  * This will also remove all messages, calling sip_msg_destroy for each
- * one.
+ * one, and remove the call from the Call-ID hash table.
  *
  * @param call Call to be destroyed
  */
@@ -225,6 +289,21 @@ sip_call_destroy(sip_call_t *call);
 char *
 sip_get_callid(const char* payload);
 
+/**
+ * @brief Check if a packet payload starts with a SIP start line
+ *
+ * This is a cheap check done before any payload allocation or parsing.
+ * Payload must start with "SIP/2.0 " followed by a status code or with an
+ * uppercase method token and a space, and its first line must end with
+ * "SIP/2.0".
+ *
+ * @param payload Packet payload (not null terminated)
+ * @param len Payload length
+ * @return 1 if payload looks like a SIP message, 0 otherwise
+ */
+int
+sip_check_start_line(const u_char *payload, int len);
+
 /**
  * @brief Loads a new message from raw header/payload
  *
@@ -241,6 +320,39 @@ sip_msg_t *
 sip_load_message(struct timeval tv, struct in_addr src, u_short sport, struct in_addr dst,
                  u_short dport, u_char *payload);
 
+/**
+ * @brief Parse a new message from raw header/payload
+ *
+ * Create a message structure with all its attributes filled, without
+ * adding it to any call. This function doesn't use the calls list, so
+ * it can be used from multiple threads at the same time.
+ *
+ * @param tv Packet timestamp
+ * @param src Source address
+ * @param sport Source port
+ * @param dst Destination address
+ * @param dport Destination port
+ * @param payload SIP message payload
+ * @return a SIP msg structure pointer or NULL if payload is not SIP
+ */
+sip_msg_t *
+sip_parse_message(struct timeval tv, struct in_addr src, u_short sport, struct in_addr dst,
+                  u_short dport, u_char *payload);
+
+/**
+ * @brief Add a parsed message to its call
+ *
+ * Find or create the call of a message returned by sip_parse_message
+ * and update the call with it. Messages must be added in capture order.
+ * If the message doesn't belong to any call and can not create a new one
+ * it will be destroyed.
+ *
+ * @param msg Parsed SIP message
+ * @return the same message or NULL if it has been discarded
+ */
+sip_msg_t *
+sip_commit_message(sip_msg_t *msg);
+
 /**
  * @brief Getter for calls linked list size
  *
@@ -249,6 +361,31 @@ sip_load_message(struct timeval tv, struct in_addr src, u_short sport, struct in
 int
 sip_calls_count();
 
+/**
+ * @brief Getter for calls list version
+ *
+ * This value changes every time a call is added, removed or
+ * updated, so it can be used to check if anything has changed
+ * in the calls list.
+ *
+ * @return calls list version
+ */
+int
+sip_calls_version();
+
+/**
+ * @brief Get current calls in an array
+ *
+ * Calls list is locked only once while the array is filled, instead
+ * of once per call like call_get_next.
+ *
+ * @param filtered Skip calls that don't match display filters
+ * @param count Number of calls in the returned array
+ * @return allocated array of calls or NULL if there is no call
+ */
+sip_call_t **
+sip_calls_array(int filtered, int *count);
+
 /**
  * @brief Append message to the call's message list
  *
@@ -362,6 +499,8 @@ call_get_prev(sip_call_t *cur);
 /**
  * @brief Get next call after applying filters and ignores
  *
+ * Filtered calls are returned in the order set with sip_set_sort.
+ *
  * @param cur Current call. Pass NULL to get the first call.
  * @return Next call in the list or NULL if there is no next call
  */
@@ -371,8 +510,7 @@ call_get_next_filtered(sip_call_t *cur);
 /**
  * @brief Get previous call applying filters and ignores
  *
- * General getter for call list. Never access calls list
- * directly, use this instead.
+ * Filtered calls are returned in the order set with sip_set_sort.
  *
  * @param cur Current call
  * @return Prev call in the list or NULL if there is no previous call
@@ -380,6 +518,18 @@ call_get_next_filtered(sip_call_t *cur);
 sip_call_t *
 call_get_prev_filtered(sip_call_t *cur);
 
+/**
+ * @brief Get next RTP stream of a call
+ *
+ * Streams are only detected when capture.rtp option is enabled.
+ *
+ * @param call Call owning the streams
+ * @param cur Current stream. Pass NULL to get the first stream.
+ * @return Next stream of the call or NULL if there is no next stream
+ */
+struct rtp_stream *
+call_get_next_stream(sip_call_t *call, struct rtp_stream *cur);
+
 /**
  * @brief Update Call State attribute with its last parsed message
  *
@@ -401,11 +551,46 @@ call_update_state(sip_call_t *call, sip_msg_t *msg);
 int
 msg_parse_payload(sip_msg_t *msg, const char *payload);
 
+/**
+ * @brief Set message attributes from its packet data
+ *
+ * Set source, destination, date and time attributes using message
+ * addresses, ports and timestamp.
+ *
+ * @param msg SIP message
+ */
+void
+msg_set_packet_attributes(sip_msg_t *msg);
+
+/**
+ * @brief Get the payload of a message
+ *
+ * Messages loaded from a capture file index don't store their payload.
+ * It will be read from the input file the first time it's requested.
+ *
+ * @param msg SIP message
+ * @return message payload
+ */
+const char *
+msg_get_payload(sip_msg_t *msg);
+
+/**
+ * @brief Get the packet data of a message
+ *
+ * Like the payload, packet data is read from the input file when
+ * the message has been loaded from a capture file index.
+ *
+ * @param msg SIP message
+ * @return packet data or NULL if it is not available
+ */
+const u_char *
+msg_get_packet(sip_msg_t *msg);
+
 /**
  * @brief Check if a package is a retransmission
  *
- * This function will compare its payload with the previous message
- * in the dialog, to check if it has the same content.
+ * Retransmissions are detected when the message is added to its
+ * call, comparing its payload hash with the previous messages.
  *
  * @param msg SIP message that will be checked
  * @return 1 if the previous message is equal to msg, 0 otherwise
@@ -448,6 +633,10 @@ sip_calculate_duration(const sip_msg_t *start, const sip_msg_t *end, char *dur);
 /**
  * @brief Set Capture Matching expression
  *
+ * If sip.matchheaders option is set, the expression will only be checked
+ * against the listed header lines (and the request/status line if the
+ * list contains "ruri") instead of the whole payload.
+ *
  * @param expr String containing matching expreson
  * @param insensitive 1 for case insensitive matching
  * @param invert 1 for reverse matching
@@ -456,9 +645,42 @@ sip_calculate_duration(const sip_msg_t *start, const sip_msg_t *end, char *dur);
 int
 sip_set_match_expression(const char *expr, int insensitive, int invert);
 
+/**
+ * @brief Get Capture Matching expression
+ *
+ * @return matching expression or NULL if not set
+ */
+const char *
+sip_get_match_expression();
+
+/**
+ * @brief Change the order of filtered calls
+ *
+ * Calls returned by call_get_next_filtered and call_get_prev_filtered
+ * will be sorted by the given attribute.
+ *
+ * @param by Sort attribute
+ * @param asc 1 for ascending order, 0 for descending
+ */
+void
+sip_set_sort(enum sip_attr_id by, int asc);
+
+/**
+ * @brief Get current order of filtered calls
+ *
+ * @param by Sort attribute
+ * @param asc 1 for ascending order, 0 for descending
+ */
+void
+sip_get_sort(enum sip_attr_id *by, int *asc);
+
 /**
  * @brief Checks if a given payload matches expression
  *
+ * When the expression is scoped to some headers, payload lines are scanned
+ * until the end of the headers and the expression is checked only against
+ * the selected lines, stopping at the first one that matches.
+ *
  * @param payload Packet payload
  * @return 1 if matches, 0 otherwise
  */
@@ -31,10 +31,12 @@
 #include <string.h>
 #include <stdarg.h>
 #include "option.h"
+#include "sip.h"
 #include "sip_attr.h"
+#include "intern.h"
 
 static sip_attr_hdr_t attrs[] = {
-    { .id = SIP_ATTR_CALLINDEX,     .name = "index", .title = "Idx", .desc = "Call Index", .dwidth = 4 },
+    { .id = SIP_ATTR_CALLINDEX,     .name = "index", .title = "Idx", .desc = "Call Index", .dwidth = 4, .numeric = 1 },
     { .id = SIP_ATTR_SIPFROM,       .name = "sipfrom", .desc = "SIP From", .dwidth = 30 },
     { .id = SIP_ATTR_SIPFROMUSER,   .name = "sipfromuser", .desc = "SIP From User", .dwidth = 20 },
     { .id = SIP_ATTR_SIPTO,         .name = "sipto", .desc = "SIP To", .dwidth = 30 },
@@ -49,12 +51,21 @@ static sip_attr_hdr_t attrs[] = {
     { .id = SIP_ATTR_TIME,          .name = "time", .desc = "Time", .dwidth = 8 },
     { .id = SIP_ATTR_METHOD,        .name = "method", .desc = "Method", .dwidth = 15 },
     { .id = SIP_ATTR_SDP_ADDRESS,   .name = "sdpaddress", .desc = "SDP Address", .dwidth = 22 },
-    { .id = SIP_ATTR_SDP_PORT,      .name = "sdpport", .desc = "SDP Port", .dwidth = 5 },
+    { .id = SIP_ATTR_SDP_PORT,      .name = "sdpport", .desc = "SDP Port", .dwidth = 5, .numeric = 1 },
     { .id = SIP_ATTR_TRANSPORT,     .name = "transport", .title = "Trans", .desc = "Transport", .dwidth = 3 },
-    { .id = SIP_ATTR_MSGCNT,        .name = "msgcnt", .title = "Msgs", .desc = "Message Count", .dwidth = 5 },
+    { .id = SIP_ATTR_MSGCNT,        .name = "msgcnt", .title = "Msgs", .desc = "Message Count", .dwidth = 5, .numeric = 1 },
     { .id = SIP_ATTR_CALLSTATE,     .name = "state", .desc = "Call State", .dwidth = 10 },
-    { .id = SIP_ATTR_CONVDUR,       .name = "convdur", .title = "ConvDur", .desc = "Conversation Duration", .dwidth = 7 },
-    { .id = SIP_ATTR_TOTALDUR,      .name = "totaldur", .title = "TotalDur", .desc = "Total Duration", .dwidth = 8 }
+    { .id = SIP_ATTR_CONVDUR,       .name = "convdur", .title = "ConvDur", .desc = "Conversation Duration", .dwidth = 7, .numeric = 1 },
+    { .id = SIP_ATTR_TOTALDUR,      .name = "totaldur", .title = "TotalDur", .desc = "Total Duration", .dwidth = 8, .numeric = 1 },
+    { .id = SIP_ATTR_PDD,           .name = "pdd", .title = "PDD", .desc = "Post Dial Delay", .dwidth = 8, .numeric = 1 },
+    { .id = SIP_ATTR_TTA,           .name = "tta", .title = "TTA", .desc = "Time To Answer", .dwidth = 8, .numeric = 1 },
+    { .id = SIP_ATTR_RETRANS,       .name = "retrans", .title = "Retrans", .desc = "Retransmissions", .dwidth = 7, .numeric = 1 },
+    { .id = SIP_ATTR_RESP1XX,       .name = "resp1xx", .title = "1xx", .desc = "1xx Responses", .dwidth = 4, .numeric = 1 },
+    { .id = SIP_ATTR_RESP2XX,       .name = "resp2xx", .title = "2xx", .desc = "2xx Responses", .dwidth = 4, .numeric = 1 },
+    { .id = SIP_ATTR_RESP3XX,       .name = "resp3xx", .title = "3xx", .desc = "3xx Responses", .dwidth = 4, .numeric = 1 },
+    { .id = SIP_ATTR_RESP4XX,       .name = "resp4xx", .title = "4xx", .desc = "4xx Responses", .dwidth = 4, .numeric = 1 },
+    { .id = SIP_ATTR_RESP5XX,       .name = "resp5xx", .title = "5xx", .desc = "5xx Responses", .dwidth = 4, .numeric = 1 },
+    { .id = SIP_ATTR_RESP6XX,       .name = "resp6xx", .title = "6xx", .desc = "6xx Responses", .dwidth = 4, .numeric = 1 }
 };
 
 sip_attr_hdr_t *
@@ -101,6 +112,16 @@ sip_attr_get_name(enum sip_attr_id id)
     return NULL;
 }
 
+int
+sip_attr_is_numeric(enum sip_attr_id id)
+{
+    sip_attr_hdr_t *header;
+    if ((header = sip_attr_get_header(id))) {
+        return header->numeric;
+    }
+    return 0;
+}
+
 int
 sip_attr_get_width(enum sip_attr_id id)
 {
@@ -132,8 +153,8 @@ sip_attr_list_destroy(sip_attr_t *list)
     while (list) {
         attr = list;
         list = attr->next;
-        // Free attribute value
-        free(attr->value);
+        // Release attribute value
+        intern_release(attr->value);
         // Free attribute structure
         free(attr);
     }
@@ -147,10 +168,10 @@ sip_attr_set(sip_attr_t **list, enum sip_attr_id id, const char *value)
     // If attribute already exists change its value
     for (attr = *list; attr; attr = attr->next) {
         if (id == attr->hdr->id) {
-            // Free previous value
-            free(attr->value);
+            // Release previous value
+            intern_release(attr->value);
             // Store the new value
-            attr->value = strdup(value);
+            attr->value = intern_get(value);
             return;
         }
     }
@@ -160,7 +181,7 @@ sip_attr_set(sip_attr_t **list, enum sip_attr_id id, const char *value)
         return;
 
     attr->hdr = sip_attr_get_header(id);
-    attr->value = strdup(value);
+    attr->value = intern_get(value);
     attr->next = *list;
     *list = attr;
 }
@@ -189,6 +210,9 @@ call_set_attribute(sip_call_t *call, enum sip_attr_id id, const char *fmt, ...)
     va_end(ap);
 
     sip_attr_set(&call->attrs, id, value);
+
+    // Call data has changed
+    call->version++;
 }
 
 const char *
@@ -203,6 +227,15 @@ call_get_attribute(sip_call_t *call, enum sip_attr_id id)
         case SIP_ATTR_CALLSTATE:
         case SIP_ATTR_CONVDUR:
         case SIP_ATTR_TOTALDUR:
+        case SIP_ATTR_PDD:
+        case SIP_ATTR_TTA:
+        case SIP_ATTR_RETRANS:
+        case SIP_ATTR_RESP1XX:
+        case SIP_ATTR_RESP2XX:
+        case SIP_ATTR_RESP3XX:
+        case SIP_ATTR_RESP4XX:
+        case SIP_ATTR_RESP5XX:
+        case SIP_ATTR_RESP6XX:
             return sip_attr_get(call->attrs, id);
         default:
             return msg_get_attribute(call_get_next_msg(call, NULL), id);
@@ -211,6 +244,62 @@ call_get_attribute(sip_call_t *call, enum sip_attr_id id)
     return NULL;
 }
 
+int
+call_get_attribute_num(sip_call_t *call, enum sip_attr_id id, double *value)
+{
+    const char *text;
+    char *end;
+
+    if (!call)
+        return 1;
+
+    switch (id) {
+        case SIP_ATTR_CALLINDEX:
+            *value = call->index;
+            return 0;
+        case SIP_ATTR_MSGCNT:
+            *value = call->msgcnt;
+            return 0;
+        case SIP_ATTR_CONVDUR:
+            if (call->convdur < 0)
+                return 1;
+            *value = call->convdur / 1000000.0;
+            return 0;
+        case SIP_ATTR_TOTALDUR:
+            if (call->totaldur < 0)
+                return 1;
+            *value = call->totaldur / 1000000.0;
+            return 0;
+        case SIP_ATTR_PDD:
+            if (call->pdd < 0)
+                return 1;
+            *value = call->pdd / 1000000.0;
+            return 0;
+        case SIP_ATTR_TTA:
+            if (call->tta < 0)
+                return 1;
+            *value = call->tta / 1000000.0;
+            return 0;
+        case SIP_ATTR_RETRANS:
+            *value = call->retrans;
+            return 0;
+        case SIP_ATTR_RESP1XX:
+        case SIP_ATTR_RESP2XX:
+        case SIP_ATTR_RESP3XX:
+        case SIP_ATTR_RESP4XX:
+        case SIP_ATTR_RESP5XX:
+        case SIP_ATTR_RESP6XX:
+            *value = call->responses[id - SIP_ATTR_RESP1XX];
+            return 0;
+        default:
+            // Other attributes are only stored as text
+            if (!(text = call_get_attribute(call, id)))
+                return 1;
+            *value = strtod(text, &end);
+            return (end == text);
+    }
+}
+
 void
 msg_set_attribute(sip_msg_t *msg, enum sip_attr_id id, const char *fmt, ...)
 {
@@ -99,6 +99,19 @@ enum sip_attr_id {
     SIP_ATTR_CONVDUR,
     //! Total call duration
     SIP_ATTR_TOTALDUR,
+    //! Post dial delay (first INVITE to first 18x response)
+    SIP_ATTR_PDD,
+    //! Time to answer (first INVITE to its 2xx response)
+    SIP_ATTR_TTA,
+    //! Retransmitted messages counter
+    SIP_ATTR_RETRANS,
+    //! Responses counters by class
+    SIP_ATTR_RESP1XX,
+    SIP_ATTR_RESP2XX,
+    SIP_ATTR_RESP3XX,
+    SIP_ATTR_RESP4XX,
+    SIP_ATTR_RESP5XX,
+    SIP_ATTR_RESP6XX,
     //! SIP Attribute count
     SIP_ATTR_SENTINEL
 };
@@ -123,6 +136,8 @@ struct sip_attr_hdr {
     char *desc;
     //! Attribute default display width
     int dwidth;
+    //! Attribute has a numeric value (@see call_get_attribute_num)
+    int numeric;
 };
 
 /**
@@ -132,12 +147,15 @@ struct sip_attr_hdr {
  * as a linked list for all attributes of a message (or call)
  * Right now, all the attributed are stored as strings, which may
  * not be the better option, but will fit our actual needs.
+ *
+ * Values are interned (see intern.h), so two attribute values are
+ * equal only if they are the same pointer.
  */
 struct sip_attr {
     //! Attribute header pointer
     sip_attr_hdr_t *hdr;
-    //! Attribute value
-    char *value;
+    //! Attribute value (interned)
+    const char *value;
     //! Next attribute in the linked list
     sip_attr_t *next;
 };
@@ -189,6 +207,18 @@ sip_attr_get_title(enum sip_attr_id id);
 const char *
 sip_attr_get_name(enum sip_attr_id id);
 
+/**
+ * @brief Check if an Attribute has numeric values
+ *
+ * Numeric attributes are compared and sorted using their
+ * numeric value instead of their text.
+ *
+ * @param id Attribute id
+ * @return 1 if attribute is numeric, 0 otherwise
+ */
+int
+sip_attr_is_numeric(enum sip_attr_id id);
+
 /**
  * @brief Get Attribute prefered display width
  *
@@ -266,6 +296,21 @@ call_set_attribute(struct sip_call *call, enum sip_attr_id id, const char *fmt,
 const char *
 call_get_attribute(struct sip_call *call, enum sip_attr_id id);
 
+/**
+ * @brief Return a call attribute numeric value
+ *
+ * Call metrics are read from call structure numeric fields, without
+ * parsing attribute texts. Durations and delays are returned in seconds
+ * with microseconds precision.
+ *
+ * @param call SIP call structure
+ * @param id Attribute id
+ * @param value Attribute numeric value
+ * @return 0 if attribute has a numeric value, 1 otherwise
+ */
+int
+call_get_attribute_num(struct sip_call *call, enum sip_attr_id id, double *value);
+
 /**
  * @brief Sets the attribute value for a given message
  *
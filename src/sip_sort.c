@@ -0,0 +1,308 @@
+/**************************************************************************
+ **
+ ** sngrep - SIP Messages flow viewer
+ **
+ ** Copyright (C) 2013,2014 Ivan Alonso (Kaian)
+ ** Copyright (C) 2013,2014 Irontec SL. All rights reserved.
+ **
+ ** This program is free software: you can redistribute it and/or modify
+ ** it under the terms of the GNU General Public License as published by
+ ** the Free Software Foundation, either version 3 of the License, or
+ ** (at your option) any later version.
+ **
+ ** This program is distributed in the hope that it will be useful,
+ ** but WITHOUT ANY WARRANTY; without even the implied warranty of
+ ** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ ** GNU General Public License for more details.
+ **
+ ** You should have received a copy of the GNU General Public License
+ ** along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ **
+ ****************************************************************************/
+/**
+ * @file sip_sort.c
+ * @author Ivan Alonso [aka Kaian] <kaian@irontec.com>
+ *
+ * @brief Source of functions defined in sip_sort.h
+ *
+ */
+#include "config.h"
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include "sip.h"
+#include "sip_sort.h"
+
+/**
+ * @brief Sort key of a call
+ */
+struct sip_sort_key {
+    //! Call has a value for the sort attribute
+    int hasvalue;
+    //! Numeric value
+    double number;
+    //! Text value
+    const char *text;
+    //! Sorted call
+    struct sip_call *call;
+};
+
+/**
+ * @brief Get the current sort key of a call
+ */
+static void
+sip_sort_get_key(sip_sort_t *sort, struct sip_call *call, struct sip_sort_key *key)
+{
+    memset(key, 0, sizeof(struct sip_sort_key));
+    key->call = call;
+
+    if (sort->numeric) {
+        key->hasvalue = (call_get_attribute_num(call, sort->by, &key->number) == 0);
+    } else {
+        key->text = call_get_attribute(call, sort->by);
+        key->hasvalue = (key->text != NULL);
+    }
+}
+
+/**
+ * @brief Compare a node with a sort key
+ *
+ * Calls with the same value are sorted by creation order.
+ *
+ * @return <0 if node goes before the key, >0 if it goes after, 0 if equal
+ */
+static int
+sip_sort_compare(sip_sort_t *sort, sip_sort_node_t *node, struct sip_sort_key *key)
+{
+    int cmp;
+
+    if (node->hasvalue != key->hasvalue) {
+        cmp = node->hasvalue - key->hasvalue;
+    } else if (!key->hasvalue) {
+        cmp = 0;
+    } else if (sort->numeric) {
+        cmp = (node->number > key->number) - (node->number < key->number);
+    } else {
+        cmp = strcmp(node->text, key->text);
+    }
+
+    // Same value, keep creation order
+    if (!cmp)
+        cmp = (node->call->index > key->call->index) - (node->call->index < key->call->index);
+    if (!cmp)
+        cmp = ((uintptr_t) node->call > (uintptr_t) key->call)
+              - ((uintptr_t) node->call < (uintptr_t) key->call);
+
+    return (sort->asc) ? cmp : -cmp;
+}
+
+/**
+ * @brief Find the last node before the key in each level
+ */
+static void
+sip_sort_search(sip_sort_t *sort, struct sip_sort_key *key, sip_sort_node_t **update)
+{
+    sip_sort_node_t *node = sort->head;
+    int i;
+
+    for (i = sort->level - 1; i >= 0; i--) {
+        while (node->next[i] && sip_sort_compare(sort, node->next[i], key) < 0)
+            node = node->next[i];
+        update[i] = node;
+    }
+}
+
+/**
+ * @brief Get a random level for a new node
+ *
+ * Each level has a quarter of the nodes of the level below.
+ */
+static int
+sip_sort_random_level()
+{
+    int level = 1;
+
+    while (level < SIP_SORT_MAXLEVEL && (rand() & 3) == 0)
+        level++;
+    return level;
+}
+
+void
+sip_sort_init(sip_sort_t *sort, enum sip_attr_id by, int asc)
+{
+    if (!sort->head) {
+        sort->head = malloc(sizeof(sip_sort_node_t) + sizeof(sip_sort_node_t *) * SIP_SORT_MAXLEVEL);
+        memset(sort->head, 0, sizeof(sip_sort_node_t) + sizeof(sip_sort_node_t *) * SIP_SORT_MAXLEVEL);
+        sort->head->level = SIP_SORT_MAXLEVEL;
+    }
+
+    // Use creation order if attribute is unknown
+    if ((int) by < 0 || by >= SIP_ATTR_SENTINEL)
+        by = SIP_ATTR_CALLINDEX;
+
+    sort->by = by;
+    sort->numeric = sip_attr_is_numeric(by);
+    sort->asc = asc;
+    sort->level = 1;
+    sort->tail = NULL;
+}
+
+void
+sip_sort_insert(sip_sort_t *sort, struct sip_call *call)
+{
+    sip_sort_node_t *update[SIP_SORT_MAXLEVEL], *node;
+    struct sip_sort_key key;
+    int i, level;
+
+    if (!sort->head || call->sortnode)
+        return;
+
+    sip_sort_get_key(sort, call, &key);
+
+    // Create a node with a random number of levels
+    level = sip_sort_random_level();
+    node = malloc(sizeof(sip_sort_node_t) + sizeof(sip_sort_node_t *) * level);
+    memset(node, 0, sizeof(sip_sort_node_t) + sizeof(sip_sort_node_t *) * level);
+    node->call = call;
+    node->level = level;
+    node->hasvalue = key.hasvalue;
+    node->number = key.number;
+    node->text = (key.text) ? strdup(key.text) : NULL;
+
+    // New levels start at list head
+    for (i = sort->level; i < level; i++)
+        sort->head->next[i] = NULL;
+
+    // Find node position in all levels
+    sip_sort_search(sort, &key, update);
+    for (i = sort->level; i < level; i++)
+        update[i] = sort->head;
+    if (level > sort->level)
+        sort->level = level;
+
+    // Link the new node
+    for (i = 0; i < level; i++) {
+        node->next[i] = update[i]->next[i];
+        update[i]->next[i] = node;
+    }
+    node->prev = (update[0] == sort->head) ? NULL : update[0];
+    if (node->next[0]) {
+        node->next[0]->prev = node;
+    } else {
+        sort->tail = node;
+    }
+
+    call->sortnode = node;
+}
+
+void
+sip_sort_remove(sip_sort_t *sort, struct sip_call *call)
+{
+    sip_sort_node_t *update[SIP_SORT_MAXLEVEL], *node;
+    struct sip_sort_key key;
+    int i;
+
+    if (!(node = call->sortnode))
+        return;
+
+    // Search using the key the node was sorted with
+    key.hasvalue = node->hasvalue;
+    key.number = node->number;
+    key.text = node->text;
+    key.call = call;
+    sip_sort_search(sort, &key, update);
+
+    // Unlink the node from all its levels
+    for (i = 0; i < node->level; i++) {
+        if (update[i]->next[i] == node)
+            update[i]->next[i] = node->next[i];
+    }
+    if (node->next[0]) {
+        node->next[0]->prev = node->prev;
+    } else {
+        sort->tail = node->prev;
+    }
+
+    // Remove empty levels
+    while (sort->level > 1 && !sort->head->next[sort->level - 1])
+        sort->level--;
+
+    call->sortnode = NULL;
+    free(node->text);
+    free(node);
+}
+
+void
+sip_sort_update(sip_sort_t *sort, struct sip_call *call)
+{
+    sip_sort_node_t *node;
+    struct sip_sort_key key;
+
+    if (!(node = call->sortnode))
+        return;
+
+    // Check if sort key has changed
+    sip_sort_get_key(sort, call, &key);
+    if (node->hasvalue == key.hasvalue) {
+        if (!key.hasvalue)
+            return;
+        if (sort->numeric && node->number == key.number)
+            return;
+        if (!sort->numeric && !strcmp(node->text, key.text))
+            return;
+    }
+
+    // Move the call to its new position
+    sip_sort_remove(sort, call);
+    sip_sort_insert(sort, call);
+}
+
+void
+sip_sort_clear(sip_sort_t *sort)
+{
+    sip_sort_node_t *node, *next;
+    int i;
+
+    if (!sort->head)
+        return;
+
+    for (node = sort->head->next[0]; node; node = next) {
+        next = node->next[0];
+        node->call->sortnode = NULL;
+        free(node->text);
+        free(node);
+    }
+
+    for (i = 0; i < SIP_SORT_MAXLEVEL; i++)
+        sort->head->next[i] = NULL;
+    sort->level = 1;
+    sort->tail = NULL;
+}
+
+struct sip_call *
+sip_sort_next(sip_sort_t *sort, struct sip_call *call)
+{
+    sip_sort_node_t *node;
+
+    if (!call) {
+        node = (sort->head) ? sort->head->next[0] : NULL;
+    } else {
+        node = (call->sortnode) ? call->sortnode->next[0] : NULL;
+    }
+
+    return (node) ? node->call : NULL;
+}
+
+struct sip_call *
+sip_sort_prev(sip_sort_t *sort, struct sip_call *call)
+{
+    sip_sort_node_t *node;
+
+    if (!call) {
+        node = sort->tail;
+    } else {
+        node = (call->sortnode) ? call->sortnode->prev : NULL;
+    }
+
+    return (node) ? node->call : NULL;
+}
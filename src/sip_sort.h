@@ -0,0 +1,148 @@
+/**************************************************************************
+ **
+ ** sngrep - SIP Messages flow viewer
+ **
+ ** Copyright (C) 2013,2014 Ivan Alonso (Kaian)
+ ** Copyright (C) 2013,2014 Irontec SL. All rights reserved.
+ **
+ ** This program is free software: you can redistribute it and/or modify
+ ** it under the terms of the GNU General Public License as published by
+ ** the Free Software Foundation, either version 3 of the License, or
+ ** (at your option) any later version.
+ **
+ ** This program is distributed in the hope that it will be useful,
+ ** but WITHOUT ANY WARRANTY; without even the implied warranty of
+ ** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ ** GNU General Public License for more details.
+ **
+ ** You should have received a copy of the GNU General Public License
+ ** along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ **
+ ****************************************************************************/
+/**
+ * @file sip_sort.h
+ * @author Ivan Alonso [aka Kaian] <kaian@irontec.com>
+ *
+ * @brief Functions to keep calls sorted by an attribute
+ *
+ * Calls are kept in a skip list ordered by the value of the sort
+ * attribute. Each call stores its sort key, so when a call changes only
+ * that call is moved to its new position, in O(log n). Walking the
+ * sorted calls from any call is O(1) per step.
+ *
+ * Numeric attributes are sorted by their numeric value and the rest by
+ * their text. Calls without value are sorted first, and calls with the
+ * same value keep their creation order.
+ */
+#ifndef __SNGREP_SIP_SORT_H
+#define __SNGREP_SIP_SORT_H
+
+#include "config.h"
+#include "sip_attr.h"
+
+//! Max number of skip list levels
+#define SIP_SORT_MAXLEVEL 16
+
+//! Shorter declaration of sip_sort structure
+typedef struct sip_sort sip_sort_t;
+//! Shorter declaration of sip_sort_node structure
+typedef struct sip_sort_node sip_sort_node_t;
+
+// Forward struct declaration for calls
+struct sip_call;
+
+/**
+ * @brief Skip list node of a call
+ */
+struct sip_sort_node {
+    //! Sorted call (NULL for list head)
+    struct sip_call *call;
+    //! Call has a value for the sort attribute
+    int hasvalue;
+    //! Sort key for numeric attributes
+    double number;
+    //! Sort key for text attributes
+    char *text;
+    //! Previous node in the lowest level
+    sip_sort_node_t *prev;
+    //! Number of levels of this node
+    int level;
+    //! Next node in each level
+    sip_sort_node_t *next[];
+};
+
+/**
+ * @brief Sorted calls list
+ */
+struct sip_sort {
+    //! Sort attribute
+    enum sip_attr_id by;
+    //! Sort attribute is numeric
+    int numeric;
+    //! Ascending (1) or descending (0) order
+    int asc;
+    //! Current number of used levels
+    int level;
+    //! List head, with all levels
+    sip_sort_node_t *head;
+    //! Last node in the lowest level
+    sip_sort_node_t *tail;
+};
+
+/**
+ * @brief Initialize a sorted list
+ *
+ * @param sort Sorted list
+ * @param by Sort attribute
+ * @param asc 1 for ascending order, 0 for descending
+ */
+void
+sip_sort_init(sip_sort_t *sort, enum sip_attr_id by, int asc);
+
+/**
+ * @brief Add a new call to the sorted list
+ */
+void
+sip_sort_insert(sip_sort_t *sort, struct sip_call *call);
+
+/**
+ * @brief Remove a call from the sorted list
+ */
+void
+sip_sort_remove(sip_sort_t *sort, struct sip_call *call);
+
+/**
+ * @brief Move a call to its new position after it has changed
+ *
+ * Call is only moved if its sort key has changed.
+ */
+void
+sip_sort_update(sip_sort_t *sort, struct sip_call *call);
+
+/**
+ * @brief Remove all calls from the sorted list
+ */
+void
+sip_sort_clear(sip_sort_t *sort);
+
+/**
+ * @brief Get the next call in sort order
+ *
+ * @param sort Sorted list
+ * @param call Current call or NULL to get the first one
+ * @return next call or NULL
+ */
+struct sip_call *
+sip_sort_next(sip_sort_t *sort, struct sip_call *call);
+
+/**
+ * @brief Get the previous call in sort order
+ *
+ * @param sort Sorted list
+ * @param call Current call or NULL to get the last one
+ * @return previous call or NULL
+ */
+struct sip_call *
+sip_sort_prev(sip_sort_t *sort, struct sip_call *call);
+
+#endif /* __SNGREP_SIP_SORT_H */
@@ -0,0 +1,405 @@
+/**************************************************************************
+ **
+ ** sngrep - SIP Messages flow viewer
+ **
+ ** Copyright (C) 2013,2014 Ivan Alonso (Kaian)
+ ** Copyright (C) 2013,2014 Irontec SL. All rights reserved.
+ **
+ ** This program is free software: you can redistribute it and/or modify
+ ** it under the terms of the GNU General Public License as published by
+ ** the Free Software Foundation, either version 3 of the License, or
+ ** (at your option) any later version.
+ **
+ ** This program is distributed in the hope that it will be useful,
+ ** but WITHOUT ANY WARRANTY; without even the implied warranty of
+ ** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ ** GNU General Public License for more details.
+ **
+ ** You should have received a copy of the GNU General Public License
+ ** along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ **
+ ****************************************************************************/
+/**
+ * @file spool.c
+ * @author Ivan Alonso [aka Kaian] <kaian@irontec.com>
+ *
+ * @brief Source of functions defined in spool.h
+ *
+ */
+#include "config.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <limits.h>
+#include <unistd.h>
+#include "spool.h"
+#include "capture.h"
+#include "option.h"
+
+//! Spool file and payload cache
+static spool_t spool = {
+    .state = SPOOL_UNKNOWN,
+    .fd = -1,
+    .lock = PTHREAD_MUTEX_INITIALIZER
+};
+
+/**
+ * @brief Create the spool file if capture.spool option is enabled
+ *
+ * Spool file is removed as soon as it's created, so it will be deleted
+ * when sngrep exits.
+ */
+static void
+spool_open()
+{
+    char path[PATH_MAX];
+    const char *tmpdir;
+
+    if (!is_option_enabled("capture.spool")) {
+        spool.state = SPOOL_DISABLED;
+        return;
+    }
+
+    spool.state = SPOOL_ENABLED;
+    spool.limit = (size_t) get_option_int_value("capture.spoolcache") * 1024 * 1024;
+
+    if (!(tmpdir = getenv("TMPDIR")))
+        tmpdir = "/tmp";
+    snprintf(path, sizeof(path), "%s/sngrep-spool-XXXXXX", tmpdir);
+
+    // Without spool file only messages from input file will be released
+    if ((spool.fd = mkstemp(path)) == -1)
+        return;
+    unlink(path);
+
+    if (write(spool.fd, SPOOL_MAGIC, strlen(SPOOL_MAGIC)) != strlen(SPOOL_MAGIC)) {
+        close(spool.fd);
+        spool.fd = -1;
+        return;
+    }
+
+    spool.size = strlen(SPOOL_MAGIC);
+    spool.buffer = malloc(SPOOL_BUFFER_SIZE);
+}
+
+/**
+ * @brief Write buffered data to the spool file
+ *
+ * @return 0 if data has been written, 1 otherwise
+ */
+static int
+spool_flush()
+{
+    off_t offset = spool.size - spool.buflen;
+    size_t written = 0;
+    ssize_t ret;
+
+    while (written < spool.buflen) {
+        if ((ret = pwrite(spool.fd, spool.buffer + written, spool.buflen - written,
+                          offset + written)) <= 0)
+            break;
+        written += ret;
+    }
+
+    // Data that could not be written is discarded
+    ret = (written != spool.buflen);
+    if (ret && !spool.lost)
+        spool.lost = offset;
+    spool.buflen = 0;
+    return ret;
+}
+
+/**
+ * @brief Append data to the spool file
+ *
+ * Once a write has failed, nothing else is written.
+ *
+ * @return 0 if data has been written or buffered, 1 otherwise
+ */
+static int
+spool_write(const void *data, size_t len)
+{
+    // Buffer can't store this data
+    if (spool.buflen + len > SPOOL_BUFFER_SIZE)
+        spool_flush();
+
+    if (spool.lost)
+        return 1;
+
+    if (len > SPOOL_BUFFER_SIZE) {
+        if (pwrite(spool.fd, data, len, spool.size) != (ssize_t) len) {
+            spool.lost = spool.size;
+            return 1;
+        }
+    } else {
+        memcpy(spool.buffer + spool.buflen, data, len);
+        spool.buflen += len;
+    }
+    spool.size += len;
+    return 0;
+}
+
+/**
+ * @brief Read data from the spool file
+ *
+ * @return 0 if data has been read, 1 otherwise
+ */
+static int
+spool_read(off_t offset, void *data, size_t len)
+{
+    off_t bufstart = spool.size - spool.buflen;
+
+    // Data not written yet
+    if (offset >= bufstart) {
+        if (offset + len > spool.size)
+            return 1;
+        memcpy(data, spool.buffer + (offset - bufstart), len);
+        return 0;
+    }
+
+    return pread(spool.fd, data, len, offset) != (ssize_t) len;
+}
+
+/**
+ * @brief Get the memory used by a message payload and packet
+ */
+static size_t
+spool_msg_size(sip_msg_t *msg)
+{
+    size_t size = 0;
+
+    if (msg->payload)
+        size += strlen(msg->payload) + 1;
+    if (msg->pcap_packet && msg->pcap_header)
+        size += msg->pcap_header->caplen;
+    return size;
+}
+
+/**
+ * @brief Remove a message from the cached messages list
+ */
+static void
+spool_cache_unlink(sip_msg_t *msg)
+{
+    if (!msg->cached)
+        return;
+
+    if (msg->cache_prev) {
+        msg->cache_prev->cache_next = msg->cache_next;
+    } else {
+        spool.first = msg->cache_next;
+    }
+    if (msg->cache_next) {
+        msg->cache_next->cache_prev = msg->cache_prev;
+    } else {
+        spool.last = msg->cache_prev;
+    }
+
+    msg->cache_prev = msg->cache_next = NULL;
+    msg->cached = 0;
+    spool.cached -= msg->cachesize;
+}
+
+/**
+ * @brief Add a message as the most recently used of the cached list
+ *
+ * Only messages that can be read again are added to the list.
+ */
+static void
+spool_cache_push(sip_msg_t *msg)
+{
+    spool_cache_unlink(msg);
+
+    if (!msg->spool_offset && !msg->pcap_offset)
+        return;
+
+    msg->cache_next = spool.first;
+    if (spool.first) {
+        spool.first->cache_prev = msg;
+    } else {
+        spool.last = msg;
+    }
+    spool.first = msg;
+
+    msg->cached = 1;
+    msg->cachesize = spool_msg_size(msg);
+    spool.cached += msg->cachesize;
+}
+
+void
+spool_store(sip_msg_t *msg)
+{
+    uint32_t lens[2];
+
+    pthread_mutex_lock(&spool.lock);
+
+    if (spool.state == SPOOL_UNKNOWN)
+        spool_open();
+
+    if (spool.state == SPOOL_ENABLED) {
+        // Store data that can't be read from the input file
+        if (!msg->pcap_offset && spool.fd != -1 && msg->payload && msg->pcap_packet) {
+            lens[0] = strlen(msg->payload) + 1;
+            lens[1] = msg->pcap_header->caplen;
+            msg->spool_offset = spool.size;
+            // Keep the message in memory if it could not be stored
+            if (spool_write(lens, sizeof(lens)) != 0
+                || spool_write(msg->payload, lens[0]) != 0
+                || spool_write(msg->pcap_packet, lens[1]) != 0)
+                msg->spool_offset = 0;
+        }
+        spool_cache_push(msg);
+    }
+
+    pthread_mutex_unlock(&spool.lock);
+}
+
+/**
+ * @brief Read message payload and packet from spool file
+ *
+ * Spool lock must be held by the caller.
+ */
+static void
+spool_load_message(sip_msg_t *msg, char **payload, u_char **packet)
+{
+    uint32_t lens[2];
+
+    *payload = NULL;
+    *packet = NULL;
+
+    if (spool_read(msg->spool_offset, lens, sizeof(lens)) == 0) {
+        *payload = malloc(lens[0]);
+        *packet = malloc(lens[1]);
+        if (spool_read(msg->spool_offset + sizeof(lens), *payload, lens[0]) != 0
+            || spool_read(msg->spool_offset + sizeof(lens) + lens[0], *packet, lens[1]) != 0) {
+            free(*payload);
+            free(*packet);
+            *payload = NULL;
+            *packet = NULL;
+        } else {
+            (*payload)[lens[0] - 1] = '\0';
+        }
+    }
+}
+
+void
+spool_fetch(sip_msg_t *msg)
+{
+    char *payload = NULL;
+    u_char *packet = NULL;
+
+    // Payloads are never released without spool
+    if (spool.state != SPOOL_ENABLED && msg->payload && msg->pcap_packet)
+        return;
+
+    pthread_mutex_lock(&spool.lock);
+
+    // Read released data
+    if (!msg->payload || !msg->pcap_packet) {
+        if (msg->spool_offset) {
+            spool_load_message(msg, &payload, &packet);
+        } else {
+            // Parsing the input file packet doesn't require the lock
+            pthread_mutex_unlock(&spool.lock);
+            capture_load_message(msg, &payload, &packet);
+            pthread_mutex_lock(&spool.lock);
+        }
+
+        // Other threads may have loaded the message meanwhile
+        if (!msg->payload) {
+            msg->payload = (payload) ? payload : strdup("");
+            payload = NULL;
+        }
+        if (!msg->pcap_packet) {
+            msg->pcap_packet = packet;
+            packet = NULL;
+        }
+    }
+
+    // Mark as most recently used
+    if (spool.state == SPOOL_ENABLED)
+        spool_cache_push(msg);
+
+    pthread_mutex_unlock(&spool.lock);
+
+    free(payload);
+    free(packet);
+}
+
+void
+spool_remove(sip_msg_t *msg)
+{
+    pthread_mutex_lock(&spool.lock);
+    spool_cache_unlink(msg);
+    pthread_mutex_unlock(&spool.lock);
+}
+
+/**
+ * @brief Get the spool file offset where message stored data ends
+ */
+static off_t
+spool_record_end(sip_msg_t *msg)
+{
+    return msg->spool_offset + sizeof(uint32_t) * 2 + strlen(msg->payload) + 1
+           + msg->pcap_header->caplen;
+}
+
+void
+spool_trim()
+{
+    sip_msg_t *msg;
+
+    if (spool.state != SPOOL_ENABLED)
+        return;
+
+    pthread_mutex_lock(&spool.lock);
+
+    // Released messages must be in the spool file
+    if (!spool.pins && spool.cached > spool.limit && spool.buflen)
+        spool_flush();
+
+    while (!spool.pins && spool.cached > spool.limit && (msg = spool.last)) {
+        spool_cache_unlink(msg);
+        // Data that could not be written is kept in memory
+        if (spool.lost && msg->spool_offset
+            && spool_record_end(msg) > spool.lost) {
+            msg->spool_offset = 0;
+            continue;
+        }
+        free(msg->payload);
+        msg->payload = NULL;
+        free(msg->pcap_packet);
+        msg->pcap_packet = NULL;
+    }
+    pthread_mutex_unlock(&spool.lock);
+}
+
+void
+spool_pin()
+{
+    pthread_mutex_lock(&spool.lock);
+    spool.pins++;
+    pthread_mutex_unlock(&spool.lock);
+}
+
+void
+spool_unpin()
+{
+    pthread_mutex_lock(&spool.lock);
+    spool.pins--;
+    pthread_mutex_unlock(&spool.lock);
+}
+
+void
+spool_close()
+{
+    pthread_mutex_lock(&spool.lock);
+    if (spool.fd != -1)
+        close(spool.fd);
+    spool.fd = -1;
+    free(spool.buffer);
+    spool.buffer = NULL;
+    spool.buflen = 0;
+    pthread_mutex_unlock(&spool.lock);
+}
@@ -0,0 +1,165 @@
+/**************************************************************************
+ **
+ ** sngrep - SIP Messages flow viewer
+ **
+ ** Copyright (C) 2013,2014 Ivan Alonso (Kaian)
+ ** Copyright (C) 2013,2014 Irontec SL. All rights reserved.
+ **
+ ** This program is free software: you can redistribute it and/or modify
+ ** it under the terms of the GNU General Public License as published by
+ ** the Free Software Foundation, either version 3 of the License, or
+ ** (at your option) any later version.
+ **
+ ** This program is distributed in the hope that it will be useful,
+ ** but WITHOUT ANY WARRANTY; without even the implied warranty of
+ ** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ ** GNU General Public License for more details.
+ **
+ ** You should have received a copy of the GNU General Public License
+ ** along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ **
+ ****************************************************************************/
+/**
+ * @file spool.h
+ * @author Ivan Alonso [aka Kaian] <kaian@irontec.com>
+ *
+ * @brief Functions to keep message payloads out of memory
+ *
+ * When capture.spool option is enabled, captured message payloads and
+ * packets are appended to a spool file as soon as they are added to a
+ * call. Messages read from a mapped input file don't need to be spooled,
+ * as they can be read again from the input file.
+ *
+ * Payloads in memory are kept in a cache of capture.spoolcache MB,
+ * sorted by last use. When the cache is full, least recently used
+ * payloads are released and read again from the spool or input file
+ * next time they are requested (see msg_get_payload).
+ *
+ * Released payloads may be in use by the interface, so the cache is only
+ * trimmed from the interface thread before drawing panels (or the batch
+ * mode thread), and never while other threads (like call exports) have
+ * pinned the cache.
+ *
+ * If the spool file can not be written, messages not stored yet are kept
+ * in memory and nothing else is written to the spool file.
+ */
+#ifndef __SNGREP_SPOOL_H
+#define __SNGREP_SPOOL_H
+
+#include "config.h"
+#include <pthread.h>
+#include <sys/types.h>
+#include "sip.h"
+
+//! Spool file write buffer size
+#define SPOOL_BUFFER_SIZE (256 * 1024)
+//! Spool file header (no message is stored at offset 0)
+#define SPOOL_MAGIC "SNGSPOOL"
+
+//! Shorter declaration of spool structure
+typedef struct spool spool_t;
+
+/**
+ * @brief Spool states
+ */
+enum spool_state {
+    //! Option not checked yet
+    SPOOL_UNKNOWN = 0,
+    //! Payloads are kept in memory
+    SPOOL_DISABLED,
+    //! Payloads are released when the cache is full
+    SPOOL_ENABLED,
+};
+
+/**
+ * @brief Spool file and payload cache information
+ */
+struct spool {
+    //! Spool state
+    enum spool_state state;
+    //! Spool file descriptor (-1 if file could not be created)
+    int fd;
+    //! Spool file size, including buffered data
+    off_t size;
+    //! Data from this offset could not be written (0 if no write failed)
+    off_t lost;
+    //! Data pending to be written
+    char *buffer;
+    //! Bytes pending to be written
+    size_t buflen;
+    //! Cached messages, most recently used first
+    sip_msg_t *first;
+    //! Least recently used cached message
+    sip_msg_t *last;
+    //! Bytes used by cached messages
+    size_t cached;
+    //! Max bytes used by cached messages
+    size_t limit;
+    //! Threads using payloads outside the interface thread
+    int pins;
+    //! Lock for spool file and cache
+    pthread_mutex_t lock;
+};
+
+/**
+ * @brief Store the payload of a new message
+ *
+ * Append the message payload and packet to the spool file (if they can
+ * not be read again from the input file) and add the message to the
+ * payload cache.
+ *
+ * @param msg SIP message added to a call
+ */
+void
+spool_store(sip_msg_t *msg);
+
+/**
+ * @brief Make sure the message payload and packet are in memory
+ *
+ * Read them from the spool or input file if they have been released
+ * and mark the message as most recently used.
+ *
+ * @param msg SIP message
+ */
+void
+spool_fetch(sip_msg_t *msg);
+
+/**
+ * @brief Remove a message from the payload cache
+ *
+ * @param msg SIP message being destroyed
+ */
+void
+spool_remove(sip_msg_t *msg);
+
+/**
+ * @brief Release least recently used payloads until cache is not full
+ *
+ * This must only be called when no payload is being used.
+ */
+void
+spool_trim();
+
+/**
+ * @brief Keep cached payloads in memory
+ *
+ * Payloads are not released by spool_trim until spool_unpin is called.
+ * Used by threads that read messages payloads while the interface is
+ * running.
+ */
+void
+spool_pin();
+
+/**
+ * @brief Allow releasing cached payloads again
+ */
+void
+spool_unpin();
+
+/**
+ * @brief Close the spool file and free its memory
+ */
+void
+spool_close();
+
+#endif /* __SNGREP_SPOOL_H */
@@ -0,0 +1,362 @@
+/**************************************************************************
+ **
+ ** sngrep - SIP Messages flow viewer
+ **
+ ** Copyright (C) 2013,2014 Ivan Alonso (Kaian)
+ ** Copyright (C) 2013,2014 Irontec SL. All rights reserved.
+ **
+ ** This program is free software: you can redistribute it and/or modify
+ ** it under the terms of the GNU General Public License as published by
+ ** the Free Software Foundation, either version 3 of the License, or
+ ** (at your option) any later version.
+ **
+ ** This program is distributed in the hope that it will be useful,
+ ** but WITHOUT ANY WARRANTY; without even the implied warranty of
+ ** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ ** GNU General Public License for more details.
+ **
+ ** You should have received a copy of the GNU General Public License
+ ** along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ **
+ ****************************************************************************/
+/**
+ * @file stats.c
+ * @author Ivan Alonso [aka Kaian] <kaian@irontec.com>
+ *
+ * @brief Source of functions defined in stats.h
+ *
+ */
+#include "config.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <arpa/inet.h>
+#include "stats.h"
+
+//! Aggregated traffic statistics
+static stats_t stats = { .lock = PTHREAD_MUTEX_INITIALIZER };
+
+//! Names of counted methods
+static const char *stats_methods[STATS_METHOD_COUNT] = {
+    "INVITE", "ACK", "BYE", "CANCEL", "REGISTER", "OPTIONS", "SUBSCRIBE",
+    "NOTIFY", "PUBLISH", "MESSAGE", "INFO", "PRACK", "UPDATE", "REFER", "Other"
+};
+
+/**
+ * @brief Get counted method from its name
+ */
+static enum stats_method
+stats_method_from_name(const char *name)
+{
+    int i;
+
+    for (i = 0; i < STATS_METHOD_OTHER; i++) {
+        if (!strcasecmp(name, stats_methods[i]))
+            return i;
+    }
+    return STATS_METHOD_OTHER;
+}
+
+/**
+ * @brief Calculate top key hash (FNV-1a)
+ */
+static uint32_t
+stats_key_hash(const char *key)
+{
+    uint32_t hash = 2166136261U;
+
+    for (; *key; key++) {
+        hash ^= (unsigned char) *key;
+        hash *= 16777619U;
+    }
+    return hash;
+}
+
+/**
+ * @brief Count a key in a space-saving summary
+ *
+ * If the key is not tracked and the summary is full, it replaces the
+ * key with the lowest count, inheriting its count as error.
+ */
+static void
+stats_topk_add(stats_topk_t *topk, const char *key)
+{
+    stats_topk_entry_t *entry, *min = NULL;
+    uint32_t hash = stats_key_hash(key);
+    int i;
+
+    for (i = 0; i < topk->count; i++) {
+        entry = &topk->entries[i];
+        if (entry->hash == hash && !strcmp(entry->key, key)) {
+            entry->count++;
+            return;
+        }
+        if (!min || entry->count < min->count)
+            min = entry;
+    }
+
+    if (topk->count < STATS_TOPK) {
+        entry = &topk->entries[topk->count++];
+        entry->count = 1;
+        entry->error = 0;
+    } else {
+        entry = min;
+        entry->error = min->count;
+        entry->count = min->count + 1;
+    }
+    snprintf(entry->key, STATS_KEYLEN, "%s", key);
+    entry->hash = hash;
+}
+
+/**
+ * @brief Move top summaries to the window of the given second
+ *
+ * Current summaries become the previous ones when a new window starts.
+ */
+static void
+stats_rotate_top(time_t sec)
+{
+    time_t start = sec - sec % STATS_WINDOW;
+    int i;
+
+    if (start <= stats.topstart)
+        return;
+
+    if (start == stats.topstart + STATS_WINDOW) {
+        stats.topcur = !stats.topcur;
+    } else {
+        // Previous window has no traffic
+        for (i = 0; i < STATS_TOP_COUNT; i++)
+            memset(&stats.top[i][!stats.topcur], 0, sizeof(stats_topk_t));
+    }
+
+    for (i = 0; i < STATS_TOP_COUNT; i++)
+        memset(&stats.top[i][stats.topcur], 0, sizeof(stats_topk_t));
+    stats.topstart = start;
+}
+
+/**
+ * @brief Get the bucket of a second of traffic
+ *
+ * @return bucket or NULL if the second is no longer in the window
+ */
+static stats_bucket_t *
+stats_get_bucket(time_t sec)
+{
+    stats_bucket_t *bucket;
+
+    // Too old to be counted
+    if (stats.last && sec <= stats.last - STATS_WINDOW)
+        return NULL;
+
+    if (!stats.first || sec < stats.first)
+        stats.first = sec;
+    if (sec > stats.last)
+        stats.last = sec;
+
+    // Reuse the bucket of an old second
+    bucket = &stats.buckets[sec % STATS_WINDOW];
+    if (bucket->sec != sec) {
+        memset(bucket, 0, sizeof(stats_bucket_t));
+        bucket->sec = sec;
+    }
+    return bucket;
+}
+
+void
+stats_add_message(sip_msg_t *msg)
+{
+    stats_bucket_t *bucket;
+    const char *method, *user;
+    char src[INET_ADDRSTRLEN], dst[INET_ADDRSTRLEN];
+    int code;
+
+    if (!(method = msg_get_attribute(msg, SIP_ATTR_METHOD)))
+        return;
+
+    inet_ntop(AF_INET, &msg->src, src, sizeof(src));
+    inet_ntop(AF_INET, &msg->dst, dst, sizeof(dst));
+
+    pthread_mutex_lock(&stats.lock);
+    bucket = stats_get_bucket(msg->ts.tv_sec);
+    stats_rotate_top(msg->ts.tv_sec);
+
+    if (msg->retrans) {
+        // Retransmissions are only counted by themselves
+        if (bucket)
+            bucket->retrans++;
+    } else if (msg->request) {
+        if (bucket)
+            bucket->requests[stats_method_from_name(method)]++;
+        if ((user = msg_get_attribute(msg, SIP_ATTR_SIPFROMUSER)))
+            stats_topk_add(&stats.top[STATS_TOP_FROM][stats.topcur], user);
+    } else if ((code = atoi(method)) >= 100 && code <= 699) {
+        if (bucket)
+            bucket->responses[code / 100 - 1]++;
+        // Authentication challenges are not errors
+        if (code >= 400 && code != 401 && code != 407)
+            stats_topk_add(&stats.top[STATS_TOP_ERROR][stats.topcur], src);
+    }
+
+    stats_topk_add(&stats.top[STATS_TOP_SRC][stats.topcur], src);
+    stats_topk_add(&stats.top[STATS_TOP_DST][stats.topcur], dst);
+    pthread_mutex_unlock(&stats.lock);
+}
+
+void
+stats_add_setup(sip_msg_t *msg)
+{
+    stats_bucket_t *bucket;
+    const char *method;
+    int code, answered = 0, effective = 1;
+
+    if (!(method = msg_get_attribute(msg, SIP_ATTR_METHOD)))
+        return;
+
+    // Requests ending a setup are caller cancellations
+    if (!msg->request) {
+        code = atoi(method);
+        // Setup continues after authentication
+        if (code == 401 || code == 407)
+            return;
+        answered = (code >= 200 && code < 300);
+        effective = answered || code == 408 || code == 480 || code == 486
+                    || code == 487 || code == 600 || code == 603;
+    }
+
+    pthread_mutex_lock(&stats.lock);
+    if ((bucket = stats_get_bucket(msg->ts.tv_sec))) {
+        bucket->setups++;
+        bucket->answered += answered;
+        bucket->effective += effective;
+    }
+    pthread_mutex_unlock(&stats.lock);
+}
+
+void
+stats_add_rejected(time_t sec, int count)
+{
+    stats_bucket_t *bucket;
+
+    pthread_mutex_lock(&stats.lock);
+    if ((bucket = stats_get_bucket(sec)))
+        bucket->rejected += count;
+    pthread_mutex_unlock(&stats.lock);
+}
+
+void
+stats_clear()
+{
+    pthread_mutex_lock(&stats.lock);
+    stats.first = stats.last = stats.topstart = 0;
+    memset(stats.buckets, 0, sizeof(stats.buckets));
+    memset(stats.top, 0, sizeof(stats.top));
+    pthread_mutex_unlock(&stats.lock);
+}
+
+int
+stats_get_window(time_t now, stats_bucket_t *total)
+{
+    stats_bucket_t *bucket;
+    int i, j, seconds = 0;
+
+    memset(total, 0, sizeof(stats_bucket_t));
+
+    pthread_mutex_lock(&stats.lock);
+    if (stats.first) {
+        // Window ends at the last second with traffic at least
+        if (now < stats.last)
+            now = stats.last;
+
+        for (i = 0; i < STATS_WINDOW; i++) {
+            bucket = &stats.buckets[i];
+            if (!bucket->sec || bucket->sec <= now - STATS_WINDOW || bucket->sec > now)
+                continue;
+            for (j = 0; j < STATS_METHOD_COUNT; j++)
+                total->requests[j] += bucket->requests[j];
+            for (j = 0; j < 6; j++)
+                total->responses[j] += bucket->responses[j];
+            total->retrans += bucket->retrans;
+            total->rejected += bucket->rejected;
+            total->setups += bucket->setups;
+            total->answered += bucket->answered;
+            total->effective += bucket->effective;
+        }
+
+        seconds = now - stats.first + 1;
+        if (seconds > STATS_WINDOW)
+            seconds = STATS_WINDOW;
+    }
+    pthread_mutex_unlock(&stats.lock);
+
+    return seconds;
+}
+
+/**
+ * @brief Sort top keys by count, higher first
+ */
+static int
+stats_topk_compare(const void *a, const void *b)
+{
+    return ((const stats_topk_entry_t *) b)->count - ((const stats_topk_entry_t *) a)->count;
+}
+
+int
+stats_get_top(enum stats_top top, time_t now, stats_topk_entry_t *entries, int max)
+{
+    stats_topk_entry_t merged[STATS_TOPK * 2];
+    stats_topk_t *topk;
+    time_t start, wstart;
+    int i, j, w, count = 0;
+
+    pthread_mutex_lock(&stats.lock);
+    if (now < stats.last)
+        now = stats.last;
+    start = now - now % STATS_WINDOW;
+
+    // Merge current and previous windows keys
+    for (w = 0; w < 2; w++) {
+        wstart = (w == 0) ? stats.topstart : stats.topstart - STATS_WINDOW;
+        if (!stats.topstart || wstart < start - STATS_WINDOW)
+            continue;
+
+        topk = &stats.top[top][(w == 0) ? stats.topcur : !stats.topcur];
+        for (i = 0; i < topk->count; i++) {
+            for (j = 0; j < count; j++) {
+                if (merged[j].hash == topk->entries[i].hash
+                    && !strcmp(merged[j].key, topk->entries[i].key))
+                    break;
+            }
+            if (j == count) {
+                merged[count++] = topk->entries[i];
+            } else {
+                merged[j].count += topk->entries[i].count;
+                merged[j].error += topk->entries[i].error;
+            }
+        }
+    }
+    pthread_mutex_unlock(&stats.lock);
+
+    // Only keep the guaranteed part of each count
+    for (i = 0, j = 0; i < count; i++) {
+        merged[i].count -= merged[i].error;
+        merged[i].error = 0;
+        if (merged[i].count > 0)
+            merged[j++] = merged[i];
+    }
+    count = j;
+
+    qsort(merged, count, sizeof(stats_topk_entry_t), stats_topk_compare);
+    if (count > max)
+        count = max;
+    memcpy(entries, merged, sizeof(stats_topk_entry_t) * count);
+
+    return count;
+}
+
+const char *
+stats_method_name(enum stats_method method)
+{
+    return stats_methods[method];
+}
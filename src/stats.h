@@ -0,0 +1,239 @@
+/**************************************************************************
+ **
+ ** sngrep - SIP Messages flow viewer
+ **
+ ** Copyright (C) 2013,2014 Ivan Alonso (Kaian)
+ ** Copyright (C) 2013,2014 Irontec SL. All rights reserved.
+ **
+ ** This program is free software: you can redistribute it and/or modify
+ ** it under the terms of the GNU General Public License as published by
+ ** the Free Software Foundation, either version 3 of the License, or
+ ** (at your option) any later version.
+ **
+ ** This program is distributed in the hope that it will be useful,
+ ** but WITHOUT ANY WARRANTY; without even the implied warranty of
+ ** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ ** GNU General Public License for more details.
+ **
+ ** You should have received a copy of the GNU General Public License
+ ** along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ **
+ ****************************************************************************/
+/**
+ * @file stats.h
+ * @author Ivan Alonso [aka Kaian] <kaian@irontec.com>
+ *
+ * @brief Functions to keep aggregated traffic statistics
+ *
+ * Every message added to a call is accounted here, using fixed size
+ * structures, so statistics don't depend on the number of stored calls.
+ *
+ * Request rates, response classes and call setup results are counted in
+ * a ring of one second buckets (the last STATS_WINDOW seconds of traffic).
+ * Top addresses and users are counted using space-saving summaries of
+ * STATS_TOPK keys for the current and previous windows.
+ *
+ * Answer seizure ratio (ASR) is the percentage of finished call setups
+ * that were answered. Network effectiveness ratio (NER) also counts as
+ * effective setups the ones ended by the user: busy (486, 600), no answer
+ * (408, 480, 487), declined (603) or cancelled by the caller.
+ * Authentication challenges (401, 407) don't end a call setup.
+ */
+#ifndef __SNGREP_STATS_H
+#define __SNGREP_STATS_H
+
+#include "config.h"
+#include <stdint.h>
+#include <time.h>
+#include <pthread.h>
+#include "sip.h"
+
+//! Seconds of traffic in statistics window
+#define STATS_WINDOW 60
+//! Keys tracked in each top summary
+#define STATS_TOPK 64
+//! Max length of top keys
+#define STATS_KEYLEN 64
+
+//! Shorter declaration of stats structure
+typedef struct stats stats_t;
+//! Shorter declaration of stats_bucket structure
+typedef struct stats_bucket stats_bucket_t;
+//! Shorter declaration of stats_topk structure
+typedef struct stats_topk stats_topk_t;
+//! Shorter declaration of stats_topk_entry structure
+typedef struct stats_topk_entry stats_topk_entry_t;
+
+/**
+ * @brief Counted request methods
+ */
+enum stats_method {
+    STATS_METHOD_INVITE = 0,
+    STATS_METHOD_ACK,
+    STATS_METHOD_BYE,
+    STATS_METHOD_CANCEL,
+    STATS_METHOD_REGISTER,
+    STATS_METHOD_OPTIONS,
+    STATS_METHOD_SUBSCRIBE,
+    STATS_METHOD_NOTIFY,
+    STATS_METHOD_PUBLISH,
+    STATS_METHOD_MESSAGE,
+    STATS_METHOD_INFO,
+    STATS_METHOD_PRACK,
+    STATS_METHOD_UPDATE,
+    STATS_METHOD_REFER,
+    //! Any other request method
+    STATS_METHOD_OTHER,
+    //! Number of counted methods
+    STATS_METHOD_COUNT,
+};
+
+/**
+ * @brief Available top summaries
+ */
+enum stats_top {
+    //! Message source addresses
+    STATS_TOP_SRC = 0,
+    //! Message destination addresses
+    STATS_TOP_DST,
+    //! From users of requests
+    STATS_TOP_FROM,
+    //! Source addresses of error responses (4xx-6xx)
+    STATS_TOP_ERROR,
+    //! Number of top summaries
+    STATS_TOP_COUNT,
+};
+
+/**
+ * @brief Counters of one second of traffic
+ */
+struct stats_bucket {
+    //! Second of this bucket
+    time_t sec;
+    //! Requests by method
+    int requests[STATS_METHOD_COUNT];
+    //! Responses by class (1xx to 6xx)
+    int responses[6];
+    //! Retransmitted messages
+    int retrans;
+    //! Packets rejected before parsing (not SIP)
+    int rejected;
+    //! Finished call setups
+    int setups;
+    //! Answered call setups
+    int answered;
+    //! Effective call setups (including answered)
+    int effective;
+};
+
+/**
+ * @brief Space-saving summary counter
+ */
+struct stats_topk_entry {
+    //! Counted key
+    char key[STATS_KEYLEN];
+    //! Key hash, to speed up searches
+    uint32_t hash;
+    //! Estimated count
+    int count;
+    //! Max overestimation of count
+    int error;
+};
+
+/**
+ * @brief Space-saving summary of most frequent keys
+ */
+struct stats_topk {
+    //! Tracked keys
+    stats_topk_entry_t entries[STATS_TOPK];
+    //! Number of used entries
+    int count;
+};
+
+/**
+ * @brief Aggregated traffic statistics
+ */
+struct stats {
+    //! First second with traffic
+    time_t first;
+    //! Last second with traffic
+    time_t last;
+    //! Ring of one second buckets
+    stats_bucket_t buckets[STATS_WINDOW];
+    //! First second of the current top window
+    time_t topstart;
+    //! Top summaries of current and previous windows
+    stats_topk_t top[STATS_TOP_COUNT][2];
+    //! Index of current window top summaries
+    int topcur;
+    //! Protect access from capture and interface threads
+    pthread_mutex_t lock;
+};
+
+/**
+ * @brief Account a message added to a call
+ *
+ * @param msg SIP message
+ */
+void
+stats_add_message(sip_msg_t *msg);
+
+/**
+ * @brief Account the message that ended a call setup
+ *
+ * @param msg Final response or CANCEL request
+ */
+void
+stats_add_setup(sip_msg_t *msg);
+
+/**
+ * @brief Account packets rejected before parsing
+ *
+ * @param sec Packets capture second
+ * @param count Number of rejected packets
+ */
+void
+stats_add_rejected(time_t sec, int count);
+
+/**
+ * @brief Remove all statistics
+ */
+void
+stats_clear();
+
+/**
+ * @brief Get counters of the statistics window
+ *
+ * The window ends at the given second or, if zero, at the last second
+ * with traffic.
+ *
+ * @param now Last second of the window or 0
+ * @param total Sum of all window buckets
+ * @return number of seconds of traffic in the window
+ */
+int
+stats_get_window(time_t now, stats_bucket_t *total);
+
+/**
+ * @brief Get most frequent keys of a top summary
+ *
+ * Counts of current and previous windows are merged. Returned counts
+ * don't include the overestimation of replaced keys, so they are the
+ * minimum number of times each key has been seen.
+ *
+ * @param top Top summary
+ * @param now Current second or 0 to use the last second with traffic
+ * @param entries Array to store the keys sorted by count
+ * @param max Max number of keys to store
+ * @return number of stored keys
+ */
+int
+stats_get_top(enum stats_top top, time_t now, stats_topk_entry_t *entries, int max);
+
+/**
+ * @brief Get the name of a counted method
+ */
+const char *
+stats_method_name(enum stats_method method);
+
+#endif /* __SNGREP_STATS_H */
@@ -0,0 +1,208 @@
+/**************************************************************************
+ **
+ ** sngrep - SIP Messages flow viewer
+ **
+ ** Copyright (C) 2013,2014 Ivan Alonso (Kaian)
+ ** Copyright (C) 2013,2014 Irontec SL. All rights reserved.
+ **
+ ** This program is free software: you can redistribute it and/or modify
+ ** it under the terms of the GNU General Public License as published by
+ ** the Free Software Foundation, either version 3 of the License, or
+ ** (at your option) any later version.
+ **
+ ** This program is distributed in the hope that it will be useful,
+ ** but WITHOUT ANY WARRANTY; without even the implied warranty of
+ ** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ ** GNU General Public License for more details.
+ **
+ ** You should have received a copy of the GNU General Public License
+ ** along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ **
+ ****************************************************************************/
+/**
+ * @file trace.c
+ * @author Ivan Alonso [aka Kaian] <kaian@irontec.com>
+ *
+ * @brief Source of functions defined in trace.h
+ *
+ */
+#include "config.h"
+#include <stdlib.h>
+#include <string.h>
+#include <signal.h>
+#include <pthread.h>
+#include "trace.h"
+
+//! Histograms of current thread
+static __thread trace_thread_t *trace_local;
+//! Histograms of all threads
+static trace_thread_t *trace_threads;
+//! Protect threads list
+static pthread_mutex_t trace_lock = PTHREAD_MUTEX_INITIALIZER;
+
+//! Stage names
+static const char *trace_names[TRACE_STAGE_COUNT] = {
+    "decode", "callid", "parse", "match", "attr", "lock", "dump"
+};
+
+/**
+ * @brief Get histogram bucket of a value
+ */
+static inline int
+trace_bucket(uint64_t value)
+{
+    int shift;
+
+    // First range has one bucket per value
+    if (value < TRACE_HIST_SUBBUCKETS)
+        return value;
+
+    // Remaining ranges are split in TRACE_HIST_SUBBUCKETS buckets
+    shift = 63 - __builtin_clzll(value) - TRACE_HIST_SUBBITS;
+    return ((shift + 1) << TRACE_HIST_SUBBITS) + ((value >> shift) & (TRACE_HIST_SUBBUCKETS - 1));
+}
+
+/**
+ * @brief Get the middle value of a histogram bucket
+ */
+static uint64_t
+trace_bucket_value(int bucket)
+{
+    int shift;
+
+    if (bucket < TRACE_HIST_SUBBUCKETS)
+        return bucket;
+
+    shift = (bucket >> TRACE_HIST_SUBBITS) - 1;
+    return ((uint64_t) (TRACE_HIST_SUBBUCKETS + (bucket & (TRACE_HIST_SUBBUCKETS - 1))) << shift)
+           + ((1ULL << shift) >> 1);
+}
+
+/**
+ * @brief Wait for SIGUSR1 and dump percentiles
+ */
+static void *
+trace_signal_thread(void *data)
+{
+    sigset_t *set = data;
+    int signum;
+
+    while (sigwait(set, &signum) == 0)
+        trace_dump(stderr);
+
+    return NULL;
+}
+
+void
+trace_init()
+{
+    static sigset_t set;
+    pthread_t thread;
+
+    // Block SIGUSR1 in this and all threads created later
+    sigemptyset(&set);
+    sigaddset(&set, SIGUSR1);
+    pthread_sigmask(SIG_BLOCK, &set, NULL);
+
+    if (pthread_create(&thread, NULL, trace_signal_thread, &set) == 0)
+        pthread_detach(thread);
+}
+
+void
+trace_record(enum trace_stage stage, uint64_t ns)
+{
+    trace_hist_t *hist;
+
+    // Register this thread histograms on first use
+    if (!trace_local) {
+        if (!(trace_local = calloc(1, sizeof(trace_thread_t))))
+            return;
+        pthread_mutex_lock(&trace_lock);
+        trace_local->next = trace_threads;
+        trace_threads = trace_local;
+        pthread_mutex_unlock(&trace_lock);
+    }
+
+    hist = &trace_local->hist[stage];
+    hist->counts[trace_bucket(ns)]++;
+    hist->total++;
+    if (ns > hist->max)
+        hist->max = ns;
+}
+
+void
+trace_clear()
+{
+    trace_thread_t *thread;
+
+    // Threads may be recording now, cleared counters are not exact
+    pthread_mutex_lock(&trace_lock);
+    for (thread = trace_threads; thread; thread = thread->next)
+        memset(thread->hist, 0, sizeof(thread->hist));
+    pthread_mutex_unlock(&trace_lock);
+}
+
+void
+trace_get_stats(enum trace_stage stage, trace_stats_t *stats)
+{
+    static trace_hist_t merged;
+    trace_thread_t *thread;
+    uint64_t sum = 0;
+    int i;
+
+    memset(stats, 0, sizeof(trace_stats_t));
+
+    // Merge histograms of all threads
+    pthread_mutex_lock(&trace_lock);
+    memset(&merged, 0, sizeof(merged));
+    for (thread = trace_threads; thread; thread = thread->next) {
+        for (i = 0; i < TRACE_HIST_SIZE; i++)
+            merged.counts[i] += thread->hist[stage].counts[i];
+        merged.total += thread->hist[stage].total;
+        if (thread->hist[stage].max > merged.max)
+            merged.max = thread->hist[stage].max;
+    }
+
+    stats->count = merged.total;
+    stats->max = merged.max;
+
+    // Find percentile buckets
+    for (i = 0; i < TRACE_HIST_SIZE && merged.total; i++) {
+        if (!merged.counts[i])
+            continue;
+        sum += merged.counts[i];
+        if (!stats->p50 && sum * 2 >= merged.total)
+            stats->p50 = trace_bucket_value(i);
+        if (!stats->p99 && sum * 100 >= merged.total * 99)
+            stats->p99 = trace_bucket_value(i);
+        if (!stats->p999 && sum * 1000 >= merged.total * 999) {
+            stats->p999 = trace_bucket_value(i);
+            break;
+        }
+    }
+    pthread_mutex_unlock(&trace_lock);
+}
+
+const char *
+trace_stage_name(enum trace_stage stage)
+{
+    return trace_names[stage];
+}
+
+void
+trace_dump(FILE *out)
+{
+    trace_stats_t stats;
+    int i;
+
+    fprintf(out, "%-8s %12s %10s %10s %10s %10s\n", "stage", "count", "p50 ns", "p99 ns",
+            "p999 ns", "max ns");
+    for (i = 0; i < TRACE_STAGE_COUNT; i++) {
+        trace_get_stats(i, &stats);
+        fprintf(out, "%-8s %12llu %10llu %10llu %10llu %10llu\n", trace_stage_name(i),
+                (unsigned long long) stats.count, (unsigned long long) stats.p50,
+                (unsigned long long) stats.p99, (unsigned long long) stats.p999,
+                (unsigned long long) stats.max);
+    }
+    fflush(out);
+}
@@ -0,0 +1,190 @@
+/**************************************************************************
+ **
+ ** sngrep - SIP Messages flow viewer
+ **
+ ** Copyright (C) 2013,2014 Ivan Alonso (Kaian)
+ ** Copyright (C) 2013,2014 Irontec SL. All rights reserved.
+ **
+ ** This program is free software: you can redistribute it and/or modify
+ ** it under the terms of the GNU General Public License as published by
+ ** the Free Software Foundation, either version 3 of the License, or
+ ** (at your option) any later version.
+ **
+ ** This program is distributed in the hope that it will be useful,
+ ** but WITHOUT ANY WARRANTY; without even the implied warranty of
+ ** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ ** GNU General Public License for more details.
+ **
+ ** You should have received a copy of the GNU General Public License
+ ** along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ **
+ ****************************************************************************/
+/**
+ * @file trace.h
+ * @author Ivan Alonso [aka Kaian] <kaian@irontec.com>
+ *
+ * @brief Functions to measure packet processing stages
+ *
+ * When sngrep is configured with --enable-tracing, the time spent in each
+ * stage of packet processing is recorded in latency histograms. Every
+ * thread records into its own histograms, so recording doesn't need any
+ * lock. Histograms are log-linear: each power of two range of nanoseconds
+ * is split in TRACE_HIST_SUBBUCKETS buckets, so percentiles have a
+ * relative error below 1/TRACE_HIST_SUBBUCKETS.
+ *
+ * Percentiles of each stage can be seen pressing 'T' in the statistics
+ * panel or sending SIGUSR1 to sngrep, that prints them to stderr.
+ *
+ * Without --enable-tracing, TRACE_BEGIN and TRACE_END expand to nothing.
+ */
+#ifndef __SNGREP_TRACE_H
+#define __SNGREP_TRACE_H
+
+#include "config.h"
+
+#ifdef WITH_TRACING
+#include <stdio.h>
+#include <stdint.h>
+#include <time.h>
+
+//! Number of buckets in each power of two range (log2)
+#define TRACE_HIST_SUBBITS 4
+//! Number of buckets in each power of two range
+#define TRACE_HIST_SUBBUCKETS (1 << TRACE_HIST_SUBBITS)
+//! Number of buckets of a histogram
+#define TRACE_HIST_SIZE (64 * TRACE_HIST_SUBBUCKETS)
+
+//! Shorter declaration of trace_hist structure
+typedef struct trace_hist trace_hist_t;
+//! Shorter declaration of trace_thread structure
+typedef struct trace_thread trace_thread_t;
+//! Shorter declaration of trace_stats structure
+typedef struct trace_stats trace_stats_t;
+
+/**
+ * @brief Measured processing stages
+ */
+enum trace_stage {
+    //! Link and IP headers decoding
+    TRACE_DECODE = 0,
+    //! Call-ID lookup in calls hash table
+    TRACE_CALLID,
+    //! SIP payload parsing (msg_parse_payload)
+    TRACE_PARSE,
+    //! Match expression check
+    TRACE_MATCH,
+    //! Packet attributes formatting
+    TRACE_ATTR,
+    //! Wait for calls list lock
+    TRACE_LOCK,
+    //! Packet write to dump file
+    TRACE_DUMP,
+    //! Number of stages
+    TRACE_STAGE_COUNT
+};
+
+/**
+ * @brief Latency histogram of a stage
+ */
+struct trace_hist {
+    //! Samples in each bucket
+    uint64_t counts[TRACE_HIST_SIZE];
+    //! Total samples
+    uint64_t total;
+    //! Max recorded value
+    uint64_t max;
+};
+
+/**
+ * @brief Histograms of a thread
+ */
+struct trace_thread {
+    //! One histogram for each stage
+    trace_hist_t hist[TRACE_STAGE_COUNT];
+    //! Next registered thread
+    trace_thread_t *next;
+};
+
+/**
+ * @brief Percentiles of a stage for all threads
+ */
+struct trace_stats {
+    //! Total samples
+    uint64_t count;
+    //! Percentiles in nanoseconds
+    uint64_t p50, p99, p999;
+    //! Max value in nanoseconds
+    uint64_t max;
+};
+
+/**
+ * @brief Get current time in nanoseconds
+ */
+static inline uint64_t
+trace_now()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t) ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+/**
+ * @brief Start dump thread for SIGUSR1
+ *
+ * This must be called before creating any other thread, so SIGUSR1 is
+ * only handled by the dump thread.
+ */
+void
+trace_init();
+
+/**
+ * @brief Record the time spent in a stage by current thread
+ *
+ * @param stage Processing stage
+ * @param ns Elapsed time in nanoseconds
+ */
+void
+trace_record(enum trace_stage stage, uint64_t ns);
+
+/**
+ * @brief Remove all recorded samples
+ */
+void
+trace_clear();
+
+/**
+ * @brief Get the percentiles of a stage
+ *
+ * @param stage Processing stage
+ * @param stats Percentiles of the stage
+ */
+void
+trace_get_stats(enum trace_stage stage, trace_stats_t *stats);
+
+/**
+ * @brief Get the name of a stage
+ */
+const char *
+trace_stage_name(enum trace_stage stage);
+
+/**
+ * @brief Print percentiles of all stages
+ *
+ * @param out Output stream
+ */
+void
+trace_dump(FILE *out);
+
+//! Start measuring a stage
+#define TRACE_BEGIN(name) uint64_t name = trace_now()
+//! Record the time since TRACE_BEGIN
+#define TRACE_END(stage, name) trace_record(stage, trace_now() - (name))
+
+#else
+
+#define TRACE_BEGIN(name)
+#define TRACE_END(stage, name)
+
+#endif /* WITH_TRACING */
+
+#endif /* __SNGREP_TRACE_H */
@@ -30,6 +30,7 @@
  */
 #include <stdlib.h>
 #include <string.h>
+#include <time.h>
 #include "ui_call_flow.h"
 #include "ui_call_raw.h"
 #include "ui_msg_diff.h"
@@ -73,7 +74,8 @@ ui_t ui_call_flow = {
     .create = call_flow_create,
     .draw = call_flow_draw,
     .handle_key = call_flow_handle_key,
-    .help = call_flow_help
+    .help = call_flow_help,
+    .destroy = call_flow_destroy
 };
 
 PANEL *
@@ -119,7 +121,12 @@ call_flow_destroy(PANEL *panel)
     hide_panel(panel);
     // Free the panel information
     if ((info = call_flow_info(panel))) {
-        // Deallocate group memory
+        // Deallocate flow layout memory
+        call_flow_layout_clear(panel);
+        free(info->arrows);
+        // Deallocate raw window
+        if (info->raw_win)
+            delwin(info->raw_win);
         free(info);
     }
     // Delete panel window
@@ -132,9 +139,8 @@ int
 call_flow_draw(PANEL *panel)
 {
     call_flow_info_t *info;
-    sip_msg_t *msg;
     WINDOW *win;
-    int height, width, cline = 0;
+    int height, width, cline = 0, i;
     char title[256];
 
     // Get panel information
@@ -146,11 +152,11 @@ call_flow_draw(PANEL *panel)
     werase(win);
 
     // Set title
-    if (info->group->callcnt == 1) {
+    if (call_group_count(info->group) == 1) {
         sprintf(title, "Call flow for %s",
-                call_get_attribute(*info->group->calls, SIP_ATTR_CALLID));
+                call_get_attribute(call_group_get_next(info->group, NULL), SIP_ATTR_CALLID));
     } else {
-        sprintf(title, "Call flow for %d dialogs", info->group->callcnt);
+        sprintf(title, "Call flow for %d dialogs", call_group_count(info->group));
     }
 
     // Print color mode in title
@@ -169,26 +175,28 @@ call_flow_draw(PANEL *panel)
     // Show some keybinding
     call_flow_draw_footer(panel);
 
+    // Add new messages to the layout
+    call_flow_layout_update(panel);
+
     // Redraw columns
     call_flow_draw_columns(panel);
 
     // Let's start from the first displayed message (not the first in the call group)
-    for (msg = info->first_msg; msg; msg = call_group_get_next_msg(info->group, msg)) {
+    for (i = info->first_arrow; i < info->arrowcnt; i++) {
         // Draw messages until the Message height has been filled
-        if (call_flow_draw_message(panel, msg, cline) != 0)
+        if (call_flow_draw_message(panel, &info->arrows[i], cline) != 0)
             break;
         // One message fills 2 lines
         cline += 2;
     }
 
     // If there are only three columns, then draw the raw message on this panel
-    if (is_option_enabled("cf.forceraw")) {
-        call_flow_draw_raw(panel, info->cur_msg);
+    if (is_option_enabled("cf.forceraw") && info->arrowcnt) {
+        call_flow_draw_raw(panel, call_flow_cur_msg(panel));
     }
 
     // Draw the scrollbar
-    draw_vscrollbar(info->flow_win, call_group_msg_number(info->group, info->first_msg) * 2,
-                    call_group_msg_count(info->group) * 2, 1);
+    draw_vscrollbar(info->flow_win, info->first_arrow * 2, info->arrowcnt * 2, 1);
 
     // Redraw flow win
     wnoutrefresh(info->flow_win);
@@ -223,7 +231,6 @@ call_flow_draw_columns(PANEL *panel)
     call_flow_info_t *info;
     call_flow_column_t *column;
     WINDOW *win;
-    sip_msg_t *msg;
     int flow_height, flow_width;
     const char *coltext;
 
@@ -233,13 +240,6 @@ call_flow_draw_columns(PANEL *panel)
     win = panel_window(panel);
     getmaxyx(info->flow_win, flow_height, flow_width);
 
-    // Load columns
-    for (msg = call_group_get_next_msg(info->group, NULL); msg;
-         msg = call_group_get_next_msg(info->group, msg)) {
-        call_flow_column_add(panel, CALLID(msg), SRC(msg), SRCHOST(msg));
-        call_flow_column_add(panel, CALLID(msg), DST(msg), DSTHOST(msg));
-    }
-
     // Draw vertical columns lines
     for (column = info->columns; column; column = column->next) {
         mvwvline(info->flow_win, 0, 20 + 30 * column->colpos, ACS_VLINE, flow_height);
@@ -252,21 +252,103 @@ call_flow_draw_columns(PANEL *panel)
     return 0;
 }
 
+/**
+ * @brief Turn on the highlight attributes if arrow is the current one
+ */
+static void
+call_flow_draw_highlight(call_flow_info_t *info, call_flow_arrow_t *arrow, WINDOW *win)
+{
+    if (arrow != &info->arrows[info->cur_arrow])
+        return;
+
+    if (is_option_value("cf.highlight", "reverse")) {
+        wattron(win, A_REVERSE);
+    }
+    if (is_option_value("cf.highlight", "bold")) {
+        wattron(win, A_BOLD);
+    }
+    if (is_option_value("cf.highlight", "reversebold")) {
+        wattron(win, A_REVERSE);
+        wattron(win, A_BOLD);
+    }
+}
+
+/**
+ * @brief Draw a RTP stream arrow in the given line
+ *
+ * Stream counters change while packets are captured, so the arrow
+ * text is created every time the arrow is drawn.
+ *
+ * @return 0 if arrow is drawn, 1 otherwise
+ */
+static int
+call_flow_draw_stream(PANEL *panel, call_flow_arrow_t *arrow, int cline)
+{
+    call_flow_info_t *info = call_flow_info(panel);
+    WINDOW *win = info->flow_win;
+    rtp_stream_t *stream = arrow->stream;
+    char label[80], codec[16], time[20];
+    struct tm *first;
+    time_t sec;
+    int expected, msglen;
+
+    // Get the current line in the win
+    if (cline > getmaxy(win) + 2)
+        return 1;
+
+    // Print first packet timestamp
+    sec = stream->first.tv_sec;
+    first = localtime(&sec);
+    strftime(time, sizeof(time), "%H:%M:%S", first);
+    mvwprintw(win, cline, 2, "%s.%06d", time, (int) stream->first.tv_usec);
+
+    // Create arrow text with stream quality
+    expected = rtp_stream_expected(stream);
+    sprintf(label, "RTP %s %.1f%% %.1fms", rtp_stream_codec(stream, codec),
+            (expected) ? rtp_stream_lost(stream) * 100.0 / expected : 0, rtp_stream_jitter(stream));
+    if ((msglen = strlen(label)) > 24)
+        msglen = 24;
+
+    int startpos = 20 + 30 * arrow->startcol;
+    int endpos = 20 + 30 * arrow->endcol;
+    int distance = abs(endpos - startpos) - 3;
+
+    // Highlight current stream
+    call_flow_draw_highlight(info, arrow, win);
+
+    wattron(win, COLOR_PAIR(CP_YELLOW_ON_DEF));
+    mvwprintw(win, cline, startpos + 2, "%*s", distance, "");
+    mvwprintw(win, cline, startpos + distance / 2 - msglen / 2 + 2, "%.26s", label);
+    mvwhline(win, cline + 1, startpos + 2, ACS_HLINE, distance);
+
+    // Media arrows are always drawn doubled
+    if (arrow->dir == CF_ARROW_RIGHT) {
+        mvwaddch(win, cline + 1, endpos - 2, '>');
+        mvwaddch(win, cline + 1, endpos - 3, '>');
+    } else {
+        mvwaddch(win, cline + 1, startpos + 2, '<');
+        mvwaddch(win, cline + 1, startpos + 3, '<');
+    }
+
+    wattroff(win, COLOR_PAIR(CP_YELLOW_ON_DEF));
+    wattroff(win, A_BOLD);
+    wattroff(win, A_REVERSE);
+
+    return 0;
+}
+
 int
-call_flow_draw_message(PANEL *panel, sip_msg_t *msg, int cline)
+call_flow_draw_message(PANEL *panel, call_flow_arrow_t *arrow, int cline)
 {
     call_flow_info_t *info;
     WINDOW *win;
-    const char *msg_time;
-    const char *msg_callid;
-    const char *msg_method;
-    const char *msg_from;
-    const char *msg_to;
-    const char *msg_src;
-    const char *msg_dst;
-    char method[80];
+    sip_msg_t *msg = arrow->msg;
     int height, width;
 
+    // Stream arrows have their own format
+    if (arrow->stream)
+        return call_flow_draw_stream(panel, arrow, cline);
+
     // Get panel information
     info = call_flow_info(panel);
     // Get the messages window
@@ -277,71 +359,20 @@ call_flow_draw_message(PANEL *panel, sip_msg_t *msg, int cline)
     if (cline > height + 2)
         return 1;
 
-    // Get message attributes
-    msg_time = msg_get_attribute(msg, SIP_ATTR_TIME);
-    msg_callid = msg_get_attribute(msg, SIP_ATTR_CALLID);
-    msg_method = msg_get_attribute(msg, SIP_ATTR_METHOD);
-    msg_from = msg_get_attribute(msg, SIP_ATTR_SIPFROM);
-    msg_to = msg_get_attribute(msg, SIP_ATTR_SIPTO);
-    msg_src = msg_get_attribute(msg, SIP_ATTR_SRC);
-    msg_dst = msg_get_attribute(msg, SIP_ATTR_DST);
-
     // Print timestamp
-    mvwprintw(win, cline, 2, "%s", msg_time);
-
-    // Get Message method (include extra info)
-    memset(method, 0, sizeof(method));
-    if (msg_method)
-        sprintf(method, "%s", msg_method);
-
-    // If message has sdp information
-    if (msg->sdp) {
-        if (is_option_enabled("cf.sdpinfo")) {
-            // Show message sdp in title
-            memset(method, 0, sizeof(method));
-            strncpy(method, msg_method, 3);
-            sprintf(method + strlen(method), " (%s:%s)",
-                    msg_get_attribute(msg, SIP_ATTR_SDP_ADDRESS),
-                    msg_get_attribute(msg, SIP_ATTR_SDP_PORT));
-        } else {
-            // Show sdp tag in tittle
-            strcat(method, " (SDP)");
-        }
-    }
+    mvwprintw(win, cline, 2, "%s", msg_get_attribute(msg, SIP_ATTR_TIME));
 
     // Draw message type or status and line
-    int msglen = strlen(method);
+    int msglen = strlen(arrow->label);
     if (msglen > 24)
         msglen = 24;
 
-    // Get origin and destination column
-    call_flow_column_t *column1 = call_flow_column_get(panel, msg_callid, msg_src);
-    call_flow_column_t *column2 = call_flow_column_get(panel, msg_callid, msg_dst);
-
-    call_flow_column_t *tmp;
-    if (column1->colpos > column2->colpos) {
-        tmp = column1;
-        column1 = column2;
-        column2 = tmp;
-    }
-
-    int startpos = 20 + 30 * column1->colpos;
-    int endpos = 20 + 30 * column2->colpos;
+    int startpos = 20 + 30 * arrow->startcol;
+    int endpos = 20 + 30 * arrow->endcol;
     int distance = abs(endpos - startpos) - 3;
 
     // Highlight current message
-    if (msg == info->cur_msg) {
-        if (is_option_value("cf.highlight", "reverse")) {
-            wattron(win, A_REVERSE);
-        }
-        if (is_option_value("cf.highlight", "bold")) {
-            wattron(win, A_BOLD);
-        }
-        if (is_option_value("cf.highlight", "reversebold")) {
-            wattron(win, A_REVERSE);
-            wattron(win, A_BOLD);
-        }
-    }
+    call_flow_draw_highlight(info, arrow, win);
 
     // Color the message {
     if (is_option_enabled("color.request")) {
@@ -363,7 +394,7 @@ call_flow_draw_message(PANEL *panel, sip_msg_t *msg, int cline)
     wattron(win, COLOR_PAIR(msg->color));
 
     mvwprintw(win, cline, startpos + 2, "%*s", distance, "");
-    mvwprintw(win, cline, startpos + distance / 2 - msglen / 2 + 2, "%.26s", method);
+    mvwprintw(win, cline, startpos + distance / 2 - msglen / 2 + 2, "%.26s", arrow->label);
     if (msg == info->selected) {
         mvwhline(win, cline + 1, startpos + 2, '=', distance);
     } else {
@@ -371,15 +402,15 @@ call_flow_draw_message(PANEL *panel, sip_msg_t *msg, int cline)
     }
 
     // Write the arrow at the end of the message (two arros if this is a retrans)
-    if (!strcasecmp(msg_src, column1->addr)) {
+    if (arrow->dir == CF_ARROW_RIGHT) {
         mvwaddch(win, cline + 1, endpos - 2, '>');
-        if (msg_is_retrans(msg)) {
+        if (arrow->retrans) {
             mvwaddch(win, cline + 1, endpos - 3, '>');
             mvwaddch(win, cline + 1, endpos - 4, '>');
         }
     } else {
         mvwaddch(win, cline + 1, startpos + 2, '<');
-        if (msg_is_retrans(msg)) {
+        if (arrow->retrans) {
             mvwaddch(win, cline + 1, startpos + 3, '<');
             mvwaddch(win, cline + 1, startpos + 4, '<');
         }
@@ -396,6 +427,36 @@ call_flow_draw_message(PANEL *panel, sip_msg_t *msg, int cline)
     return 0;
 }
 
+/**
+ * @brief Print RTP stream counters in the given window
+ */
+static void
+call_flow_draw_stream_info(WINDOW *win, rtp_stream_t *stream)
+{
+    char codec[16], src[INET_ADDRSTRLEN], dst[INET_ADDRSTRLEN];
+    int expected = rtp_stream_expected(stream), lost = rtp_stream_lost(stream);
+
+    inet_ntop(AF_INET, &stream->src, src, sizeof(src));
+    inet_ntop(AF_INET, &stream->dst, dst, sizeof(dst));
+
+    wattron(win, COLOR_PAIR(CP_YELLOW_ON_DEF));
+    mvwprintw(win, 0, 0, "RTP Stream");
+    wattroff(win, COLOR_PAIR(CP_YELLOW_ON_DEF));
+    mvwprintw(win, 2, 0, "Codec:       %s", rtp_stream_codec(stream, codec));
+    mvwprintw(win, 3, 0, "Source:      %s:%u", src, ntohs(stream->sport));
+    mvwprintw(win, 4, 0, "Destination: %s:%u", dst, ntohs(stream->dport));
+    mvwprintw(win, 5, 0, "SSRC:        0x%08X", stream->ssrc);
+    mvwprintw(win, 6, 0, "Packets:     %d", stream->pktcnt);
+    mvwprintw(win, 7, 0, "Expected:    %d", expected);
+    mvwprintw(win, 8, 0, "Lost:        %d (%.2f%%)", lost, (expected) ? lost * 100.0 / expected : 0);
+    mvwprintw(win, 9, 0, "Jitter:      %.2f ms", rtp_stream_jitter(stream));
+    mvwprintw(win, 10, 0, "Duration:    %.2f s",
+              (stream->last.tv_sec - stream->first.tv_sec)
+              + (stream->last.tv_usec - stream->first.tv_usec) / 1000000.0);
+    mvwprintw(win, 12, 0, "Negotiated in %s at %s", msg_get_attribute(stream->msg, SIP_ATTR_METHOD),
+              msg_get_attribute(stream->msg, SIP_ATTR_TIME));
+}
+
 int
 call_flow_draw_raw(PANEL *panel, sip_msg_t *msg)
 {
@@ -411,7 +472,7 @@ call_flow_draw_raw(PANEL *panel, sip_msg_t *msg)
     getmaxyx(win, height, width);
 
     // Calculate the raw data width (width - used columns for flow - vertical lines)
-    raw_width = width - (31 + 30 * info->columns->colpos) - 2;
+    raw_width = width - (31 + 30 * (info->colcnt - 1)) - 2;
     // We can define a mininum size for rawminwidth
     if (raw_width < get_option_int_value("cf.rawminwidth")) {
         raw_width = get_option_int_value("cf.rawminwidth");
@@ -446,8 +507,13 @@ call_flow_draw_raw(PANEL *panel, sip_msg_t *msg)
     mvwvline(win, 1, width - raw_width - 2, ACS_VLINE, height - 2);
     wattroff(win, COLOR_PAIR(CP_BLUE_ON_DEF));
 
-    // Print msg payload
-    draw_message(info->raw_win, msg);
+    // Print stream counters or msg payload
+    if (info->arrowcnt && info->arrows[info->cur_arrow].stream
+        && info->arrows[info->cur_arrow].msg == msg) {
+        call_flow_draw_stream_info(raw_win, info->arrows[info->cur_arrow].stream);
+    } else {
+        draw_message(info->raw_win, msg);
+    }
 
     // Copy the raw_win contents into the panel
     copywin(raw_win, win, 0, 0, 1, width - raw_width - 1, raw_height, width - 2, 0);
@@ -460,7 +526,6 @@ call_flow_handle_key(PANEL *panel, int key)
 {
     int i, rnpag_steps = 4, raw_width, height, width;
     call_flow_info_t *info = call_flow_info(panel);
-    sip_msg_t *next = NULL, *prev = NULL;
     ui_t *next_panel;
     sip_call_group_t *group;
 
@@ -473,32 +538,25 @@ call_flow_handle_key(PANEL *panel, int key)
     switch (key) {
         case KEY_DOWN:
             // Check if there is a call below us
-            if (!(next = call_group_get_next_msg(info->group, info->cur_msg)))
+            if (info->cur_arrow + 1 >= info->arrowcnt)
                 break;
-            info->cur_msg = next;
+            info->cur_arrow++;
             info->cur_line += 2;
             // If we are out of the bottom of the displayed list
             // refresh it starting in the next call
             if (info->cur_line >= height) {
-                info->first_msg = call_group_get_next_msg(info->group, info->first_msg);
+                info->first_arrow++;
                 info->cur_line -= 2;
             }
             break;
         case KEY_UP:
-            // Loop through messages until we found current message
-            // storing the previous one
-            while ((next = call_group_get_next_msg(info->group, next))) {
-                if (next == info->cur_msg)
-                    break;
-                prev = next;
-            }
             // We're at the first message already
-            if (!prev)
+            if (info->cur_arrow == 0)
                 break;
-            info->cur_msg = prev;
+            info->cur_arrow--;
             info->cur_line -= 2;
             if (info->cur_line <= 0) {
-                info->first_msg = info->cur_msg;
+                info->first_arrow = info->cur_arrow;
                 info->cur_line += 2;
             }
             break;
@@ -516,14 +574,14 @@ call_flow_handle_key(PANEL *panel, int key)
         case KEY_F(4):
             werase(panel_window(panel));
             // KEY_X , Display current call flow
-            if (info->group->callcnt == 1) {
+            if (call_group_count(info->group) == 1) {
                 group = call_group_create();
-                call_group_add(group, info->group->calls[0]);
-                call_group_add(group, call_get_xcall(info->group->calls[0]));
+                call_group_add(group, call_group_get_next(info->group, NULL));
+                call_group_add(group, call_get_xcall(call_group_get_next(info->group, NULL)));
                 call_flow_set_group(group);
             } else {
                 group = call_group_create();
-                call_group_add(group, info->group->calls[0]);
+                call_group_add(group, call_group_get_next(info->group, NULL));
                 call_flow_set_group(group);
             }
             break;
@@ -566,19 +624,18 @@ call_flow_handle_key(PANEL *panel, int key)
         case 's':
         case KEY_F(5):
             set_option_value("cf.splitcallid", is_option_enabled("cf.splitcallid") ? "off" : "on");
-            // Force columns reload
-            info->columns = NULL;
             break;
         case ' ':
             if (!info->selected) {
-                info->selected = info->cur_msg;
+                info->selected = call_flow_cur_msg(panel);
             } else {
-                if (info->selected == info->cur_msg) {
+                if (info->selected == call_flow_cur_msg(panel)) {
                     info->selected = NULL;
                 } else {
                     // Show diff panel
                     next_panel = ui_create(ui_find_by_type(PANEL_MSG_DIFF));
-                    msg_diff_set_msgs(ui_get_panel(next_panel), info->selected, info->cur_msg);
+                    msg_diff_set_msgs(ui_get_panel(next_panel), info->selected,
+                                      call_flow_cur_msg(panel));
                     wait_for_input(next_panel);
                 }
             }
@@ -588,7 +645,7 @@ call_flow_handle_key(PANEL *panel, int key)
             next_panel = ui_create(ui_find_by_type(PANEL_CALL_RAW));
             // TODO
             call_raw_set_group(info->group);
-            call_raw_set_msg(info->cur_msg);
+            call_raw_set_msg(call_flow_cur_msg(panel));
             wait_for_input(next_panel);
             break;
         default:
@@ -676,19 +733,285 @@ call_flow_set_group(sip_call_group_t *group)
         return -1;
 
     info->group = group;
-    info->cur_msg = info->first_msg = call_group_get_next_msg(group, NULL);
     info->cur_line = 1;
+
+    // Create the layout of the new group
+    call_flow_layout_clear(panel);
+    info->cur_arrow = info->first_arrow = 0;
+    call_flow_layout_update(panel);
+
+    return 0;
+}
+
+void
+call_flow_layout_clear(PANEL *panel)
+{
+    call_flow_info_t *info;
+    call_flow_column_t *column, *next;
+
+    if (!(info = call_flow_info(panel)))
+        return;
+
+    // Remove all columns
+    for (column = info->columns; column; column = next) {
+        next = column->next;
+        free(column);
+    }
     info->columns = NULL;
+    info->colcnt = 0;
+    htable_destroy(info->colhash);
+    info->colhash = NULL;
+
+    // Remove all arrows (keep the allocated memory)
+    info->arrowcnt = 0;
+    info->last_msg = NULL;
+    info->streamcnt = info->streamlaid = 0;
+}
 
+/**
+ * @brief Compare two streams using their first packet time
+ */
+static int
+call_flow_stream_cmp(const void *a, const void *b)
+{
+    const rtp_stream_t *one = *(rtp_stream_t **) a, *two = *(rtp_stream_t **) b;
+
+    if (timercmp(&one->first, &two->first, <))
+        return -1;
+    if (timercmp(&one->first, &two->first, >))
+        return 1;
     return 0;
 }
 
+/**
+ * @brief Get the streams of the group with received packets
+ *
+ * @return number of streams, sorted by their first packet time
+ */
+static int
+call_flow_group_streams(sip_call_group_t *group, rtp_stream_t ***streams)
+{
+    sip_call_t *call = NULL;
+    rtp_stream_t *stream;
+    int count = 0, size = 0;
+
+    *streams = NULL;
+    while ((call = call_group_get_next(group, call))) {
+        for (stream = NULL; (stream = call_get_next_stream(call, stream));) {
+            if (!stream->pktcnt)
+                continue;
+            if (count == size) {
+                size += 16;
+                *streams = realloc(*streams, sizeof(rtp_stream_t *) * size);
+            }
+            (*streams)[count++] = stream;
+        }
+    }
+
+    if (count > 1)
+        qsort(*streams, count, sizeof(rtp_stream_t *), call_flow_stream_cmp);
+    return count;
+}
+
+void
+call_flow_layout_update(PANEL *panel)
+{
+    call_flow_info_t *info;
+    sip_msg_t *msg;
+    rtp_stream_t **streams;
+    int streamcnt;
+
+    if (!(info = call_flow_info(panel)) || !info->group)
+        return;
+
+    // Get streams of the group calls
+    streamcnt = call_flow_group_streams(info->group, &streams);
+
+    // Merge new messages, older ones may be placed before the last laid out
+    call_group_index_update(info->group);
+
+    // Check if the layout was created with other options, new streams have
+    // started or messages have been merged again
+    if (info->splitcallid != is_option_enabled("cf.splitcallid")
+        || info->sdpinfo != is_option_enabled("cf.sdpinfo")
+        || info->streamcnt != streamcnt
+        || info->generation != info->group->generation) {
+        call_flow_layout_clear(panel);
+    }
+
+    // Create columns hash if required
+    if (!info->colhash) {
+        info->colhash = htable_create(64);
+        info->splitcallid = is_option_enabled("cf.splitcallid");
+        info->sdpinfo = is_option_enabled("cf.sdpinfo");
+        info->streamcnt = streamcnt;
+        info->generation = info->group->generation;
+    }
+
+    // Continue from the last laid out message
+    msg = info->last_msg;
+
+    while ((msg = call_group_get_next_msg(info->group, msg))) {
+        // Add streams started before this message
+        while (info->streamlaid < streamcnt
+               && timercmp(&streams[info->streamlaid]->first, &msg->ts, <)) {
+            if (call_flow_layout_stream(panel, streams[info->streamlaid]) != 0)
+                break;
+            info->streamlaid++;
+        }
+        if (call_flow_layout_msg(panel, msg) != 0)
+            break;
+        info->last_msg = msg;
+    }
+
+    // Add streams started after the last message
+    while (info->streamlaid < streamcnt) {
+        if (call_flow_layout_stream(panel, streams[info->streamlaid]) != 0)
+            break;
+        info->streamlaid++;
+    }
+    free(streams);
+
+    // Keep positions inside the layout
+    if (info->cur_arrow >= info->arrowcnt)
+        info->cur_arrow = (info->arrowcnt) ? info->arrowcnt - 1 : 0;
+    if (info->first_arrow > info->cur_arrow)
+        info->first_arrow = info->cur_arrow;
+}
+
+/**
+ * @brief Get a new arrow at the end of the layout
+ *
+ * @return the new arrow or NULL if memory can not be allocated
+ */
+static call_flow_arrow_t *
+call_flow_arrow_new(call_flow_info_t *info)
+{
+    call_flow_arrow_t *arrow;
+    void *arrows;
+
+    // Make room for the new arrow
+    if (info->arrowcnt == info->arrowsize) {
+        if (!(arrows = realloc(info->arrows, sizeof(call_flow_arrow_t) * (info->arrowsize + 200))))
+            return NULL;
+        info->arrows = arrows;
+        info->arrowsize += 200;
+    }
+
+    arrow = &info->arrows[info->arrowcnt++];
+    memset(arrow, 0, sizeof(call_flow_arrow_t));
+    return arrow;
+}
+
+int
+call_flow_layout_msg(PANEL *panel, sip_msg_t *msg)
+{
+    call_flow_info_t *info;
+    call_flow_arrow_t *arrow;
+    call_flow_column_t *column1, *column2, *tmp;
+    const char *msg_method;
+
+    if (!(info = call_flow_info(panel)))
+        return 1;
+
+    // Add message columns
+    call_flow_column_add(panel, CALLID(msg), SRC(msg), SRCHOST(msg));
+    call_flow_column_add(panel, CALLID(msg), DST(msg), DSTHOST(msg));
+
+    // Get origin and destination column
+    column1 = call_flow_column_get(panel, CALLID(msg), SRC(msg));
+    column2 = call_flow_column_get(panel, CALLID(msg), DST(msg));
+    if (!column1 || !column2)
+        return 1;
+
+    if (column1->colpos > column2->colpos) {
+        tmp = column1;
+        column1 = column2;
+        column2 = tmp;
+    }
+
+    if (!(arrow = call_flow_arrow_new(info)))
+        return 1;
+    arrow->msg = msg;
+    arrow->startcol = column1->colpos;
+    arrow->endcol = column2->colpos;
+    arrow->dir = (SRC(msg) == column1->addr) ? CF_ARROW_RIGHT : CF_ARROW_LEFT;
+    arrow->retrans = msg_is_retrans(msg);
+
+    // Get Message method (include extra info)
+    if ((msg_method = msg_get_attribute(msg, SIP_ATTR_METHOD)))
+        sprintf(arrow->label, "%.40s", msg_method);
+
+    // If message has sdp information
+    if (msg->sdp) {
+        if (info->sdpinfo) {
+            // Show message sdp in title
+            sprintf(arrow->label, "%.3s (%.30s:%.10s)", (msg_method) ? msg_method : "",
+                    msg_get_attribute(msg, SIP_ATTR_SDP_ADDRESS),
+                    msg_get_attribute(msg, SIP_ATTR_SDP_PORT));
+        } else {
+            // Show sdp tag in tittle
+            strcat(arrow->label, " (SDP)");
+        }
+    }
+
+    return 0;
+}
+
+int
+call_flow_layout_stream(PANEL *panel, rtp_stream_t *stream)
+{
+    call_flow_info_t *info;
+    call_flow_arrow_t *arrow;
+    call_flow_column_t *column1, *column2, *tmp;
+    sip_msg_t *msg = stream->msg;
+
+    if (!(info = call_flow_info(panel)))
+        return 1;
+
+    // Stream goes between the SDP message endpoints
+    call_flow_column_add(panel, CALLID(msg), SRC(msg), SRCHOST(msg));
+    call_flow_column_add(panel, CALLID(msg), DST(msg), DSTHOST(msg));
+
+    column1 = call_flow_column_get(panel, CALLID(msg), SRC(msg));
+    column2 = call_flow_column_get(panel, CALLID(msg), DST(msg));
+    if (!column1 || !column2)
+        return 1;
+
+    if (column1->colpos > column2->colpos) {
+        tmp = column1;
+        column1 = column2;
+        column2 = tmp;
+    }
+
+    if (!(arrow = call_flow_arrow_new(info)))
+        return 1;
+    arrow->msg = msg;
+    arrow->stream = stream;
+    arrow->startcol = column1->colpos;
+    arrow->endcol = column2->colpos;
+    // Media is sent to the address announced by the SDP message sender
+    arrow->dir = (SRC(msg) == column1->addr) ? CF_ARROW_LEFT : CF_ARROW_RIGHT;
+
+    return 0;
+}
+
+sip_msg_t *
+call_flow_cur_msg(PANEL *panel)
+{
+    call_flow_info_t *info;
+
+    if (!(info = call_flow_info(panel)) || !info->arrowcnt)
+        return NULL;
+
+    return info->arrows[info->cur_arrow].msg;
+}
+
 void
 call_flow_column_add(PANEL *panel, const char *callid, const char *addr, const char *host)
 {
     call_flow_info_t *info;
-    call_flow_column_t *column;
-    int colpos = 0;
+    call_flow_column_t *column, *first;
 
     if (!(info = call_flow_info(panel)))
         return;
@@ -696,26 +1019,32 @@ call_flow_column_add(PANEL *panel, const char *callid, const char *addr, const c
     if (call_flow_column_get(panel, callid, addr))
         return;
 
-    column = info->columns;
-    while (column) {
-        if (!strcasecmp(addr, column->addr) && column->colpos != 0 && !column->callid2) {
+    // Check columns with the same address
+    first = htable_find(info->colhash, addr);
+    for (column = first; column; column = column->next_addr) {
+        if (column->colpos != 0 && !column->callid2) {
             column->callid2 = callid;
             return;
         }
-        column = column->next;
     }
 
-    if (info->columns)
-        colpos = info->columns->colpos + 1;
-
     column = malloc(sizeof(call_flow_column_t));
     memset(column, 0, sizeof(call_flow_column_t));
     column->callid = callid;
     column->addr = addr;
     column->host = host;
-    column->colpos = colpos;
+    column->colpos = info->colcnt++;
     column->next = info->columns;
     info->columns = column;
+
+    // Add the column to the address hash or at the end of its address list
+    if (!first) {
+        htable_insert(info->colhash, addr, column);
+    } else {
+        while (first->next_addr)
+            first = first->next_addr;
+        first->next_addr = column;
+    }
 }
 
 call_flow_column_t *
@@ -724,21 +1053,15 @@ call_flow_column_get(PANEL *panel, const char *callid, const char *addr)
     call_flow_info_t *info;
     call_flow_column_t *columns;
 
-    if (!(info = call_flow_info(panel)))
+    if (!(info = call_flow_info(panel)) || !info->colhash)
         return NULL;
 
-    columns = info->columns;
-    while (columns) {
-        if (!strcasecmp(addr, columns->addr)) {
-            if (is_option_enabled("cf.splitcallid"))
-                return columns;
-            if (columns->callid && !strcasecmp(callid, columns->callid))
-                return columns;
-            if (columns->callid2 && !strcasecmp(callid, columns->callid2))
-                return columns;
-        }
-        columns = columns->next;
+    // Column values are interned message attributes, compare them by pointer
+    for (columns = htable_find(info->colhash, addr); columns; columns = columns->next_addr) {
+        if (info->splitcallid)
+            return columns;
+        if (callid && (callid == columns->callid || callid == columns->callid2))
+            return columns;
     }
     return NULL;
 }
-
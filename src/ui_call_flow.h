@@ -35,11 +35,15 @@
 #include "config.h"
 #include "ui_manager.h"
 #include "group.h"
+#include "hash.h"
+#include "rtp.h"
 
 //! Sorter declaration of struct call_flow_info
 typedef struct call_flow_info call_flow_info_t;
 //! Sorter declaration of struct call_flow_column
 typedef struct call_flow_column call_flow_column_t;
+//! Sorter declaration of struct call_flow_arrow
+typedef struct call_flow_arrow call_flow_arrow_t;
 
 struct call_flow_column {
     const char *addr;
@@ -48,6 +52,39 @@ struct call_flow_column {
     const char *callid2;
     int colpos;
     call_flow_column_t *next;
+    //! Next column with the same address
+    call_flow_column_t *next_addr;
+};
+
+/**
+ * @brief Arrow directions in the call flow
+ */
+enum call_flow_arrow_dir {
+    CF_ARROW_RIGHT = 0,
+    CF_ARROW_LEFT,
+};
+
+/**
+ * @brief Precalculated layout of a message in the call flow
+ *
+ * Each message of the group is laid out once when it's added to the
+ * flow, so drawing only needs to print the visible arrows.
+ */
+struct call_flow_arrow {
+    //! Message of this arrow (SDP message for stream arrows)
+    sip_msg_t *msg;
+    //! RTP stream of this arrow or NULL for message arrows
+    rtp_stream_t *stream;
+    //! Leftmost column position of the arrow
+    int startcol;
+    //! Rightmost column position of the arrow
+    int endcol;
+    //! Arrow direction
+    enum call_flow_arrow_dir dir;
+    //! Message is a retransmission
+    int retrans;
+    //! Text printed over the arrow
+    char label[80];
 };
 
 /**
@@ -60,12 +97,36 @@ struct call_flow_info {
     WINDOW *raw_win;
     WINDOW *flow_win;
     sip_call_group_t *group;
-    sip_msg_t *first_msg;
-    sip_msg_t *cur_msg;
     sip_msg_t *selected;
     int raw_width;
     int cur_line;
     call_flow_column_t *columns;
+    //! Number of columns in the flow
+    int colcnt;
+    //! Address to first column with that address
+    htable_t *colhash;
+    //! Laid out arrows of the group messages
+    call_flow_arrow_t *arrows;
+    //! Number of laid out arrows
+    int arrowcnt;
+    //! Allocated arrows
+    int arrowsize;
+    //! First displayed arrow
+    int first_arrow;
+    //! Selected arrow
+    int cur_arrow;
+    //! cf.splitcallid value when the layout was created
+    int splitcallid;
+    //! cf.sdpinfo value when the layout was created
+    int sdpinfo;
+    //! Last laid out message
+    sip_msg_t *last_msg;
+    //! Group messages index generation when the layout was created
+    int generation;
+    //! Number of group streams with packets when the layout was created
+    int streamcnt;
+    //! Number of laid out streams
+    int streamlaid;
 };
 
 /**
@@ -123,16 +184,16 @@ call_flow_draw_columns(PANEL *panel);
  * @brief Draw the message arrow in the given line
  *
  * Draw the given message arrow in the given line.
- * This function will calculate origin and destriny coordinates
- * base on message information. Each message use two lines
+ * Origin and destiny coordinates are taken from the arrow layout
+ * calculated when the message was added. Each message use two lines
  *
  * @param panel Ncurses panel pointer
- * @param msg Message data to draw
+ * @param arrow Laid out message to draw
  * @param cline Window line to draw the message
  * @return 0 if arrow is drawn, 1 otherwise
  */
 int
-call_flow_draw_message(PANEL *panel, sip_msg_t *msg, int cline);
+call_flow_draw_message(PANEL *panel, call_flow_arrow_t *arrow, int cline);
 
 /**
  * @brief Draw raw panel with message payload
@@ -183,6 +244,63 @@ call_flow_help(PANEL *panel);
 int
 call_flow_set_group(sip_call_group_t *group);
 
+/**
+ * @brief Remove all columns and arrows of the flow layout
+ *
+ * @param panel Ncurses panel pointer
+ */
+void
+call_flow_layout_clear(PANEL *panel);
+
+/**
+ * @brief Add the new messages of the group to the flow layout
+ *
+ * Columns and arrows are only calculated for the messages that were
+ * not laid out yet. If any option affecting the layout has changed
+ * since last update, or group messages have been merged again because
+ * an older message arrived, the layout is created again.
+ *
+ * RTP streams of the group calls are placed between the messages using
+ * the time of their first packet. The layout is also created again when
+ * a new stream receives its first packet.
+ *
+ * @param panel Ncurses panel pointer
+ */
+void
+call_flow_layout_update(PANEL *panel);
+
+/**
+ * @brief Add a message arrow to the flow layout
+ *
+ * @param panel Ncurses panel pointer
+ * @param msg SIP message to be laid out
+ * @return 0 if the arrow has been added, 1 otherwise
+ */
+int
+call_flow_layout_msg(PANEL *panel, sip_msg_t *msg);
+
+/**
+ * @brief Add a RTP stream arrow to the flow layout
+ *
+ * Stream arrows use the columns of the message that announced the
+ * stream in its SDP and point to that message sender.
+ *
+ * @param panel Ncurses panel pointer
+ * @param stream RTP stream to be laid out
+ * @return 0 if the arrow has been added, 1 otherwise
+ */
+int
+call_flow_layout_stream(PANEL *panel, rtp_stream_t *stream);
+
+/**
+ * @brief Get the message of the selected arrow
+ *
+ * @param panel Ncurses panel pointer
+ * @return selected message or NULL if the flow is empty
+ */
+sip_msg_t *
+call_flow_cur_msg(PANEL *panel);
+
 /**
  * @brief Add a new column (if required)
  *
@@ -203,7 +321,7 @@ call_flow_column_add(PANEL *panel, const char *callid, const char *addr, const c
  * @brief Get a flow column data
  *
  * @param panel Ncurses panel pointer
- * @param callid Call-Id header of SIP payload
+ * @param callid Call-Id attribute of a message (interned)
  * @param addr Address:port string
  * @return column structure pointer or NULL if not found
  */
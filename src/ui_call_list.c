@@ -108,6 +108,10 @@ call_list_create()
     info->list_win = subwin(win, height - 5, width, 4, 0);
     info->group = call_group_create();
 
+    // Create the displayed rows cache
+    info->rows = malloc(sizeof(call_list_row_t) * (height - 5));
+    memset(info->rows, 0, sizeof(call_list_row_t) * (height - 5));
+
     // Draw a Panel header lines
     if ((infile = capture_get_infile()))
         mvwprintw(win, 1, width - strlen(infile) - 11, "Filename: %s", infile);
@@ -122,6 +126,7 @@ call_list_create()
     // Set defualt filter text if configured
     if (get_option_value("cl.filter")) {
         set_field_buffer(info->fields[FLD_LIST_FILTER], 0, get_option_value("cl.filter"));
+        filter_set(FILTER_CALL_LIST, get_option_value("cl.filter"));
         call_list_form_activate(panel, 0);
     }
 
@@ -150,6 +155,8 @@ call_list_destroy(PANEL *panel)
         // Deallocate group data
         if (info->group)
             call_group_destroy(info->group);
+        // Deallocate rows cache
+        free(info->rows);
         free(info);
     }
 
@@ -183,8 +190,12 @@ call_list_draw(PANEL *panel)
     int height, width, cline = 0, i, colpos, collen;
     struct sip_call *call;
     int dispcallcnt, callcnt, cury, curx;
-    const char *coldesc;
-    char linetext[256];
+    int flags, version, displayhost, countpos, countlen;
+    const char *coldesc, *mode, *infile;
+    char count[64];
+    call_list_row_t *row;
+    enum sip_attr_id sortby;
+    int sortasc;
 
     // Get panel info
     call_list_info_t *info = (call_list_info_t*) panel_userptr(panel);
@@ -198,17 +209,24 @@ call_list_draw(PANEL *panel)
     // Store cursor position
     getyx(win, cury, curx);
 
+    // Calls count is printed after current mode (that may include load progress)
+    mode = capture_status();
+    countpos = 16 + strlen(mode) + 2;
+    if (countpos < 35)
+        countpos = 35;
+
     // Update current mode information
     if (!info->form_active) {
         // Print current running mode information
-        mvwprintw(win, 1, 2, "%*s", 35, "");
-        mvwprintw(win, 1, 2, "Current Mode: %s", capture_status());
+        mvwprintw(win, 1, 2, "%*s", countpos - 2, "");
+        mvwprintw(win, 1, 2, "Current Mode: %s", mode);
 
         // Reverse colors on monochrome terminals
         if (!has_colors())
             wattron(win, A_REVERSE);
 
         // Draw columns titles
+        sip_get_sort(&sortby, &sortasc);
         wattron(win, A_BOLD | COLOR_PAIR(CP_DEF_ON_CYAN));
         mvwprintw(win, 3, 0, "%*s", width, "");
         for (colpos = 6, i = 0; i < info->columncnt; i++) {
@@ -221,6 +239,9 @@ call_list_draw(PANEL *panel)
             if (colpos + strlen(coldesc) >= width)
                 break;
             mvwprintw(win, 3, colpos, "%.*s", collen, coldesc);
+            // Mark the column calls are sorted by
+            if (info->columns[i].id == sortby && (int) strlen(coldesc) < collen)
+                mvwaddch(win, 3, colpos + strlen(coldesc), sortasc ? ACS_UARROW : ACS_DARROW);
             colpos += collen + 1;
         }
         wattroff(win, A_BOLD | A_REVERSE | COLOR_PAIR(CP_DEF_ON_CYAN));
@@ -229,13 +250,19 @@ call_list_draw(PANEL *panel)
     // Get filter call counters
     filter_stats(&callcnt, &dispcallcnt);
 
+    // Calls count field ends before the input filename
+    countlen = width - countpos - 1;
+    if ((infile = capture_get_infile()))
+        countlen -= strlen(infile) + 11;
+
     // Print calls count (also filtered)
-    mvwprintw(win, 1, 35, "%*s", 35, "");
     if (callcnt != dispcallcnt) {
-        mvwprintw(win, 1, 35, "Dialogs: %d (%d displayed)", callcnt, dispcallcnt);
+        sprintf(count, "Dialogs: %d (%d displayed)", callcnt, dispcallcnt);
     } else {
-        mvwprintw(win, 1, 35, "Dialogs: %d", callcnt);
+        sprintf(count, "Dialogs: %d", callcnt);
     }
+    if (countlen > 0)
+        mvwprintw(win, 1, countpos, "%-*.*s", countlen, countlen, count);
 
     // Restore cursor position
     wmove(win, cury, curx);
@@ -244,9 +271,15 @@ call_list_draw(PANEL *panel)
     win = info->list_win;
     getmaxyx(win, height, width);
 
-    // No calls, we've finished drawing
-    if (dispcallcnt == 0)
-        return 0;
+    // Repaint all rows if displayed columns values change or the
+    // scrollbar is no longer drawn
+    displayhost = is_option_enabled("sngrep.displayhost");
+    if (info->displayhost != displayhost
+        || (info->dispcallcnt >= height && dispcallcnt < height)) {
+        memset(info->rows, 0, sizeof(call_list_row_t) * height);
+        info->displayhost = displayhost;
+    }
+    info->dispcallcnt = dispcallcnt;
 
     // If no active call, use the fist one (if exists)
     if (!info->first_call && call_get_next_filtered(NULL)) {
@@ -264,14 +297,40 @@ call_list_draw(PANEL *panel)
         if (!call_msg_count(call))
             continue;
 
+        // Get current row display flags
+        flags = 0;
+        if (call_group_exists(info->group, call))
+            flags |= CL_ROW_SELECTED;
+        if (call == info->cur_call)
+            flags |= CL_ROW_HIGHLIGHT;
+
+        // Get call version before reading its data
+        row = &info->rows[cline];
+        version = call->version;
+
+        // Nothing has changed in this row since last draw
+        if (row->call == call && row->version == version && row->flags == flags) {
+            cline++;
+            continue;
+        }
+
+        // Only format the line text if the displayed call data has changed
+        if (row->call != call || row->version != version) {
+            memset(row->text, 0, sizeof(row->text));
+            call_list_line_text(panel, call, row->text);
+        }
+        row->call = call;
+        row->version = version;
+        row->flags = flags;
+
         // Show bold selected rows
-        if (call_group_exists(info->group, call)) {
+        if (flags & CL_ROW_SELECTED) {
             wattron(win, A_BOLD);
             wattron(win, COLOR_PAIR(CP_DEFAULT));
         }
 
         // Highlight active call
-        if (call == info->cur_call) {
+        if (flags & CL_ROW_HIGHLIGHT) {
             // Reverse colors on monochrome terminals
             if (!has_colors())
                 wattron(win, A_REVERSE);
@@ -281,11 +340,10 @@ call_list_draw(PANEL *panel)
         // Set current line background
         mvwprintw(win, cline, 0, "%*s", width, "");
         // Set current line selection box
-        mvwprintw(win, cline, 2, call_group_exists(info->group, call) ? "[*]" : "[ ]");
+        mvwprintw(win, cline, 2, (flags & CL_ROW_SELECTED) ? "[*]" : "[ ]");
 
         // Print call line if no filter is active or it matchs the filter
-        memset(linetext, 0, sizeof(linetext));
-        mvwprintw(win, cline, 6, "%.*s", width - 6, call_list_line_text(panel, call, linetext));
+        mvwprintw(win, cline, 6, "%.*s", width - 6, row->text);
         cline++;
 
         wattroff(win, COLOR_PAIR(CP_DEFAULT));
@@ -293,6 +351,14 @@ call_list_draw(PANEL *panel)
         wattroff(win, A_BOLD | A_REVERSE);
     }
 
+    // Clear the rows no longer displayed
+    for (; cline < height; cline++) {
+        if (info->rows[cline].call) {
+            mvwprintw(win, cline, 0, "%*s", width, "");
+            info->rows[cline].call = NULL;
+        }
+    }
+
     // Draw scrollbar to the right
     draw_vscrollbar(win, info->first_line, dispcallcnt, 1);
     wnoutrefresh(info->list_win);
@@ -345,19 +411,8 @@ call_list_line_text(PANEL *panel, sip_call_t *call, char *text)
     // Print requested columns
     for (i = 0; i < info->columncnt; i++) {
 
-        // Swappable columns
-        switch (info->columns[i].id) {
-            case SIP_ATTR_SRC:
-            case SIP_ATTR_SRC_HOST:
-                colid = (is_option_enabled("sngrep.displayhost")) ? SIP_ATTR_SRC_HOST : SIP_ATTR_SRC;
-                break;
-            case SIP_ATTR_DST:
-            case SIP_ATTR_DST_HOST:
-                colid = (is_option_enabled("sngrep.displayhost")) ? SIP_ATTR_DST_HOST : SIP_ATTR_DST;
-                break;
-            default:
-                colid = info->columns[i].id;
-        }
+        // Get displayed attribute for this column
+        colid = call_list_column_attr(panel, i);
 
         // Get current column width
         collen = info->columns[i].width;
@@ -383,6 +438,51 @@ call_list_line_text(PANEL *panel, sip_call_t *call, char *text)
     return text;
 }
 
+enum sip_attr_id
+call_list_column_attr(PANEL *panel, int column)
+{
+    // Get panel info
+    call_list_info_t *info = (call_list_info_t*) panel_userptr(panel);
+
+    // Check column exists
+    if (!info || column < 0 || column >= info->columncnt)
+        return -1;
+
+    // Swappable columns
+    switch (info->columns[column].id) {
+        case SIP_ATTR_SRC:
+        case SIP_ATTR_SRC_HOST:
+            return (is_option_enabled("sngrep.displayhost")) ? SIP_ATTR_SRC_HOST : SIP_ATTR_SRC;
+        case SIP_ATTR_DST:
+        case SIP_ATTR_DST_HOST:
+            return (is_option_enabled("sngrep.displayhost")) ? SIP_ATTR_DST_HOST : SIP_ATTR_DST;
+        default:
+            return info->columns[column].id;
+    }
+}
+
+/**
+ * @brief Move the call list to its first call
+ *
+ * Displayed rows will be drawn again, but selected calls are kept.
+ */
+static void
+call_list_move_top(PANEL *panel)
+{
+    call_list_info_t *info = (call_list_info_t*) panel_userptr(panel);
+
+    // Start again from the first call
+    info->first_call = info->cur_call = NULL;
+    info->first_line = info->cur_line = 0;
+
+    // Displayed rows must be drawn again
+    memset(info->rows, 0, sizeof(call_list_row_t) * getmaxy(info->list_win));
+
+    // Clear Displayed lines
+    werase(info->list_win);
+    wnoutrefresh(info->list_win);
+}
+
 int
 call_list_handle_key(PANEL *panel, int key)
 {
@@ -390,6 +490,8 @@ call_list_handle_key(PANEL *panel, int key)
     call_list_info_t *info = (call_list_info_t*) panel_userptr(panel);
     ui_t *next_panel;
     sip_call_group_t *group;
+    enum sip_attr_id sortby;
+    int sortasc;
 
     // Sanity check, this should not happen
     if (!info)
@@ -453,7 +555,7 @@ call_list_handle_key(PANEL *panel, int key)
                 return -1;
             // KEY_ENTER , Display current call flow
             next_panel = ui_create(ui_find_by_type(PANEL_CALL_FLOW));
-            if (info->group->callcnt) {
+            if (call_group_count(info->group)) {
                 group = info->group;
             } else {
                 if (!info->cur_call)
@@ -468,7 +570,7 @@ call_list_handle_key(PANEL *panel, int key)
         case KEY_F(4):
             // KEY_X , Display current call flow (extended)
             next_panel = ui_create(ui_find_by_type(PANEL_CALL_FLOW));
-            if (info->group->callcnt) {
+            if (call_group_count(info->group)) {
                 group = info->group;
             } else {
                 if (!info->cur_call)
@@ -485,7 +587,7 @@ call_list_handle_key(PANEL *panel, int key)
         case KEY_F(6):
             // KEY_R , Display current call flow (extended)
             next_panel = ui_create(ui_find_by_type(PANEL_CALL_RAW));
-            if (info->group->callcnt) {
+            if (call_group_count(info->group)) {
                 group = info->group;
             } else {
                 if (!info->cur_call)
@@ -522,6 +624,12 @@ call_list_handle_key(PANEL *panel, int key)
                 wait_for_input(next_panel);
             }
             break;
+        case 'd':
+        case 'D':
+            // Display traffic statistics panel
+            next_panel = ui_create(ui_find_by_type(PANEL_STATS));
+            wait_for_input(next_panel);
+            break;
         case 'i':
         case 'I':
             // Set Display filter text
@@ -531,10 +639,34 @@ call_list_handle_key(PANEL *panel, int key)
             filter_reset_calls();
             break;
         case KEY_F(5):
+            // Clear List before its calls are destroyed
+            call_list_clear(panel);
             // Remove all stored calls
             sip_calls_clear();
-            // Clear List
-            call_list_clear(panel);
+            break;
+        case '<':
+        case '>':
+            if (!info->columncnt)
+                break;
+            // Sort calls by the previous or next displayed column
+            sip_get_sort(&sortby, &sortasc);
+            for (i = 0; i < info->columncnt && info->columns[i].id != sortby; i++)
+                ;
+            if (i == info->columncnt) {
+                i = (key == '>') ? 0 : info->columncnt - 1;
+            } else if (key == '>') {
+                i = (i + 1) % info->columncnt;
+            } else {
+                i = (i + info->columncnt - 1) % info->columncnt;
+            }
+            sip_set_sort(info->columns[i].id, sortasc);
+            call_list_move_top(panel);
+            break;
+        case 'z':
+            // Reverse calls sort order
+            sip_get_sort(&sortby, &sortasc);
+            sip_set_sort(sortby, !sortasc);
+            call_list_move_top(panel);
             break;
         case ' ':
             if (!info->cur_call)
@@ -562,7 +694,7 @@ call_list_handle_key(PANEL *panel, int key)
 int
 call_list_handle_form_key(PANEL *panel, int key)
 {
-    int field_idx;
+    int field_idx, i;
     char dfilter[256];
 
     // Get panel information
@@ -618,9 +750,11 @@ call_list_handle_form_key(PANEL *panel, int key)
     form_driver(info->form, REQ_VALIDATION);
 
     // Store dfilter input
-    // We trim spaces with sscanf because and empty field is stored as space characters
+    // Filter expressions can contain spaces, so only trim the trailing ones
     memset(dfilter, 0, sizeof(dfilter));
-    sscanf(field_buffer(info->fields[FLD_LIST_FILTER], 0), "%[^ ]", dfilter);
+    strncpy(dfilter, field_buffer(info->fields[FLD_LIST_FILTER], 0), sizeof(dfilter) - 1);
+    for (i = strlen(dfilter) - 1; i >= 0 && isspace(dfilter[i]); i--)
+        dfilter[i] = '\0';
 
     // Set display filter
     filter_set(FILTER_CALL_LIST, strlen(dfilter) ? dfilter : NULL);
@@ -636,7 +770,7 @@ call_list_help(PANEL *panel)
     int height, width;
 
     // Create a new panel and show centered
-    height = 28;
+    height = 31;
     width = 65;
     help_win = newwin(height, width, (LINES - height) / 2, (COLS - width) / 2);
     help_panel = new_panel(help_win);
@@ -675,7 +809,7 @@ call_list_help(PANEL *panel)
     mvwprintw(help_win, 12, 2, "Space       Select call");
     mvwprintw(help_win, 13, 2, "F1/h        Show this screen");
     mvwprintw(help_win, 14, 2, "F2/S        Save captured packages to a file");
-    mvwprintw(help_win, 15, 2, "F3//        Display filtering (match string case insensitive)");
+    mvwprintw(help_win, 15, 2, "F3//        Display filtering (match string or expression)");
     mvwprintw(help_win, 16, 2, "F4/X        Show selected call-flow (Extended) if available");
     mvwprintw(help_win, 17, 2, "F5          Clear call list (can not be undone!)");
     mvwprintw(help_win, 18, 2, "F6/R        Show selected call messages in raw mode");
@@ -685,6 +819,9 @@ call_list_help(PANEL *panel)
     mvwprintw(help_win, 22, 2, "F10/t       Select displayed columns");
     mvwprintw(help_win, 23, 2, "i/I         Set display filter to invite");
     mvwprintw(help_win, 24, 2, "p           Stop/Resume packet capture");
+    mvwprintw(help_win, 25, 2, "</>         Sort calls by previous/next column");
+    mvwprintw(help_win, 26, 2, "z           Reverse calls sort order");
+    mvwprintw(help_win, 27, 2, "d/D         Show traffic statistics");
 
     // Press any key to close
     wgetch(help_win);
@@ -774,6 +911,10 @@ call_list_add_column(PANEL *panel, enum sip_attr_id id, const char* attr, const
     info->columns[info->columncnt].title = title;
     info->columns[info->columncnt].width = width;
     info->columncnt++;
+
+    // Cached rows were drawn with the previous columns layout
+    if (info->rows)
+        memset(info->rows, 0, sizeof(call_list_row_t) * getmaxy(info->list_win));
     return 0;
 }
 
@@ -786,11 +927,6 @@ call_list_clear(PANEL *panel)
         return;
 
     // Initialize structures
-    info->first_call = info->cur_call = NULL;
-    info->first_line = info->cur_line = 0;
-    info->group->callcnt = 0;
-
-    // Clear Displayed lines
-    werase(info->list_win);
-    wnoutrefresh(info->list_win);
+    call_list_move_top(panel);
+    call_group_clear(info->group);
 }
@@ -47,10 +47,22 @@ enum call_list_field_list {
     FLD_LIST_COUNT
 };
 
+/**
+ * @brief Call List row display flags
+ */
+enum call_list_row_flags {
+    //! Row call is in the selected group
+    CL_ROW_SELECTED = 1,
+    //! Row call is the active call
+    CL_ROW_HIGHLIGHT = 2,
+};
+
 //! Sorter declaration of call_list_column struct
 typedef struct call_list_column call_list_column_t;
 //! Sorter declaration of call_list_info struct
 typedef struct call_list_info call_list_info_t;
+//! Sorter declaration of call_list_row struct
+typedef struct call_list_row call_list_row_t;
 
 /**
  * @brief Call List column information
@@ -66,6 +78,24 @@ struct call_list_column {
     int width;
 };
 
+/**
+ * @brief Call List displayed row information
+ *
+ * Each displayed row stores the call and the call version it was
+ * drawn with, so only rows whose call has changed since last draw
+ * are painted again.
+ */
+struct call_list_row {
+    //! Displayed call in this row
+    sip_call_t *call;
+    //! Call version when the row was drawn
+    int version;
+    //! Row is selected or highlighted
+    int flags;
+    //! Formatted line text
+    char text[256];
+};
+
 /**
  * @brief Call List panel status information
  *
@@ -95,6 +125,12 @@ struct call_list_info {
     FIELD *fields[FLD_LIST_COUNT + 1];
     //! We're entering keys on form
     int form_active;
+    //! Displayed rows cache (one per list window line)
+    call_list_row_t *rows;
+    //! Displayed calls count in last drawn list
+    int dispcallcnt;
+    //! Display host option value in last drawn list
+    int displayhost;
 };
 
 /**
@@ -172,6 +208,19 @@ call_list_form_activate(PANEL *panel, int active);
 const char*
 call_list_line_text(PANEL *panel, sip_call_t *call, char *text);
 
+/**
+ * @brief Get the attribute displayed in a column
+ *
+ * Some columns display different attributes depending on the
+ * configuration (like source and destination host columns)
+ *
+ * @param panel Ncurses panel pointer
+ * @param column Column position in the list
+ * @return attribute id or -1 if the column does not exist
+ */
+enum sip_attr_id
+call_list_column_attr(PANEL *panel, int column);
+
 /**
  * @brief Handle Call list key strokes
  *
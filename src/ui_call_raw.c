@@ -26,7 +26,6 @@
  * @brief Source of functions defined in ui_call_raw.h
  *
  * @todo Code help screen. Please.
- * @todo Replace the panel refresh. Wclear sucks on high latency conections.
  *
  */
 #include <string.h>
@@ -45,7 +44,8 @@ ui_t ui_call_raw = {
     .panel = NULL,
     .create = call_raw_create,
     .draw = call_raw_draw,
-    .handle_key = call_raw_handle_key
+    .handle_key = call_raw_handle_key,
+    .destroy = call_raw_destroy
 };
 
 PANEL *
@@ -64,74 +64,145 @@ call_raw_create()
     // Store it into panel userptr
     set_panel_userptr(panel, (void*) info);
 
-    // Create a initial pad of 1000 lines
-    info->pad = newpad(500, COLS);
-    info->padline = 0;
-    info->scroll = 0;
-
     return panel;
 }
 
+void
+call_raw_destroy(PANEL *panel)
+{
+    call_raw_info_t *info;
+
+    // Hide the panel
+    hide_panel(panel);
+
+    // Free its status data
+    if ((info = (call_raw_info_t*) panel_userptr(panel))) {
+        free(info->msgs);
+        free(info->msglines);
+        free(info->lines);
+        free(info);
+    }
+
+    // Finally free the panel memory
+    delwin(panel_window(panel));
+    del_panel(panel);
+}
+
+/**
+ * @brief Remove all indexed messages and lines
+ */
+static void
+call_raw_index_clear(call_raw_info_t *info)
+{
+    info->last = NULL;
+    info->msgcnt = 0;
+    info->linecnt = 0;
+    info->scroll = 0;
+}
+
 int
 call_raw_draw(PANEL *panel)
 {
     sip_msg_t *msg = NULL;
+    int idx, line, height, scroll;
 
     // Get panel information
     call_raw_info_t *info = (call_raw_info_t*) panel_userptr(panel);
+    WINDOW *win = panel_window(panel);
+    height = getmaxy(win);
 
     if (info->group) {
-        // Print the call group messages into the pad
+        // Older messages may have been merged before the last indexed one
+        call_group_index_update(info->group);
+        if (info->generation != info->group->generation) {
+            // Index all messages again, keeping the displayed lines
+            scroll = info->scroll;
+            call_raw_index_clear(info);
+            info->scroll = scroll;
+            info->generation = info->group->generation;
+        }
+
+        // Index the new messages of the call group
         while ((msg = call_group_get_next_msg(info->group, info->last)))
-            call_raw_print_msg(panel, msg);
-    } else {
-        call_raw_set_msg(info->msg);
+            call_raw_index_msg(panel, msg);
+    } else if (info->msg && !info->msgcnt) {
+        call_raw_index_msg(panel, info->msg);
     }
 
-    // Copy the visible part of the pad into the panel window
-    copywin(info->pad, panel_window(panel), info->scroll, 0, 0, 0, LINES - 1, COLS - 1, 0);
+    // Clear the window
+    werase(win);
+
+    // Nothing to display
+    if (info->scroll >= info->linecnt)
+        return 0;
+
+    // Get the first message in the displayed lines
+    idx = info->lines[info->scroll];
+    line = info->msglines[idx] - info->scroll;
+
+    // Draw only the messages with visible lines
+    for (; idx < info->msgcnt && line < height; idx++)
+        line += call_raw_print_msg(panel, info->msgs[idx], line);
+
     return 0;
 }
 
 int
-call_raw_print_msg(PANEL *panel, sip_msg_t *msg)
+call_raw_index_msg(PANEL *panel, sip_msg_t *msg)
 {
-    int payload_lines, i, column, height, width;
-    // Message ngrep style Header
-    char header[256];
+    int i, msg_lines;
+    void *ptr;
 
     // Get panel information
     call_raw_info_t *info = (call_raw_info_t*) panel_userptr(panel);
 
-    // Get the pad window
-    WINDOW *pad = info->pad;
-
-    // Get current pad dimensions
-    getmaxyx(pad, height, width);
-
-    // Check how many lines we well need to draw this message
-    payload_lines = 0;
-    column = 0;
-    for (i = 0; i < strlen(msg->payload); i++) {
-        if (column == width || msg->payload[i] == '\n') {
-            payload_lines++;
-            column = 0;
-            continue;
-        }
-        column++;
+    // Header, payload and an extra line between messages
+    msg_lines = draw_message_lines(panel_window(panel), msg) + 2;
+
+    // Make room for the new message
+    if (info->msgcnt == info->msgsize) {
+        info->msgsize += 500;
+        if (!(ptr = realloc(info->msgs, sizeof(sip_msg_t *) * info->msgsize)))
+            return 1;
+        info->msgs = ptr;
+        if (!(ptr = realloc(info->msglines, sizeof(int) * info->msgsize)))
+            return 1;
+        info->msglines = ptr;
     }
 
-    // Check if we have enough space in our huge pad to store this message
-    if (info->padline + payload_lines > height) {
-        // Delete previous pad
-        delwin(info->pad);
-        // Create a new pad with more lines!
-        pad = newpad(height + 500, COLS);
-        // And copy all previous information
-        overwrite(info->pad, pad);
-        info->pad = pad;
+    // Make room for the message lines
+    if (info->linecnt + msg_lines > info->linesize) {
+        info->linesize = info->linecnt + msg_lines + 5000;
+        if (!(ptr = realloc(info->lines, sizeof(int) * info->linesize)))
+            return 1;
+        info->lines = ptr;
     }
 
+    // Store message first line and index of its lines
+    info->msgs[info->msgcnt] = msg;
+    info->msglines[info->msgcnt] = info->linecnt;
+    for (i = 0; i < msg_lines; i++)
+        info->lines[info->linecnt++] = info->msgcnt;
+    info->msgcnt++;
+
+    // Set this as the last indexed message
+    info->last = msg;
+
+    return 0;
+}
+
+int
+call_raw_print_msg(PANEL *panel, sip_msg_t *msg, int line)
+{
+    // Message ngrep style Header
+    char header[256];
+
+    // Get panel information
+    call_raw_info_t *info = (call_raw_info_t*) panel_userptr(panel);
+
+    // Get the panel window
+    WINDOW *win = panel_window(panel);
+
     // Color the message {
     if (is_option_enabled("color.request")) {
         // Determine arrow color
@@ -149,22 +220,23 @@ call_raw_print_msg(PANEL *panel, sip_msg_t *msg)
     }
 
     // Turn on the message color
-    wattron(pad, COLOR_PAIR(msg->color));
+    wattron(win, COLOR_PAIR(msg->color));
 
     // Print msg header
-    wattron(pad, A_BOLD);
-    mvwprintw(pad, info->padline++, 0, "%s", msg_get_header(msg, header));
-    wattroff(pad, A_BOLD);
+    if (line >= 0) {
+        wattron(win, A_BOLD);
+        mvwprintw(win, line, 0, "%s", msg_get_header(msg, header));
+        wattroff(win, A_BOLD);
+    }
 
     // Print msg payload
-    info->padline += draw_message_pos(pad, msg, info->padline);
-    // Extra line between messages
-    info->padline++;
+    draw_message_pos(win, msg, line + 1);
 
-    // Set this as the last printed message
-    info->last = msg;
+    // Turn off the message color
+    wattroff(win, COLOR_PAIR(msg->color));
 
-    return 0;
+    // Header, payload and an extra line between messages
+    return draw_message_lines(win, msg) + 2;
 }
 
 int
@@ -196,12 +268,6 @@ call_raw_handle_key(PANEL *panel, int key)
         case 'l':
             // Tooggle Host/Address display
             toggle_option("sngrep.displayhost");
-            // Force refresh panel
-            if (info->group) {
-                call_raw_set_group(info->group);
-            } else {
-                call_raw_set_msg(info->msg);
-            }
             break;
         case 's':
         case 'S':
@@ -216,26 +282,16 @@ call_raw_handle_key(PANEL *panel, int key)
         case 'c':
             // Handle colors using default handler
             default_handle_key(ui_find_by_panel(panel), key);
-            // Create a new pad (forces messages draw)
-            delwin(info->pad);
-            info->pad = newpad(500, COLS);
-            info->last = NULL;
-            // Force refresh panel
-            if (info->group) {
-                call_raw_set_group(info->group);
-            } else {
-                call_raw_set_msg(info->msg);
-            }
             break;
         default:
             return key;
     }
 
-    if (info->scroll < 0 || info->padline < LINES) {
+    if (info->scroll < 0 || info->linecnt < LINES) {
         info->scroll = 0;   // Disable scrolling if there's nothing to scroll
     } else {
-        if (info->scroll + LINES / 2 > info->padline)
-            info->scroll = info->padline - LINES / 2;
+        if (info->scroll + LINES / 2 > info->linecnt)
+            info->scroll = info->linecnt - LINES / 2;
     }
     return 0;
 }
@@ -263,9 +319,8 @@ call_raw_set_group(sip_call_group_t *group)
     info->group = group;
     info->msg = NULL;
 
-    // Initialize internal pad
-    info->padline = 0;
-    wclear(info->pad);
+    // Initialize messages index
+    call_raw_index_clear(info);
 
     return 0;
 }
@@ -293,12 +348,11 @@ call_raw_set_msg(sip_msg_t *msg)
     info->group = NULL;
     info->msg = msg;
 
-    // Initialize internal pad
-    info->padline = 0;
-    wclear(info->pad);
+    // Initialize messages index
+    call_raw_index_clear(info);
 
-    // Print the message in the pad
-    call_raw_print_msg(panel, msg);
+    // Index the message
+    call_raw_index_msg(panel, msg);
 
     return 0;
 
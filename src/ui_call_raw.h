@@ -43,13 +43,33 @@ typedef struct call_raw_info call_raw_info_t;
  *
  * This data stores the actual status of the panel. It's stored in the
  * PANEL user pointer.
+ *
+ * Messages are not printed into a pad. Instead, the panel keeps an index
+ * with the first line of each message and the message of each line, so
+ * only the messages in the visible lines are drawn.
  */
 struct call_raw_info {
+    //! Group of messages displayed
     sip_call_group_t *group;
+    //! Single message displayed
     sip_msg_t *msg;
+    //! Last indexed message
     sip_msg_t *last;
-    WINDOW *pad;
-    int padline;
+    //! Group messages index generation when messages were indexed
+    int generation;
+    //! Indexed messages
+    sip_msg_t **msgs;
+    //! First line of each indexed message
+    int *msglines;
+    //! Number of indexed messages
+    int msgcnt;
+    //! Index of message for each line
+    int *lines;
+    //! Number of indexed lines
+    int linecnt;
+    //! Allocated messages and lines slots
+    int msgsize, linesize;
+    //! First displayed line
     int scroll;
 };
 
@@ -66,6 +86,16 @@ struct call_raw_info {
 PANEL *
 call_raw_create();
 
+/**
+ * @brief Destroy panel
+ *
+ * This function will hide the panel and free all allocated memory.
+ *
+ * @param panel Ncurses panel pointer
+ */
+void
+call_raw_destroy(PANEL *panel);
+
 /**
  * @brief Draw the Call Raw panel
  *
@@ -78,17 +108,33 @@ call_raw_create();
 int
 call_raw_draw(PANEL *panel);
 
+/**
+ * @brief Add a message to call Raw index
+ *
+ * Calculate the lines required to display the message and add them
+ * to the panel lines index.
+ *
+ * @param panel Ncurses panel pointer
+ * @param msg New message to be indexed
+ * @return 0 if the message has been indexed, 1 otherwise
+ */
+int
+call_raw_index_msg(PANEL *panel, sip_msg_t *msg);
+
 /**
  * @brief Draw a message in call Raw
  *
- * Draw a new message in the Raw pad.
+ * Draw a message in the panel window starting at the given line. Lines
+ * of the message outside the window are not drawn, so line can be
+ * negative to display only the last part of the message.
  *
  * @param panel Ncurses panel pointer
- * @param msg New message to be printed
- * @return 0 in call cases
+ * @param msg Message to be printed
+ * @param line Window line where message header will be drawn
+ * @return number of lines used by the message
  */
 int
-call_raw_print_msg(PANEL *panel, sip_msg_t *msg);
+call_raw_print_msg(PANEL *panel, sip_msg_t *msg, int line);
 
 /**
  * @brief Handle Call Raw key strokes
@@ -147,7 +147,7 @@ column_select_create()
     wattron(win, COLOR_PAIR(CP_CYAN_ON_DEF));
     mvwprintw(win, 3, 2, "This windows show the list of columns displayed on Call");
     mvwprintw(win, 4, 2, "List. You can enable/disable using Space Bar and reorder");
-    mvwprintw(win, 5, 2, "them using + and - keys.");
+    mvwprintw(win, 5, 2, "them using + and - keys. Sort calls by column using s.");
     wattroff(win, COLOR_PAIR(CP_CYAN_ON_DEF));
 
     info->form_active = 0;
@@ -193,6 +193,8 @@ column_select_handle_key_menu(PANEL *panel, int key)
     MENU *menu;
     ITEM *current;
     int current_idx;
+    enum sip_attr_id sortby, attr_id;
+    int sortasc;
 
     // Get panel information
     column_select_info_t *info = (column_select_info_t*) panel_userptr(panel);
@@ -227,6 +229,12 @@ column_select_handle_key_menu(PANEL *panel, int key)
             column_select_move_item(panel, current, current_idx - 1);
             column_select_update_menu(panel);
             break;
+        case 's':
+            // Sort calls by this column, reverse order if already sorted
+            sip_get_sort(&sortby, &sortasc);
+            attr_id = sip_attr_from_name(item_userptr(current));
+            sip_set_sort(attr_id, (attr_id == sortby) ? !sortasc : sortasc);
+            break;
         case 9 /*KEY_TAB*/:
             info->form_active = 1;
             set_menu_fore(menu, COLOR_PAIR(CP_DEFAULT));
@@ -333,6 +341,8 @@ column_select_update_columns(PANEL *panel)
 
     // Reset column count
     list_info->columncnt = 0;
+    // Displayed rows must be drawn again with the new columns
+    memset(list_info->rows, 0, sizeof(call_list_row_t) * getmaxy(list_info->list_win));
 
     // Add all selected columns
     for (column = 0; column < item_count(info->menu); column++) {
@@ -31,6 +31,10 @@
 #include <math.h>
 #include <stdlib.h>
 #include <locale.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <sys/time.h>
 #include "option.h"
 #include "ui_manager.h"
 #include "capture.h"
@@ -42,6 +46,8 @@
 #include "ui_save_raw.h"
 #include "ui_msg_diff.h"
 #include "ui_column_select.h"
+#include "ui_stats.h"
+#include "spool.h"
 
 /**
  * @brief Available panel windows list
@@ -59,8 +65,14 @@ static ui_t *panel_pool[] = {
     &ui_save_raw,
     &ui_msg_diff,
     &ui_column_select,
+    &ui_stats,
 };
 
+//! Pipe used to request screen redraws from other threads
+static int wakeup_pipe[2] = { -1, -1 };
+//! There is a redraw request pending in the pipe
+static int wakeup_pending = 0;
+
 int
 init_interface()
 {
@@ -91,8 +103,12 @@ init_interface()
     curs_set(0);
     // Only delay ESC Sequences 25 ms (we dont want Escape sequences)
     ESCDELAY = 25;
-    // Set character input timeout 200 ms
-    halfdelay(REFRESHTHSECS);
+
+    // Create redraw requests pipe
+    if (pipe(wakeup_pipe) == 0) {
+        fcntl(wakeup_pipe[0], F_SETFL, O_NONBLOCK);
+        fcntl(wakeup_pipe[1], F_SETFL, O_NONBLOCK);
+    }
 
     // Redefine some keys
     term = getenv("TERM");
@@ -213,15 +229,10 @@ ui_draw_panel(ui_t *ui)
 void
 ui_help(ui_t *ui)
 {
-    // Disable input timeout
-    nocbreak();
-    cbreak();
     // If current ui has help function
     if (ui->help) {
         ui->help(ui_get_panel(ui));
     }
-    // Enable input timeout
-    halfdelay(REFRESHTHSECS);
 }
 
 int
@@ -259,36 +270,117 @@ ui_find_by_type(int type)
     return NULL;
 }
 
+void
+ui_wakeup()
+{
+    // Interface not initialized
+    if (wakeup_pipe[1] == -1)
+        return;
+
+    // Only write to the pipe if there is no pending request
+    if (__sync_bool_compare_and_swap(&wakeup_pending, 0, 1)) {
+        if (write(wakeup_pipe[1], "", 1) != 1)
+            wakeup_pending = 0;
+    }
+}
+
+/**
+ * @brief Get current time in milliseconds
+ */
+static long long
+ui_time_msecs()
+{
+    struct timeval now;
+    gettimeofday(&now, NULL);
+    return (long long) now.tv_sec * 1000 + now.tv_usec / 1000;
+}
+
 int
 wait_for_input(ui_t *ui)
 {
     WINDOW *win;
+    struct pollfd fds[2];
+    char buffer[64];
+    int c, ret, timeout, period, redraw = 1, force = 1;
+    long long now, lastdraw = 0;
+    int interval = 1000 / REFRESHRATE;
+
+    // Get minimum time between data redraws
+    if (get_option_int_value("sngrep.refreshrate") > 0)
+        interval = 1000 / get_option_int_value("sngrep.refreshrate");
 
     // Keep getting keys until panel is destroyed
     while (ui_get_panel(ui)) {
-        // Redraw this panel
-        if (ui_draw_panel(ui) != 0)
-            return -1;
+        // Redraw this panel after keys or new data (rate limited)
+        if (redraw) {
+            now = ui_time_msecs();
+            if (force || now - lastdraw >= interval) {
+                // No payload is in use, release them if required
+                spool_trim();
+                if ((ret = ui_draw_panel(ui)) < 0)
+                    return -1;
+                // Panel has finished, close it
+                if (ret > 0) {
+                    ui_destroy(ui);
+                    break;
+                }
+                lastdraw = now;
+                redraw = force = 0;
+            }
+        }
 
         // Enable key input on current panel
         win = panel_window(ui_get_panel(ui));
         keypad(win, TRUE);
+        nodelay(win, TRUE);
 
         // Get pressed key
-        int c = wgetch(win);
+        if ((c = wgetch(win)) != ERR) {
+            // Redraw panel as soon as possible after handling the key
+            redraw = force = 1;
+
+            // Check if current panel has custom bindings for that key
+            if ((c = ui_handle_key(ui, c)) == 0) {
+                // Key has been handled by panel
+                continue;
+            }
 
-        // Timeout, no key pressed
-        if (c == ERR)
+            // Key not handled by UI, try default handler
+            default_handle_key(ui, c);
             continue;
+        }
 
-        // Check if current panel has custom bindings for that key
-        if ((c = ui_handle_key(ui, c)) == 0) {
-            // Key has been handled by panel
-            continue;
+        // Wait until next redraw is allowed or forever if nothing to redraw
+        timeout = (redraw) ? (int) (lastdraw + interval - ui_time_msecs()) : -1;
+        if (redraw && timeout < 0)
+            timeout = 0;
+
+        // Some panels display data that changes without new messages
+        if (!redraw && ui->redraw_interval
+            && (period = ui->redraw_interval(ui_get_panel(ui))) > 0) {
+            if ((timeout = (int) (lastdraw + period - ui_time_msecs())) <= 0) {
+                redraw = 1;
+                continue;
+            }
         }
 
-        // Key not handled by UI, try default handler
-        default_handle_key(ui, c);
+        // Wait for user input or redraw requests
+        fds[0].fd = STDIN_FILENO;
+        fds[0].events = POLLIN;
+        fds[1].fd = wakeup_pipe[0];
+        fds[1].events = POLLIN;
+        fds[0].revents = fds[1].revents = 0;
+        if (poll(fds, 2, timeout) <= 0)
+            continue;
+
+        // Redraw requested, consume pending requests
+        if (fds[1].revents & POLLIN) {
+            while (read(wakeup_pipe[0], buffer, sizeof(buffer)) > 0)
+                ;
+            // Allow new requests, data notified until now will be drawn
+            __sync_lock_release(&wakeup_pending);
+            redraw = 1;
+        }
     }
 
     return -1;
@@ -450,8 +542,9 @@ draw_message(WINDOW *win, sip_msg_t *msg)
 int
 draw_message_pos(WINDOW *win, sip_msg_t *msg, int starting)
 {
-    int height, width, line, column, i;
-    char *cur_line = msg->payload;
+    int height, width, line, column, i, len;
+    const char *payload = msg_get_payload(msg);
+    const char *cur_line = payload;
     int syntax = is_option_enabled("syntax");
 
     // Default text format
@@ -465,7 +558,8 @@ draw_message_pos(WINDOW *win, sip_msg_t *msg, int starting)
     // Print msg payload
     line = starting;
     column = 0;
-    for (i = 0; i < strlen(msg->payload); i++) {
+    len = strlen(payload);
+    for (i = 0; i < len; i++) {
         // If syntax highlighting is enabled
         if (syntax) {
             // First line highlight
@@ -479,13 +573,13 @@ draw_message_pos(WINDOW *win, sip_msg_t *msg, int starting)
                     attrs = A_BOLD | COLOR_PAIR(CP_RED_ON_DEF);
 
                 // SIP URI syntax
-                if (!strncasecmp(msg->payload + i, "sip:", 4)) {
+                if (!strncasecmp(payload + i, "sip:", 4)) {
                     attrs = A_BOLD | COLOR_PAIR(CP_CYAN_ON_DEF);
                 }
             } else {
 
                 // Header syntax
-                if (strchr(cur_line, ':') && msg->payload + i < strchr(cur_line, ':'))
+                if (strchr(cur_line, ':') && payload + i < strchr(cur_line, ':'))
                     attrs = A_NORMAL | COLOR_PAIR(CP_GREEN_ON_DEF);
 
                 // Call-ID Header syntax
@@ -493,20 +587,20 @@ draw_message_pos(WINDOW *win, sip_msg_t *msg, int starting)
                     attrs = A_BOLD | COLOR_PAIR(CP_MAGENTA_ON_DEF);
 
                 // CSeq Heaedr syntax
-                if (!strncasecmp(cur_line, "CSeq:", 5) && column > 5 && !isdigit(msg->payload[i]))
+                if (!strncasecmp(cur_line, "CSeq:", 5) && column > 5 && !isdigit(payload[i]))
                     attrs = A_NORMAL | COLOR_PAIR(CP_YELLOW_ON_DEF);
 
                 // tag and branch syntax
-                if (i > 0 && msg->payload[i - 1] == ';') {
+                if (i > 0 && payload[i - 1] == ';') {
                     // Highlight branch if requested
                     if (is_option_enabled("syntax.branch")) {
-                        if (!strncasecmp(msg->payload + i, "branch", 6)) {
+                        if (!strncasecmp(payload + i, "branch", 6)) {
                             attrs = A_BOLD | COLOR_PAIR(CP_CYAN_ON_DEF);
                         }
                     }
                     // Highlight tag if requested
                     if (is_option_enabled("syntax.tag")) {
-                        if (!strncasecmp(msg->payload + i, "tag", 3)) {
+                        if (!strncasecmp(payload + i, "tag", 3)) {
                             if (!strncasecmp(cur_line, "From:", 5)) {
                                 attrs = A_BOLD | COLOR_PAIR(CP_DEFAULT);
                             } else {
@@ -522,7 +616,7 @@ draw_message_pos(WINDOW *win, sip_msg_t *msg, int starting)
             }
 
             // Remove previous syntax
-            if (strcspn(msg->payload + i, " \n;<>") == 0) {
+            if (strcspn(payload + i, " \n;<>") == 0) {
                 wattroff(win, attrs);
                 attrs = A_NORMAL | COLOR_PAIR(CP_DEFAULT);
             }
@@ -532,22 +626,22 @@ draw_message_pos(WINDOW *win, sip_msg_t *msg, int starting)
         }
 
         // Dont print this characters
-        if (msg->payload[i] == '\r')
+        if (payload[i] == '\r')
             continue;
 
         // Store where the line begins
-        if (msg->payload[i] == '\n')
-            cur_line = msg->payload + i + 1;
+        if (payload[i] == '\n')
+            cur_line = payload + i + 1;
 
         // Move to the next line if line is filled or a we reach a line break
-        if (column > width || msg->payload[i] == '\n') {
+        if (column > width || payload[i] == '\n') {
             line++;
             column = 0;
             continue;
         }
 
         // Put next character in position
-        mvwaddch(win, line, column++, msg->payload[i]);
+        mvwaddch(win, line, column++, payload[i]);
 
         // Stop if we've reached the bottom of the window
         if (line == height)
@@ -563,3 +657,27 @@ draw_message_pos(WINDOW *win, sip_msg_t *msg, int starting)
 
     return line - starting;
 }
+
+int
+draw_message_lines(WINDOW *win, sip_msg_t *msg)
+{
+    int width, lines = 0, column = 0;
+    const char *payload;
+
+    // Get window width
+    width = getmaxx(win);
+
+    // Count lines the same way draw_message_pos prints them
+    for (payload = msg_get_payload(msg); *payload; payload++) {
+        if (*payload == '\r')
+            continue;
+        if (column > width || *payload == '\n') {
+            lines++;
+            column = 0;
+            continue;
+        }
+        column++;
+    }
+
+    return lines;
+}
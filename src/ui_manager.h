@@ -46,8 +46,8 @@
 #include "sip.h"
 #include "group.h"
 
-//! Refresh UI every 200 ms
-#define REFRESHTHSECS   2
+//! Default max screen redraws per second
+#define REFRESHRATE     5
 
 //! Shorter declaration of ui structure
 typedef struct ui ui_t;
@@ -78,6 +78,9 @@ struct ui {
     //! Show help window for this panel (if any)
     int
     (*help)(PANEL *);
+    //! Msecs between redraws without new data (if any, 0 to disable)
+    int
+    (*redraw_interval)(PANEL *);
 };
 
 /**
@@ -129,6 +132,8 @@ enum panel_types {
     PANEL_MSG_DIFF,
     //! Column selector panel
     PANEL_COLUMN_SELECT,
+    //! Traffic statistics panel
+    PANEL_STATS,
     //! Panel Counter
     PANEL_COUNT,
 };
@@ -144,6 +149,7 @@ extern ui_t ui_save;
 extern ui_t ui_save_raw;
 extern ui_t ui_msg_diff;
 extern ui_t ui_column_select;
+extern ui_t ui_stats;
 
 /**
  * @brief Initialize ncurses mode
@@ -208,8 +214,11 @@ ui_get_panel(ui_t *ui);
  * This function acts as wrapper to custom ui draw functions
  * with some checks
  *
+ * Panels that have finished their work while drawing return 1, so
+ * the caller can destroy them once drawing is done.
+ *
  * @param ui UI structure
- * @return 0 if ui has been drawn, -1 otherwise
+ * @return 0 if ui has been drawn, 1 if ui must be closed, -1 otherwise
  */
 int
 ui_draw_panel(ui_t *ui);
@@ -257,11 +266,26 @@ ui_find_by_type(int type);
  * This function manages all user input in all panel types and
  * redraws the panel using its own draw function
  *
+ * Panel is redrawn after each handled key or when new data
+ * has been notified using ui_wakeup, at most sngrep.refreshrate
+ * times per second. Panels with a redraw interval are also redrawn
+ * when it expires.
+ *
  * @param ui the topmost panel ui structure
  */
 int
 wait_for_input(ui_t *ui);
 
+/**
+ * @brief Request a screen redraw from other threads
+ *
+ * This function can be used by capture threads to notify the
+ * UI that new data is available. Multiple requests will be
+ * coalesced into a single screen redraw.
+ */
+void
+ui_wakeup();
+
 /**
  * @brief Default handler for keys
  *
@@ -344,4 +368,17 @@ draw_message(WINDOW *win, sip_msg_t *msg);
 int
 draw_message_pos(WINDOW *win, sip_msg_t *msg, int starting);
 
+/**
+ * @brief Get the number of lines required to draw a message payload
+ *
+ * Calculate how many lines draw_message_pos will write in the given
+ * window without drawing anything.
+ *
+ * @param win Ncurses window where payload would be drawn
+ * @param msg Msg to be measured
+ * @return number of lines draw_message_pos would return
+ */
+int
+draw_message_lines(WINDOW *win, sip_msg_t *msg);
+
 #endif    // __SNGREP_UI_MANAGER_H
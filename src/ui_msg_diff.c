@@ -157,7 +157,7 @@ msg_diff_highlight(sip_msg_t *one, sip_msg_t *two, char *highlight)
         if (!strcasecmp(get_option_value("diff.mode"), "lcs")) {
             // @todo msg_diff_lcs_highlight(one->payloadptr, two->payloadptr, highlight);
         } else if (!strcasecmp(get_option_value("diff.mode"), "line")) {
-            msg_diff_line_highlight(one->payload, two->payload, highlight);
+            msg_diff_line_highlight(msg_get_payload(one), msg_get_payload(two), highlight);
         } else {
             // Unknown hightlight enabled
         }
@@ -201,6 +201,7 @@ msg_diff_draw_message(WINDOW *win, sip_msg_t *msg, char *highlight)
 {
     int height, width, line, column, i;
     char header[256];
+    const char *payload = msg_get_payload(msg);
 
     // Clear the window
     werase(win);
@@ -215,11 +216,11 @@ msg_diff_draw_message(WINDOW *win, sip_msg_t *msg, char *highlight)
     // Print msg payload
     line = 2;
     column = 0;
-    for (i = 0; i < strlen(msg->payload); i++) {
-        if (msg->payload[i] == '\r')
+    for (i = 0; i < strlen(payload); i++) {
+        if (payload[i] == '\r')
             continue;
 
-        if (column == width || msg->payload[i] == '\n') {
+        if (column == width || payload[i] == '\n') {
             line++;
             column = 0;
             continue;
@@ -235,7 +236,7 @@ msg_diff_draw_message(WINDOW *win, sip_msg_t *msg, char *highlight)
         }
 
         // Put next character in position
-        mvwaddch(win, line, column++, msg->payload[i]);
+        mvwaddch(win, line, column++, payload[i]);
     }
 
     // Redraw raw win
@@ -134,11 +134,70 @@ save_create()
 void
 save_destroy(PANEL *panel)
 {
+    save_info_t *info;
+    int i;
+
+    // Free its status data
+    if ((info = (save_info_t*) panel_userptr(panel))) {
+        // Stop running export
+        if (info->export) {
+            capture_export_cancel(info->export);
+            capture_export_destroy(info->export);
+        }
+
+        // Deallocate forms data
+        unpost_form(info->form);
+        free_form(info->form);
+        for (i = 0; i < FLD_SAVE_COUNT; i++)
+            free_field(info->fields[i]);
+        free(info);
+    }
+
     // Unpause capture
     capture_set_paused(0);
 
     // Disable cursor position
     curs_set(0);
+
+    // Finally free the panel memory
+    delwin(panel_window(panel));
+    del_panel(panel);
+}
+
+/**
+ * @brief Draw export progress and check if it has finished
+ *
+ * @return 1 if panel must be closed, 0 otherwise
+ */
+static int
+save_draw_progress(PANEL *panel)
+{
+    save_info_t *info = (save_info_t*) panel_userptr(panel);
+    WINDOW *win = panel_window(panel);
+    capture_export_t *export = info->export;
+
+    switch (export->status) {
+        case CAPTURE_EXPORT_RUNNING:
+            mvwhline(win, 4, 3, ' ', 80);
+            if (!export->total) {
+                mvwprintw(win, 4, 3, "Sorting packets... (Esc to cancel)");
+            } else {
+                mvwprintw(win, 4, 3, "Saving %d of %d packets (%d%%)... (Esc to cancel)",
+                          export->written, export->total,
+                          (int) (export->written * 100LL / export->total));
+            }
+            curs_set(0);
+            return 0;
+        case CAPTURE_EXPORT_FAILED:
+            save_error_message(panel, strerror(export->error));
+            capture_export_destroy(export);
+            info->export = NULL;
+            curs_set(1);
+            return 0;
+        default:
+            // Export finished or cancelled, panel must be closed
+            return 1;
+    }
 }
 
 int
@@ -150,6 +209,10 @@ save_draw(PANEL *panel)
     save_info_t *info = (save_info_t*) panel_userptr(panel);
     WINDOW *win = panel_window(panel);
 
+    // Display export progress while saving
+    if (info->export && save_draw_progress(panel))
+        return 1;
+
     // Get filter stats
     filter_stats(&total, &displayed);
 
@@ -180,6 +243,13 @@ save_handle_key(PANEL *panel, int key)
     // Get panel information
     save_info_t *info = (save_info_t*) panel_userptr(panel);
 
+    // While saving, only allow to cancel the export
+    if (info->export) {
+        if (key == 27 /*KEY_ESC*/)
+            capture_export_cancel(info->export);
+        return 0;
+    }
+
     // Get current field id
     field_idx = field_index(current_field(info->form));
 
@@ -247,7 +317,8 @@ save_handle_key(PANEL *panel, int key)
                     save_error_message(panel, "Invalid filename");
                     return 0;
                 }
-                return save_to_file(panel);
+                save_to_file(panel);
+                return 0;
             }
             return 27;
         default:
@@ -290,6 +361,7 @@ void
 save_error_message(PANEL *panel, const char *message)
 {
     WINDOW *win = panel_window(panel);
+    mvwhline(win, 4, 3, ' ', 80);
     mvwprintw(win, 4, 3, "Error: %s", message);
     wmove(win, 3, 15);
 }
@@ -298,9 +370,9 @@ int
 save_to_file(PANEL *panel)
 {
     char field_value[256];
-    sip_call_t *call = NULL;
-    sip_msg_t *msg = NULL;
-    int i;
+    sip_call_group_t *group;
+    sip_call_t *call = NULL, **calls;
+    int i, count;
 
     // Get panel information
     save_info_t *info = (save_info_t*) panel_userptr(panel);
@@ -318,43 +390,23 @@ save_to_file(PANEL *panel)
         return 1;
     }
 
-    // Open dump file
-    pcap_dumper_t *pd = dump_open(field_value);
-    if (access(field_value, W_OK) != 0) {
-        save_error_message(panel, capture_last_error());
-        return 1;
+    // Create a group with the calls to be saved
+    group = call_group_create();
+    if (info->savemode == SAVE_SELECTED) {
+        while ((call = call_group_get_next(info->group, call)))
+            call_group_add(group, call);
+    } else if ((calls = sip_calls_array(info->savemode == SAVE_DISPLAYED, &count))) {
+        for (i = 0; i < count; i++)
+            call_group_add(group, calls[i]);
+        free(calls);
     }
 
-    switch(info->savemode) {
-        case SAVE_ALL:
-            // Save all packets to the file
-            while ((call = call_get_next(call))) {
-                while ((msg = call_get_next_msg(call, msg))) {
-                    dump_packet(pd, msg->pcap_header, msg->pcap_packet);
-                }
-            }
-            break;
-        case SAVE_SELECTED:
-            // Save selected packets to file
-            while ((call = call_group_get_next(info->group, call))) {
-                while ((msg = call_get_next_msg(call, msg))) {
-                    dump_packet(pd, msg->pcap_header, msg->pcap_packet);
-                }
-            }
-            break;
-        case SAVE_DISPLAYED:
-            // Save selected packets to file
-            while ((call = call_get_next_filtered(call))) {
-                while ((msg = call_get_next_msg(call, msg))) {
-                    dump_packet(pd, msg->pcap_header, msg->pcap_packet);
-                }
-            }
-            break;
+    // Start writing packets in background
+    if (!(info->export = capture_export_start(field_value, group))) {
+        save_error_message(panel, strerror(errno));
+        call_group_destroy(group);
+        return 1;
     }
 
-    // Close dump file
-    dump_close(pd);
-
-    return 27;
+    return 0;
 }
-
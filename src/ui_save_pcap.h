@@ -35,6 +35,7 @@
 #include "config.h"
 #include <form.h>
 #include "group.h"
+#include "capture_export.h"
 #include "ui_manager.h"
 
 /**
@@ -80,6 +81,8 @@ struct save_info {
     int savemode;
     //! Call group to be saved
     sip_call_group_t *group;
+    //! Running export (NULL if not saving)
+    capture_export_t *export;
 };
 
 /**
@@ -110,7 +113,7 @@ save_destroy();
  * status
  *
  * @param panel Ncurses panel pointer
- * @return 0 if the panel has been drawn, -1 otherwise
+ * @return 0 if the panel has been drawn, 1 if export has finished
  */
 extern int
 save_draw(PANEL *panel);
@@ -154,12 +157,14 @@ extern void
 save_error_message(PANEL *panel, const char *message);
 
 /**
- * @brief Save form data to options
+ * @brief Start saving selected dialogs
  *
- * This function will try to copy the temporal file to
- * another location user entered
+ * This function will start exporting packets of selected dialogs
+ * to the file user entered. Panel will display export progress
+ * and will be closed when export finishes.
  *
  * @param panel Save panel pointer
+ * @return 0 if export has started, 1 otherwise
  */
 extern int
 save_to_file(PANEL *panel);
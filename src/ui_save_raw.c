@@ -258,7 +258,7 @@ save_raw_to_file(PANEL *panel)
     while ((msg = call_group_get_next_msg(info->group, msg))) {
         fprintf(f, "%s %s %s -> %s\n%s\n\n", msg_get_attribute(msg, SIP_ATTR_DATE),
                 msg_get_attribute(msg, SIP_ATTR_TIME), msg_get_attribute(msg, SIP_ATTR_SRC),
-                msg_get_attribute(msg, SIP_ATTR_DST), msg->payload);
+                msg_get_attribute(msg, SIP_ATTR_DST), msg_get_payload(msg));
     }
 
     fclose(f);
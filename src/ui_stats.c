@@ -0,0 +1,335 @@
+/**************************************************************************
+ **
+ ** sngrep - SIP Messages flow viewer
+ **
+ ** Copyright (C) 2013,2014 Ivan Alonso (Kaian)
+ ** Copyright (C) 2013,2014 Irontec SL. All rights reserved.
+ **
+ ** This program is free software: you can redistribute it and/or modify
+ ** it under the terms of the GNU General Public License as published by
+ ** the Free Software Foundation, either version 3 of the License, or
+ ** (at your option) any later version.
+ **
+ ** This program is distributed in the hope that it will be useful,
+ ** but WITHOUT ANY WARRANTY; without even the implied warranty of
+ ** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ ** GNU General Public License for more details.
+ **
+ ** You should have received a copy of the GNU General Public License
+ ** along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ **
+ ****************************************************************************/
+/**
+ * @file ui_stats.c
+ * @author Ivan Alonso [aka Kaian] <kaian@irontec.com>
+ *
+ * @brief Source of functions defined in ui_stats.h
+ *
+ */
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "capture.h"
+#include "stats.h"
+#include "trace.h"
+#include "ui_stats.h"
+
+/***
+ *
+ * Some basic ascii art of this panel.
+ *
+ * +--------------------------------------------------------+
+ * |                     Title                              |
+ * | Window seconds, setups, ASR, NER, retrans, rejected    |
+ * |                                                        |
+ * | Requests         | Top Sources      | Top From Users   |
+ * |                  |                  |                  |
+ * |                  |                  |                  |
+ * | Responses        | Top Destinations | Top Error Sources|
+ * |                  |                  |                  |
+ * |                  |                  |                  |
+ * | Usefull hotkeys                                        |
+ * +--------------------------------------------------------+
+ *
+ */
+
+/**
+ * Ui Structure definition for Statistics panel
+ */
+ui_t ui_stats = {
+    .type = PANEL_STATS,
+    .panel = NULL,
+    .create = stats_create,
+    .destroy = stats_destroy,
+    .draw = stats_draw,
+    .handle_key = stats_handle_key,
+    .help = stats_help,
+    .redraw_interval = stats_redraw_interval
+};
+
+//! Titles of top lists
+static const char *stats_top_titles[STATS_TOP_COUNT] = {
+    "Top Sources", "Top Destinations", "Top From Users", "Top Error Sources"
+};
+
+#ifdef WITH_TRACING
+//! Show processing stages latency instead of traffic (hidden 'T' key)
+static int stats_show_trace = 0;
+#endif
+
+PANEL *
+stats_create()
+{
+    PANEL *panel;
+
+    // Create a new panel to fill all the screen
+    panel = new_panel(newwin(LINES, COLS, 0, 0));
+
+    // Draw title and keybindings
+    draw_title(panel, "sngrep - Traffic statistics");
+    stats_draw_footer(panel);
+
+    return panel;
+}
+
+void
+stats_destroy(PANEL *panel)
+{
+    WINDOW *win = panel_window(panel);
+
+    // Deallocate panel window
+    del_panel(panel);
+    delwin(win);
+}
+
+void
+stats_draw_footer(PANEL *panel)
+{
+    const char *keybindings[] = {
+        "Esc",
+        "Calls List",
+        "F1",
+        "Help",
+        "F5",
+        "Reset"
+    };
+
+    draw_keybindings(panel, keybindings, 6);
+}
+
+/**
+ * @brief Format a percentage or a dash if there is no total
+ */
+static const char *
+stats_ratio(int value, int total, char *text)
+{
+    if (total) {
+        sprintf(text, "%.1f%%", value * 100.0 / total);
+    } else {
+        sprintf(text, "-");
+    }
+    return text;
+}
+
+/**
+ * @brief Draw a top list starting at the given position
+ */
+static void
+stats_draw_top(WINDOW *win, enum stats_top top, time_t now, int line, int col, int width, int rows)
+{
+    stats_topk_entry_t entries[STATS_TOPN];
+    int i, count;
+
+    if (rows > STATS_TOPN)
+        rows = STATS_TOPN;
+
+    wattron(win, A_BOLD);
+    mvwprintw(win, line++, col, "%-*.*s%8s", width - 8, width - 8, stats_top_titles[top], "Count");
+    wattroff(win, A_BOLD);
+
+    count = stats_get_top(top, now, entries, rows);
+    for (i = 0; i < count; i++) {
+        mvwprintw(win, line++, col, "%-*.*s%8d", width - 8, width - 8, entries[i].key,
+                  entries[i].count);
+    }
+}
+
+#ifdef WITH_TRACING
+/**
+ * @brief Draw latency percentiles of processing stages
+ */
+static int
+stats_draw_trace(WINDOW *win)
+{
+    trace_stats_t stats;
+    int i;
+
+    wattron(win, A_BOLD);
+    mvwprintw(win, 2, 2, "%-10s%12s%12s%12s%12s%12s", "Stage", "Count", "p50 ns", "p99 ns",
+              "p999 ns", "max ns");
+    wattroff(win, A_BOLD);
+
+    for (i = 0; i < TRACE_STAGE_COUNT; i++) {
+        trace_get_stats(i, &stats);
+        mvwprintw(win, 3 + i, 2, "%-10s%12llu%12llu%12llu%12llu%12llu", trace_stage_name(i),
+                  (unsigned long long) stats.count, (unsigned long long) stats.p50,
+                  (unsigned long long) stats.p99, (unsigned long long) stats.p999,
+                  (unsigned long long) stats.max);
+    }
+    return 0;
+}
+#endif
+
+int
+stats_draw(PANEL *panel)
+{
+    WINDOW *win = panel_window(panel);
+    stats_bucket_t total;
+    char asr[16], ner[16];
+    int height, width, seconds, i, line, colwidth, rows;
+    time_t now;
+
+    getmaxyx(win, height, width);
+
+    // Live captures window ends now, even if there is no traffic
+    now = (capture_is_online()) ? time(NULL) : 0;
+
+    // Clear previous data
+    for (line = 1; line < height - 1; line++)
+        mvwprintw(win, line, 0, "%*s", width, "");
+
+#ifdef WITH_TRACING
+    if (stats_show_trace)
+        return stats_draw_trace(win);
+#endif
+
+    // Get counters of the statistics window
+    if (!(seconds = stats_get_window(now, &total))) {
+        mvwprintw(win, 2, 2, "No traffic captured yet");
+        return 0;
+    }
+
+    // Draw window summary
+    mvwprintw(win, 2, 2, "Last %ds   Call setups: %d   ASR: %s   NER: %s   Retrans: %.2f/s"
+              "   Rejected: %.2f/s",
+              seconds, total.setups, stats_ratio(total.answered, total.setups, asr),
+              stats_ratio(total.effective, total.setups, ner), (double) total.retrans / seconds,
+              (double) total.rejected / seconds);
+
+    // Draw request rates by method
+    line = 4;
+    wattron(win, A_BOLD);
+    mvwprintw(win, line++, 2, "%-12s%8s%10s", "Requests", "Count", "Rate/s");
+    wattroff(win, A_BOLD);
+    for (i = 0; i < STATS_METHOD_COUNT && line < height - 10; i++) {
+        if (!total.requests[i])
+            continue;
+        mvwprintw(win, line++, 2, "%-12s%8d%10.2f", stats_method_name(i), total.requests[i],
+                  (double) total.requests[i] / seconds);
+    }
+
+    // Draw response rates by class
+    line++;
+    wattron(win, A_BOLD);
+    mvwprintw(win, line++, 2, "%-12s%8s%10s", "Responses", "Count", "Rate/s");
+    wattroff(win, A_BOLD);
+    for (i = 0; i < 6 && line < height - 1; i++) {
+        mvwprintw(win, line++, 2, "%dxx%9s%8d%10.2f", i + 1, "", total.responses[i],
+                  (double) total.responses[i] / seconds);
+    }
+
+    // Draw top lists in two columns, if there is space left
+    colwidth = (width - 36) / 2 - 2;
+    if (colwidth < 20)
+        return 0;
+    rows = (height - 6) / 2 - 2;
+    stats_draw_top(win, STATS_TOP_SRC, now, 4, 36, colwidth, rows);
+    stats_draw_top(win, STATS_TOP_DST, now, 4 + rows + 2, 36, colwidth, rows);
+    stats_draw_top(win, STATS_TOP_FROM, now, 4, 38 + colwidth, colwidth, rows);
+    stats_draw_top(win, STATS_TOP_ERROR, now, 4 + rows + 2, 38 + colwidth, colwidth, rows);
+
+    return 0;
+}
+
+int
+stats_handle_key(PANEL *panel, int key)
+{
+    switch (key) {
+        case KEY_F(5):
+            // Start counting again
+            stats_clear();
+#ifdef WITH_TRACING
+            trace_clear();
+#endif
+            break;
+#ifdef WITH_TRACING
+        case 'T':
+            // Toggle processing stages latency
+            stats_show_trace = !stats_show_trace;
+            break;
+#endif
+        default:
+            return key;
+    }
+
+    return 0;
+}
+
+int
+stats_redraw_interval(PANEL *panel)
+{
+    // Rates of online captures decrease when traffic stops
+    return (capture_is_online()) ? STATS_REFRESH : 0;
+}
+
+int
+stats_help(PANEL *panel)
+{
+    WINDOW *help_win;
+    PANEL *help_panel;
+    int height, width;
+
+    // Create a new panel and show centered
+    height = 16;
+    width = 65;
+    help_win = newwin(height, width, (LINES - height) / 2, (COLS - width) / 2);
+    help_panel = new_panel(help_win);
+
+    // Set the window title
+    mvwprintw(help_win, 1, 22, "Traffic Statistics Help");
+
+    // Write border and boxes around the window
+    wattron(help_win, COLOR_PAIR(CP_BLUE_ON_DEF));
+    box(help_win, 0, 0);
+    mvwhline(help_win, 2, 1, ACS_HLINE, width - 2);
+    mvwhline(help_win, height - 3, 1, ACS_HLINE, width - 2);
+    mvwaddch(help_win, 2, 0, ACS_LTEE);
+    mvwaddch(help_win, height - 3, 0, ACS_LTEE);
+    mvwaddch(help_win, 2, 64, ACS_RTEE);
+    mvwaddch(help_win, height - 3, 64, ACS_RTEE);
+    wattroff(help_win, COLOR_PAIR(CP_BLUE_ON_DEF));
+
+    // Set the window footer (nice blue?)
+    mvwprintw(help_win, height - 2, 20, "Press any key to continue");
+
+    // Some brief explanation abotu what window shows
+    wattron(help_win, COLOR_PAIR(CP_CYAN_ON_DEF));
+    mvwprintw(help_win, 3, 2, "This window shows statistics of the last seconds of traffic.");
+    mvwprintw(help_win, 4, 2, "Top lists also include the previous minute of traffic.");
+    wattroff(help_win, COLOR_PAIR(CP_CYAN_ON_DEF));
+    mvwprintw(help_win, 6, 2, "ASR        Answered call setups");
+    mvwprintw(help_win, 7, 2, "NER        Answered, busy, not answered, declined or");
+    mvwprintw(help_win, 8, 2, "           cancelled call setups");
+    mvwprintw(help_win, 9, 2, "Retrans    Retransmitted messages per second");
+    mvwprintw(help_win, 11, 2, "Esc/Q      Return to Call List");
+    mvwprintw(help_win, 12, 2, "F5         Reset statistics");
+
+    // Press any key to close
+    wgetch(help_win);
+    del_panel(help_panel);
+    delwin(help_win);
+    update_panels();
+    doupdate();
+
+    return 0;
+}
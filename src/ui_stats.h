@@ -0,0 +1,107 @@
+/**************************************************************************
+ **
+ ** sngrep - SIP Messages flow viewer
+ **
+ ** Copyright (C) 2013,2014 Ivan Alonso (Kaian)
+ ** Copyright (C) 2013,2014 Irontec SL. All rights reserved.
+ **
+ ** This program is free software: you can redistribute it and/or modify
+ ** it under the terms of the GNU General Public License as published by
+ ** the Free Software Foundation, either version 3 of the License, or
+ ** (at your option) any later version.
+ **
+ ** This program is distributed in the hope that it will be useful,
+ ** but WITHOUT ANY WARRANTY; without even the implied warranty of
+ ** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ ** GNU General Public License for more details.
+ **
+ ** You should have received a copy of the GNU General Public License
+ ** along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ **
+ ****************************************************************************/
+/**
+ * @file ui_stats.h
+ * @author Ivan Alonso [aka Kaian] <kaian@irontec.com>
+ *
+ * @brief Functions to manage traffic statistics panel
+ *
+ * This panel shows the aggregated statistics of the last seconds of
+ * traffic (see stats.h): request rates by method, responses by class,
+ * call setup ratios and the most active addresses and users.
+ */
+#ifndef __UI_STATS_H
+#define __UI_STATS_H
+
+#include "config.h"
+#include "ui_manager.h"
+
+//! Max number of keys displayed in each top list
+#define STATS_TOPN 20
+//! Msecs between redraws while capturing online
+#define STATS_REFRESH 1000
+
+/**
+ * @brief Create statistics panel
+ *
+ * @return the allocated ncurses panel
+ */
+PANEL *
+stats_create();
+
+/**
+ * @brief Deallocate panel memory
+ *
+ * @param panel Ncurses panel pointer
+ */
+void
+stats_destroy(PANEL *panel);
+
+/**
+ * @brief Redraw panel data
+ *
+ * Statistics are drawn again each time the panel is redrawn, so they
+ * are updated while new messages are captured.
+ *
+ * @param panel Ncurses panel pointer
+ * @return 0 in all cases
+ */
+int
+stats_draw(PANEL *panel);
+
+/**
+ * @brief Draw panel footer
+ *
+ * @param panel Ncurses panel pointer
+ */
+void
+stats_draw_footer(PANEL *panel);
+
+/**
+ * @brief Handle key strokes
+ *
+ * @param panel Ncurses panel pointer
+ * @param key Pressed keycode
+ * @return 0 if the function can handle the key, key otherwise
+ */
+int
+stats_handle_key(PANEL *panel, int key);
+
+/**
+ * @brief Request the panel to show its help
+ *
+ * @param panel Ncurses panel pointer
+ * @return 0 if the screen has help
+ */
+int
+stats_help(PANEL *panel);
+
+/**
+ * @brief Get the interval to redraw the panel without new messages
+ *
+ * @param panel Ncurses panel pointer
+ * @return STATS_REFRESH msecs while capturing online, 0 otherwise
+ */
+int
+stats_redraw_interval(PANEL *panel);
+
+#endif